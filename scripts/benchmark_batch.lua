@@ -0,0 +1,59 @@
+-- Lose Face - An open source face recognition project
+-- Copyright (C) 2008-2010 David Capello
+-- All rights reserved.
+--
+-- Description:
+--   Measures the time of each training epoch of a MLP using different
+--   batch sizes (see "batch" parameter of mlp:train).
+--
+-- Usage:
+--   You can use this script directly running the following command:
+--
+--     loseface benchmark_batch.lua [PATTERNS_DIR INPUTS HIDDENS SUBJECTS]
+--
+-- Parameters:
+--   PATTERNS_DIR: Directory where patterns are located (default "orl_patterns",
+--                 you can create them with orl_patterns.lua)
+--   INPUTS: Number of inputs for the MLP (default 50)
+--   HIDDENS: Number of hidden neurons for the MLP (default 60)
+--   SUBJECTS: Number of outputs for the MLP (default 40)
+
+PATTERNS_DIR = arg[1] or "orl_patterns"
+INPUTS = tonumber(arg[2] or 50)
+HIDDENS = tonumber(arg[3] or 60)
+SUBJECTS = tonumber(arg[4] or 40)
+
+LEARNING_RATE = 0.6
+MOMENTUM = 0.1
+EPOCHS = 100
+BATCH_SIZES = { 1, 4, 16, 64, 256 }
+
+local train_set = ann.PatternSet({ file=string.format("%s/%d_fold1_training.txt", PATTERNS_DIR, INPUTS), inputs=INPUTS, outputs=SUBJECTS })
+
+local n = ann.Normalizer(train_set)
+n:normalize(train_set)
+
+print("----------------------------------------------------------------------")
+print("INPUTS="..INPUTS.." HIDDENS="..HIDDENS.." SUBJECTS="..SUBJECTS)
+print("BATCH\tSECS/EPOCH\tMSE")
+
+for i = 1,#BATCH_SIZES do
+  local batch = BATCH_SIZES[i]
+
+  ann.init_random(1)
+  local mlp = ann.Mlp({ inputs=INPUTS, hiddens=HIDDENS, outputs=SUBJECTS, hiddenfunc=ann.LOGSIG, outputfunc=ann.LOGSIG })
+  mlp:init({ min=-1.0, max=1.0 })
+
+  -- The learning rate is applied to the sum of the deltas of each
+  -- batch, so it is divided by the batch size to compare MSEs
+  local t = os.clock()
+  mlp:train({ learning_rate=LEARNING_RATE/batch,
+	      momentum=MOMENTUM,
+	      set=train_set,
+	      epochs=EPOCHS,
+	      shuffle=1,
+	      batch=batch })
+  t = os.clock() - t
+
+  print(string.format("%d\t%.6f\t%.6g", batch, t/EPOCHS, mlp:mse(train_set)))
+end
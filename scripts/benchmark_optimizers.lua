@@ -0,0 +1,81 @@
+-- Lose Face - An open source face recognition project
+-- Copyright (C) 2008-2010 David Capello
+-- All rights reserved.
+--
+-- Description:
+--   Measures the epochs and the time that ann.RPROP and ann.ADAM
+--   need to reach the MSE that the default training (steepest
+--   descent, as in mlp_global.lua) reaches in a fixed number of
+--   epochs (see "algorithm" parameter of mlp:train).
+--
+-- Usage:
+--   You can use this script directly running the following command:
+--
+--     loseface benchmark_optimizers.lua [PATTERNS_DIR INPUTS HIDDENS SUBJECTS EPOCHS]
+--
+-- Parameters:
+--   PATTERNS_DIR: Directory where patterns are located (default "orl_patterns",
+--                 you can create them with orl_patterns.lua)
+--   INPUTS: Number of inputs for the MLP (default 50)
+--   HIDDENS: Number of hidden neurons for the MLP (default 60)
+--   SUBJECTS: Number of outputs for the MLP (default 40)
+--   EPOCHS: Epochs of the default training (default 400)
+
+PATTERNS_DIR = arg[1] or "orl_patterns"
+INPUTS = tonumber(arg[2] or 50)
+HIDDENS = tonumber(arg[3] or 60)
+SUBJECTS = tonumber(arg[4] or 40)
+EPOCHS = tonumber(arg[5] or 400)
+
+LEARNING_RATE = 0.6
+MOMENTUM = 0.1
+MAX_EPOCHS = 10 * EPOCHS
+ADAM_LEARNING_RATE = 0.01
+ADAM_BATCH = 16
+
+local train_set = ann.PatternSet({ file=string.format("%s/%d_fold1_training.txt", PATTERNS_DIR, INPUTS), inputs=INPUTS, outputs=SUBJECTS })
+
+local n = ann.Normalizer(train_set)
+n:normalize(train_set)
+
+function create_mlp()
+  ann.init_random(1)
+  local mlp = ann.Mlp({ inputs=INPUTS, hiddens=HIDDENS, outputs=SUBJECTS, hiddenfunc=ann.LOGSIG, outputfunc=ann.LOGSIG })
+  mlp:init({ min=-1.0, max=1.0 })
+  return mlp
+end
+
+print("----------------------------------------------------------------------")
+print("INPUTS="..INPUTS.." HIDDENS="..HIDDENS.." SUBJECTS="..SUBJECTS)
+print("ALGORITHM\tEPOCHS\tSECS\tMSE")
+
+-- Default training
+local mlp = create_mlp()
+local t = os.clock()
+mlp:train({ learning_rate=LEARNING_RATE,
+	    momentum=MOMENTUM,
+	    set=train_set,
+	    epochs=EPOCHS,
+	    shuffle=1 })
+t = os.clock() - t
+local goal_mse = mlp:mse(train_set)
+print(string.format("BACKPROP\t%d\t%.3f\t%.6g", EPOCHS, t, goal_mse))
+
+-- The same MSE with the other algorithms
+local algorithms = {
+  { name="RPROP", params={ algorithm=ann.RPROP } },
+  { name="ADAM", params={ algorithm=ann.ADAM, learning_rate=ADAM_LEARNING_RATE, batch=ADAM_BATCH, shuffle=1 } }
+}
+
+for i = 1,#algorithms do
+  local params = algorithms[i].params
+  params.set = train_set
+  params.epochs = MAX_EPOCHS
+  params.goal_mse = goal_mse
+
+  mlp = create_mlp()
+  t = os.clock()
+  local epochs = mlp:train(params)
+  t = os.clock() - t
+  print(string.format("%s\t%d\t%.3f\t%.6g", algorithms[i].name, epochs, t, mlp:mse(train_set)))
+end
@@ -83,16 +83,6 @@ function do_train_fixed(mlp, train_set, epochs)
 	      goal=ann.BESTMSE })
 end
 
-function do_train_mse(mlp, train_set, mse, max_epochs)
-  return
-  mlp:train({ learning_rate=LEARNING_RATE,
-	      momentum=MOMENTUM,
-	      set=train_set,
-	      epochs=max_epochs,
-	      shuffle=1,
-	      goal_mse=mse })
-end
-
 ----------------------------------------------------------------------
 
 function get_fold(k)
@@ -136,24 +126,15 @@ function test_array(array, set)
     -- 'subject_nth', but we do not use the 'target' for testing,
     -- so the outputs of 'positive_set' is irrelevant
     local positive_set = prepare_positive_patterns(subject_nth, set)
-    local outputs = array:recall(positive_set)
-    for j=1,#outputs do
-      local output = outputs[j]
-
-      -- get the max output
-      local max_pos = 0
-      for i=1,#output do
-	--if output[i] > 0 then
-	if max_pos == 0 or output[max_pos] < output[i] then
-	  max_pos = i
+    if #positive_set > 0 then
+      local outputs = array:recall_batch(positive_set)
+      for j=1,outputs:cols() do
+	-- get the max output
+	if outputs:max_pos(j) == subject_nth then
+	  hits = hits+1;
 	end
-	--end
+	total = total+1;
       end
-
-      if max_pos == subject_nth then
-	hits = hits+1;
-      end
-      total = total+1;
     end
   end
 
@@ -180,37 +161,62 @@ for i=1,FOLDS do
   for seed=1,REPEAT_EACH_FOLD do
     -- We create "SUBJECTS" MLP networks (one MLP to identify one subject)
     local mlps = {}
-    for subject_nth = 1,SUBJECTS do
-      t1 = os.date()
+    local array
 
-      -- Create a new MLP for subject 'subject_nth'
-      local mlp = create_mlp(seed)
-
-      -- Get the positive/negative patterns for this particular network
-      local positive_set = prepare_positive_patterns(subject_nth, train_set)
-      local negative_sets = prepare_negative_patterns(subject_nth, train_set)
+    ----------------------------------------------------------------------
+    -- basic training: all the networks are trained in parallel
+    if NUMBER_OF_NEGATIVES == 0 then
+      for subject_nth = 1,SUBJECTS do
+	table.insert(mlps, create_mlp(seed))
+      end
+      array = ann.MlpArray(mlps)
+
+      local params = { learning_rate=LEARNING_RATE,
+		       momentum=MOMENTUM,
+		       set=train_set,
+		       shuffle=1,
+		       seed=seed }
+      if STOP_GOAL == "fixed" then
+	params.epochs = FIXED_EPOCHS
+	params.goal = ann.BESTMSE
+      elseif STOP_GOAL == "mse" then
+	params.epochs = MAX_EPOCHS_FOR_MSE_GOAL
+	params.goal_mse = MSE_GOAL
+      end
 
-      local fullmix = ann.PatternSet()
-      fullmix:merge(positive_set)
-      for i=1,#negative_sets do
-	fullmix:merge(negative_sets[i])
+      t1 = os.date()
+      local epochs, adjustements, stats = array:train_all(params)
+      t2 = os.date()
+      for subject_nth = 1,SUBJECTS do
+	print(string.format("	 MLP#%02d MSE=%.16g\t(%s-%s) epochs=%d (adjustements=%d)",
+			    subject_nth, stats.mse[subject_nth], t1, t2,
+			    epochs[subject_nth], adjustements[subject_nth]))
       end
 
-      local epochs = 0
-      local adjustements = 0
+    ----------------------------------------------------------------------
+    -- special training: each network is trained with its own mixes
+    else
+      for subject_nth = 1,SUBJECTS do
+	t1 = os.date()
 
-      ----------------------------------------------------------------------
-      -- basic training
-      if NUMBER_OF_NEGATIVES == 0 then
-	if STOP_GOAL == "fixed" then
-	  epochs = do_train_fixed(mlp, fullmix, FIXED_EPOCHS)
-	elseif STOP_GOAL == "mse" then
-	  epochs = do_train_mse(mlp, fullmix, MSE_GOAL, MAX_EPOCHS_FOR_MSE_GOAL)
+	-- Create a new MLP for subject 'subject_nth'
+	local mlp = create_mlp(seed)
+
+	-- Get the positive/negative patterns for this particular network
+	local positive_set = prepare_positive_patterns(subject_nth, train_set)
+	local negative_sets = prepare_negative_patterns(subject_nth, train_set)
+
+	local fullmix = ann.PatternSet()
+	fullmix:merge(positive_set)
+	for i=1,#negative_sets do
+	  fullmix:merge(negative_sets[i])
 	end
-	adjustements = epochs * #fullmix
-      ----------------------------------------------------------------------
-      -- mixing patterns 1 positive + 'NUMBER_OF_NEGATIVES' negatives
-      else
+
+	local epochs = 0
+	local adjustements = 0
+
+	----------------------------------------------------------------------
+	-- mixing patterns 1 positive + 'NUMBER_OF_NEGATIVES' negatives
 	if STOP_GOAL == "fixed" then
 	  for i=1,SPECIAL_TRAINING_WHOLE_PROCESS_TIMES do
 	    for j=1,#negative_sets,NUMBER_OF_NEGATIVES do -- rotate negative patterns
@@ -253,20 +259,22 @@ for i=1,FOLDS do
 	    end
 	  end
 	end
-      end
 
-      ----------------------------------------------------------------------
+	----------------------------------------------------------------------
 
-      t2 = os.date()
-      print(string.format("	 MLP#%02d MSE=%.16g\t(%s-%s) epochs=%d (adjustements=%d)",
-			  subject_nth, mlp:mse(fullmix), t1, t2, epochs, adjustements))
+	t2 = os.date()
+	print(string.format("	 MLP#%02d MSE=%.16g\t(%s-%s) epochs=%d (adjustements=%d)",
+			    subject_nth, mlp:mse(fullmix), t1, t2, epochs, adjustements))
 
-      table.insert(mlps, mlp)
+	table.insert(mlps, mlp)
+      end
     end
     print(string.format("    TRAINING END "..os.date()))
 
     -- create the array of networks
-    local array = ann.MlpArray(mlps)
+    if array == nil then
+      array = ann.MlpArray(mlps)
+    end
     --print("  test_array(train_set)")
     table.insert(hits_train, test_array(array, train_set))
     --print("  test_array(test_set)")
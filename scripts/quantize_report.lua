@@ -0,0 +1,119 @@
+-- Lose Face - An open source face recognition project
+-- Copyright (C) 2008-2010 David Capello
+-- All rights reserved.
+--
+-- Description:
+--   Trains a global MLP and an array of MLPs, quantizes them to 8-bit
+--   integers (see ann.QuantizedMlp), and reports the hits of each
+--   network and its quantized copy with the testing patterns (held-out
+--   set) next to the recall throughput of both.
+--
+-- Usage:
+--   You can use this script directly running the following command:
+--
+--     loseface quantize_report.lua [PATTERNS_DIR INPUTS HIDDENS SUBJECTS]
+--
+-- Parameters:
+--   PATTERNS_DIR: Directory where patterns are located (default "orl_patterns",
+--                 you can create them with orl_patterns.lua)
+--   INPUTS: Number of inputs for the MLPs (default 50)
+--   HIDDENS: Number of hidden neurons of the global MLP (default 60)
+--   SUBJECTS: Number of subjects (default 40)
+
+PATTERNS_DIR = arg[1] or "orl_patterns"
+INPUTS = tonumber(arg[2] or 50)
+HIDDENS = tonumber(arg[3] or 60)
+SUBJECTS = tonumber(arg[4] or 40)
+
+LEARNING_RATE = 0.6
+MOMENTUM = 0.1
+EPOCHS = 400
+ARRAY_HIDDENS = 10 -- Hidden neurons of each MLP in the array
+REPEAT_RECALL = 50 -- Times that the testing set is recalled to measure the throughput
+
+----------------------------------------------------------------------
+
+-- Returns the proportion of patterns of "set" recognized by "net"
+-- (a Mlp, MlpArray or QuantizedMlp)
+function test_net(net, set)
+  local hits = 0
+  local total = 0
+
+  for subject_nth = 1,SUBJECTS do
+    local subject_set = set:split_by_output({ subject_nth })[1]
+    if #subject_set > 0 then
+      local outputs = net:recall_batch(subject_set)
+      for j=1,outputs:cols() do
+	if outputs:max_pos(j) == subject_nth then
+	  hits = hits+1
+	end
+      end
+      total = total + outputs:cols()
+    end
+  end
+
+  return hits/total
+end
+
+-- Returns the number of patterns per second that "net" recalls
+function throughput(net, set)
+  local t = os.clock()
+  for i = 1,REPEAT_RECALL do
+    net:recall_batch(set)
+  end
+  t = os.clock() - t
+  return REPEAT_RECALL * #set / t
+end
+
+function report(name, net, test_set)
+  local qnet = ann.QuantizedMlp(net)
+
+  local hits = test_net(net, test_set)
+  local qhits = test_net(qnet, test_set)
+  local speed = throughput(net, test_set)
+  local qspeed = throughput(qnet, test_set)
+
+  print(string.format("%s\tdouble\t%.4f\t%.0f", name, hits, speed))
+  print(string.format("%s\tint8\t%.4f\t%.0f", name, qhits, qspeed))
+  print(string.format("%s\tdelta\t%+.4f\tx%.2f", name, qhits-hits, qspeed/speed))
+end
+
+----------------------------------------------------------------------
+
+local train_set = ann.PatternSet({ file=string.format("%s/%d_fold1_training.txt", PATTERNS_DIR, INPUTS), inputs=INPUTS, outputs=SUBJECTS })
+local test_set = ann.PatternSet({ file=string.format("%s/%d_fold1_testing.txt", PATTERNS_DIR, INPUTS), inputs=INPUTS, outputs=SUBJECTS })
+
+local n = ann.Normalizer(train_set)
+n:normalize(train_set)
+n:normalize(test_set)
+
+print("----------------------------------------------------------------------")
+print("INPUTS="..INPUTS.." HIDDENS="..HIDDENS.." SUBJECTS="..SUBJECTS)
+print("NET\tTYPE\tHITS\tPATTERNS/SEC")
+
+-- Global MLP
+ann.init_random(1)
+local mlp = ann.Mlp({ inputs=INPUTS, hiddens=HIDDENS, outputs=SUBJECTS, hiddenfunc=ann.LOGSIG, outputfunc=ann.LOGSIG })
+mlp:init({ min=-1.0, max=1.0 })
+mlp:train({ learning_rate=LEARNING_RATE,
+	    momentum=MOMENTUM,
+	    set=train_set,
+	    epochs=EPOCHS,
+	    shuffle=1,
+	    goal=ann.BESTMSE })
+report("global", mlp, test_set)
+
+-- Array of MLPs (one output for each subject)
+local mlps = {}
+for i = 1,SUBJECTS do
+  table.insert(mlps, ann.Mlp({ inputs=INPUTS, hiddens=ARRAY_HIDDENS, outputs=1, hiddenfunc=ann.LOGSIG, outputfunc=ann.LOGSIG }))
+end
+local array = ann.MlpArray(mlps)
+array:train_all({ set=train_set,
+		  learning_rate=LEARNING_RATE,
+		  momentum=MOMENTUM,
+		  epochs=EPOCHS,
+		  shuffle=1,
+		  goal=ann.BESTMSE,
+		  init={ min=-1.0, max=1.0 } })
+report("array", array, test_set)
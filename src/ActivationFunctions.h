@@ -8,13 +8,26 @@
 
 #include <cmath>
 
+/// Activation functions that have specialized (whole-layer) forms
+/// in MlpKernels. Other functions are called neuron by neuron.
+///
+enum ActivationKind {
+  CustomActivation,
+  PurelinActivation,
+  LogsigActivation,
+  TansigActivation
+};
+
 /// Base class for activation functions.
 ///
 class ActivationFunction
 {
 public:
+  virtual ~ActivationFunction() { }
+
   virtual double f(double x) = 0;
   virtual double df(double x, double s) = 0;
+  virtual ActivationKind getKind() const { return CustomActivation; }
 
   virtual ActivationFunction* clone() const = 0;
 };
@@ -27,6 +40,8 @@ public:
   double f(double x)            { return x; }
   double df(double x, double s) { return double(1.0); }
 
+  ActivationKind getKind() const { return PurelinActivation; }
+
   Purelin* clone() const { return new Purelin(*this); }
 };
 
@@ -38,6 +53,8 @@ public:
   double  f(double x)           { return double(1) / (double(1) + std::exp(-x)); }
   double df(double x, double s) { return s * (double(1) - s); }
 
+  ActivationKind getKind() const { return LogsigActivation; }
+
   Logsig* clone() const { return new Logsig(*this); }
 };
 
@@ -49,6 +66,8 @@ public:
   double  f(double x)		{ return std::tanh(x); }
   double df(double x, double s)	{ return double(1) - s*s; }
 
+  ActivationKind getKind() const { return TansigActivation; }
+
   Tansig* clone() const { return new Tansig(*this); }
 };
 
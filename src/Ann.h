@@ -11,6 +11,9 @@
 #include "ActivationFunctions.h"
 #include "Mlp.h"
 #include "MlpArray.h"
+#include "MlpKernels.h"
 #include "Backpropagation.h"
+#include "LevenbergMarquardt.h"
+#include "QuantizedMlp.h"
 
 #endif // LOSEFACE_ANN_H
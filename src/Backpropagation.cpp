@@ -3,18 +3,36 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "Backpropagation.h"
 #include "Mlp.h"
 #include "PatternSet.h"
 #include "ActivationFunctions.h"
+#include "MlpKernels.h"
+#include "Blas.h"
+#include "Thread.h"
 
 //////////////////////////////////////////////////////////////////////
 // Helper class to update weights
 //////////////////////////////////////////////////////////////////////
 
+/// Keeps the last delta applied to each weight (to use momentum) and
+/// applies new deltas in place. For each weight:
+///
+///   oldDelta = momentum*oldDelta + eta*delta(k)*input(j)
+///   weight += oldDelta
+///
+/// is calculated in just one pass over the weights matrix, without
+/// temporary matrices.
+///
+template<class T>
 class UpdateWeightsHelper
 {
-  Mlp m_oldDelta, m_tmp;
+  MatrixT<T> m_oldWeight1, m_oldWeight2;
+  VectorT<T> m_oldBias1, m_oldBias2;
   bool m_valid;
 
 public:
@@ -23,25 +41,98 @@ public:
     m_valid = false;
   }
 
-  void beforePatterns(Mlp& zeroDelta)
+  void beforePatterns(const MlpT<T>& net)
   {
     if (!m_valid) {
       m_valid = true;
-      m_oldDelta = zeroDelta;
+      m_oldWeight1.resize(net.getHiddens(), net.getInputs());
+      m_oldWeight2.resize(net.getOutputs(), net.getHiddens());
+      m_oldBias1.resize(net.getHiddens());
+      m_oldBias2.resize(net.getOutputs());
+      m_oldWeight1.zero();
+      m_oldWeight2.zero();
+      m_oldBias1.zero();
+      m_oldBias2.zero();
     }
   }
 
-  void applyWeights(Mlp& net, Mlp& delta, double momentum)
+  /// @param delta
+  ///   Delta of each neuron of the layer multiplied by the learning
+  ///   rate.
+  void applyHiddenLayer(MatrixT<T>& weight1, VectorT<T>& bias1,
+			const VectorT<T>& delta, const VectorT<T>& input, T momentum)
+  {
+    apply(weight1, bias1, m_oldWeight1, m_oldBias1, delta, input, momentum);
+  }
+
+  void applyOutputLayer(MatrixT<T>& weight2, VectorT<T>& bias2,
+			const VectorT<T>& delta, const VectorT<T>& hidden, T momentum)
+  {
+    apply(weight2, bias2, m_oldWeight2, m_oldBias2, delta, hidden, momentum);
+  }
+
+  /// Applies the already calculated deltas of a batch of patterns
+  /// (multiplied by the learning rate).
+  void applyHiddenLayer(MatrixT<T>& weight1, VectorT<T>& bias1,
+			const MatrixT<T>& delta, const VectorT<T>& deltaBias, T momentum)
   {
-#if 0
-    m_oldDelta = delta + m_oldDelta * momentum;
-#else  // optimized (without temporary objects)
-    m_tmp = m_oldDelta;
-    m_tmp *= momentum;
-    m_tmp += delta;
-    m_oldDelta = m_tmp;
-#endif
-    net += m_oldDelta;
+    apply(weight1, bias1, m_oldWeight1, m_oldBias1, delta, deltaBias, momentum);
+  }
+
+  void applyOutputLayer(MatrixT<T>& weight2, VectorT<T>& bias2,
+			const MatrixT<T>& delta, const VectorT<T>& deltaBias, T momentum)
+  {
+    apply(weight2, bias2, m_oldWeight2, m_oldBias2, delta, deltaBias, momentum);
+  }
+
+private:
+
+  static void apply(MatrixT<T>& weight, VectorT<T>& bias,
+		    MatrixT<T>& oldWeight, VectorT<T>& oldBias,
+		    const MatrixT<T>& delta, const VectorT<T>& deltaBias, T momentum)
+  {
+    const size_t n = weight.rows() * weight.cols();
+    const T* d = delta.getRaw();
+    T* w = weight.getRaw();
+    T* v = oldWeight.getRaw();
+
+    for (size_t i=0; i<n; ++i) {
+      v[i] = v[i]*momentum + d[i];
+      w[i] += v[i];
+    }
+
+    d = deltaBias.getRaw();
+    w = bias.getRaw();
+    v = oldBias.getRaw();
+    for (size_t k=0; k<bias.size(); ++k) {
+      v[k] = v[k]*momentum + d[k];
+      w[k] += v[k];
+    }
+  }
+
+  static void apply(MatrixT<T>& weight, VectorT<T>& bias,
+		    MatrixT<T>& oldWeight, VectorT<T>& oldBias,
+		    const VectorT<T>& delta, const VectorT<T>& input, T momentum)
+  {
+    const size_t rows = weight.rows();
+    const T* d = delta.getRaw();
+    T* w = weight.getRaw();
+    T* v = oldWeight.getRaw();
+
+    for (size_t j=0; j<weight.cols(); ++j, w+=rows, v+=rows) {
+      T x = input(j);
+      for (size_t k=0; k<rows; ++k) {
+	v[k] = v[k]*momentum + d[k]*x;
+	w[k] += v[k];
+      }
+    }
+
+    T* b = bias.getRaw();
+    v = oldBias.getRaw();
+    for (size_t k=0; k<rows; ++k) {
+      v[k] = v[k]*momentum + d[k];
+      b[k] += v[k];
+    }
   }
 
 };
@@ -50,21 +141,27 @@ public:
 // BoldDriverMethod
 //////////////////////////////////////////////////////////////////////
 
-BoldDriverMethod::BoldDriverMethod()
+template<class T>
+BoldDriverMethodT<T>::BoldDriverMethodT()
 {
   m_increaseFactor = 1.1;
   m_decreaseFactor = 0.5;
 }
 
-void BoldDriverMethod::beforePatterns(const Mlp& net, const PatternSet& training_set)
+/// The MSE of the previous epoch is reused if it was already
+/// calculated (see BackpropagationT::calcMSE).
+///
+template<class T>
+void BoldDriverMethodT<T>::beforePatterns(BackpropagationT<T>& bp, const MlpT<T>& net, const PatternSet& training_set)
 {
   m_netBackup = net;	// Copy the whole net
-  m_mse       = net.calcMSE(training_set);
+  m_mse       = bp.calcMSE(training_set);
 }
 
-void BoldDriverMethod::afterPatterns(Backpropagation& bp, Mlp& net, const PatternSet& training_set)
+template<class T>
+void BoldDriverMethodT<T>::afterPatterns(BackpropagationT<T>& bp, MlpT<T>& net, const PatternSet& training_set)
 {
-  double newMse = net.calcMSE(training_set);
+  double newMse = bp.calcMSE(training_set);
 
   // We are getting better (less error)
   if (newMse < m_mse) {
@@ -75,12 +172,116 @@ void BoldDriverMethod::afterPatterns(Backpropagation& bp, Mlp& net, const Patter
   else {
     // Undo the this epoch
     net = m_netBackup;
+    bp.invalidateMSE();
+    bp.setMSE(training_set, m_mse);
 
     // Decrease learning rate
     bp.setLearningRate(m_decreaseFactor * bp.getLearningRate());
   }
 }
 
+//////////////////////////////////////////////////////////////////////
+// Optimizers
+//////////////////////////////////////////////////////////////////////
+
+// Resizes the state of a block (the first time it is used)
+template<class T>
+static std::vector<T>& block_state(std::vector<std::vector<T> >& state,
+				   size_t block, size_t n, T value)
+{
+  if (state.size() <= block)
+    state.resize(block+1);
+  if (state[block].size() != n)
+    state[block].assign(n, value);
+  return state[block];
+}
+
+template<class T>
+RpropT<T>::RpropT()
+{
+  m_increaseFactor = 1.2;
+  m_decreaseFactor = 0.5;
+  m_initialStep = 0.1;
+  m_minStep = 1e-6;
+  m_maxStep = 50.0;
+  m_error = m_prevError = std::numeric_limits<double>::max();
+}
+
+template<class T>
+void RpropT<T>::beginStep(double error)
+{
+  m_prevError = m_error;
+  m_error = error;
+}
+
+template<class T>
+void RpropT<T>::update(size_t block, size_t n, T* weights, const T* gradient)
+{
+  T* step = &block_state(m_steps, block, n, T(m_initialStep))[0];
+  T* prevGradient = &block_state(m_prevGradient, block, n, T(0))[0];
+  T* prevDelta = &block_state(m_prevDelta, block, n, T(0))[0];
+  const bool worse = (m_error > m_prevError);
+
+  for (size_t i=0; i<n; ++i) {
+    T g = gradient[i];
+    T sign = prevGradient[i] * g;
+
+    if (sign > 0) {
+      step[i] = std::min<T>(step[i] * T(m_increaseFactor), T(m_maxStep));
+      prevDelta[i] = (g > 0 ? step[i]: -step[i]);
+      weights[i] += prevDelta[i];
+    }
+    else if (sign < 0) {
+      step[i] = std::max<T>(step[i] * T(m_decreaseFactor), T(m_minStep));
+      if (worse)
+	weights[i] -= prevDelta[i];
+      prevDelta[i] = 0;
+      g = 0;			// The next step does not change the step size
+    }
+    else {
+      prevDelta[i] = (g > 0 ? step[i]: (g < 0 ? -step[i]: T(0)));
+      weights[i] += prevDelta[i];
+    }
+    prevGradient[i] = g;
+  }
+}
+
+template<class T>
+AdamT<T>::AdamT(double learningRate)
+{
+  m_learningRate = learningRate;
+  m_beta1 = 0.9;
+  m_beta2 = 0.999;
+  m_epsilon = 1e-8;
+  m_step = 0;
+  m_correction1 = m_correction2 = 1.0;
+}
+
+template<class T>
+void AdamT<T>::beginStep(double /*error*/)
+{
+  ++m_step;
+  m_correction1 = 1.0 - std::pow(m_beta1, double(m_step));
+  m_correction2 = 1.0 - std::pow(m_beta2, double(m_step));
+}
+
+template<class T>
+void AdamT<T>::update(size_t block, size_t n, T* weights, const T* gradient)
+{
+  T* mean = &block_state(m_mean, block, n, T(0))[0];
+  T* variance = &block_state(m_variance, block, n, T(0))[0];
+  const T beta1 = T(m_beta1), beta2 = T(m_beta2);
+  const T rate = T(m_learningRate / m_correction1);
+  const T correction2 = T(m_correction2), epsilon = T(m_epsilon);
+
+  for (size_t i=0; i<n; ++i) {
+    T g = gradient[i];
+    mean[i] = beta1*mean[i] + (1-beta1)*g;
+    variance[i] = beta2*variance[i] + (1-beta2)*g*g;
+    weights[i] += rate * mean[i] / (std::sqrt(variance[i] / correction2) + epsilon);
+  }
+}
+
 //////////////////////////////////////////////////////////////////////
 // Backpropagation
 //////////////////////////////////////////////////////////////////////
@@ -91,94 +292,546 @@ void BoldDriverMethod::afterPatterns(Backpropagation& bp, Mlp& net, const Patter
 /// @param net The MLP to be trained (the initial weights of this net
 ///   will be used as start point).
 ///
-Backpropagation::Backpropagation(Mlp& net)
+template<class T>
+BackpropagationT<T>::BackpropagationT(MlpT<T>& net)
   : m_net(net)
 {
   m_epoch = 0;
   m_eta = 0.0001;
-  m_adaptativeLearningRate = new NoAdaptativeLearningRate();
+  m_adaptativeLearningRate = new NoAdaptativeLearningRateT<T>();
+  m_optimizer = NULL;
   m_mu = 0.0;
-  m_updateWeightsHelper = new UpdateWeightsHelper();
+  m_batchSize = 1;
+  m_threads = 1;
+  m_parallelMode = SynchronousMode;
+  m_updateWeightsHelper = new UpdateWeightsHelper<T>();
+  m_forwardPasses = 0;
+  m_trainingError = 0.0;
 }
 
-Backpropagation::~Backpropagation()
+template<class T>
+BackpropagationT<T>::~BackpropagationT()
 {
   delete m_adaptativeLearningRate;
+  delete m_optimizer;
   delete m_updateWeightsHelper;
+
+  for (size_t t=0; t<m_hogwildHelpers.size(); ++t)
+    delete m_hogwildHelpers[t];
 }
 
-AdaptativeLearningRate& Backpropagation::getAdaptativeLearningRate()
+template<class T>
+AdaptativeLearningRateT<T>& BackpropagationT<T>::getAdaptativeLearningRate()
 {
   return *m_adaptativeLearningRate;
 }
 
-const AdaptativeLearningRate& Backpropagation::getAdaptativeLearningRate() const
+template<class T>
+const AdaptativeLearningRateT<T>& BackpropagationT<T>::getAdaptativeLearningRate() const
 {
   return *m_adaptativeLearningRate;
 }
 
-void Backpropagation::setAdaptativeLearningRate(const AdaptativeLearningRate& method)
+template<class T>
+void BackpropagationT<T>::setAdaptativeLearningRate(const AdaptativeLearningRateT<T>& method)
 {
   delete m_adaptativeLearningRate;
   m_adaptativeLearningRate = method.clone();
+  invalidateMSE();
 }
 
-/// Trains just one epoch.
+/// Uses the gradient of each batch with @a optimizer (a copy of it)
+/// instead of the steepest descent. The batch size is the one
+/// returned by OptimizerT::getBatchSize, and the learning rate,
+/// momentum and Hogwild mode are not used.
 ///
-void Backpropagation::train(const PatternSet& training_set)
+template<class T>
+void BackpropagationT<T>::setOptimizer(const OptimizerT<T>& optimizer)
 {
-  PatternSet::const_iterator pattern;
-  size_t i, j, k;
+  delete m_optimizer;
+  m_optimizer = optimizer.clone();
+  invalidateMSE();
+}
+
+/// Goes back to the steepest descent with momentum (the default).
+///
+template<class T>
+void BackpropagationT<T>::useSteepestDescent()
+{
+  delete m_optimizer;
+  m_optimizer = NULL;
+  invalidateMSE();
+}
 
-  // vectors
-  Vector hidden0, hidden, delta_hidden;
-  Vector output0, output, delta_output;
+/// Calculates the MSE of the net for @a set, or returns the value
+/// calculated before if the weights were not changed since then
+/// (training epochs change them). So the adaptative learning rate
+/// and the caller can ask for the MSE of the same set after each
+/// epoch, and only one forward pass is done.
+///
+/// The MSE is calculated again if the patterns of @a set were added
+/// or modified (see PatternSet::getVersion). The net cannot be
+/// checked in the same way: if its weights are modified outside this
+/// class (e.g. the net is assigned or initialized again)
+/// #invalidateMSE must be called.
+///
+template<class T>
+double BackpropagationT<T>::calcMSE(const PatternSet& set)
+{
+  for (size_t i=0; i<m_mseCache.size(); ++i)
+    if (m_mseCache[i].set == &set) {
+      if (m_mseCache[i].version == set.getVersion())
+	return m_mseCache[i].mse;
 
-  // delta for weights
-  Mlp delta(m_net);
-  delta.zero();
+      m_mseCache.erase(m_mseCache.begin()+i);
+      break;
+    }
+
+  double mse = m_net.calcMSE(set);
+  setMSE(set, mse);
+  m_forwardPasses++;
+  return mse;
+}
+
+/// Remembers the MSE of the current weights for @a set (e.g. when
+/// the weights are restored to a state with a known MSE).
+///
+template<class T>
+void BackpropagationT<T>::setMSE(const PatternSet& set, double mse)
+{
+  CachedMSE cached;
+  cached.set = &set;
+  cached.version = set.getVersion();
+  cached.mse = mse;
+
+  for (size_t i=0; i<m_mseCache.size(); ++i)
+    if (m_mseCache[i].set == &set) {
+      m_mseCache[i] = cached;
+      return;
+    }
+  m_mseCache.push_back(cached);
+}
+
+/// Forgets all the MSE calculated with #calcMSE.
+///
+template<class T>
+void BackpropagationT<T>::invalidateMSE()
+{
+  m_mseCache.clear();
+}
+
+/// Trains just one epoch.
+///
+/// If the batch size is 1 the weights are updated after each
+/// pattern (online training), in other case they are updated after
+/// each batch of patterns (see #setBatchSize). Each batch can be
+/// calculated by several threads (see #setThreads), or in
+/// Hogwild mode each thread trains online a part of the patterns.
+///
+template<class T>
+void BackpropagationT<T>::train(const PatternSet& training_set)
+{
+  size_t threads = (m_threads > 0 ? m_threads: Thread::processors());
 
   // Pre-processing policies
-  m_updateWeightsHelper->beforePatterns(delta);
-  m_adaptativeLearningRate->beforePatterns(m_net, training_set);
+  m_updateWeightsHelper->beforePatterns(m_net);
+  m_adaptativeLearningRate->beforePatterns(*this, m_net, training_set);
+
+  // The weights are going to change
+  invalidateMSE();
+
+  double sse = 0.0;
+  if (m_optimizer)
+    sse = trainBatch(training_set,
+		     m_optimizer->getBatchSize(m_batchSize, training_set.size()),
+		     threads);
+  else if (m_parallelMode == HogwildMode && threads > 1)
+    sse = trainHogwild(training_set, threads);
+  else if (m_batchSize > 1)
+    sse = trainBatch(training_set, m_batchSize, threads);
+  else
+    trainPatterns(training_set, 0, training_set.size(), *m_updateWeightsHelper, sse);
+
+  m_forwardPasses++;
+  m_trainingError = sse / (training_set.size() * m_net.getOutputs());
+
+  // Post-processing policies
+  m_adaptativeLearningRate->afterPatterns(*this, m_net, training_set);
+
+  m_epoch++;
+}
+
+/// Online training of patterns [@a first, @a last) of the set.
+///
+/// @param sse
+///   The squared errors of the outputs are added to this variable.
+///
+template<class T>
+void BackpropagationT<T>::trainPatterns(const PatternSet& training_set,
+					size_t first, size_t last,
+					UpdateWeightsHelper<T>& helper, double& sse)
+{
+  const MlpKernels<T>& kernels(mlp_kernels<T>(*m_net.m_hiddenFunc, *m_net.m_outputFunc));
+
+  // vectors (they are reused for each pattern, so the loop does not
+  // allocate memory)
+  VectorT<T> hidden0, hidden, delta_hidden(m_net.getHiddens());
+  VectorT<T> output0, output, delta_output(m_net.getOutputs());
+  VectorT<T> input(m_net.getInputs()), target(m_net.getOutputs());
 
   // for each pattern in the training set
-  for (pattern=training_set.begin();
-       pattern!=training_set.end(); ++pattern) {
-    const Vector& input((*pattern)->getInput());
-    const Vector& target((*pattern)->getOutput());
+  for (size_t p=first; p<last; ++p) {
+    // copy (and convert for float networks) the rows of the pattern
+    const double* in = training_set.getInputRow(p);
+    const double* out = training_set.getOutputRow(p);
+    std::copy(in, in+input.size(), input.getRaw());
+    std::copy(out, out+target.size(), target.getRaw());
 
     // forward propagation phase
     m_net.recall(input, hidden0, hidden, output0, output);
 
+    for (size_t k=0; k<target.size(); ++k)
+      sse += (target(k) - output(k)) * (target(k) - output(k));
+
     // backward pass
 
     // ...for output neurons
-    delta_output = target - output;
-    for (k=0; k<m_net.getOutputs(); ++k) {
-      delta_output(k) *= m_net.m_outputFunc->df(output0(k), output(k));
-      delta.m_bias2(k) = m_eta * delta_output(k);
+    kernels.outputDelta(m_net.m_outputFunc, m_net.getOutputs(),
+			target.getRaw(), output0.getRaw(), output.getRaw(),
+			delta_output.getRaw());
+
+    // ..for hidden neurons (delta_hidden = weight2^T * delta_output)
+    blas_gemv(GemmTransposed, m_net.getOutputs(), m_net.getHiddens(),
+	      1.0, m_net.m_weight2.getRaw(), m_net.getOutputs(),
+	      delta_output.getRaw(), 0.0, delta_hidden.getRaw());
+    kernels.hiddenDelta(m_net.m_hiddenFunc, m_net.getHiddens(),
+			hidden0.getRaw(), hidden.getRaw(), delta_hidden.getRaw());
+
+    // Apply deltas to the weights (eta*delta(k)*input(j) for each weight)
+    delta_output *= m_eta;
+    delta_hidden *= m_eta;
+    helper.applyOutputLayer(m_net.m_weight2, m_net.m_bias2,
+			    delta_output, hidden, T(m_mu));
+    helper.applyHiddenLayer(m_net.m_weight1, m_net.m_bias1,
+			    delta_hidden, input, T(m_mu));
+  }
+}
 
-      for (j=0; j<m_net.getHiddens(); ++j)
-	delta.m_weight2(k, j) = m_eta * delta_output(k) * hidden(j);
+//////////////////////////////////////////////////////////////////////
+// Mini-batch training
+//////////////////////////////////////////////////////////////////////
+
+// Maximum number of patterns in each chunk of a batch
+#define BATCH_CHUNK	32
+
+/// A chunk of patterns of a batch: buffers for the forward/backward
+/// passes (one pattern per column) and the resulting deltas for the
+/// weights.
+///
+template<class T>
+struct BackpropagationT<T>::BatchChunk
+{
+  MatrixT<T> input, target;
+  MatrixT<T> hidden0, hidden;
+  MatrixT<T> output0, output;
+  MatrixT<T> delta_hidden, delta_output;
+  MatrixT<T> delta_weight1, delta_weight2;
+  VectorT<T> delta_bias1, delta_bias2;
+  double sse;			// Squared errors of the outputs
+
+  BatchChunk(size_t inputs, size_t hiddens, size_t outputs)
+    : input(inputs, BATCH_CHUNK), target(outputs, BATCH_CHUNK)
+    , hidden0(hiddens, BATCH_CHUNK), hidden(hiddens, BATCH_CHUNK)
+    , output0(outputs, BATCH_CHUNK), output(outputs, BATCH_CHUNK)
+    , delta_hidden(hiddens, BATCH_CHUNK), delta_output(outputs, BATCH_CHUNK)
+    , delta_weight1(hiddens, inputs), delta_weight2(outputs, hiddens)
+    , delta_bias1(hiddens), delta_bias2(outputs), sse(0.0) { }
+};
+
+/// Chunks of a batch calculated by one thread.
+///
+template<class T>
+struct BackpropagationT<T>::BatchTask
+{
+  BackpropagationT* bp;
+  const PatternSet* set;
+  std::vector<BatchChunk*>* chunks;
+  size_t first;			// First pattern of the batch
+  size_t patterns;		// Number of patterns in the batch
+  size_t thread;		// Chunks thread, thread+threads, ...
+  size_t threads;
+};
+
+/// Mini-batch training: each batch is divided in chunks of
+/// BATCH_CHUNK patterns, the deltas of each chunk are calculated
+/// with matrix products (by @a threads threads), and then they are
+/// added always in the same order (so the result does not depend on
+/// the number of threads). The weights are updated with the sum of
+/// the deltas of all patterns in the batch (so an epoch moves the
+/// weights as much as an online epoch with the same learning rate),
+/// or with the optimizer (see #setOptimizer).
+///
+/// @return The sum of squared errors of the outputs.
+///
+template<class T>
+double BackpropagationT<T>::trainBatch(const PatternSet& training_set, size_t batchSize, size_t threads)
+{
+  const size_t batch = std::max<size_t>(1, std::min(batchSize, training_set.size()));
+  const size_t maxChunks = (batch + BATCH_CHUNK - 1) / BATCH_CHUNK;
+
+  threads = std::max<size_t>(1, std::min(threads, maxChunks));
+
+  std::vector<BatchChunk*> chunks(maxChunks);
+  for (size_t c=0; c<maxChunks; ++c)
+    chunks[c] = new BatchChunk(m_net.getInputs(), m_net.getHiddens(), m_net.getOutputs());
+
+  std::vector<BatchTask> tasks(threads);
+  double sse = 0.0;
+  for (size_t t=0; t<threads; ++t) {
+    tasks[t].bp = this;
+    tasks[t].set = &training_set;
+    tasks[t].chunks = &chunks;
+    tasks[t].thread = t;
+    tasks[t].threads = threads;
+  }
+
+  for (size_t first=0; first<training_set.size(); first+=batch) {
+    size_t patterns = std::min(batch, training_set.size()-first);
+    size_t nchunks = (patterns + BATCH_CHUNK - 1) / BATCH_CHUNK;
+
+    for (size_t t=0; t<threads; ++t) {
+      tasks[t].first = first;
+      tasks[t].patterns = patterns;
     }
 
-    // ..for hidden neurons
-    delta_hidden = m_net.m_weight2.getTranspose() * delta_output;
-    for (j=0; j<m_net.getHiddens(); ++j) {
-      delta_hidden(j) *= m_net.m_hiddenFunc->df(hidden0(j), hidden(j));
-      delta.m_bias1(j) = m_eta * delta_hidden(j);
+    // The first thread is this one
+    std::vector<Thread*> workers;
+    for (size_t t=1; t<threads && t<nchunks; ++t)
+      workers.push_back(new Thread(&BackpropagationT::batchThread, &tasks[t]));
+
+    batchThread(&tasks[0]);
+
+    for (size_t t=0; t<workers.size(); ++t)
+      delete workers[t];
+
+    // Sum the deltas of all chunks
+    BatchChunk& delta = *chunks[0];
+    double batchSse = delta.sse;
+    for (size_t c=1; c<nchunks; ++c) {
+      batchSse += chunks[c]->sse;
+      delta.delta_weight1 += chunks[c]->delta_weight1;
+      delta.delta_weight2 += chunks[c]->delta_weight2;
+      delta.delta_bias1 += chunks[c]->delta_bias1;
+      delta.delta_bias2 += chunks[c]->delta_bias2;
+    }
 
-      for (i=0; i<m_net.getInputs(); ++i)
-	delta.m_weight1(j, i) = m_eta * delta_hidden(j) * input(i);
+    sse += batchSse;
+
+    // Apply deltas to the weights
+    if (m_optimizer) {
+      m_optimizer->beginStep(batchSse / (patterns * m_net.getOutputs()));
+      m_optimizer->update(0, delta.delta_weight1.rows() * delta.delta_weight1.cols(),
+			  m_net.m_weight1.getRaw(), delta.delta_weight1.getRaw());
+      m_optimizer->update(1, delta.delta_bias1.size(),
+			  m_net.m_bias1.getRaw(), delta.delta_bias1.getRaw());
+      m_optimizer->update(2, delta.delta_weight2.rows() * delta.delta_weight2.cols(),
+			  m_net.m_weight2.getRaw(), delta.delta_weight2.getRaw());
+      m_optimizer->update(3, delta.delta_bias2.size(),
+			  m_net.m_bias2.getRaw(), delta.delta_bias2.getRaw());
     }
+    else {
+      m_updateWeightsHelper->applyOutputLayer(m_net.m_weight2, m_net.m_bias2,
+					      delta.delta_weight2, delta.delta_bias2, T(m_mu));
+      m_updateWeightsHelper->applyHiddenLayer(m_net.m_weight1, m_net.m_bias1,
+					      delta.delta_weight1, delta.delta_bias1, T(m_mu));
+    }
+  }
+
+  for (size_t c=0; c<maxChunks; ++c)
+    delete chunks[c];
+
+  return sse;
+}
 
-    // Apply delta to the weights
-    m_updateWeightsHelper->applyWeights(m_net, delta, m_mu);
+template<class T>
+void BackpropagationT<T>::batchThread(void* data)
+{
+  BatchTask& task = *(BatchTask*)data;
+  size_t nchunks = (task.patterns + BATCH_CHUNK - 1) / BATCH_CHUNK;
+
+  for (size_t c=task.thread; c<nchunks; c+=task.threads) {
+    size_t first = task.first + c*BATCH_CHUNK;
+    size_t n = std::min<size_t>(BATCH_CHUNK, task.patterns - c*BATCH_CHUNK);
+
+    task.bp->trainChunk(*task.set, first, n, *(*task.chunks)[c]);
   }
+}
 
-  // Post-processing policies
-  m_adaptativeLearningRate->afterPatterns(*this, m_net, training_set);
+/// Calculates the deltas for weights of @a n patterns (from @a first)
+/// with the current weights, they are not modified. The deltas are
+/// multiplied by the learning rate, except with an optimizer (they
+/// are the gradient).
+///
+template<class T>
+void BackpropagationT<T>::trainChunk(const PatternSet& training_set,
+				     size_t first, size_t n, BatchChunk& chunk)
+{
+  const size_t inputs = m_net.getInputs();
+  const size_t hiddens = m_net.getHiddens();
+  const size_t outputs = m_net.getOutputs();
+  const MlpKernels<T>& kernels(mlp_kernels<T>(*m_net.m_hiddenFunc, *m_net.m_outputFunc));
+  const T* bias1 = m_net.m_bias1.getRaw();
+  const T* bias2 = m_net.m_bias2.getRaw();
+  const T eta = (m_optimizer ? T(1): T(m_eta));
+  size_t j;
+
+  // Patterns are copied (and converted for float networks) to the
+  // columns of the chunk
+  for (j=0; j<n; ++j) {
+    const double* in = training_set.getInputRow(first+j);
+    const double* out = training_set.getOutputRow(first+j);
+    std::copy(in, in+inputs, chunk.input.getRaw() + j*inputs);
+    std::copy(out, out+outputs, chunk.target.getRaw() + j*outputs);
+  }
 
-  m_epoch++;
+  const T* input = chunk.input.getRaw();
+  const T* target = chunk.target.getRaw();
+  T* hidden0 = chunk.hidden0.getRaw();
+  T* hidden = chunk.hidden.getRaw();
+  T* output0 = chunk.output0.getRaw();
+  T* output = chunk.output.getRaw();
+  T* delta_hidden = chunk.delta_hidden.getRaw();
+  T* delta_output = chunk.delta_output.getRaw();
+
+  // forward propagation phase: hidden0 = weight1*input + bias1
+  for (j=0; j<n; ++j)
+    std::copy(bias1, bias1+hiddens, hidden0+j*hiddens);
+  blas_gemm(GemmNormal, GemmNormal, hiddens, n, inputs,
+	    1.0, m_net.m_weight1.getRaw(), hiddens, input, inputs,
+	    1.0, hidden0, hiddens);
+  kernels.hidden(m_net.m_hiddenFunc, hiddens*n, hidden0, hidden);
+
+  // output0 = weight2*hidden + bias2
+  for (j=0; j<n; ++j)
+    std::copy(bias2, bias2+outputs, output0+j*outputs);
+  blas_gemm(GemmNormal, GemmNormal, outputs, n, hiddens,
+	    1.0, m_net.m_weight2.getRaw(), outputs, hidden, hiddens,
+	    1.0, output0, outputs);
+  kernels.output(m_net.m_outputFunc, outputs*n, output0, output);
+
+  chunk.sse = 0.0;
+  for (j=0; j<outputs*n; ++j)
+    chunk.sse += (target[j] - output[j]) * (target[j] - output[j]);
+
+  // backward pass
+
+  // ...for output neurons
+  kernels.outputDelta(m_net.m_outputFunc, outputs*n,
+		      target, output0, output, delta_output);
+
+  // ..for hidden neurons (delta_hidden = weight2^T * delta_output)
+  blas_gemm(GemmTransposed, GemmNormal, hiddens, n, outputs,
+	    1.0, m_net.m_weight2.getRaw(), outputs, delta_output, outputs,
+	    0.0, delta_hidden, hiddens);
+  kernels.hiddenDelta(m_net.m_hiddenFunc, hiddens*n,
+		      hidden0, hidden, delta_hidden);
+
+  // delta_weight2 = eta * delta_output * hidden^T
+  blas_gemm(GemmNormal, GemmTransposed, outputs, hiddens, n,
+	    eta, delta_output, outputs, hidden, hiddens,
+	    0.0, chunk.delta_weight2.getRaw(), outputs);
+
+  // delta_weight1 = eta * delta_hidden * input^T
+  blas_gemm(GemmNormal, GemmTransposed, hiddens, inputs, n,
+	    eta, delta_hidden, hiddens, input, inputs,
+	    0.0, chunk.delta_weight1.getRaw(), hiddens);
+
+  // Deltas for bias are the sum of all columns
+  chunk.delta_bias2.zero();
+  chunk.delta_bias1.zero();
+  for (j=0; j<n; ++j) {
+    blas_axpy(outputs, eta, delta_output+j*outputs, chunk.delta_bias2.getRaw());
+    blas_axpy(hiddens, eta, delta_hidden+j*hiddens, chunk.delta_bias1.getRaw());
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Hogwild training
+//////////////////////////////////////////////////////////////////////
+
+/// Patterns trained by one thread in Hogwild mode.
+///
+template<class T>
+struct BackpropagationT<T>::HogwildTask
+{
+  BackpropagationT* bp;
+  const PatternSet* set;
+  size_t first, last;
+  UpdateWeightsHelper<T>* helper;
+  double sse;
+};
+
+/// Hogwild[1] training: the patterns are divided between @a threads
+/// threads, and each one trains online its patterns updating the
+/// same net without locks. Threads can overwrite the updates of other
+/// threads, so the result is not deterministic.
+///
+/// [1] F. Niu, B. Recht, C. Re, S. J. Wright. 2011. "Hogwild!: A
+/// Lock-Free Approach to Parallelizing Stochastic Gradient Descent".
+///
+/// @return The sum of squared errors of the outputs.
+///
+template<class T>
+double BackpropagationT<T>::trainHogwild(const PatternSet& training_set, size_t threads)
+{
+  threads = std::max<size_t>(1, std::min(threads, training_set.size()));
+
+  // Each thread has its own deltas for momentum
+  while (m_hogwildHelpers.size() < threads-1)
+    m_hogwildHelpers.push_back(new UpdateWeightsHelper<T>());
+
+  std::vector<HogwildTask> tasks(threads);
+  size_t first = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t patterns = training_set.size()/threads + (t < training_set.size()%threads ? 1: 0);
+
+    tasks[t].bp = this;
+    tasks[t].set = &training_set;
+    tasks[t].first = first;
+    tasks[t].last = first + patterns;
+    tasks[t].helper = (t == 0 ? m_updateWeightsHelper: m_hogwildHelpers[t-1]);
+    tasks[t].sse = 0.0;
+    tasks[t].helper->beforePatterns(m_net);
+    first += patterns;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&BackpropagationT::hogwildThread, &tasks[t]));
+
+  hogwildThread(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+
+  double sse = 0.0;
+  for (size_t t=0; t<threads; ++t)
+    sse += tasks[t].sse;
+  return sse;
 }
+
+template<class T>
+void BackpropagationT<T>::hogwildThread(void* data)
+{
+  HogwildTask& task = *(HogwildTask*)data;
+  task.bp->trainPatterns(*task.set, task.first, task.last, *task.helper, task.sse);
+}
+
+template class BoldDriverMethodT<double>;
+template class BoldDriverMethodT<float>;
+template class RpropT<double>;
+template class RpropT<float>;
+template class AdamT<double>;
+template class AdamT<float>;
+template class BackpropagationT<double>;
+template class BackpropagationT<float>;
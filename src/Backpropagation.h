@@ -6,38 +6,44 @@
 #ifndef LOSEFACE_BACKPROPAGATION_H
 #define LOSEFACE_BACKPROPAGATION_H
 
+#include <utility>
+#include <vector>
+
 #include "Mlp.h"
 
 class PatternSet;
-class Backpropagation;
-class UpdateWeightsHelper;
+template<class T> class UpdateWeightsHelper;
 
-/// It specifies how to modify learning rate in the training process.
+/// It specifies how to modify learning rate in the training process
+/// of a MlpT<T>.
 ///
-class AdaptativeLearningRate
+template<class T>
+class AdaptativeLearningRateT
 {
 public:
-  virtual ~AdaptativeLearningRate() { }
-  virtual void beforePatterns(const Mlp& net, const PatternSet& training_set) = 0;
-  virtual void afterPatterns(Backpropagation& bp, Mlp& net, const PatternSet& training_set) = 0;
-  virtual AdaptativeLearningRate* clone() const = 0;
+  virtual ~AdaptativeLearningRateT() { }
+  virtual void beforePatterns(BackpropagationT<T>& bp, const MlpT<T>& net, const PatternSet& training_set) = 0;
+  virtual void afterPatterns(BackpropagationT<T>& bp, MlpT<T>& net, const PatternSet& training_set) = 0;
+  virtual AdaptativeLearningRateT* clone() const = 0;
 };
 
 /// Default adaptative learning rate method
 ///
-class NoAdaptativeLearningRate : public AdaptativeLearningRate
+template<class T>
+class NoAdaptativeLearningRateT : public AdaptativeLearningRateT<T>
 {
 public:
-  void beforePatterns(const Mlp& net, const PatternSet& training_set) { }
-  void afterPatterns(Backpropagation& bp, Mlp& net, const PatternSet& training_set) { }
-  NoAdaptativeLearningRate* clone() const { return new NoAdaptativeLearningRate(*this); }
+  void beforePatterns(BackpropagationT<T>& bp, const MlpT<T>& net, const PatternSet& training_set) { }
+  void afterPatterns(BackpropagationT<T>& bp, MlpT<T>& net, const PatternSet& training_set) { }
+  NoAdaptativeLearningRateT* clone() const { return new NoAdaptativeLearningRateT(*this); }
 };
 
-class BoldDriverMethod : public AdaptativeLearningRate
+template<class T>
+class BoldDriverMethodT : public AdaptativeLearningRateT<T>
 {
   /// This variable is a backup of the net before processing all
   /// patterns, so with it we can cancel the whole training epoch.
-  Mlp m_netBackup;
+  MlpT<T> m_netBackup;
 
   /// Previous MSE at the epoch's beginning (to know if we have a
   /// performance improvement with the last epoch).
@@ -58,16 +64,124 @@ class BoldDriverMethod : public AdaptativeLearningRate
   double m_decreaseFactor;
 
 public:
-  BoldDriverMethod();
+  BoldDriverMethodT();
 
   double getIncreaseFactor() const { return m_increaseFactor; }
   double getDecreaseFactor() const { return m_decreaseFactor; }
   void setIncreaseFactor(double value) { m_increaseFactor = value; }
   void setDecreaseFactor(double value) { m_decreaseFactor = value; }
 
-  void beforePatterns(const Mlp& net, const PatternSet& training_set);
-  void afterPatterns(Backpropagation& bp, Mlp& net, const PatternSet& training_set);
-  BoldDriverMethod* clone() const { return new BoldDriverMethod(*this); }
+  void beforePatterns(BackpropagationT<T>& bp, const MlpT<T>& net, const PatternSet& training_set);
+  void afterPatterns(BackpropagationT<T>& bp, MlpT<T>& net, const PatternSet& training_set);
+  BoldDriverMethodT* clone() const { return new BoldDriverMethodT(*this); }
+};
+
+/// It specifies how the weights are modified with the gradient of
+/// each batch of patterns, instead of the steepest descent with
+/// momentum (see BackpropagationT::setOptimizer).
+///
+/// The weights of the net are updated in four blocks (weight1,
+/// bias1, weight2 and bias2, in that order), and each optimizer can
+/// keep its own state for each weight of each block.
+///
+template<class T>
+class OptimizerT
+{
+public:
+  virtual ~OptimizerT() { }
+
+  /// Number of patterns of each batch (@a batchSize is the one
+  /// specified in BackpropagationT::setBatchSize).
+  virtual size_t getBatchSize(size_t batchSize, size_t /*patterns*/) const { return batchSize; }
+
+  /// Called before the blocks are updated with the gradient of a
+  /// batch.
+  ///
+  /// @param error
+  ///   MSE of the patterns of the batch with the current weights.
+  ///
+  virtual void beginStep(double /*error*/) { }
+
+  /// Updates the @a n weights of a block.
+  ///
+  /// @param gradient
+  ///   Direction of steepest descent (-dE/dw) of each weight, summed
+  ///   for all the patterns of the batch.
+  ///
+  virtual void update(size_t block, size_t n, T* weights, const T* gradient) = 0;
+
+  virtual OptimizerT* clone() const = 0;
+};
+
+/// iRPROP+[1]: each weight has its own step that grows while the
+/// gradient keeps its sign, and only the sign of the gradient is
+/// used. The steps of the weights whose gradient changed the sign are
+/// undone if the error increased. It uses the whole training set as
+/// one batch (learning rate and momentum are not used).
+///
+/// [1] C. Igel, M. Husken. 2000. "Improving the Rprop Learning
+/// Algorithm". Proceedings of the Second International Symposium on
+/// Neural Computation, NC 2000, ICSC Academic Press, 115-121.
+///
+template<class T>
+class RpropT : public OptimizerT<T>
+{
+  double m_increaseFactor;	// 1.2
+  double m_decreaseFactor;	// 0.5
+  double m_initialStep;		// 0.1
+  double m_minStep;		// 1e-6
+  double m_maxStep;		// 50
+
+  double m_error, m_prevError;
+  std::vector<std::vector<T> > m_steps;
+  std::vector<std::vector<T> > m_prevGradient;
+  std::vector<std::vector<T> > m_prevDelta;
+
+public:
+  RpropT();
+
+  double getInitialStep() const { return m_initialStep; }
+  void setInitialStep(double step) { m_initialStep = step; }
+  double getMaxStep() const { return m_maxStep; }
+  void setMaxStep(double step) { m_maxStep = step; }
+
+  size_t getBatchSize(size_t /*batchSize*/, size_t patterns) const { return patterns; }
+  void beginStep(double error);
+  void update(size_t block, size_t n, T* weights, const T* gradient);
+  RpropT* clone() const { return new RpropT(*this); }
+};
+
+/// Adam[1]: the steps are the moving average of the gradient divided
+/// by the square root of the moving average of its square (with bias
+/// correction). It is used with mini-batches (see
+/// BackpropagationT::setBatchSize), and it has its own learning rate.
+///
+/// [1] D. P. Kingma, J. Ba. 2015. "Adam: A Method for Stochastic
+/// Optimization". 3rd International Conference for Learning
+/// Representations, San Diego.
+///
+template<class T>
+class AdamT : public OptimizerT<T>
+{
+  double m_learningRate;	// 0.001
+  double m_beta1;		// 0.9
+  double m_beta2;		// 0.999
+  double m_epsilon;		// 1e-8
+
+  size_t m_step;
+  double m_correction1, m_correction2;
+  std::vector<std::vector<T> > m_mean;
+  std::vector<std::vector<T> > m_variance;
+
+public:
+  AdamT(double learningRate = 0.001);
+
+  double getLearningRate() const { return m_learningRate; }
+  void setLearningRate(double rate) { m_learningRate = rate; }
+
+  void beginStep(double error);
+  void update(size_t block, size_t n, T* weights, const T* gradient);
+  AdamT* clone() const { return new AdamT(*this); }
 };
 
 /// Steepest descent backpropagation[1] algorithm to train MLP models.
@@ -77,8 +191,31 @@ public:
 /// of Cognition, Vol. 1: Foundations</em>, D. E. Rumelhart, J. L. McClelland, Eds. Mit Press
 /// Computational Models Of Cognition And Perception Series. MIT Press, Cambridge, MA, 318-362.
 ///
-class Backpropagation
+/// It trains networks of @a T weights (Backpropagation for Mlp, or
+/// BackpropagationT<float> for MlpT<float>).
+///
+/// The gradient of each batch can be used by other optimizers
+/// instead of the steepest descent (see #setOptimizer).
+///
+template<class T>
+class BackpropagationT
 {
+public:
+  /// How the training is distributed between threads.
+  ///
+  enum ParallelMode {
+    /// Each mini-batch is divided between threads and its deltas
+    /// are added before updating the weights. The result does not
+    /// depend on the number of threads. It needs a batch size
+    /// greater than 1 (online training uses just one thread).
+    SynchronousMode,
+
+    /// Each thread trains online a part of the patterns updating the
+    /// weights without locks (the result is not deterministic).
+    HogwildMode
+  };
+
+private:
   /// Training epoch.
   ///
   unsigned m_epoch;
@@ -89,36 +226,121 @@ class Backpropagation
 
   /// Net in training.
   ///
-  Mlp& m_net;
+  MlpT<T>& m_net;
 
   /// Type of adaptative learning rate.
   ///
-  AdaptativeLearningRate* m_adaptativeLearningRate;
+  AdaptativeLearningRateT<T>* m_adaptativeLearningRate;
+
+  /// Optimizer used instead of the steepest descent (NULL by
+  /// default).
+  ///
+  OptimizerT<T>* m_optimizer;
 
   /// Momentum
   double m_mu;
 
+  /// Number of patterns processed together before updating the
+  /// weights (1 means online training).
+  size_t m_batchSize;
+
+  /// Number of threads used to train (0 means one per processor).
+  size_t m_threads;
+
+  /// How threads are used (see #ParallelMode).
+  ParallelMode m_parallelMode;
+
   /// Helper to update MLP weights
-  UpdateWeightsHelper* m_updateWeightsHelper;
+  UpdateWeightsHelper<T>* m_updateWeightsHelper;
+
+  /// Helpers of the other threads in Hogwild mode (each thread has
+  /// its own momentum).
+  std::vector<UpdateWeightsHelper<T>*> m_hogwildHelpers;
+
+  /// MSE of the current weights for a set (see #calcMSE).
+  struct CachedMSE {
+    const PatternSet* set;
+    unsigned long version;	// PatternSet::getVersion of the set
+    double mse;
+  };
+
+  /// MSE of the current weights for each set where it was calculated.
+  std::vector<CachedMSE> m_mseCache;
+
+  /// Sweeps over whole sets: training passes and MSE calculations.
+  size_t m_forwardPasses;
+
+  /// MSE of the outputs calculated in the last training pass.
+  double m_trainingError;
+
+  struct BatchChunk;
+  struct BatchTask;
+  struct HogwildTask;
 
 public:
-  Backpropagation(Mlp& net);
-  ~Backpropagation();
+  BackpropagationT(MlpT<T>& net);
+  ~BackpropagationT();
 
   unsigned getEpoch() const { return m_epoch; }
-  const Mlp& getNet() const { return m_net; }
+  const MlpT<T>& getNet() const { return m_net; }
 
   double getLearningRate() const { return m_eta; }
   double getMomentum() const { return m_mu; }
   void setLearningRate(double rate) { m_eta = rate; }
   void setMomentum(double mu) { m_mu = mu; }
 
-  const AdaptativeLearningRate& getAdaptativeLearningRate() const;
-  AdaptativeLearningRate& getAdaptativeLearningRate();
-  void setAdaptativeLearningRate(const AdaptativeLearningRate& method);
+  size_t getBatchSize() const { return m_batchSize; }
+  void setBatchSize(size_t size) { m_batchSize = (size > 0 ? size: 1); }
+
+  size_t getThreads() const { return m_threads; }
+  void setThreads(size_t threads) { m_threads = threads; }
+
+  ParallelMode getParallelMode() const { return m_parallelMode; }
+  void setParallelMode(ParallelMode mode) { m_parallelMode = mode; }
+
+  const AdaptativeLearningRateT<T>& getAdaptativeLearningRate() const;
+  AdaptativeLearningRateT<T>& getAdaptativeLearningRate();
+  void setAdaptativeLearningRate(const AdaptativeLearningRateT<T>& method);
+
+  const OptimizerT<T>* getOptimizer() const { return m_optimizer; }
+  void setOptimizer(const OptimizerT<T>& optimizer);
+  void useSteepestDescent();
 
   void train(const PatternSet& training_set);
 
+  double calcMSE(const PatternSet& set);
+  void setMSE(const PatternSet& set, double mse);
+  void invalidateMSE();
+
+  /// Number of sweeps over whole sets since this object was created
+  /// (each training epoch and each MSE not found in the cache).
+  size_t getForwardPasses() const { return m_forwardPasses; }
+
+  /// MSE of the outputs calculated while the last epoch was
+  /// trained. The weights change during the epoch, so it is only an
+  /// estimate, except when the whole set is one batch (then it is the
+  /// MSE of the net before the epoch).
+  double getTrainingError() const { return m_trainingError; }
+
+private:
+  void trainPatterns(const PatternSet& training_set,
+		     size_t first, size_t last,
+		     UpdateWeightsHelper<T>& helper, double& sse);
+  double trainBatch(const PatternSet& training_set, size_t batchSize, size_t threads);
+  void trainChunk(const PatternSet& training_set,
+		  size_t first, size_t n, BatchChunk& chunk);
+  double trainHogwild(const PatternSet& training_set, size_t threads);
+  static void batchThread(void* data);
+  static void hogwildThread(void* data);
+
 };
 
+typedef AdaptativeLearningRateT<double> AdaptativeLearningRate;
+typedef NoAdaptativeLearningRateT<double> NoAdaptativeLearningRate;
+typedef BoldDriverMethodT<double> BoldDriverMethod;
+typedef OptimizerT<double> Optimizer;
+typedef RpropT<double> Rprop;
+typedef AdamT<double> Adam;
+typedef BackpropagationT<double> Backpropagation;
+
 #endif // LOSEFACE_BACKPROPAGATION_H
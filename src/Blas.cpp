@@ -0,0 +1,456 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "Blas.h"
+#include "Simd.h"
+#include "Thread.h"
+
+#if defined(LOSEFACE_BLAS_BUNDLED) || defined(LOSEFACE_BLAS_SYSTEM)
+
+// Fortran interface. The bundled BLAS is compiled with blaswrap.h,
+// so its routines have the "f2c_" prefix and use the f2c integer
+// type. A system BLAS uses the usual "name_" symbols and Fortran
+// INTEGERs (int).
+#if defined(LOSEFACE_BLAS_BUNDLED)
+  #define BLAS_NAME(name)	f2c_##name
+  typedef long blas_int;
+#else
+  #define BLAS_NAME(name)	name##_
+  typedef int blas_int;
+#endif
+
+extern "C" {
+  int BLAS_NAME(dgemm)(const char* transa, const char* transb,
+		       const blas_int* m, const blas_int* n, const blas_int* k,
+		       const double* alpha, const double* a, const blas_int* lda,
+		       const double* b, const blas_int* ldb,
+		       const double* beta, double* c, const blas_int* ldc);
+  int BLAS_NAME(dgemv)(const char* trans, const blas_int* m, const blas_int* n,
+		       const double* alpha, const double* a, const blas_int* lda,
+		       const double* x, const blas_int* incx,
+		       const double* beta, double* y, const blas_int* incy);
+  int BLAS_NAME(dger)(const blas_int* m, const blas_int* n, const double* alpha,
+		      const double* x, const blas_int* incx,
+		      const double* y, const blas_int* incy,
+		      double* a, const blas_int* lda);
+  int BLAS_NAME(dsyrk)(const char* uplo, const char* trans,
+		       const blas_int* n, const blas_int* k,
+		       const double* alpha, const double* a, const blas_int* lda,
+		       const double* beta, double* c, const blas_int* ldc);
+  int BLAS_NAME(daxpy)(const blas_int* n, const double* alpha,
+		       const double* x, const blas_int* incx,
+		       double* y, const blas_int* incy);
+  double BLAS_NAME(ddot)(const blas_int* n,
+			 const double* x, const blas_int* incx,
+			 const double* y, const blas_int* incy);
+}
+
+static const char* blas_trans(GemmOp op)
+{
+  return op == GemmNormal ? "N": "T";
+}
+
+const char* blas_backend()
+{
+#if defined(LOSEFACE_BLAS_BUNDLED)
+  return "bundled";
+#else
+  return "system";
+#endif
+}
+
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       const double* B, size_t ldb,
+	       double beta, double* C, size_t ldc)
+{
+  blas_int m_ = m, n_ = n, k_ = k;
+  blas_int lda_ = lda, ldb_ = ldb, ldc_ = ldc;
+
+  BLAS_NAME(dgemm)(blas_trans(opA), blas_trans(opB), &m_, &n_, &k_,
+		   &alpha, A, &lda_, B, &ldb_, &beta, C, &ldc_);
+}
+
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       double alpha, const double* A, size_t lda,
+	       const double* x, double beta, double* y)
+{
+  blas_int m_ = m, n_ = n, lda_ = lda, inc = 1;
+
+  BLAS_NAME(dgemv)(blas_trans(op), &m_, &n_,
+		   &alpha, A, &lda_, x, &inc, &beta, y, &inc);
+}
+
+void blas_ger(size_t m, size_t n, double alpha,
+	      const double* x, const double* y,
+	      double* A, size_t lda)
+{
+  blas_int m_ = m, n_ = n, lda_ = lda, inc = 1;
+
+  BLAS_NAME(dger)(&m_, &n_, &alpha, x, &inc, y, &inc, A, &lda_);
+}
+
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       double beta, double* C, size_t ldc)
+{
+  blas_int n_ = n, k_ = k, lda_ = lda, ldc_ = ldc;
+
+  // BLAS syrk uses "T" for A^T*A and "N" for A*A^T
+  BLAS_NAME(dsyrk)("U", blas_trans(op), &n_, &k_,
+		   &alpha, A, &lda_, &beta, C, &ldc_);
+
+  // Copy the upper triangle to the lower one
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=j+1; i<n; ++i)
+      C[i+j*ldc] = C[j+i*ldc];
+}
+
+void blas_axpy(size_t n, double a, const double* x, double* y)
+{
+  blas_int n_ = n, inc = 1;
+  BLAS_NAME(daxpy)(&n_, &a, x, &inc, y, &inc);
+}
+
+double blas_dot(size_t n, const double* x, const double* y)
+{
+  blas_int n_ = n, inc = 1;
+  return BLAS_NAME(ddot)(&n_, x, &inc, y, &inc);
+}
+
+#else  // native backend
+
+const char* blas_backend()
+{
+  return "native";
+}
+
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       const double* B, size_t ldb,
+	       double beta, double* C, size_t ldc)
+{
+  gemm(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       double alpha, const double* A, size_t lda,
+	       const double* x, double beta, double* y)
+{
+  const SimdKernels& kernels = simd();
+  size_t j, ny = (op == GemmNormal ? m: n);
+
+  if (beta == 0.0) {
+    if (op == GemmNormal)
+      kernels.gemv(m, n, A, lda, x, y);
+    else
+      kernels.gemvT(m, n, A, lda, x, y);
+
+    if (alpha != 1.0)
+      kernels.scale(ny, alpha, y, y);
+  }
+  else {
+    if (beta != 1.0)
+      kernels.scale(ny, beta, y, y);
+
+    if (op == GemmNormal) {
+      for (j=0; j<n; ++j)
+	kernels.axpy(m, alpha*x[j], A+j*lda, y);
+    }
+    else {
+      for (j=0; j<n; ++j)
+	y[j] += alpha * kernels.dot(m, A+j*lda, x);
+    }
+  }
+}
+
+void blas_ger(size_t m, size_t n, double alpha,
+	      const double* x, const double* y,
+	      double* A, size_t lda)
+{
+  const SimdKernels& kernels = simd();
+
+  for (size_t j=0; j<n; ++j)
+    kernels.axpy(m, alpha*y[j], x, A+j*lda);
+}
+
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       double beta, double* C, size_t ldc)
+{
+  gemm(op, op == GemmNormal ? GemmTransposed: GemmNormal,
+       n, n, k, alpha, A, lda, A, lda, beta, C, ldc);
+}
+
+void blas_axpy(size_t n, double a, const double* x, double* y)
+{
+  simd().axpy(n, a, x, y);
+}
+
+double blas_dot(size_t n, const double* x, const double* y)
+{
+  return simd().dot(n, x, y);
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Single precision
+//////////////////////////////////////////////////////////////////////
+
+#if defined(LOSEFACE_BLAS_SYSTEM)
+
+extern "C" {
+  int sgemm_(const char* transa, const char* transb,
+	     const int* m, const int* n, const int* k,
+	     const float* alpha, const float* a, const int* lda,
+	     const float* b, const int* ldb,
+	     const float* beta, float* c, const int* ldc);
+  int sgemv_(const char* trans, const int* m, const int* n,
+	     const float* alpha, const float* a, const int* lda,
+	     const float* x, const int* incx,
+	     const float* beta, float* y, const int* incy);
+  int sger_(const int* m, const int* n, const float* alpha,
+	    const float* x, const int* incx,
+	    const float* y, const int* incy,
+	    float* a, const int* lda);
+  int ssyrk_(const char* uplo, const char* trans,
+	     const int* n, const int* k,
+	     const float* alpha, const float* a, const int* lda,
+	     const float* beta, float* c, const int* ldc);
+  int saxpy_(const int* n, const float* alpha,
+	     const float* x, const int* incx,
+	     float* y, const int* incy);
+}
+
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       const float* B, size_t ldb,
+	       float beta, float* C, size_t ldc)
+{
+  int m_ = m, n_ = n, k_ = k;
+  int lda_ = lda, ldb_ = ldb, ldc_ = ldc;
+
+  sgemm_(blas_trans(opA), blas_trans(opB), &m_, &n_, &k_,
+	 &alpha, A, &lda_, B, &ldb_, &beta, C, &ldc_);
+}
+
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       float alpha, const float* A, size_t lda,
+	       const float* x, float beta, float* y)
+{
+  int m_ = m, n_ = n, lda_ = lda, inc = 1;
+
+  sgemv_(blas_trans(op), &m_, &n_,
+	 &alpha, A, &lda_, x, &inc, &beta, y, &inc);
+}
+
+void blas_ger(size_t m, size_t n, float alpha,
+	      const float* x, const float* y,
+	      float* A, size_t lda)
+{
+  int m_ = m, n_ = n, lda_ = lda, inc = 1;
+
+  sger_(&m_, &n_, &alpha, x, &inc, y, &inc, A, &lda_);
+}
+
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       float beta, float* C, size_t ldc)
+{
+  int n_ = n, k_ = k, lda_ = lda, ldc_ = ldc;
+
+  ssyrk_("U", blas_trans(op), &n_, &k_,
+	 &alpha, A, &lda_, &beta, C, &ldc_);
+
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=j+1; i<n; ++i)
+      C[i+j*ldc] = C[j+i*ldc];
+}
+
+void blas_axpy(size_t n, float a, const float* x, float* y)
+{
+  int n_ = n, inc = 1;
+  saxpy_(&n_, &a, x, &inc, y, &inc);
+}
+
+// sdot is not used: some BLAS return its float result as a double
+float blas_dot(size_t n, const float* x, const float* y)
+{
+  return simd().sdot(n, x, y);
+}
+
+#else  // native single precision (the bundled BLAS is only double)
+
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       const float* B, size_t ldb,
+	       float beta, float* C, size_t ldc)
+{
+  gemm(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       float alpha, const float* A, size_t lda,
+	       const float* x, float beta, float* y)
+{
+  const SimdKernels& kernels = simd();
+  size_t i, j, ny = (op == GemmNormal ? m: n);
+
+  if (beta == 0.0f)
+    std::fill(y, y+ny, 0.0f);
+  else if (beta != 1.0f)
+    for (i=0; i<ny; ++i)
+      y[i] *= beta;
+
+  if (op == GemmNormal) {
+    for (j=0; j<n; ++j)
+      kernels.saxpy(m, alpha*x[j], A+j*lda, y);
+  }
+  else {
+    for (j=0; j<n; ++j)
+      y[j] += alpha * kernels.sdot(m, A+j*lda, x);
+  }
+}
+
+void blas_ger(size_t m, size_t n, float alpha,
+	      const float* x, const float* y,
+	      float* A, size_t lda)
+{
+  const SimdKernels& kernels = simd();
+
+  for (size_t j=0; j<n; ++j)
+    kernels.saxpy(m, alpha*y[j], x, A+j*lda);
+}
+
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       float beta, float* C, size_t ldc)
+{
+  gemm(op, op == GemmNormal ? GemmTransposed: GemmNormal,
+       n, n, k, alpha, A, lda, A, lda, beta, C, ldc);
+}
+
+void blas_axpy(size_t n, float a, const float* x, float* y)
+{
+  simd().saxpy(n, a, x, y);
+}
+
+float blas_dot(size_t n, const float* x, const float* y)
+{
+  return simd().sdot(n, x, y);
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Multithreaded GEMM (for any backend)
+//////////////////////////////////////////////////////////////////////
+
+// Minimum number of columns of C per thread
+#define GEMM_PARALLEL_MIN_COLS	16
+
+namespace {
+
+  template<class T>
+  struct GemmTask
+  {
+    GemmOp opA, opB;
+    size_t m, n, k;
+    T alpha, beta;
+    const T* A;
+    const T* B;
+    T* C;
+    size_t lda, ldb, ldc;
+  };
+
+  template<class T>
+  void gemm_task(void* data)
+  {
+    const GemmTask<T>& t = *(GemmTask<T>*)data;
+    blas_gemm(t.opA, t.opB, t.m, t.n, t.k,
+	      t.alpha, t.A, t.lda, t.B, t.ldb, t.beta, t.C, t.ldc);
+  }
+
+}
+
+template<class T>
+static void gemm_parallel(GemmOp opA, GemmOp opB,
+			  size_t m, size_t n, size_t k,
+			  T alpha, const T* A, size_t lda,
+			  const T* B, size_t ldb,
+			  T beta, T* C, size_t ldc,
+			  size_t threads)
+{
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::min(threads, n / GEMM_PARALLEL_MIN_COLS);
+
+  if (threads <= 1) {
+    blas_gemm(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+    return;
+  }
+
+  // Each thread calculates a range of columns of C, which needs the
+  // same columns of op(B)
+  std::vector<GemmTask<T> > tasks(threads);
+  size_t j = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t cols = n/threads + (t < n%threads ? 1: 0);
+    GemmTask<T>& task = tasks[t];
+
+    task.opA = opA;
+    task.opB = opB;
+    task.m = m;
+    task.n = cols;
+    task.k = k;
+    task.alpha = alpha;
+    task.beta = beta;
+    task.A = A;
+    task.lda = lda;
+    task.B = (opB == GemmNormal ? B + j*ldb: B + j);
+    task.ldb = ldb;
+    task.C = C + j*ldc;
+    task.ldc = ldc;
+    j += cols;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&gemm_task<T>, &tasks[t]));
+
+  gemm_task<T>(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+}
+
+void blas_gemm_parallel(GemmOp opA, GemmOp opB,
+			size_t m, size_t n, size_t k,
+			double alpha, const double* A, size_t lda,
+			const double* B, size_t ldb,
+			double beta, double* C, size_t ldc,
+			size_t threads)
+{
+  gemm_parallel(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, threads);
+}
+
+void blas_gemm_parallel(GemmOp opA, GemmOp opB,
+			size_t m, size_t n, size_t k,
+			float alpha, const float* A, size_t lda,
+			const float* B, size_t ldb,
+			float beta, float* C, size_t ldc,
+			size_t threads)
+{
+  gemm_parallel(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, threads);
+}
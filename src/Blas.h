@@ -0,0 +1,95 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_BLAS_H
+#define LOSEFACE_BLAS_H
+
+#include <cstddef>
+
+#include "Gemm.h"
+
+// BLAS backend used by Matrix and Vector. It is selected at configure
+// time with the LOSEFACE_BLAS CMake option:
+//
+//   native   Blocked GEMM (Gemm.cpp) and SIMD kernels (Simd.cpp).
+//   bundled  Reference BLAS of third_party/clapack.
+//   system   An optimized BLAS found by CMake (OpenBLAS, MKL, ATLAS...)
+//
+// All matrices are stored column by column, ld* parameters are the
+// distance between two columns.
+
+/// Integer type of the bundled CLAPACK routines (the "integer" type
+/// of f2c).
+typedef long lapack_int;
+
+/// Returns the name of the BLAS backend (native, bundled or system).
+const char* blas_backend();
+
+/// C = alpha*op(A)*op(B) + beta*C, where C is @a m x @a n and
+/// op(A) is @a m x @a k.
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       const double* B, size_t ldb,
+	       double beta, double* C, size_t ldc);
+
+/// Same as #blas_gemm, but the columns of C are distributed between
+/// @a threads threads (zero means one thread per processor).
+void blas_gemm_parallel(GemmOp opA, GemmOp opB,
+			size_t m, size_t n, size_t k,
+			double alpha, const double* A, size_t lda,
+			const double* B, size_t ldb,
+			double beta, double* C, size_t ldc,
+			size_t threads = 0);
+
+/// y = alpha*op(A)*x + beta*y, where A is @a m x @a n.
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       double alpha, const double* A, size_t lda,
+	       const double* x, double beta, double* y);
+
+/// A = alpha*x*y^T + A, where A is @a m x @a n (rank-1 update).
+void blas_ger(size_t m, size_t n, double alpha,
+	      const double* x, const double* y,
+	      double* A, size_t lda);
+
+/// C = alpha*op(A)*op(A)^T + beta*C, where C is @a n x @a n and
+/// op(A) is @a n x @a k. Both triangles of C are filled.
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       double alpha, const double* A, size_t lda,
+	       double beta, double* C, size_t ldc);
+
+/// y = a*x + y
+void blas_axpy(size_t n, double a, const double* x, double* y);
+
+/// Returns x^T*y.
+double blas_dot(size_t n, const double* x, const double* y);
+
+// Single precision versions (a system BLAS uses its s* routines, the
+// other backends the native implementation)
+
+void blas_gemm(GemmOp opA, GemmOp opB,
+	       size_t m, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       const float* B, size_t ldb,
+	       float beta, float* C, size_t ldc);
+void blas_gemm_parallel(GemmOp opA, GemmOp opB,
+			size_t m, size_t n, size_t k,
+			float alpha, const float* A, size_t lda,
+			const float* B, size_t ldb,
+			float beta, float* C, size_t ldc,
+			size_t threads = 0);
+void blas_gemv(GemmOp op, size_t m, size_t n,
+	       float alpha, const float* A, size_t lda,
+	       const float* x, float beta, float* y);
+void blas_ger(size_t m, size_t n, float alpha,
+	      const float* x, const float* y,
+	      float* A, size_t lda);
+void blas_syrk(GemmOp op, size_t n, size_t k,
+	       float alpha, const float* A, size_t lda,
+	       float beta, float* C, size_t ldc);
+void blas_axpy(size_t n, float a, const float* x, float* y);
+float blas_dot(size_t n, const float* x, const float* y);
+
+#endif // LOSEFACE_BLAS_H
@@ -4,18 +4,99 @@
 // Read LICENSE.txt for more information.
 
 #include "Eigenfaces.h"
+#include "Blas.h"
+#include "Gram.h"
 
-Eigenfaces::Eigenfaces()
+// Copies the @a image to the j-th column of @a X (converting it to
+// the type of X)
+template<class T>
+static void set_image(MatrixT<T>& X, size_t j, const Vector& image)
+{
+  std::copy(image.begin(), image.end(), X.getRaw() + j*X.rows());
+}
+
+// Mean of the columns of @a X (accumulated in double)
+template<class T>
+static void mean_col(const MatrixT<T>& X, Vector& mean)
+{
+  mean.resize(X.rows());
+  for (size_t i=0; i<X.rows(); ++i) {
+    double sum = 0.0;
+    for (size_t j=0; j<X.cols(); ++j)
+      sum += X(i, j);
+    mean(i) = sum / X.cols();
+  }
+}
+
+// Each eigenface is a linear combination of the training images
+// (with zero mean) using the eigenvector coefficients:
+//
+//   (X - mean*1^T)*v = X*v - mean*sum(v)
+//
+static void combine_images(const Matrix& X, const Matrix& V,
+			   const Vector& mean, Matrix& E)
+{
+  E = X * V;
+
+  for (size_t i=0; i<V.cols(); ++i) {
+    VectorView eigenface = E.getCol(i);
+
+    double sum = 0.0;
+    for (size_t j=0; j<V.rows(); ++j)
+      sum += V(j, i);
+    eigenface -= sum * mean;
+
+    // Normalize the eigenface
+    double length = eigenface.magnitude();
+    if (length > 0.0)
+      eigenface /= length;
+  }
+}
+
+// The same for float images (the product is in single precision,
+// the normalization is accumulated in double)
+static void combine_images(const MatrixT<float>& X, const Matrix& V,
+			   const Vector& mean, MatrixT<float>& E)
+{
+  MatrixT<float> Vf;
+  Vf.assign(V);
+  X.multiply(Vf, E);
+
+  for (size_t i=0; i<V.cols(); ++i) {
+    float* eigenface = E.getRaw() + i*E.rows();
+
+    double sum = 0.0;
+    for (size_t j=0; j<V.rows(); ++j)
+      sum += V(j, i);
+
+    double length = 0.0;
+    for (size_t k=0; k<E.rows(); ++k) {
+      eigenface[k] -= float(sum * mean(k));
+      length += double(eigenface[k]) * eigenface[k];
+    }
+
+    // Normalize the eigenface
+    length = std::sqrt(length);
+    if (length > 0.0)
+      for (size_t k=0; k<E.rows(); ++k)
+	eigenface[k] = float(eigenface[k] / length);
+  }
+}
+
+template<class T>
+EigenfacesT<T>::EigenfacesT()
 {
   m_pixelsPerImage = 0;
   m_preallocatedImages = 0;
 }
 
-Eigenfaces::~Eigenfaces()
+template<class T>
+EigenfacesT<T>::~EigenfacesT()
 {
 }
 
-void Eigenfaces::reserve(size_t numImages)
+template<class T>
+void EigenfacesT<T>::reserve(size_t numImages)
 {
   if (numImages <= 0)
     throw std::invalid_argument("Invalid argument 'numImages' in Eigenfaces::reserve method.");
@@ -26,7 +107,8 @@ void Eigenfaces::reserve(size_t numImages)
   m_preallocatedImages += numImages;
 }
 
-void Eigenfaces::addImage(const Vector& faceImage)
+template<class T>
+void EigenfacesT<T>::addImage(const Vector& faceImage)
 {
   // If this is the first added image...
   if (m_pixelsPerImage == 0) {
@@ -40,10 +122,10 @@ void Eigenfaces::addImage(const Vector& faceImage)
       m_dataSet.resize(m_pixelsPerImage, 1);
 
     // It is the first image in the data set
-    m_dataSet.setCol(0, faceImage);
+    set_image(m_dataSet, 0, faceImage);
   }
   else if (m_preallocatedImages > 0) {
-    m_dataSet.setCol(m_dataSet.cols() - m_preallocatedImages, faceImage);
+    set_image(m_dataSet, m_dataSet.cols() - m_preallocatedImages, faceImage);
     m_preallocatedImages--;
   }
   else {
@@ -51,38 +133,45 @@ void Eigenfaces::addImage(const Vector& faceImage)
       throw std::invalid_argument("Invalid face: you cannot use different face sizes in the same Eigenfaces instance.");
 
     // Add a column in the data set (each column is an image)
-    m_dataSet.addCol(m_dataSet.cols(), faceImage);
+    m_dataSet.resize(m_pixelsPerImage, m_dataSet.cols()+1);
+    set_image(m_dataSet, m_dataSet.cols()-1, faceImage);
   }
 }
 
 /// Returns the number of training images available to calculate
 /// eigenfaces.
 ///
-size_t Eigenfaces::getImageCount() const
+template<class T>
+size_t EigenfacesT<T>::getImageCount() const
 {
   return (m_pixelsPerImage == 0) ? 0: m_dataSet.cols() - m_preallocatedImages;
 }
 
 /// Returns the number of pixels per image.
 ///
-size_t Eigenfaces::getPixelsPerImage() const
+template<class T>
+size_t EigenfacesT<T>::getPixelsPerImage() const
 {
   return m_pixelsPerImage;
 }
 
-size_t Eigenfaces::getEigenfaceComponents() const
+template<class T>
+size_t EigenfacesT<T>::getEigenfaceComponents() const
 {
   return m_eigenfaceComponents;
 }
 
-size_t Eigenfaces::getEigenvaluesCount() const
+template<class T>
+size_t EigenfacesT<T>::getEigenvaluesCount() const
 {
   return m_eigenvalues.size();
 }
 
-/// Calculate eivenvalues and sort them in descendant order.
+/// Calculates the eigenvalues of the covariance matrix in
+/// descending order.
 ///
-bool Eigenfaces::calculateEigenvalues()
+template<class T>
+bool EigenfacesT<T>::calculateEigenvalues()
 {
   // If there are reserved columns we just removed them so they do
   // not mess all the calculations
@@ -90,54 +179,32 @@ bool Eigenfaces::calculateEigenvalues()
     m_dataSet.resize(m_pixelsPerImage, m_dataSet.cols() - m_preallocatedImages);
 
   // Calculate the mean of all faces
-  m_dataSet.meanCol(m_meanFace);
-
-  // Substract the mean from all faces
-  m_dataSetZeroMean.resize(m_dataSet.rows(),
-			   m_dataSet.cols());
-  for (int j=0; j<m_dataSet.cols(); ++j)
-    m_dataSetZeroMean.setCol(j, m_dataSet.getCol(j) - m_meanFace);
+  mean_col(m_dataSet, m_meanFace);
 
   // Here we get the MxM covariance matrix to calculate its eigenvectors
   // (where M is the number of training images). In this way we avoid
   // to calculate the N eigenvectors of the original covariance matrix NxN
-  // (where N is the number of pixels in images)
-
-  Matrix covarianceMatrix;	// (At*A)/M
-  m_dataSetZeroMean.getTranspose(covarianceMatrix);
-  covarianceMatrix *= m_dataSetZeroMean;
-  covarianceMatrix /= m_dataSetZeroMean.cols();
-
-  //std::cout << "covarianceMatrix = " << covarianceMatrix.rows() << " x " << covarianceMatrix.cols() << "\n";
-
-  // We calculate eigenvectors (this can take a while)...
+  // (where N is the number of pixels in images). The mean is
+  // subtracted on the fly, so we do not need a zero-mean copy of the
+  // data set (the covariance matrix is accumulated in double for
+  // float images too).
+
+  Matrix covarianceMatrix;
+  gram(m_dataSet, m_meanFace, covarianceMatrix);
+  covarianceMatrix /= m_dataSet.cols();
+
+  // Here we calculate only the eigenvalues (in descending order),
+  // eigenvectors are calculated in calculateEigenfaces() when we
+  // know how many components are needed (from the same tridiagonal
+  // form, so the matrix is reduced only once)
   try {
-    covarianceMatrix.eig_sym(m_eigenvalues,
-			     m_eigenvectors);
+    m_covarianceEigen.reduce(covarianceMatrix);
+    m_covarianceEigen.getEigenvalues(m_eigenvalues);
   }
   catch (std::exception& e) {
     return false;
   }
 
-  // We sort the eigenvectors in descending order by its
-  // corresponding eigenvalue significance
-#if 1
-  for (int i=0; i<m_eigenvalues.size(); ++i) { // TODO replace bubble-sort with qsort
-    for (int j=i+1; j<m_eigenvalues.size(); ++j) {
-      if (std::fabs(m_eigenvalues(j)) > std::fabs(m_eigenvalues(i))) {
-	// Swap eigenvalues
-	std::swap(m_eigenvalues(i), m_eigenvalues(j));
-	// Swap eigenvectors
-	{
-	  Vector aux = m_eigenvectors.getCol(j);
-	  m_eigenvectors.setCol(j, m_eigenvectors.getCol(i));
-	  m_eigenvectors.setCol(i, aux);
-	}
-      }
-    }
-  }
-#endif
-
 #if 1
   std::cout << "----------------------------------------------------------------------\n";
   std::cout << "Eigenvalues (" << m_eigenvalues.size() << "):\n";
@@ -161,30 +228,27 @@ bool Eigenfaces::calculateEigenvalues()
 ///
 /// @warning You have to call #calculateEigenvalues before.
 ///
-void Eigenfaces::calculateEigenfaces(size_t components)
+template<class T>
+void EigenfacesT<T>::calculateEigenfaces(size_t components)
 {
-  if (components < 1 && components > m_eigenvalues.size()) {
+  if (components < 1 || components > m_eigenvalues.size()) {
     char buf[1024];
     std::sprintf(buf, "Invalid argument components=%d in Eigenfaces::calculateEigenfaces method.\n"
 		      "It is not between 1 and %d.",
-		 components, m_eigenvalues.size());
+		 (int)components, (int)m_eigenvalues.size());
     throw std::invalid_argument(std::string(buf));
   }
 
   m_eigenfaceComponents = components;
 
-  // Calculate eigenfaces...
-  m_eigenfaces.resize(m_pixelsPerImage,	// Rows
-		      m_eigenfaceComponents); // Columns
+  // Calculate only the eigenvectors of the largest eigenvalues (this
+  // can take a while)...
+  Vector eigenvalues;
+  m_covarianceEigen.getEigenvectors(eigenvalues, m_eigenvectors, components);
 
-  Vector eigenface(m_pixelsPerImage);
-  for (size_t i=0; i<m_eigenfaceComponents; ++i) {
-    eigenface.zero();
-    for (size_t j=0; j<m_dataSetZeroMean.cols(); ++j)
-      eigenface += m_eigenvectors(i, j) * m_dataSetZeroMean.getCol(j);
+  combine_images(m_dataSet, m_eigenvectors, m_meanFace, m_eigenfaces);
 
-    m_eigenfaces.setCol(i, eigenface);
-  }
+  calculateMeanProjection();
 }
 
 /// Returns the number of eigenfaces required to represent the
@@ -196,7 +260,8 @@ void Eigenfaces::calculateEigenfaces(size_t components)
 ///   The number of components for eigenfaces. Then you should call
 ///   #calculateEigenfaces with this returned value.
 ///
-size_t Eigenfaces::getNumComponentsFor(double variance) const
+template<class T>
+size_t EigenfacesT<T>::getNumComponentsFor(double variance) const
 {
   double total = 0.0;
   for (size_t i=0; i<m_eigenvalues.size(); ++i)
@@ -221,79 +286,106 @@ size_t Eigenfaces::getNumComponentsFor(double variance) const
 /// @param eigenspacePoint
 ///   Resulting point in the eigenspace.
 ///
-void Eigenfaces::projectInEigenspace(const Vector& faceImage, Vector& eigenspacePoint) const
+template<class T>
+void EigenfacesT<T>::projectInEigenspace(const VectorT<T>& faceImage, VectorT<T>& eigenspacePoint) const
 {
-  eigenspacePoint.resize(m_eigenfaceComponents);
-  for (size_t k=0; k<m_eigenfaceComponents; ++k)
-    eigenspacePoint(k) = m_eigenfaces.getCol(k) * (faceImage - m_meanFace);
+  assert(faceImage.size() == m_eigenfaces.rows());
+
+  // eigenspacePoint = E^T*(faceImage - Psi) = E^T*faceImage - E^T*Psi
+  eigenspacePoint = m_meanProjection;
+  blas_gemv(GemmTransposed, m_eigenfaces.rows(), m_eigenfaceComponents,
+	    1.0, m_eigenfaces.getRaw(), m_eigenfaces.rows(),
+	    faceImage.getRaw(), -1.0, eigenspacePoint.getRaw());
+}
+
+/// Projects a set of images in the eigenspace with just one matrix
+/// product.
+///
+/// @param faceImages
+///   Faces to be projected, one image per column.
+///
+/// @param eigenspacePoints
+///   Resulting points in the eigenspace, the i-th column is the
+///   projection of the i-th image.
+///
+template<class T>
+void EigenfacesT<T>::projectBatch(const MatrixT<T>& faceImages, MatrixT<T>& eigenspacePoints) const
+{
+  if (faceImages.rows() != m_eigenfaces.rows())
+    throw std::invalid_argument("Invalid argument 'faceImages' in Eigenfaces::projectBatch method: images must have the size of the eigenfaces.");
+
+  size_t images = faceImages.cols();
+
+  // The mean projection is put in each point, then the product
+  // E^T*faceImages is added (beta=-1)
+  eigenspacePoints.resize(m_eigenfaceComponents, images);
+  for (size_t j=0; j<images; ++j)
+    std::copy(m_meanProjection.begin(), m_meanProjection.end(),
+	      eigenspacePoints.getRaw() + j*m_eigenfaceComponents);
+
+  blas_gemm_parallel(GemmTransposed, GemmNormal,
+		     m_eigenfaceComponents, images, m_eigenfaces.rows(),
+		     1.0, m_eigenfaces.getRaw(), m_eigenfaces.rows(),
+		     faceImages.getRaw(), faceImages.rows(),
+		     -1.0, eigenspacePoints.getRaw(), m_eigenfaceComponents);
+}
+
+template<class T>
+void EigenfacesT<T>::calculateMeanProjection()
+{
+  VectorT<T> tmp;
+  const VectorT<T>& meanFace(convert_vector(m_meanFace, tmp));
+
+  m_meanProjection.resize(m_eigenfaces.cols());
+  blas_gemv(GemmTransposed, m_eigenfaces.rows(), m_eigenfaces.cols(),
+	    1.0, m_eigenfaces.getRaw(), m_eigenfaces.rows(),
+	    meanFace.getRaw(), 0.0, m_meanProjection.getRaw());
 }
 
 //////////////////////////////////////////////////////////////////////
 // Binary I/O
 //////////////////////////////////////////////////////////////////////
 
-void Eigenfaces::save(const char* filename) const
+template<class T>
+void EigenfacesT<T>::save(const char* filename) const
 {
   std::ofstream f(filename, std::ios::binary);
   write(f);
 }
 
-void Eigenfaces::load(const char* filename)
+template<class T>
+void EigenfacesT<T>::load(const char* filename)
 {
   std::ifstream f(filename, std::ios::binary);
   read(f);
 }
 
-void Eigenfaces::write(std::ostream& s) const
+/// Writes the eigenvalues, the mean face, the eigenvectors and the
+/// eigenfaces (the last ones tagged with their scalar type, see
+/// Matrix::write).
+///
+template<class T>
+void EigenfacesT<T>::write(std::ostream& s) const
 {
-  size_t eigenvalues_size = m_eigenvalues.size();
-  size_t meanFace_size = m_meanFace.size();
-  size_t eigenvectors_rows = m_eigenvectors.rows();
-  size_t eigenvectors_cols = m_eigenvectors.cols();
-  size_t eigenfaces_rows = m_eigenfaces.rows();
-  size_t eigenfaces_cols = m_eigenfaces.cols();
-
-  s.write((char*)&eigenvalues_size, sizeof(size_t));
-  s.write((char*)m_eigenvalues.getRaw(), sizeof(double)*eigenvalues_size);
-
-  s.write((char*)&meanFace_size, sizeof(size_t));
-  s.write((char*)m_meanFace.getRaw(), sizeof(double)*meanFace_size);
-
-  s.write((char*)&eigenvectors_rows, sizeof(size_t));
-  s.write((char*)&eigenvectors_cols, sizeof(size_t));
-  s.write((char*)m_eigenvectors.getRaw(), sizeof(double)*eigenvectors_rows*eigenvectors_cols);
-
-  s.write((char*)&eigenfaces_rows, sizeof(size_t));
-  s.write((char*)&eigenfaces_cols, sizeof(size_t));
-  s.write((char*)m_eigenfaces.getRaw(), sizeof(double)*eigenfaces_rows*eigenfaces_cols);
+  m_eigenvalues.write(s);
+  m_meanFace.write(s);
+  m_eigenvectors.write(s);
+  m_eigenfaces.write(s);
 }
 
-void Eigenfaces::read(std::istream& s)
+/// Reads eigenfaces saved with any scalar type.
+///
+template<class T>
+void EigenfacesT<T>::read(std::istream& s)
 {
-  size_t eigenvalues_size;
-  size_t meanFace_size;
-  size_t eigenvectors_rows;
-  size_t eigenvectors_cols;
-  size_t eigenfaces_rows;
-  size_t eigenfaces_cols;
-
-  s.read((char*)&eigenvalues_size, sizeof(size_t));
-  m_eigenvalues.resize(eigenvalues_size);
-  s.read((char*)m_eigenvalues.getRaw(), sizeof(double)*eigenvalues_size);
-
-  s.read((char*)&meanFace_size, sizeof(size_t));
-  m_meanFace.resize(meanFace_size);
-  s.read((char*)m_meanFace.getRaw(), sizeof(double)*meanFace_size);
-
-  s.read((char*)&eigenvectors_rows, sizeof(size_t));
-  s.read((char*)&eigenvectors_cols, sizeof(size_t));
-  m_eigenvectors.resize(eigenvectors_rows, eigenvectors_cols);
-  s.read((char*)m_eigenvectors.getRaw(), sizeof(double)*eigenvectors_rows*eigenvectors_cols);
-
-  s.read((char*)&eigenfaces_rows, sizeof(size_t));
-  s.read((char*)&eigenfaces_cols, sizeof(size_t));
-  m_eigenfaces.resize(eigenfaces_rows, eigenfaces_cols);
-  s.read((char*)m_eigenfaces.getRaw(), sizeof(double)*eigenfaces_rows*eigenfaces_cols);
-
-  m_eigenfaceComponents = eigenfaces_cols;
+  m_eigenvalues.read(s);
+  m_meanFace.read(s);
+  m_eigenvectors.read(s);
+  m_eigenfaces.read(s);
+
+  m_eigenfaceComponents = m_eigenfaces.cols();
+  calculateMeanProjection();
 }
+
+template class EigenfacesT<double>;
+template class EigenfacesT<float>;
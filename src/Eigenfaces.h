@@ -16,8 +16,18 @@
 
 /// Calculates eigenfaces from a set of images (vectors really).
 ///
-class Eigenfaces
+/// The training images and the eigenfaces are stored as @a T
+/// (Eigenfaces for double, or EigenfacesT<float> to use half the
+/// memory and single precision projections). The covariance matrix,
+/// its eigenvectors and the mean face are always calculated in
+/// double.
+///
+template<class T>
+class EigenfacesT
 {
+  friend class QuantizedEigenfaces;
+  friend class Recognizer;
+
   /// Number of pixels per picture. It is the number of dimensions in the
   /// orignal space (face width x height pixels).
   ///
@@ -33,13 +43,14 @@ class Eigenfaces
 
   /// Set of training images (each column is an image).
   ///
-  Matrix m_dataSet;
+  MatrixT<T> m_dataSet;
 
-  /// Set of training images with zero mean.
+  /// Tridiagonal form of the covariance matrix of the training
+  /// images (M x M), its eigenvectors are calculated from it.
   ///
-  /// @see m_dataSet, m_meanFace
+  /// @see calculateEigenvalues
   ///
-  Matrix m_dataSetZeroMean;
+  SymmetricEigen m_covarianceEigen;
 
   /// Average between all faces.
   ///
@@ -50,7 +61,12 @@ class Eigenfaces
   /// This matrix has @ref eigenspaceComponents columns and
   /// @ref pixelsPerImage rows.
   ///
-  Matrix m_eigenfaces;
+  MatrixT<T> m_eigenfaces;
+
+  /// Projection of the mean face in the eigenspace (E^T*Psi), it is
+  /// subtracted from E^T*image to project images.
+  ///
+  VectorT<T> m_meanProjection;
 
   /// Number of pre-allocated images (columns).
   ///
@@ -58,8 +74,8 @@ class Eigenfaces
 
 public:
 
-  Eigenfaces();
-  ~Eigenfaces();
+  EigenfacesT();
+  ~EigenfacesT();
 
   void reserve(size_t numImages);
   void addImage(const Vector& faceImage);
@@ -72,7 +88,8 @@ public:
   bool calculateEigenvalues();
   void calculateEigenfaces(size_t components);
   size_t getNumComponentsFor(double variance) const;
-  void projectInEigenspace(const Vector& faceImage, Vector& eigenspacePoint) const;
+  void projectInEigenspace(const VectorT<T>& faceImage, VectorT<T>& eigenspacePoint) const;
+  void projectBatch(const MatrixT<T>& faceImages, MatrixT<T>& eigenspacePoints) const;
 
   //////////////////////////////////////////////////////////////////////
   // Binary I/O
@@ -83,6 +100,11 @@ public:
   void write(std::ostream& s) const;
   void read(std::istream& s);
 
+private:
+  void calculateMeanProjection();
+
 };
 
+typedef EigenfacesT<double> Eigenfaces;
+
 #endif // LOSEFACE_EIGENFACES_H
@@ -0,0 +1,386 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_EXPR_H
+#define LOSEFACE_EXPR_H
+
+#include <cassert>
+#include <cstddef>
+
+#include "Simd.h"
+
+// Expression templates for Vector and Matrix.
+//
+// Operators like "u + v", "s * u" or "A * u" do not calculate
+// anything, they return a small object (an expression) that keeps
+// references to its operands. The expression is evaluated when it is
+// assigned to a Vector/Matrix, directly in the memory of the
+// destination, so a line like
+//
+//   hidden = weight * input + bias;
+//
+// is calculated without temporary vectors.
+//
+// Each expression E has to implement:
+//
+//   enum { elementwise = ... };
+//     true if operator[] (or at() for matrices) can be used to get
+//     each element of the result (e.g. "u + v" is element-wise,
+//     "A * u" is not).
+//
+//   size()  (or rows()/cols() for matrices)
+//
+//   double operator[](size_t i) const  (only element-wise vectors)
+//   double at(size_t k) const          (only element-wise matrices,
+//                                       "k" is the column-major index)
+//
+//     These are only called (instantiated) for element-wise
+//     expressions (see ExprTag).
+//
+//   bool aliases(const double* first, const double* last) const
+//     true if the expression reads memory in [first, last).
+//
+//   void assignTo(double* dst) const
+//     dst = E  (dst is contiguous, column-major for matrices)
+//
+//   void addTo(double* dst, double s) const
+//     dst += s*E
+//
+// Expressions keep references to their operands, so they must be
+// used in the same statement where they are created.
+
+//////////////////////////////////////////////////////////////////////
+// Operations
+//////////////////////////////////////////////////////////////////////
+
+/// Used to select (at compile time) the code for element-wise or
+/// not element-wise expressions.
+template<int Elementwise>
+struct ExprTag { };
+
+struct ExprAdd
+{
+  static double apply(double a, double b) { return a + b; }
+  static double sign() { return 1.0; }
+};
+
+struct ExprSub
+{
+  static double apply(double a, double b) { return a - b; }
+  static double sign() { return -1.0; }
+};
+
+struct ExprMul
+{
+  static double apply(double a, double s) { return a * s; }
+};
+
+struct ExprDiv
+{
+  static double apply(double a, double s) { return a / s; }
+};
+
+//////////////////////////////////////////////////////////////////////
+// Vector expressions
+//////////////////////////////////////////////////////////////////////
+
+/// Base class of all vector expressions (E is the derived class).
+///
+template<class E>
+class VectorExpr
+{
+public:
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/// Element-wise operation between two vector expressions (u+v, u-v).
+///
+template<class L, class R, class Op>
+class VectorBinary : public VectorExpr<VectorBinary<L, R, Op> >
+{
+  const L& m_l;
+  const R& m_r;
+
+public:
+  enum { elementwise = L::elementwise && R::elementwise };
+
+  VectorBinary(const L& l, const R& r) : m_l(l), m_r(r) {
+    assert(l.size() == r.size());
+  }
+
+  size_t size() const { return m_l.size(); }
+  double operator[](size_t i) const { return Op::apply(m_l[i], m_r[i]); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_l.aliases(first, last) || m_r.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const { assignTo(dst, ExprTag<elementwise>()); }
+  void addTo(double* dst, double s) const { addTo(dst, s, ExprTag<elementwise>()); }
+
+private:
+  void assignTo(double* dst, ExprTag<true>) const {
+    for (size_t i=0, n=size(); i<n; ++i)
+      dst[i] = Op::apply(m_l[i], m_r[i]);
+  }
+
+  // The operand that is not element-wise (e.g. a matrix-vector
+  // product) is evaluated first directly in "dst"
+  void assignTo(double* dst, ExprTag<false>) const {
+    if (!L::elementwise) {
+      m_l.assignTo(dst);
+      m_r.addTo(dst, Op::sign());
+    }
+    else {
+      m_r.assignTo(dst);
+      if (Op::sign() < 0.0)
+	simd().scale(size(), -1.0, dst, dst);
+      m_l.addTo(dst, 1.0);
+    }
+  }
+
+  void addTo(double* dst, double s, ExprTag<true>) const {
+    for (size_t i=0, n=size(); i<n; ++i)
+      dst[i] += s * Op::apply(m_l[i], m_r[i]);
+  }
+
+  void addTo(double* dst, double s, ExprTag<false>) const {
+    m_l.addTo(dst, s);
+    m_r.addTo(dst, s * Op::sign());
+  }
+};
+
+/// Operation between a vector expression and a scalar (s*u, u/s).
+///
+template<class E, class Op>
+class VectorScalar : public VectorExpr<VectorScalar<E, Op> >
+{
+  const E& m_e;
+  double m_s;
+
+public:
+  enum { elementwise = E::elementwise };
+
+  VectorScalar(const E& e, double s) : m_e(e), m_s(s) { }
+
+  size_t size() const { return m_e.size(); }
+  double operator[](size_t i) const { return Op::apply(m_e[i], m_s); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_e.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const { assignTo(dst, ExprTag<elementwise>()); }
+  void addTo(double* dst, double s) const { addTo(dst, s, ExprTag<elementwise>()); }
+
+private:
+  void assignTo(double* dst, ExprTag<true>) const {
+    for (size_t i=0, n=size(); i<n; ++i)
+      dst[i] = Op::apply(m_e[i], m_s);
+  }
+
+  void assignTo(double* dst, ExprTag<false>) const {
+    m_e.assignTo(dst);
+    for (size_t i=0, n=size(); i<n; ++i)
+      dst[i] = Op::apply(dst[i], m_s);
+  }
+
+  void addTo(double* dst, double s, ExprTag<true>) const {
+    for (size_t i=0, n=size(); i<n; ++i)
+      dst[i] += s * Op::apply(m_e[i], m_s);
+  }
+
+  void addTo(double* dst, double s, ExprTag<false>) const {
+    m_e.addTo(dst, Op::apply(s, m_s));
+  }
+};
+
+template<class L, class R>
+inline VectorBinary<L, R, ExprAdd>
+operator+(const VectorExpr<L>& l, const VectorExpr<R>& r)
+{
+  return VectorBinary<L, R, ExprAdd>(l.self(), r.self());
+}
+
+template<class L, class R>
+inline VectorBinary<L, R, ExprSub>
+operator-(const VectorExpr<L>& l, const VectorExpr<R>& r)
+{
+  return VectorBinary<L, R, ExprSub>(l.self(), r.self());
+}
+
+template<class E>
+inline VectorScalar<E, ExprMul>
+operator*(const VectorExpr<E>& e, double s)
+{
+  return VectorScalar<E, ExprMul>(e.self(), s);
+}
+
+template<class E>
+inline VectorScalar<E, ExprMul>
+operator*(double s, const VectorExpr<E>& e)
+{
+  return VectorScalar<E, ExprMul>(e.self(), s);
+}
+
+template<class E>
+inline VectorScalar<E, ExprDiv>
+operator/(const VectorExpr<E>& e, double s)
+{
+  return VectorScalar<E, ExprDiv>(e.self(), s);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Matrix expressions
+//////////////////////////////////////////////////////////////////////
+
+/// Base class of all matrix expressions (E is the derived class).
+///
+template<class E>
+class MatrixExpr
+{
+public:
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/// Element-wise operation between two matrix expressions (A+B, A-B).
+///
+template<class L, class R, class Op>
+class MatrixBinary : public MatrixExpr<MatrixBinary<L, R, Op> >
+{
+  const L& m_l;
+  const R& m_r;
+
+public:
+  enum { elementwise = L::elementwise && R::elementwise };
+
+  MatrixBinary(const L& l, const R& r) : m_l(l), m_r(r) {
+    assert(l.rows() == r.rows());
+    assert(l.cols() == r.cols());
+  }
+
+  size_t rows() const { return m_l.rows(); }
+  size_t cols() const { return m_l.cols(); }
+  double at(size_t k) const { return Op::apply(m_l.at(k), m_r.at(k)); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_l.aliases(first, last) || m_r.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const { assignTo(dst, ExprTag<elementwise>()); }
+  void addTo(double* dst, double s) const { addTo(dst, s, ExprTag<elementwise>()); }
+
+private:
+  void assignTo(double* dst, ExprTag<true>) const {
+    for (size_t k=0, n=rows()*cols(); k<n; ++k)
+      dst[k] = Op::apply(m_l.at(k), m_r.at(k));
+  }
+
+  void assignTo(double* dst, ExprTag<false>) const {
+    if (!L::elementwise) {
+      m_l.assignTo(dst);
+      m_r.addTo(dst, Op::sign());
+    }
+    else {
+      m_r.assignTo(dst);
+      if (Op::sign() < 0.0)
+	simd().scale(rows()*cols(), -1.0, dst, dst);
+      m_l.addTo(dst, 1.0);
+    }
+  }
+
+  void addTo(double* dst, double s, ExprTag<true>) const {
+    for (size_t k=0, n=rows()*cols(); k<n; ++k)
+      dst[k] += s * Op::apply(m_l.at(k), m_r.at(k));
+  }
+
+  void addTo(double* dst, double s, ExprTag<false>) const {
+    m_l.addTo(dst, s);
+    m_r.addTo(dst, s * Op::sign());
+  }
+};
+
+/// Operation between a matrix expression and a scalar (s*A, A/s).
+///
+template<class E, class Op>
+class MatrixScalar : public MatrixExpr<MatrixScalar<E, Op> >
+{
+  const E& m_e;
+  double m_s;
+
+public:
+  enum { elementwise = E::elementwise };
+
+  MatrixScalar(const E& e, double s) : m_e(e), m_s(s) { }
+
+  size_t rows() const { return m_e.rows(); }
+  size_t cols() const { return m_e.cols(); }
+  double at(size_t k) const { return Op::apply(m_e.at(k), m_s); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_e.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const { assignTo(dst, ExprTag<elementwise>()); }
+  void addTo(double* dst, double s) const { addTo(dst, s, ExprTag<elementwise>()); }
+
+private:
+  void assignTo(double* dst, ExprTag<true>) const {
+    for (size_t k=0, n=rows()*cols(); k<n; ++k)
+      dst[k] = Op::apply(m_e.at(k), m_s);
+  }
+
+  void assignTo(double* dst, ExprTag<false>) const {
+    m_e.assignTo(dst);
+    for (size_t k=0, n=rows()*cols(); k<n; ++k)
+      dst[k] = Op::apply(dst[k], m_s);
+  }
+
+  void addTo(double* dst, double s, ExprTag<true>) const {
+    for (size_t k=0, n=rows()*cols(); k<n; ++k)
+      dst[k] += s * Op::apply(m_e.at(k), m_s);
+  }
+
+  void addTo(double* dst, double s, ExprTag<false>) const {
+    m_e.addTo(dst, Op::apply(s, m_s));
+  }
+};
+
+template<class L, class R>
+inline MatrixBinary<L, R, ExprAdd>
+operator+(const MatrixExpr<L>& l, const MatrixExpr<R>& r)
+{
+  return MatrixBinary<L, R, ExprAdd>(l.self(), r.self());
+}
+
+template<class L, class R>
+inline MatrixBinary<L, R, ExprSub>
+operator-(const MatrixExpr<L>& l, const MatrixExpr<R>& r)
+{
+  return MatrixBinary<L, R, ExprSub>(l.self(), r.self());
+}
+
+template<class E>
+inline MatrixScalar<E, ExprMul>
+operator*(const MatrixExpr<E>& e, double s)
+{
+  return MatrixScalar<E, ExprMul>(e.self(), s);
+}
+
+template<class E>
+inline MatrixScalar<E, ExprMul>
+operator*(double s, const MatrixExpr<E>& e)
+{
+  return MatrixScalar<E, ExprMul>(e.self(), s);
+}
+
+template<class E>
+inline MatrixScalar<E, ExprDiv>
+operator/(const MatrixExpr<E>& e, double s)
+{
+  return MatrixScalar<E, ExprDiv>(e.self(), s);
+}
+
+#endif // LOSEFACE_EXPR_H
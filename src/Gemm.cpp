@@ -0,0 +1,200 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <vector>
+
+#include "Gemm.h"
+
+// Size of the block of C calculated by the micro-kernel (it must be
+// kept in registers).
+#define GEMM_MR		4
+#define GEMM_NR		4
+
+// Size of packed blocks: a MCxKC block of op(A) should fit in the L2
+// cache, and a KCxNR panel of op(B) in the L1 cache.
+#define GEMM_MC		128
+#define GEMM_KC		256
+#define GEMM_NC		2048
+
+/// Copies the @a mc x @a kc block of op(A) that starts in (i0,p0) in
+/// @a dst, as a sequence of horizontal panels of GEMM_MR rows. Each
+/// panel is stored column by column, and the last one is filled with
+/// zeros if @a mc is not a multiple of GEMM_MR.
+///
+template<class T>
+static void pack_a(GemmOp opA, const T* A, size_t lda,
+		   size_t i0, size_t p0, size_t mc, size_t kc,
+		   T* dst)
+{
+  for (size_t i=0; i<mc; i+=GEMM_MR) {
+    size_t mr = std::min<size_t>(GEMM_MR, mc-i);
+
+    for (size_t p=0; p<kc; ++p) {
+      size_t r;
+      if (opA == GemmNormal) {
+	const T* src = A + (i0+i) + (p0+p)*lda;
+	for (r=0; r<mr; ++r)
+	  *(dst++) = src[r];
+      }
+      else {
+	const T* src = A + (p0+p) + (i0+i)*lda;
+	for (r=0; r<mr; ++r)
+	  *(dst++) = src[r*lda];
+      }
+      for (; r<GEMM_MR; ++r)
+	*(dst++) = 0.0;
+    }
+  }
+}
+
+/// Copies the @a kc x @a nc block of op(B) that starts in (p0,j0) in
+/// @a dst, as a sequence of vertical panels of GEMM_NR columns. Each
+/// panel is stored row by row, and the last one is filled with zeros
+/// if @a nc is not a multiple of GEMM_NR.
+///
+template<class T>
+static void pack_b(GemmOp opB, const T* B, size_t ldb,
+		   size_t p0, size_t j0, size_t kc, size_t nc,
+		   T* dst)
+{
+  for (size_t j=0; j<nc; j+=GEMM_NR) {
+    size_t nr = std::min<size_t>(GEMM_NR, nc-j);
+
+    for (size_t p=0; p<kc; ++p) {
+      size_t c;
+      if (opB == GemmNormal) {
+	const T* src = B + (p0+p) + (j0+j)*ldb;
+	for (c=0; c<nr; ++c)
+	  *(dst++) = src[c*ldb];
+      }
+      else {
+	const T* src = B + (j0+j) + (p0+p)*ldb;
+	for (c=0; c<nr; ++c)
+	  *(dst++) = src[c];
+      }
+      for (; c<GEMM_NR; ++c)
+	*(dst++) = 0.0;
+    }
+  }
+}
+
+/// Calculates C += alpha*a*b where "a" is a packed GEMM_MRx@a kc panel
+/// and "b" a packed @a kc xGEMM_NR panel. Only the first @a mr rows
+/// and @a nr columns of the result are stored in C.
+///
+template<class T>
+static void micro_kernel(size_t kc, const T* a, const T* b,
+			 T alpha, T* C, size_t ldc,
+			 size_t mr, size_t nr)
+{
+  T c00 = 0, c01 = 0, c02 = 0, c03 = 0;
+  T c10 = 0, c11 = 0, c12 = 0, c13 = 0;
+  T c20 = 0, c21 = 0, c22 = 0, c23 = 0;
+  T c30 = 0, c31 = 0, c32 = 0, c33 = 0;
+
+  for (size_t p=0; p<kc; ++p, a+=GEMM_MR, b+=GEMM_NR) {
+    T a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+    T b0 = b[0], b1 = b[1], b2 = b[2], b3 = b[3];
+
+    c00 += a0*b0;  c01 += a0*b1;  c02 += a0*b2;  c03 += a0*b3;
+    c10 += a1*b0;  c11 += a1*b1;  c12 += a1*b2;  c13 += a1*b3;
+    c20 += a2*b0;  c21 += a2*b1;  c22 += a2*b2;  c23 += a2*b3;
+    c30 += a3*b0;  c31 += a3*b1;  c32 += a3*b2;  c33 += a3*b3;
+  }
+
+  T ab[GEMM_MR*GEMM_NR] = {
+    c00, c10, c20, c30,
+    c01, c11, c21, c31,
+    c02, c12, c22, c32,
+    c03, c13, c23, c33
+  };
+
+  for (size_t j=0; j<nr; ++j)
+    for (size_t i=0; i<mr; ++i)
+      C[i+j*ldc] += alpha*ab[i+j*GEMM_MR];
+}
+
+template<class T>
+static void gemm_blocked(GemmOp opA, GemmOp opB,
+			 size_t m, size_t n, size_t k,
+			 T alpha, const T* A, size_t lda,
+			 const T* B, size_t ldb,
+			 T beta, T* C, size_t ldc)
+{
+  // C = beta*C (when beta is zero C could have NaNs, so we do not
+  // multiply, we just clear it)
+  if (beta != 1.0) {
+    for (size_t j=0; j<n; ++j) {
+      T* c = C + j*ldc;
+      if (beta == 0)
+	std::fill(c, c+m, T(0));
+      else
+	for (size_t i=0; i<m; ++i)
+	  c[i] *= beta;
+    }
+  }
+
+  if (m == 0 || n == 0 || k == 0 || alpha == 0)
+    return;
+
+  // Packed buffers are not bigger than the problem (small products,
+  // like the ones of mini-batch training, do not have to clear the
+  // whole buffers in each call)
+  size_t kmax = std::min<size_t>(GEMM_KC, k);
+  std::vector<T> packedA(kmax * ((std::min<size_t>(GEMM_MC, m)
+				       + GEMM_MR - 1) / GEMM_MR * GEMM_MR));
+  std::vector<T> packedB(kmax * ((std::min<size_t>(GEMM_NC, n)
+				       + GEMM_NR - 1) / GEMM_NR * GEMM_NR));
+
+  for (size_t jc=0; jc<n; jc+=GEMM_NC) {
+    size_t nc = std::min<size_t>(GEMM_NC, n-jc);
+
+    for (size_t pc=0; pc<k; pc+=GEMM_KC) {
+      size_t kc = std::min<size_t>(GEMM_KC, k-pc);
+
+      pack_b(opB, B, ldb, pc, jc, kc, nc, &packedB[0]);
+
+      for (size_t ic=0; ic<m; ic+=GEMM_MC) {
+	size_t mc = std::min<size_t>(GEMM_MC, m-ic);
+
+	pack_a(opA, A, lda, ic, pc, mc, kc, &packedA[0]);
+
+	// Macro-kernel: all GEMM_MRxGEMM_NR blocks of C for the packed
+	// block of A and the packed panel of B
+	for (size_t jr=0; jr<nc; jr+=GEMM_NR) {
+	  size_t nr = std::min<size_t>(GEMM_NR, nc-jr);
+	  const T* b = &packedB[jr*kc];
+
+	  for (size_t ir=0; ir<mc; ir+=GEMM_MR) {
+	    size_t mr = std::min<size_t>(GEMM_MR, mc-ir);
+	    const T* a = &packedA[ir*kc];
+
+	    micro_kernel(kc, a, b, alpha,
+			 C + (ic+ir) + (jc+jr)*ldc, ldc, mr, nr);
+	  }
+	}
+      }
+    }
+  }
+}
+
+void gemm(GemmOp opA, GemmOp opB,
+	  size_t m, size_t n, size_t k,
+	  double alpha, const double* A, size_t lda,
+	  const double* B, size_t ldb,
+	  double beta, double* C, size_t ldc)
+{
+  gemm_blocked(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void gemm(GemmOp opA, GemmOp opB,
+	  size_t m, size_t n, size_t k,
+	  float alpha, const float* A, size_t lda,
+	  const float* B, size_t ldb,
+	  float beta, float* C, size_t ldc)
+{
+  gemm_blocked(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
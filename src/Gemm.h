@@ -0,0 +1,47 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_GEMM_H
+#define LOSEFACE_GEMM_H
+
+#include <cstddef>
+
+/// How an operand of #gemm has to be read.
+///
+enum GemmOp {
+  GemmNormal,			// op(X) = X
+  GemmTransposed		// op(X) = X^T
+};
+
+/// General matrix-matrix product for column-major storage:
+///
+///   C = alpha*op(A)*op(B) + beta*C
+///
+/// where op(A) is an @a m x @a k matrix, op(B) is a @a k x @a n
+/// matrix and C is a @a m x @a n matrix. @a lda, @a ldb and @a ldc
+/// are the leading dimensions (distance between two columns) of
+/// each stored matrix, as in BLAS.
+///
+/// The product is calculated by blocks that fit in the CPU caches:
+/// panels of op(A) and op(B) are packed in contiguous buffers (the
+/// transposition is resolved in this packing step, so A^T*B does not
+/// need a transposed copy of A) and a register-tiled micro-kernel
+/// calculates each small block of C.
+///
+void gemm(GemmOp opA, GemmOp opB,
+	  size_t m, size_t n, size_t k,
+	  double alpha, const double* A, size_t lda,
+	  const double* B, size_t ldb,
+	  double beta, double* C, size_t ldc);
+
+/// Single precision version of #gemm.
+///
+void gemm(GemmOp opA, GemmOp opB,
+	  size_t m, size_t n, size_t k,
+	  float alpha, const float* A, size_t lda,
+	  const float* B, size_t ldb,
+	  float beta, float* C, size_t ldc);
+
+#endif // LOSEFACE_GEMM_H
@@ -0,0 +1,137 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "Gram.h"
+#include "Blas.h"
+#include "Matrix.h"
+#include "Thread.h"
+#include "Vector.h"
+
+// Columns of G per block, and rows of X per panel (a centered panel
+// of GRAM_PANEL x GRAM_BLOCK doubles must fit in the L2 cache)
+#define GRAM_BLOCK	128
+#define GRAM_PANEL	256
+
+namespace {
+
+  template<class T>
+  struct GramTask
+  {
+    const MatrixT<T>* X;
+    const Vector* mean;
+    Matrix* G;
+    size_t first;		// First block of this thread
+    size_t step;		// Number of threads
+  };
+
+  // Copies the rows [i0, i0+rows) of columns [j0, j0+cols) of X to
+  // "panel" subtracting the mean of each row (panels are always
+  // double, so float images are converted here).
+  template<class T>
+  void center_panel(const MatrixT<T>& X, const Vector& mean,
+		    size_t i0, size_t rows, size_t j0, size_t cols,
+		    double* panel)
+  {
+    const double* mu = mean.getRaw() + i0;
+
+    for (size_t j=0; j<cols; ++j) {
+      const T* x = X.getRaw() + i0 + (j0+j)*X.rows();
+      for (size_t i=0; i<rows; ++i)
+	panel[i+j*rows] = x[i] - mu[i];
+    }
+  }
+
+  // Calculates the upper triangle blocks (bi, bj) of G, with bi <= bj,
+  // numbered row by row, from "first" jumping "step" blocks.
+  template<class T>
+  void gram_blocks(void* data)
+  {
+    GramTask<T>& task = *(GramTask<T>*)data;
+    const MatrixT<T>& X = *task.X;
+    Matrix& G = *task.G;
+    const size_t n = X.cols();
+    const size_t nblocks = (n + GRAM_BLOCK - 1) / GRAM_BLOCK;
+
+    std::vector<double> panelI(GRAM_PANEL * GRAM_BLOCK);
+    std::vector<double> panelJ(GRAM_PANEL * GRAM_BLOCK);
+    size_t k = 0;
+
+    for (size_t bi=0; bi<nblocks; ++bi) {
+      for (size_t bj=bi; bj<nblocks; ++bj, ++k) {
+	if (k < task.first || (k - task.first) % task.step != 0)
+	  continue;
+
+	size_t j0 = bi*GRAM_BLOCK, ni = std::min<size_t>(GRAM_BLOCK, n-j0);
+	size_t j1 = bj*GRAM_BLOCK, nj = std::min<size_t>(GRAM_BLOCK, n-j1);
+	double* Gij = G.getRaw() + j0 + j1*n;
+
+	for (size_t i0=0; i0<X.rows(); i0+=GRAM_PANEL) {
+	  size_t rows = std::min<size_t>(GRAM_PANEL, X.rows()-i0);
+	  double beta = (i0 == 0 ? 0.0: 1.0);
+
+	  center_panel(X, *task.mean, i0, rows, j0, ni, &panelI[0]);
+
+	  if (bi == bj)
+	    blas_syrk(GemmTransposed, ni, rows,
+		      1.0, &panelI[0], rows, beta, Gij, n);
+	  else {
+	    center_panel(X, *task.mean, i0, rows, j1, nj, &panelJ[0]);
+	    blas_gemm(GemmTransposed, GemmNormal, ni, nj, rows,
+		      1.0, &panelI[0], rows, &panelJ[0], rows,
+		      beta, Gij, n);
+	  }
+	}
+      }
+    }
+  }
+
+}
+
+template<class T>
+void gram(const MatrixT<T>& X, const Vector& mean, Matrix& G, size_t threads)
+{
+  assert(mean.size() == X.rows());
+
+  const size_t n = X.cols();
+  const size_t nblocks = (n + GRAM_BLOCK - 1) / GRAM_BLOCK;
+  const size_t ntasks = nblocks*(nblocks+1)/2;
+
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::max<size_t>(1, std::min(threads, ntasks));
+
+  G.resize(n, n);
+
+  std::vector<GramTask<T> > tasks(threads);
+  for (size_t t=0; t<threads; ++t) {
+    tasks[t].X = &X;
+    tasks[t].mean = &mean;
+    tasks[t].G = &G;
+    tasks[t].first = t;
+    tasks[t].step = threads;
+  }
+
+  // The first block set is calculated in this thread
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&gram_blocks<T>, &tasks[t]));
+
+  gram_blocks<T>(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];		// Joins the thread
+
+  // Copy the upper triangle to the lower one
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=j+1; i<n; ++i)
+      G(i, j) = G(j, i);
+}
+
+template void gram<double>(const Matrix& X, const Vector& mean, Matrix& G, size_t threads);
+template void gram<float>(const MatrixT<float>& X, const Vector& mean, Matrix& G, size_t threads);
@@ -0,0 +1,36 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_GRAM_H
+#define LOSEFACE_GRAM_H
+
+#include <cstddef>
+
+template<class T> class MatrixT;
+template<class T> class VectorT;
+typedef MatrixT<double> Matrix;
+typedef VectorT<double> Vector;
+
+/// Calculates the Gram matrix of the columns of @a X centered in
+/// @a mean:
+///
+///   G = (X - mean*1^T)^T * (X - mean*1^T)
+///
+/// so G(i,j) is the dot product between columns i and j of X minus
+/// the mean. X is not modified and no zero-mean copy of it is
+/// created: rows of X are centered on the fly by small panels.
+///
+/// Only the upper triangle of G is calculated (by blocks, using
+/// syrk/gemm), the blocks are distributed between @a threads threads
+/// (zero means one thread per processor), and finally it is mirrored
+/// to the lower triangle.
+///
+/// X can be a float matrix (MatrixT<float>), G is accumulated in
+/// double anyway.
+///
+template<class T>
+void gram(const MatrixT<T>& X, const Vector& mean, Matrix& G, size_t threads = 0);
+
+#endif // LOSEFACE_GRAM_H
@@ -0,0 +1,43 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_INT8_H
+#define LOSEFACE_INT8_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/// Largest magnitude of the quantized values (they are in
+/// [-INT8_LEVELS, INT8_LEVELS], -128 is not used so the quantization
+/// is symmetric around zero).
+///
+#define INT8_LEVELS		127
+
+/// Quantizes @a n elements of @a x (separated by @a inc) to 8-bit
+/// integers, with one scale for all of them (x[i] ~ scale*q[i]).
+///
+/// @return The scale of the elements (zero if they are all zero).
+///
+inline double quantize_int8(size_t n, const double* x, size_t inc, signed char* q)
+{
+  double max = 0.0;
+  for (size_t i=0; i<n; ++i)
+    max = std::max(max, std::fabs(x[i*inc]));
+
+  if (max == 0.0) {
+    for (size_t i=0; i<n; ++i)
+      q[i] = 0;
+    return 0.0;
+  }
+
+  double scale = max / INT8_LEVELS;
+  double inv = INT8_LEVELS / max;
+  for (size_t i=0; i<n; ++i)
+    q[i] = (signed char)std::floor(x[i*inc]*inv + 0.5);
+  return scale;
+}
+
+#endif // LOSEFACE_INT8_H
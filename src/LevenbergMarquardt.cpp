@@ -0,0 +1,238 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+
+#include "LevenbergMarquardt.h"
+#include "PatternSet.h"
+#include "ActivationFunctions.h"
+#include "Blas.h"
+
+// LAPACK
+extern "C" {
+  extern int dposv_(char *uplo, lapack_int *n, lapack_int *nrhs,
+		    double *a, lapack_int *lda, double *b, lapack_int *ldb,
+		    lapack_int *info);
+}
+
+/// Creates a Levenberg-Marquardt trainer for @a net (its current
+/// weights are the start point).
+///
+LevenbergMarquardt::LevenbergMarquardt(Mlp& net)
+  : m_net(net)
+{
+  m_epoch = 0;
+  m_damping = 0.001;
+  m_increaseFactor = 10.0;
+  m_decreaseFactor = 0.1;
+  m_maxDamping = 1e10;
+  m_blockRows = 256;
+  m_trainingError = m_mse = 0.0;
+  m_forwardPasses = 0;
+}
+
+/// Trains one epoch: calculates the Jacobian and tries steps with
+/// more damping until one of them reduces the SSE.
+///
+/// @return False if the damping reached the maximum without reducing
+///         the error (the weights are not modified), so the training
+///         cannot continue.
+///
+bool LevenbergMarquardt::train(const PatternSet& training_set)
+{
+  const size_t W = countWeights();
+  const size_t outputs = m_net.getOutputs();
+  const size_t R = training_set.size() * outputs;
+  const size_t block = std::max<size_t>(1, m_blockRows / outputs);
+
+  // J^T*J and J^T*e, accumulated with the Jacobian of each block of
+  // patterns (so J is never calculated for the whole set)
+  m_hessian.resize(W, W);
+  m_hessian.zero();
+  m_gradient.resize(W);
+  m_gradient.zero();
+  m_errors.resize(R);
+
+  for (size_t first=0; first<training_set.size(); first += block) {
+    const size_t n = std::min(block, training_set.size() - first);
+    const size_t rows = n * outputs;
+    calcJacobian(training_set, first, n);
+
+    blas_syrk(GemmNormal, W, rows, 1.0, m_jacobian.getRaw(), W,
+	      1.0, m_hessian.getRaw(), W);
+    blas_gemv(GemmNormal, W, rows, 1.0, m_jacobian.getRaw(), W,
+	      m_errors.getRaw() + first*outputs, 1.0, m_gradient.getRaw());
+  }
+  m_forwardPasses++;
+
+  // SSE before the step (the errors are calculated as in #calcSSE,
+  // so the comparison with each step does not depend on the rounding
+  // of other recall paths)
+  double sse = 0.0;
+  for (size_t r=0; r<R; ++r)
+    sse += m_errors(r) * m_errors(r);
+  m_trainingError = sse / R;
+
+  getWeights(m_weights);
+  m_epoch++;
+
+  while (m_damping <= m_maxDamping) {
+    // Solve (J^T*J + mu*I)*dw = J^T*e
+    m_system = m_hessian;
+    for (size_t i=0; i<W; ++i)
+      m_system(i, i) += m_damping;
+    m_step = m_gradient;
+
+    char uplo = 'L';
+    lapack_int n = W, nrhs = 1, lda = W, ldb = W, info = 0;
+    dposv_(&uplo, &n, &nrhs, m_system.getRaw(), &lda,
+	   m_step.getRaw(), &ldb, &info);
+
+    // If J^T*J + mu*I is not positive definite (only in numerical
+    // terms) more damping is needed too
+    if (info == 0) {
+      m_step += m_weights;
+      setWeights(m_step);
+
+      double newSse = calcSSE(training_set);
+      m_forwardPasses++;
+
+      if (newSse < sse) {
+	m_damping = std::max(m_damping * m_decreaseFactor, 1e-20);
+	m_mse = newSse / R;
+	return true;
+      }
+    }
+
+    m_damping *= m_increaseFactor;
+  }
+
+  setWeights(m_weights);
+  m_mse = sse / R;
+  return false;
+}
+
+size_t LevenbergMarquardt::countWeights() const
+{
+  const size_t inputs = m_net.getInputs();
+  const size_t hiddens = m_net.getHiddens();
+  const size_t outputs = m_net.getOutputs();
+
+  return hiddens*inputs + hiddens + outputs*hiddens + outputs;
+}
+
+/// Calculates the errors of the outputs of the @a n patterns from
+/// @a first (in m_errors) and the derivatives of each of those
+/// outputs with respect to each weight (the columns of m_jacobian).
+/// The weights are in the order weight1, bias1, weight2, bias2.
+///
+void LevenbergMarquardt::calcJacobian(const PatternSet& training_set,
+				      size_t first, size_t n)
+{
+  const size_t inputs = m_net.getInputs();
+  const size_t hiddens = m_net.getHiddens();
+  const size_t outputs = m_net.getOutputs();
+  const size_t W = countWeights();
+  const size_t offsetBias1 = hiddens*inputs;
+  const size_t offsetWeight2 = offsetBias1 + hiddens;
+  const size_t offsetBias2 = offsetWeight2 + outputs*hiddens;
+  const double* weight2 = m_net.m_weight2.getRaw();
+
+  m_jacobian.resize(W, n * outputs);
+  m_jacobian.zero();
+
+  Vector input(inputs), hidden0, hidden, output0, output;
+  Vector delta(hiddens), dhidden(hiddens);
+
+  for (size_t p=first; p<first+n; ++p) {
+    const double* in = training_set.getInputRow(p);
+    const double* target = training_set.getOutputRow(p);
+    std::copy(in, in+inputs, input.getRaw());
+
+    m_net.recall(input, hidden0, hidden, output0, output);
+    for (size_t j=0; j<hiddens; ++j)
+      dhidden(j) = m_net.m_hiddenFunc->df(hidden0(j), hidden(j));
+
+    for (size_t k=0; k<outputs; ++k) {
+      const size_t r = p*outputs + k;
+      double* J = m_jacobian.getRaw() + (r - first*outputs)*W;
+      double doutput = m_net.m_outputFunc->df(output0(k), output(k));
+
+      m_errors(r) = target[k] - output(k);
+
+      // Output layer (only the weights of the output k)
+      for (size_t j=0; j<hiddens; ++j)
+	J[offsetWeight2 + j*outputs + k] = doutput * hidden(j);
+      J[offsetBias2 + k] = doutput;
+
+      // Hidden layer
+      for (size_t j=0; j<hiddens; ++j)
+	delta(j) = doutput * weight2[j*outputs + k] * dhidden(j);
+
+      for (size_t i=0; i<inputs; ++i) {
+	double x = input(i);
+	double* Ji = J + i*hiddens;
+	for (size_t j=0; j<hiddens; ++j)
+	  Ji[j] = delta(j) * x;
+      }
+      std::copy(delta.begin(), delta.end(), J + offsetBias1);
+    }
+  }
+}
+
+/// Calculates the SSE of the net with the same recall of
+/// #calcJacobian.
+///
+double LevenbergMarquardt::calcSSE(const PatternSet& training_set) const
+{
+  const size_t inputs = m_net.getInputs();
+  const size_t outputs = m_net.getOutputs();
+  Vector input(inputs), hidden0, hidden, output0, output;
+  double sse = 0.0;
+
+  for (size_t p=0; p<training_set.size(); ++p) {
+    const double* in = training_set.getInputRow(p);
+    const double* target = training_set.getOutputRow(p);
+    std::copy(in, in+inputs, input.getRaw());
+
+    m_net.recall(input, hidden0, hidden, output0, output);
+    for (size_t k=0; k<outputs; ++k) {
+      double e = target[k] - output(k);
+      sse += e * e;
+    }
+  }
+  return sse;
+}
+
+void LevenbergMarquardt::getWeights(Vector& weights) const
+{
+  weights.resize(countWeights());
+  double* w = weights.getRaw();
+
+  w = std::copy(m_net.m_weight1.getRaw(),
+		m_net.m_weight1.getRaw() + m_net.getHiddens()*m_net.getInputs(), w);
+  w = std::copy(m_net.m_bias1.begin(), m_net.m_bias1.end(), w);
+  w = std::copy(m_net.m_weight2.getRaw(),
+		m_net.m_weight2.getRaw() + m_net.getOutputs()*m_net.getHiddens(), w);
+  std::copy(m_net.m_bias2.begin(), m_net.m_bias2.end(), w);
+}
+
+void LevenbergMarquardt::setWeights(const Vector& weights)
+{
+  const double* w = weights.getRaw();
+  size_t n;
+
+  n = m_net.getHiddens()*m_net.getInputs();
+  std::copy(w, w+n, m_net.m_weight1.getRaw()); w += n;
+
+  n = m_net.getHiddens();
+  std::copy(w, w+n, m_net.m_bias1.getRaw()); w += n;
+
+  n = m_net.getOutputs()*m_net.getHiddens();
+  std::copy(w, w+n, m_net.m_weight2.getRaw()); w += n;
+
+  n = m_net.getOutputs();
+  std::copy(w, w+n, m_net.m_bias2.getRaw());
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_LEVENBERGMARQUARDT_H
+#define LOSEFACE_LEVENBERGMARQUARDT_H
+
+#include "Mlp.h"
+
+class PatternSet;
+
+/// Levenberg-Marquardt[1] algorithm to train small MLP models.
+///
+/// In each epoch the Jacobian J of the outputs of all patterns with
+/// respect to all the weights is calculated, and the weights are
+/// moved with the solution of the damped normal equations:
+///
+///   (J^T*J + mu*I) * dw = J^T*e
+///
+/// (e are the errors of the outputs) with LAPACK (dposv). If the SSE
+/// does not decrease, the step is discarded and the damping @a mu is
+/// increased, otherwise it is decreased for the next epoch.
+///
+/// J^T*J and J^T*e are accumulated with the Jacobian of blocks of
+/// patterns, so it needs (weights x weights) doubles for J^T*J and
+/// only (weights x 256) for J. It is for networks with few weights
+/// (e.g. the networks of a MlpArray), where it converges in a few
+/// epochs.
+///
+/// [1] M. T. Hagan, M. B. Menhaj. 1994. "Training feedforward
+/// networks with the Marquardt algorithm". IEEE Transactions on
+/// Neural Networks, 5(6), 989-993.
+///
+class LevenbergMarquardt
+{
+  /// Net in training.
+  Mlp& m_net;
+
+  /// Training epoch.
+  unsigned m_epoch;
+
+  /// Damping of the normal equations (mu).
+  double m_damping;
+  double m_increaseFactor;	// 10
+  double m_decreaseFactor;	// 0.1
+  double m_maxDamping;		// 1e10
+
+  /// Rows of J (outputs of the patterns) calculated at once.
+  size_t m_blockRows;		// 256
+
+  /// MSE of the training set before and after the last epoch.
+  double m_trainingError;
+  double m_mse;
+
+  /// Sweeps over the whole set (the Jacobian and each tried step).
+  size_t m_forwardPasses;
+
+  Matrix m_jacobian;		// J^T of a block (weights x rows)
+  Matrix m_hessian;		// J^T*J
+  Matrix m_system;		// J^T*J + mu*I (factorized by dposv)
+  Vector m_errors;		// Target - output of each output of each pattern
+  Vector m_gradient;		// J^T*e
+  Vector m_weights;		// Weights before the step
+  Vector m_step;
+
+public:
+  LevenbergMarquardt(Mlp& net);
+
+  unsigned getEpoch() const { return m_epoch; }
+  const Mlp& getNet() const { return m_net; }
+
+  double getDamping() const { return m_damping; }
+  double getMaxDamping() const { return m_maxDamping; }
+  void setDamping(double mu) { m_damping = mu; }
+  void setMaxDamping(double mu) { m_maxDamping = mu; }
+
+  double getMSE() const { return m_mse; }
+  double getTrainingError() const { return m_trainingError; }
+  size_t getForwardPasses() const { return m_forwardPasses; }
+
+  bool train(const PatternSet& training_set);
+
+private:
+  size_t countWeights() const;
+  void calcJacobian(const PatternSet& training_set, size_t first, size_t n);
+  double calcSSE(const PatternSet& training_set) const;
+  void getWeights(Vector& weights) const;
+  void setWeights(const Vector& weights);
+
+};
+
+#endif // LOSEFACE_LEVENBERGMARQUARDT_H
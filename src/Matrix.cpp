@@ -5,27 +5,80 @@
 
 #include "Matrix.h"
 #include "Vector.h"
+#include "Blas.h"
+#include "Scalar.h"
+#include "Simd.h"
 #include "approx_eq.h"
 
 // LAPACK
 extern "C" {
-  extern int dsyev_(char *jobz, char *uplo, int *n, double *a,
-		    int *lda, double *w, double *work, int *lwork,
-		    int *info);
-  extern int dgeev_(char *jobvl, char *jobvr, int *n, double *a,
-		    int *lda, double *wr, double *wi, double *vl,
-		    int *ldvl, double *vr, int *ldvr, double *work,
-		    int *lwork, int *info);
+  extern int dsyevr_(char *jobz, char *range, char *uplo, lapack_int *n,
+		     double *a, lapack_int *lda, double *vl, double *vu,
+		     lapack_int *il, lapack_int *iu, double *abstol,
+		     lapack_int *m, double *w, double *z, lapack_int *ldz,
+		     lapack_int *isuppz, double *work, lapack_int *lwork,
+		     lapack_int *iwork, lapack_int *liwork, lapack_int *info);
+  extern int dsytrd_(char *uplo, lapack_int *n, double *a, lapack_int *lda,
+		     double *d, double *e, double *tau, double *work,
+		     lapack_int *lwork, lapack_int *info);
+  extern int dsterf_(lapack_int *n, double *d, double *e, lapack_int *info);
+  extern int dstebz_(char *range, char *order, lapack_int *n, double *vl,
+		     double *vu, lapack_int *il, lapack_int *iu, double *abstol,
+		     double *d, double *e, lapack_int *m, lapack_int *nsplit,
+		     double *w, lapack_int *iblock, lapack_int *isplit,
+		     double *work, lapack_int *iwork, lapack_int *info);
+  extern int dstein_(lapack_int *n, double *d, double *e, lapack_int *m,
+		     double *w, lapack_int *iblock, lapack_int *isplit,
+		     double *z, lapack_int *ldz, double *work, lapack_int *iwork,
+		     lapack_int *ifail, lapack_int *info);
+  extern int dormtr_(char *side, char *uplo, char *trans, lapack_int *m,
+		     lapack_int *n, double *a, lapack_int *lda, double *tau,
+		     double *c, lapack_int *ldc, double *work, lapack_int *lwork,
+		     lapack_int *info);
+  extern int dgeev_(char *jobvl, char *jobvr, lapack_int *n, double *a,
+		    lapack_int *lda, double *wr, double *wi, double *vl,
+		    lapack_int *ldvl, double *vr, lapack_int *ldvr, double *work,
+		    lapack_int *lwork, lapack_int *info);
 }
 
-Matrix::Matrix()
+// The SIMD kernels are for double, float matrices use plain loops.
+
+static void scale_elements(size_t n, double s, double* x)
+{
+  simd().scale(n, s, x, x);
+}
+
+static void scale_elements(size_t n, float s, float* x)
+{
+  for (size_t i=0; i<n; ++i)
+    x[i] *= s;
+}
+
+static void add_elements(size_t n, double s, const double* x, double* y)
+{
+  if (s == 1.0)
+    simd().add(n, y, x, y);
+  else if (s == -1.0)
+    simd().sub(n, y, x, y);
+  else
+    blas_axpy(n, s, x, y);
+}
+
+static void add_elements(size_t n, float s, const float* x, float* y)
+{
+  blas_axpy(n, s, x, y);
+}
+
+template<class T>
+MatrixT<T>::MatrixT()
 {
   m_rows = 1;
   m_cols = 1;
   m_data.resize(m_rows*m_cols);
 }
 
-Matrix::Matrix(size_t rows, size_t cols)
+template<class T>
+MatrixT<T>::MatrixT(size_t rows, size_t cols)
 {
   assert(rows >= 1);
   assert(cols >= 1);
@@ -34,14 +87,16 @@ Matrix::Matrix(size_t rows, size_t cols)
   m_data.resize(m_rows*m_cols);
 }
 
-Matrix::Matrix(const Matrix& A)
+template<class T>
+MatrixT<T>::MatrixT(const MatrixT& A)
 {
   m_rows = A.m_rows;
   m_cols = A.m_cols;
   m_data = A.m_data;
 }
 
-Matrix& Matrix::resize(size_t rows, size_t cols)
+template<class T>
+MatrixT<T>& MatrixT<T>::resize(size_t rows, size_t cols)
 {
   assert(rows >= 1);
   assert(cols >= 1);
@@ -49,7 +104,7 @@ Matrix& Matrix::resize(size_t rows, size_t cols)
   if (m_rows != rows || m_cols != cols) {
     size_t old_rows = m_rows;
     size_t old_cols = m_cols;
-    std::vector<double> old_data(m_data);
+    std::vector<T> old_data(m_data);
 
     m_rows = rows;
     m_cols = cols;
@@ -66,24 +121,27 @@ Matrix& Matrix::resize(size_t rows, size_t cols)
   return *this;
 }
 
-Matrix& Matrix::zero()
+template<class T>
+MatrixT<T>& MatrixT<T>::zero()
 {
-  std::fill(m_data.begin(), m_data.end(), double(0));
+  std::fill(m_data.begin(), m_data.end(), T(0));
   return *this;
 }
 
-void Matrix::makeIdentity()
+template<class T>
+void MatrixT<T>::makeIdentity()
 {
   zero();
 
   size_t k = m_rows < m_cols ? m_rows: m_cols;
   for (size_t i=0; i<k; ++i)
-    operator()(i, i) = double(1);
+    operator()(i, i) = T(1);
 }
 
-double Matrix::getMin() const
+template<class T>
+T MatrixT<T>::getMin() const
 {
-  double min = m_data[0];
+  T min = m_data[0];
 
   size_t k = m_rows*m_cols;
   for (size_t i=1; i<k; ++i)
@@ -93,9 +151,10 @@ double Matrix::getMin() const
   return min;
 }
 
-double Matrix::getMax() const
+template<class T>
+T MatrixT<T>::getMax() const
 {
-  double max = m_data[0];
+  T max = m_data[0];
   size_t i, k = m_rows*m_cols;
 
   for (i=1; i<k; ++i)
@@ -105,10 +164,11 @@ double Matrix::getMax() const
   return max;
 }
 
-std::pair<size_t,size_t> Matrix::getMinPos() const
+template<class T>
+std::pair<size_t,size_t> MatrixT<T>::getMinPos() const
 {
   std::pair<size_t,size_t> pos(0, 0);
-  double min = m_data[0];
+  T min = m_data[0];
   size_t i, j;
 
   for (j=0; j<m_cols; ++j)
@@ -121,10 +181,11 @@ std::pair<size_t,size_t> Matrix::getMinPos() const
   return pos;
 }
 
-std::pair<size_t,size_t> Matrix::getMaxPos() const
+template<class T>
+std::pair<size_t,size_t> MatrixT<T>::getMaxPos() const
 {
   std::pair<size_t,size_t> pos(0, 0);
-  double max = m_data[0];
+  T max = m_data[0];
   size_t i, j;
 
   for (j=0; j<m_cols; ++j)
@@ -137,35 +198,81 @@ std::pair<size_t,size_t> Matrix::getMaxPos() const
   return pos;
 }
 
-void Matrix::getRow(size_t i, Vector& row) const
+template<class T>
+void MatrixT<T>::getRow(size_t i, VectorT<T>& row) const
 {
   row.resize(m_cols);
   for (size_t j=0; j<m_cols; ++j)
     row(j) = operator()(i, j);
 }
 
-void Matrix::getCol(size_t j, Vector& col) const
+template<class T>
+void MatrixT<T>::getCol(size_t j, VectorT<T>& col) const
 {
   col.resize(m_rows);
   for (size_t i=0; i<m_rows; ++i)
     col(i) = operator()(i, j);
 }
 
-Vector Matrix::getRow(size_t i) const
+/// Returns the i-th row without copying it (see ConstVectorView).
+///
+template<>
+ConstVectorView Matrix::getRow(size_t i) const
 {
-  Vector row(m_cols);
-  getRow(i, row);
-  return row;
+  assert(i >= 0 && i < m_rows);
+  return ConstVectorView(&m_data[i], m_cols, m_rows);
 }
 
-Vector Matrix::getCol(size_t j) const
+/// Returns the j-th column without copying it (see ConstVectorView).
+///
+template<>
+ConstVectorView Matrix::getCol(size_t j) const
 {
-  Vector col(m_rows);
-  getCol(j, col);
-  return col;
+  assert(j >= 0 && j < m_cols);
+  return ConstVectorView(&m_data[j*m_rows], m_rows);
 }
 
-Matrix& Matrix::setRow(size_t i, const Vector& u)
+/// Returns the block of @a rows x @a cols elements which starts in
+/// the (@a i, @a j) element, without copying it.
+///
+template<>
+ConstMatrixView Matrix::getBlock(size_t i, size_t j, size_t rows, size_t cols) const
+{
+  assert(rows >= 1 && i+rows <= m_rows);
+  assert(cols >= 1 && j+cols <= m_cols);
+  return ConstMatrixView(&m_data[i+j*m_rows], rows, cols, m_rows);
+}
+
+/// Returns a view to modify the i-th row (see VectorView).
+///
+template<>
+VectorView Matrix::getRow(size_t i)
+{
+  assert(i >= 0 && i < m_rows);
+  return VectorView(&m_data[i], m_cols, m_rows);
+}
+
+/// Returns a view to modify the j-th column (see VectorView).
+///
+template<>
+VectorView Matrix::getCol(size_t j)
+{
+  assert(j >= 0 && j < m_cols);
+  return VectorView(&m_data[j*m_rows], m_rows);
+}
+
+/// Returns a view to modify a block of this matrix (see MatrixView).
+///
+template<>
+MatrixView Matrix::getBlock(size_t i, size_t j, size_t rows, size_t cols)
+{
+  assert(rows >= 1 && i+rows <= m_rows);
+  assert(cols >= 1 && j+cols <= m_cols);
+  return MatrixView(&m_data[i+j*m_rows], rows, cols, m_rows);
+}
+
+template<class T>
+MatrixT<T>& MatrixT<T>::setRow(size_t i, const VectorT<T>& u)
 {
   assert(m_cols == u.size());
 
@@ -175,7 +282,8 @@ Matrix& Matrix::setRow(size_t i, const Vector& u)
   return *this;
 }
 
-Matrix& Matrix::setCol(size_t j, const Vector& u)
+template<class T>
+MatrixT<T>& MatrixT<T>::setCol(size_t j, const VectorT<T>& u)
 {
   assert(m_rows == u.size());
 
@@ -185,6 +293,7 @@ Matrix& Matrix::setCol(size_t j, const Vector& u)
   return *this;
 }
 
+template<>
 Matrix& Matrix::addRow(size_t i, const Vector& u)
 {
   assert(i <= m_rows);
@@ -198,6 +307,7 @@ Matrix& Matrix::addRow(size_t i, const Vector& u)
   return *this;
 }
 
+template<>
 Matrix& Matrix::addCol(size_t j, const Vector& u)
 {
   assert(j <= m_cols);
@@ -211,7 +321,8 @@ Matrix& Matrix::addCol(size_t j, const Vector& u)
   return *this;
 }
 
-void Matrix::meanRow(Vector& row) const
+template<class T>
+void MatrixT<T>::meanRow(VectorT<T>& row) const
 {
   row.resize(m_cols);
   row.zero();
@@ -224,7 +335,8 @@ void Matrix::meanRow(Vector& row) const
   }
 }
 
-void Matrix::meanCol(Vector& col) const
+template<class T>
+void MatrixT<T>::meanCol(VectorT<T>& col) const
 {
   col.resize(m_rows);
   col.zero();
@@ -237,21 +349,24 @@ void Matrix::meanCol(Vector& col) const
   }
 }
 
-Vector Matrix::meanRow() const
+template<class T>
+VectorT<T> MatrixT<T>::meanRow() const
 {
-  Vector row(m_cols);
+  VectorT<T> row(m_cols);
   meanRow(row);
   return row;
 }
 
-Vector Matrix::meanCol() const
+template<class T>
+VectorT<T> MatrixT<T>::meanCol() const
 {
-  Vector col(m_rows);
+  VectorT<T> col(m_rows);
   meanCol(col);
   return col;
 }
 
-void Matrix::getTranspose(Matrix& A) const
+template<class T>
+void MatrixT<T>::getTranspose(MatrixT& A) const
 {
   A.resize(m_cols, m_rows);		// transpose dimensions MxN -> NxM
   for (size_t i=0; i<m_rows; ++i)
@@ -259,14 +374,17 @@ void Matrix::getTranspose(Matrix& A) const
       A(j, i) = operator()(i, j);
 }
 
-Matrix Matrix::getTranspose() const
+/// Returns the transpose of this matrix as an expression, so it is
+/// not copied when it is used in a product (e.g. "A.getTranspose() * u").
+///
+template<>
+MatrixTranspose Matrix::getTranspose() const
 {
-  Matrix A;
-  getTranspose(A);
-  return A;
+  return MatrixTranspose(*this);
 }
 
-Matrix& Matrix::operator=(const Matrix& A)
+template<class T>
+MatrixT<T>& MatrixT<T>::operator=(const MatrixT& A)
 {
   m_rows = A.m_rows;
   m_cols = A.m_cols;
@@ -274,63 +392,15 @@ Matrix& Matrix::operator=(const Matrix& A)
   return *this;
 }
 
-Matrix& Matrix::operator+=(const Matrix& B)
+template<class T>
+MatrixT<T>& MatrixT<T>::operator*=(T s)
 {
-  assert(m_rows == B.m_rows);
-  assert(m_cols == B.m_cols);
-#if 1
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    m_data[i] += B.m_data[i];
-#else  // optimized
-  double* ptr = m_data;
-  double* B_ptr = B.m_data;
-
-  size_t k = m*n;
-  for (size_t i=0; i<k; ++i)
-    *(ptr++) += *(B_ptr++);
-#endif
+  scale_elements(m_rows*m_cols, s, getRaw());
   return *this;
 }
 
-Matrix& Matrix::operator-=(const Matrix& B)
-{
-  assert(m_rows == B.m_rows);
-  assert(m_cols == B.m_cols);
-#if 1
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    m_data[i] -= B.m_data[i];
-#else  // optimized
-  double* ptr = m_data;
-  double* B_ptr = B.m_data;
-
-  size_t k = m*n;
-  for (size_t i=0; i<k; ++i)
-    *(ptr++) -= *(B_ptr++);
-#endif
-
-  return *this;
-}
-
-Matrix& Matrix::operator*=(double s)
-{
-#if 1
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    m_data[i] *= s;
-#else  // optimized
-  double* ptr = m_data;
-
-  size_t k = m_rows*n;
-  for (size_t i=0; i<k; ++i)
-    *(ptr++) *= s;
-#endif
-
-  return *this;
-}
-
-Matrix& Matrix::operator/=(double s)
+template<class T>
+MatrixT<T>& MatrixT<T>::operator/=(T s)
 {
   size_t k = m_rows*m_cols;
   for (size_t i=0; i<k; ++i)
@@ -338,121 +408,97 @@ Matrix& Matrix::operator/=(double s)
   return *this;
 }
 
-Matrix Matrix::operator+(const Matrix& B) const
+template<class T>
+MatrixT<T>& MatrixT<T>::operator*=(const MatrixT& B)
 {
-  assert(m_rows == B.m_rows);
-  assert(m_cols == B.m_cols);
-
-  Matrix C(m_rows, m_cols);
-
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    C.m_data[i] = m_data[i] + B.m_data[i];
-
-  return C;
-}
-
-Matrix Matrix::operator-(const Matrix& B) const
-{
-  assert(m_rows == B.m_rows);
-  assert(m_cols == B.m_cols);
-
-  Matrix C(m_rows, m_cols);
-
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    C.m_data[i] = m_data[i] - B.m_data[i];
-
-  return C;
-}
-
-Matrix Matrix::operator*(double s) const
-{
-  Matrix B(rows(), cols());
-  size_t k = m_rows*m_cols;
-  for (size_t i=0; i<k; ++i)
-    B.m_data[i] = m_data[i] * s;
-
-  return B;
+  MatrixT C(rows(), B.cols());
+  multiply(B, C);
+  std::swap(m_rows, C.m_rows);
+  std::swap(m_cols, C.m_cols);
+  m_data.swap(C.m_data);
+  return *this;
 }
 
-Matrix Matrix::operator*(const Matrix& B) const
+/// Calculates C = A*B (where A is this matrix).
+///
+template<class T>
+void MatrixT<T>::multiply(const MatrixT& B, MatrixT& C) const
 {
   assert(cols() == B.rows());
+  assert(&C != this && &C != &B);
 
-  Matrix C(rows(), B.cols());
-  size_t i, j, k;
-  double result;
-
-  for (j=0; j<C.cols(); ++j) {
-    for (i=0; i<C.rows(); ++i) {
-      result = 0.0;
+  C.resize(rows(), B.cols());
 
-      for (k=0; k<cols(); ++k)
-	result += operator()(i, k) * B(k, j);
-
-      C(i, j) = result;
-    }
-  }
-
-  return C;
+  blas_gemm(GemmNormal, GemmNormal,
+	    rows(), B.cols(), cols(),
+	    1.0, getRaw(), m_rows,
+	    B.getRaw(), B.m_rows,
+	    0.0, C.getRaw(), C.m_rows);
 }
 
-Matrix& Matrix::operator*=(const Matrix& B)
+/// Calculates C = A^T*B (where A is this matrix) without creating
+/// the transpose of A. If B is A, the symmetric product A^T*A is
+/// calculated with syrk.
+///
+template<class T>
+void MatrixT<T>::multiplyTransposed(const MatrixT& B, MatrixT& C) const
 {
-  *this = *this * B;
-  return *this;
+  assert(rows() == B.rows());
+  assert(&C != this && &C != &B);
+
+  C.resize(cols(), B.cols());
+
+  if (&B == this)
+    blas_syrk(GemmTransposed, cols(), rows(),
+	      1.0, getRaw(), m_rows,
+	      0.0, C.getRaw(), C.m_rows);
+  else
+    blas_gemm(GemmTransposed, GemmNormal,
+	      cols(), B.cols(), rows(),
+	      1.0, getRaw(), m_rows,
+	      B.getRaw(), B.m_rows,
+	      0.0, C.getRaw(), C.m_rows);
 }
 
-void Matrix::multiply(const Vector& u, Vector& v) const
+template<class T>
+void MatrixT<T>::multiply(const VectorT<T>& u, VectorT<T>& v) const
 {
   assert(m_cols == u.size());
+  assert(&u != &v);
 
   v.resize(m_rows);
+  blas_gemv(GemmNormal, m_rows, m_cols,
+	    1.0, getRaw(), m_rows, u.getRaw(), 0.0, v.getRaw());
+}
 
-#if 1
-  double r;
-  size_t i, j;
-
-  for (i=0; i<m_rows; ++i) {
-    r = 0.0;
-    for (j=0; j<m_cols; ++j)
-      r += operator()(i, j) * u(j);
-    v(i) = r;
-  }
-#else // optimized
-  double r;
-  size_t i, j;
-
-  double* ptr;
-  double* u_ptr;
-  double* v_ptr = v.m_data;
-
-  for (i=0; i<m_rows; ++i) {
-    r = 0.0;
-
-    ptr = m_data+i;
-    u_ptr = u.m_data;
-
-    for (j=0; j<n; ++j) {
-      r += (*ptr) * (*u_ptr);
-      ptr += m_rows;
-      ++u_ptr;
-    }
+/// Calculates v = A^T*u (where A is this matrix) without creating
+/// the transpose of A.
+///
+template<class T>
+void MatrixT<T>::multiplyTransposed(const VectorT<T>& u, VectorT<T>& v) const
+{
+  assert(m_rows == u.size());
+  assert(&u != &v);
 
-    *(v_ptr++) = r;
-  }
-#endif
+  v.resize(m_cols);
+  blas_gemv(GemmTransposed, m_rows, m_cols,
+	    1.0, getRaw(), m_rows, u.getRaw(), 0.0, v.getRaw());
 }
 
-Vector Matrix::operator*(const Vector& u) const
+/// Adds the outer product alpha*u*v^T to this matrix (BLAS ger).
+///
+template<class T>
+MatrixT<T>& MatrixT<T>::addOuterProduct(T alpha, const VectorT<T>& u, const VectorT<T>& v)
 {
-  Vector v(m_rows);
-  multiply(u, v);
-  return v;
+  assert(m_rows == u.size());
+  assert(m_cols == v.size());
+
+  blas_ger(m_rows, m_cols, alpha, u.getRaw(), v.getRaw(), getRaw(), m_rows);
+  return *this;
 }
 
-bool Matrix::operator==(const Matrix& B) const
+template<class T>
+bool MatrixT<T>::operator==(const MatrixT& B) const
 {
   if (m_rows != B.m_rows || m_cols != B.m_cols)
     return false;
@@ -465,7 +511,8 @@ bool Matrix::operator==(const Matrix& B) const
   return true;
 }
 
-bool Matrix::operator!=(const Matrix& B) const
+template<class T>
+bool MatrixT<T>::operator!=(const MatrixT& B) const
 {
   return !operator==(B);
 }
@@ -485,11 +532,12 @@ bool Matrix::operator!=(const Matrix& B) const
 //      1 2 | 6.4  7.8
 //      3 4 | 3.6  5.0
 //
-Matrix Matrix::dist(const Matrix& B) const
+template<class T>
+MatrixT<T> MatrixT<T>::dist(const MatrixT& B) const
 {
   assert(m_cols == B.m_rows);
 
-  Matrix C(m_rows, B.m_cols);
+  MatrixT C(m_rows, B.m_cols);
   size_t i, j, k;
   double d, d2;
 
@@ -509,11 +557,12 @@ Matrix Matrix::dist(const Matrix& B) const
   return C;
 }
 
-Vector Matrix::distEachRow(const Vector& column_vector) const
+template<class T>
+VectorT<T> MatrixT<T>::distEachRow(const VectorT<T>& column_vector) const
 {
   assert(m_cols == column_vector.size());
 
-  Vector w(m_rows);
+  VectorT<T> w(m_rows);
   size_t i, k;
   double d, d2;
 
@@ -525,41 +574,266 @@ Vector Matrix::distEachRow(const Vector& column_vector) const
       d += d2*d2;
     }
 
-    w(i) = static_cast<double>(std::sqrt(static_cast<double>(d)));
+    w(i) = static_cast<T>(std::sqrt(d));
   }
 
   return w;
 }
 
+/// Calculates all the eigenvalues of a symmetric matrix (only the
+/// upper triangle is used). They are returned in descending order.
+///
+template<>
+void Matrix::eig_sym(Vector& eigenvalues) const
+{
+  eig_sym_range(eigenvalues, NULL, m_cols);
+}
+
+/// Calculates the @a count largest eigenvalues (and their
+/// eigenvectors) of a symmetric matrix. If @a count is zero all the
+/// eigenvalues are calculated.
+///
+/// Eigenvalues are returned in descending order, and the i-th column
+/// of @a eigenvectors is the eigenvector of the i-th eigenvalue.
+/// Only the requested eigenvectors are computed (LAPACK dsyevr with
+/// an index range), so asking for a few components of a big matrix
+/// is much faster than the full decomposition.
+///
+template<>
 void Matrix::eig_sym(Vector& eigenvalues,
-		     Matrix& eigenvectors) const
+		     Matrix& eigenvectors,
+		     size_t count) const
+{
+  if (count == 0)
+    count = m_cols;
+
+  eig_sym_range(eigenvalues, &eigenvectors, count);
+}
+
+template<>
+void Matrix::eig_sym_range(Vector& eigenvalues,
+			   Matrix* eigenvectors,
+			   size_t count) const
 {
   assert(m_rows == m_cols);
+  assert(count >= 1 && count <= m_cols);
+
+  lapack_int n = m_cols;
+  lapack_int lda = m_rows;
+  lapack_int il = n - count + 1;
+  lapack_int iu = n;
+  lapack_int m = 0;
+  lapack_int ldz = n;
+  lapack_int lwork = -1;
+  lapack_int liwork = -1;
+  lapack_int iwork_size = 0;
+  lapack_int info = 0;
+  double vl = 0.0, vu = 0.0, abstol = 0.0, work_size = 0.0;
+  char jobz[] = { eigenvectors ? 'V': 'N', 0 };
+  char range[] = { count == m_cols ? 'A': 'I', 0 };
+  char uplo[] = { 'U', 0 };
 
-  int n = m_cols;
-  int lda = m_rows;
-  int lwork = 4*n;
-  int info = 1;
-  char jobz[] = { 'N', 0 };
+  // dsyevr destroys the input matrix
+  Matrix A(*this);
+  Vector w(m_cols);
+  Matrix Z(eigenvectors ? m_rows: 1, eigenvectors ? count: 1);
+  std::vector<lapack_int> isuppz(2*count);
+
+  // Workspace query
+  dsyevr_(jobz, range, uplo, &n, A.getRaw(), &lda, &vl, &vu, &il, &iu,
+	  &abstol, &m, w.getRaw(), Z.getRaw(), &ldz, &isuppz[0],
+	  &work_size, &lwork, &iwork_size, &liwork, &info);
+
+  if (info == 0) {
+    lwork = static_cast<lapack_int>(work_size);
+    liwork = iwork_size;
+
+    std::vector<double> work(lwork);
+    std::vector<lapack_int> iwork(liwork);
+
+    dsyevr_(jobz, range, uplo, &n, A.getRaw(), &lda, &vl, &vu, &il, &iu,
+	    &abstol, &m, w.getRaw(), Z.getRaw(), &ldz, &isuppz[0],
+	    &work[0], &lwork, &iwork[0], &liwork, &info);
+  }
+
+  if (info < 0) {
+    char buf[1024];
+    std::sprintf(buf, "DSYEVR: argument %d is invalid.", (int)-info);
+    throw std::invalid_argument(std::string(buf));
+  }
+  else if (info > 0 || m != (lapack_int)count)
+    throw std::runtime_error("Eigenvalues calculation does not converge.");
+
+  // LAPACK returns the eigenvalues in ascending order
+  eigenvalues.resize(count);
+  for (size_t i=0; i<count; ++i)
+    eigenvalues(i) = w(count-1-i);
+
+  if (eigenvectors) {
+    eigenvectors->resize(m_rows, count);
+    for (size_t i=0; i<count; ++i)
+      eigenvectors->getCol(i) = Z.getCol(count-1-i);
+  }
+}
+
+/// Reduces the symmetric matrix @a A (only its upper triangle is
+/// used) to tridiagonal form (LAPACK dsytrd).
+///
+void SymmetricEigen::reduce(const Matrix& A)
+{
+  assert(A.rows() == A.cols());
+  assert(A.rows() >= 1);
+
+  lapack_int n = A.cols();
+  lapack_int lda = n;
+  lapack_int lwork = -1;
+  lapack_int info = 0;
+  double work_size = 0.0;
   char uplo[] = { 'U', 0 };
 
-  Vector work(lwork);
+  m_reflectors = A;
+  m_diagonal.resize(n);
+  m_offDiagonal.resize(n);	// n-1 elements (dstemr uses n)
+  m_tau.resize(n);
 
-  eigenvectors = *this;
-  eigenvalues.resize(n);
-  eigenvalues.zero();
+  // Workspace query
+  dsytrd_(uplo, &n, m_reflectors.getRaw(), &lda, m_diagonal.getRaw(),
+	  m_offDiagonal.getRaw(), m_tau.getRaw(), &work_size, &lwork, &info);
 
-  dsyev_(jobz, uplo, &n,
-	 eigenvectors.getRaw(), &lda,
-	 eigenvalues.getRaw(), work.getRaw(), &lwork, &info);
+  if (info == 0) {
+    lwork = static_cast<lapack_int>(work_size);
+    std::vector<double> work(lwork);
+
+    dsytrd_(uplo, &n, m_reflectors.getRaw(), &lda, m_diagonal.getRaw(),
+	    m_offDiagonal.getRaw(), m_tau.getRaw(), &work[0], &lwork, &info);
+  }
 
   if (info < 0) {
     char buf[1024];
-    std::sprintf(buf, "DSYEV: argument info=%d is invalid.", info);
+    std::sprintf(buf, "DSYTRD: argument %d is invalid.", (int)-info);
+    throw std::invalid_argument(std::string(buf));
+  }
+}
+
+/// Calculates all the eigenvalues of the reduced matrix in descending
+/// order (LAPACK dsterf).
+///
+void SymmetricEigen::getEigenvalues(Vector& eigenvalues) const
+{
+  assert(size() >= 1);
+
+  lapack_int n = size();
+  lapack_int info = 0;
+  Vector d(m_diagonal), e(m_offDiagonal);
+
+  dsterf_(&n, d.getRaw(), e.getRaw(), &info);
+
+  if (info < 0) {
+    char buf[1024];
+    std::sprintf(buf, "DSTERF: argument %d is invalid.", (int)-info);
     throw std::invalid_argument(std::string(buf));
   }
   else if (info > 0)
     throw std::runtime_error("Eigenvalues calculation does not converge.");
+
+  // LAPACK returns the eigenvalues in ascending order
+  eigenvalues.resize(n);
+  for (size_t i=0; i<size(); ++i)
+    eigenvalues(i) = d(n-1-i);
+}
+
+/// Calculates the @a count largest eigenvalues and their eigenvectors
+/// of the reduced matrix, as Matrix::eig_sym does for a few of them
+/// (LAPACK dsyevr): the eigenpairs of the tridiagonal form (dstebz
+/// and dstein) are transformed back with the reflectors (dormtr).
+///
+void SymmetricEigen::getEigenvectors(Vector& eigenvalues,
+				     Matrix& eigenvectors,
+				     size_t count) const
+{
+  assert(count >= 1 && count <= size());
+
+  lapack_int n = size();
+  lapack_int il = n - count + 1;
+  lapack_int iu = n;
+  lapack_int m = 0;
+  lapack_int nsplit = 0;
+  lapack_int ldz = n;
+  lapack_int lwork = -1;
+  lapack_int info = 0;
+  double vl = 0.0, vu = 0.0, abstol = 0.0, work_size = 0.0;
+  char range[] = { 'I', 0 };
+  char order[] = { 'B', 0 };
+  char side[] = { 'L', 0 };
+  char uplo[] = { 'U', 0 };
+  char trans[] = { 'N', 0 };
+
+  // dstebz and dstein do not modify the tridiagonal form
+  double* d = const_cast<double*>(m_diagonal.getRaw());
+  double* e = const_cast<double*>(m_offDiagonal.getRaw());
+  Vector w(n);
+  Matrix Z(n, count);
+  std::vector<lapack_int> iblock(n), isplit(n), ifail(count);
+  std::vector<double> work(5*n);
+  std::vector<lapack_int> iwork(3*n);
+
+  dstebz_(range, order, &n, &vl, &vu, &il, &iu, &abstol, d, e, &m,
+	  &nsplit, w.getRaw(), &iblock[0], &isplit[0], &work[0],
+	  &iwork[0], &info);
+
+  if (info == 0 && m == (lapack_int)count)
+    dstein_(&n, d, e, &m, w.getRaw(), &iblock[0], &isplit[0],
+	    Z.getRaw(), &ldz, &work[0], &iwork[0], &ifail[0], &info);
+
+  if (info < 0) {
+    char buf[1024];
+    std::sprintf(buf, "DSTEBZ/DSTEIN: argument %d is invalid.", (int)-info);
+    throw std::invalid_argument(std::string(buf));
+  }
+  else if (info > 0 || m != (lapack_int)count)
+    throw std::runtime_error("Eigenvalues calculation does not converge.");
+
+  // Eigenvectors of the original matrix (dormtr does not modify the
+  // reflectors)
+  double* reflectors = const_cast<double*>(m_reflectors.getRaw());
+  double* tau = const_cast<double*>(m_tau.getRaw());
+  dormtr_(side, uplo, trans, &n, &m, reflectors, &n, tau,
+	  Z.getRaw(), &ldz, &work_size, &lwork, &info);
+
+  if (info == 0) {
+    lwork = static_cast<lapack_int>(work_size);
+    work.resize(lwork);
+
+    dormtr_(side, uplo, trans, &n, &m, reflectors, &n, tau,
+	    Z.getRaw(), &ldz, &work[0], &lwork, &info);
+  }
+
+  if (info < 0) {
+    char buf[1024];
+    std::sprintf(buf, "DORMTR: argument %d is invalid.", (int)-info);
+    throw std::invalid_argument(std::string(buf));
+  }
+
+  // The eigenvalues are in ascending order in each block of the
+  // tridiagonal form, they are sorted as dsyevr does
+  std::vector<size_t> index(count);
+  for (size_t i=0; i<count; ++i)
+    index[i] = i;
+  for (size_t i=0; i+1<count; ++i) {
+    size_t min = i;
+    for (size_t j=i+1; j<count; ++j)
+      if (w(index[j]) < w(index[min]))
+	min = j;
+    std::swap(index[i], index[min]);
+  }
+
+  // Descending order
+  eigenvalues.resize(count);
+  eigenvectors.resize(n, count);
+  for (size_t i=0; i<count; ++i) {
+    eigenvalues(i) = w(index[count-1-i]);
+    eigenvectors.getCol(i) = Z.getCol(index[count-1-i]);
+  }
 }
 
 #if 0
@@ -619,38 +893,110 @@ void Matrix::eig(Vector& eigenvalues,
 }
 #endif
 
+//////////////////////////////////////////////////////////////////////
+// Expressions
+//////////////////////////////////////////////////////////////////////
+
+template<class T>
+void MatrixT<T>::assignTo(T* dst) const
+{
+  std::copy(m_data.begin(), m_data.end(), dst);
+}
+
+template<class T>
+void MatrixT<T>::addTo(T* dst, T s) const
+{
+  add_elements(m_rows*m_cols, s, getRaw(), dst);
+}
+
+void MatrixTranspose::assignTo(double* dst) const
+{
+  size_t m = m_A.rows();
+  size_t n = m_A.cols();
+
+  for (size_t i=0; i<m; ++i)
+    for (size_t j=0; j<n; ++j)
+      dst[j+i*n] = m_A(i, j);
+}
+
+void MatrixTranspose::addTo(double* dst, double s) const
+{
+  size_t m = m_A.rows();
+  size_t n = m_A.cols();
+
+  for (size_t i=0; i<m; ++i)
+    for (size_t j=0; j<n; ++j)
+      dst[j+i*n] += s * m_A(i, j);
+}
+
+void MatrixVectorProduct::assignTo(double* dst) const
+{
+  blas_gemv(m_op, m_A.rows(), m_A.cols(),
+	    1.0, m_A.getRaw(), m_A.rows(), m_u.getRaw(), 0.0, dst);
+}
+
+void MatrixVectorProduct::addTo(double* dst, double s) const
+{
+  blas_gemv(m_op, m_A.rows(), m_A.cols(),
+	    s, m_A.getRaw(), m_A.rows(), m_u.getRaw(), 1.0, dst);
+}
+
+void MatrixProduct::assignTo(double* dst) const
+{
+  blas_gemm(m_opA, m_opB, rows(), cols(), inner(),
+	    1.0, m_A.getRaw(), m_A.rows(),
+	    m_B.getRaw(), m_B.rows(),
+	    0.0, dst, rows());
+}
+
+void MatrixProduct::addTo(double* dst, double s) const
+{
+  blas_gemm(m_opA, m_opB, rows(), cols(), inner(),
+	    s, m_A.getRaw(), m_A.rows(),
+	    m_B.getRaw(), m_B.rows(),
+	    1.0, dst, rows());
+}
+
 //////////////////////////////////////////////////////////////////////
 // Binary I/O
 //////////////////////////////////////////////////////////////////////
 
-void Matrix::save(const char* filename) const
+template<class T>
+void MatrixT<T>::save(const char* filename) const
 {
   std::ofstream f(filename, std::ios::binary);
   write(f);
 }
 
-void Matrix::load(const char* filename)
+template<class T>
+void MatrixT<T>::load(const char* filename)
 {
   std::ifstream f(filename, std::ios::binary);
   read(f);
 }
 
-void Matrix::write(std::ostream& s) const
+template<class T>
+void MatrixT<T>::write(std::ostream& s) const
 {
-  s.write((char*)&m_rows, sizeof(size_t));
+  write_scalar_size<T>(s, m_rows);
   s.write((char*)&m_cols, sizeof(size_t));
-  s.write((char*)getRaw(), sizeof(double)*m_rows*m_cols);
+  s.write((char*)getRaw(), sizeof(T)*m_rows*m_cols);
 }
 
-void Matrix::read(std::istream& s)
+template<class T>
+void MatrixT<T>::read(std::istream& s)
 {
+  ScalarType type;
   size_t m, n;
-  s.read((char*)&m, sizeof(size_t));
+  m = read_scalar_size(s, type);
   s.read((char*)&n, sizeof(size_t));
   resize(m, n);
-  s.read((char*)getRaw(), sizeof(double)*m*n);
+  read_scalars(s, type, getRaw(), m*n);
 }
 
+template class MatrixT<double>;
+template class MatrixT<float>;
+
 bool approx_eq(const Matrix& A, const Matrix& B, unsigned precision)
 {
   if (A.rows() != B.rows() ||
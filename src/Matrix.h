@@ -16,96 +16,188 @@
 #include <fstream>
 
 #include "approx_eq.h"
+#include "Expr.h"
+#include "Gemm.h"
+#include "MatrixView.h"
 #include "Vector.h"
+#include "VectorView.h"
 
-// LAPACK
-extern "C" {
-  extern int dsyev_(char *jobz, char *uplo, int *n, double *a,
-		    int *lda, double *w, double *work, int *lwork,
-		    int *info);
-  extern int dgeev_(char *jobvl, char *jobvr, int *n, double *a,
-		    int *lda, double *wr, double *wi, double *vl,
-		    int *ldvl, double *vr, int *ldvr, double *work,
-		    int *lwork, int *info);
-}
+class MatrixTranspose;
 
-class Matrix
+/// A matrix of @a T elements (double or float) stored column by column.
+///
+/// Matrix (double) is the general type. MatrixT<float> has the same
+/// storage, I/O and BLAS products, but views, expressions and the
+/// eigen decomposition are only available for double (see the
+/// specializations below).
+///
+template<class T>
+class MatrixT : public MatrixExpr<MatrixT<T> >
 {
-  friend class Vector;
+  template<class U> friend class VectorT;
 
   size_t m_rows;
   size_t m_cols;
-  std::vector<double> m_data;
+  std::vector<T> m_data;
 
 public:
+  typedef T value_type;
+
+  MatrixT();
+  MatrixT(size_t rows, size_t cols);
+  MatrixT(const MatrixT& A);
 
-  Matrix();
-  Matrix(size_t rows, size_t cols);
-  Matrix(const Matrix& A);
+  /// Creates a matrix evaluating the given expression (e.g. "A * B").
+  template<class E>
+  MatrixT(const MatrixExpr<E>& expr)
+    : m_rows(expr.self().rows())
+    , m_cols(expr.self().cols())
+    , m_data(m_rows*m_cols) {
+    expr.self().assignTo(getRaw());
+  }
 
-  double* getRaw() { return &m_data[0]; }
-  const double* getRaw() const { return &m_data[0]; }
+  T* getRaw() { return &m_data[0]; }
+  const T* getRaw() const { return &m_data[0]; }
 
   size_t rows() const { return m_rows; }
   size_t cols() const { return m_cols; }
   bool isSquare() const { return m_rows == m_cols; }
 
-  Matrix& resize(size_t rows, size_t cols);
-  Matrix& zero();
+  MatrixT& resize(size_t rows, size_t cols);
+  MatrixT& zero();
   void makeIdentity();
-  double getMin() const;
-  double getMax() const;
+  T getMin() const;
+  T getMax() const;
 
   std::pair<size_t,size_t> getMinPos() const;
   std::pair<size_t,size_t> getMaxPos() const;
 
-  void getRow(size_t i, Vector& row) const;
-  void getCol(size_t j, Vector& col) const;
-  Vector getRow(size_t i) const;
-  Vector getCol(size_t j) const;
-  Matrix& setRow(size_t i, const Vector& u);
-  Matrix& setCol(size_t j, const Vector& u);
-  Matrix& addRow(size_t i, const Vector& u);
-  Matrix& addCol(size_t j, const Vector& u);
-  void meanRow(Vector& row) const;
-  void meanCol(Vector& col) const;
-  Vector meanRow() const;
-  Vector meanCol() const;
-  void getTranspose(Matrix& A) const;
-  Matrix getTranspose() const;
-
-  Matrix& operator=(const Matrix& A);
-  Matrix& operator+=(const Matrix& B);
-  Matrix& operator-=(const Matrix& B);
-  Matrix& operator*=(double s);
-  Matrix& operator/=(double s);
-  Matrix operator+(const Matrix& B) const;
-  Matrix operator-(const Matrix& B) const;
-  Matrix operator*(double s) const;
-  Matrix operator*(const Matrix& B) const;
-  Matrix& operator*=(const Matrix& B);
-  void multiply(const Vector& u, Vector& v) const;
-  Vector operator*(const Vector& u) const;
-  bool operator==(const Matrix& B) const;
-  bool operator!=(const Matrix& B) const;
-
-  Matrix dist(const Matrix& B) const;
-  Vector distEachRow(const Vector& column_vector) const;
-
-  inline double& operator()(size_t i, size_t j) {
+  /// Copies (and converts) the elements of a matrix of other type.
+  template<class U>
+  MatrixT& assign(const MatrixT<U>& A) {
+    m_rows = A.rows();
+    m_cols = A.cols();
+    m_data.assign(A.getRaw(), A.getRaw()+m_rows*m_cols);
+    return *this;
+  }
+
+  void getRow(size_t i, VectorT<T>& row) const;
+  void getCol(size_t j, VectorT<T>& col) const;
+  ConstVectorView getRow(size_t i) const;
+  ConstVectorView getCol(size_t j) const;
+  ConstMatrixView getBlock(size_t i, size_t j, size_t rows, size_t cols) const;
+  VectorView getRow(size_t i);
+  VectorView getCol(size_t j);
+  MatrixView getBlock(size_t i, size_t j, size_t rows, size_t cols);
+  MatrixT& setRow(size_t i, const VectorT<T>& u);
+  MatrixT& setCol(size_t j, const VectorT<T>& u);
+  MatrixT& addRow(size_t i, const VectorT<T>& u);
+  MatrixT& addCol(size_t j, const VectorT<T>& u);
+  void meanRow(VectorT<T>& row) const;
+  void meanCol(VectorT<T>& col) const;
+  VectorT<T> meanRow() const;
+  VectorT<T> meanCol() const;
+  void getTranspose(MatrixT& A) const;
+  MatrixTranspose getTranspose() const;
+
+  MatrixT& operator=(const MatrixT& A);
+  MatrixT& operator*=(T s);
+  MatrixT& operator/=(T s);
+  MatrixT& operator*=(const MatrixT& B);
+  void multiply(const MatrixT& B, MatrixT& C) const;
+  void multiplyTransposed(const MatrixT& B, MatrixT& C) const;
+  void multiply(const VectorT<T>& u, VectorT<T>& v) const;
+  void multiplyTransposed(const VectorT<T>& u, VectorT<T>& v) const;
+  MatrixT& addOuterProduct(T alpha, const VectorT<T>& u, const VectorT<T>& v);
+  bool operator==(const MatrixT& B) const;
+  bool operator!=(const MatrixT& B) const;
+
+  MatrixT dist(const MatrixT& B) const;
+  VectorT<T> distEachRow(const VectorT<T>& column_vector) const;
+
+  inline T& operator()(size_t i, size_t j) {
     assert(i >= 0 && i < m_rows);
     assert(j >= 0 && j < m_cols);
     return m_data[i+j*m_rows];
   }
 
-  inline const double& operator()(size_t i, size_t j) const {
+  inline const T& operator()(size_t i, size_t j) const {
     assert(i >= 0 && i < m_rows);
     assert(j >= 0 && j < m_cols);
     return m_data[i+j*m_rows];
   }
 
+  void eig_sym(Vector& eigenvalues) const;
   void eig_sym(Vector& eigenvalues,
-	       Matrix& eigenvectors) const;
+	       Matrix& eigenvectors,
+	       size_t count = 0) const;
+
+  //////////////////////////////////////////////////////////////////////
+  // Expressions (see Expr.h)
+  //////////////////////////////////////////////////////////////////////
+
+  enum { elementwise = true };
+
+  T at(size_t k) const { return m_data[k]; }
+
+  bool aliases(const T* first, const T* last) const {
+    return getRaw() < last && first < getRaw()+m_data.size();
+  }
+
+  void assignTo(T* dst) const;
+  void addTo(T* dst, T s) const;
+
+  // As in Vector, element-wise expressions are evaluated directly
+  // over this matrix, and products (e.g. "A = A * B") in a temporary
+  // matrix.
+
+  template<class E>
+  MatrixT& operator=(const MatrixExpr<E>& expr) {
+    const E& e = expr.self();
+    if (!E::elementwise && e.aliases(getRaw(), getRaw()+m_data.size())) {
+      MatrixT tmp(e);
+      std::swap(m_rows, tmp.m_rows);
+      std::swap(m_cols, tmp.m_cols);
+      m_data.swap(tmp.m_data);
+    }
+    else {
+      size_t rows = e.rows();
+      size_t cols = e.cols();
+      m_rows = rows;
+      m_cols = cols;
+      m_data.resize(rows*cols);
+      e.assignTo(getRaw());
+    }
+    return *this;
+  }
+
+  template<class E>
+  MatrixT& operator+=(const MatrixExpr<E>& expr) {
+    return addExpr(expr.self(), 1.0);
+  }
+
+  template<class E>
+  MatrixT& operator-=(const MatrixExpr<E>& expr) {
+    return addExpr(expr.self(), -1.0);
+  }
+
+  /// Evaluates the expression directly in the j-th column. Here
+  /// element-wise expressions are checked too because they can use
+  /// other rows/columns of this same matrix.
+  template<class E>
+  MatrixT& setCol(size_t j, const VectorExpr<E>& expr) {
+    const E& e = expr.self();
+    assert(m_rows == e.size());
+
+    T* dst = &m_data[j*m_rows];
+    if (e.aliases(dst, dst+m_rows)) {
+      VectorT<T> tmp(e);
+      tmp.assignTo(dst);
+    }
+    else
+      e.assignTo(dst);
+    return *this;
+  }
 
   //////////////////////////////////////////////////////////////////////
   // Binary I/O
@@ -116,7 +208,191 @@ public:
   void write(std::ostream& s) const;
   void read(std::istream& s);
 
-}; // class Matrix
+private:
+
+  void eig_sym_range(Vector& eigenvalues,
+		     Matrix* eigenvectors,
+		     size_t count) const;
+
+  template<class E>
+  MatrixT& addExpr(const E& e, T s) {
+    assert(m_rows == e.rows());
+    assert(m_cols == e.cols());
+    if (!E::elementwise && e.aliases(getRaw(), getRaw()+m_data.size())) {
+      MatrixT tmp(e);
+      tmp.addTo(getRaw(), s);
+    }
+    else
+      e.addTo(getRaw(), s);
+    return *this;
+  }
+
+}; // class MatrixT
+
+// Members that use views (over double) or LAPACK are only defined
+// for Matrix.
+
+template<> ConstVectorView Matrix::getRow(size_t i) const;
+template<> ConstVectorView Matrix::getCol(size_t j) const;
+template<> ConstMatrixView Matrix::getBlock(size_t i, size_t j, size_t rows, size_t cols) const;
+template<> VectorView Matrix::getRow(size_t i);
+template<> VectorView Matrix::getCol(size_t j);
+template<> MatrixView Matrix::getBlock(size_t i, size_t j, size_t rows, size_t cols);
+template<> Matrix& Matrix::addRow(size_t i, const Vector& u);
+template<> Matrix& Matrix::addCol(size_t j, const Vector& u);
+template<> MatrixTranspose Matrix::getTranspose() const;
+template<> void Matrix::eig_sym(Vector& eigenvalues) const;
+template<> void Matrix::eig_sym(Vector& eigenvalues, Matrix& eigenvectors, size_t count) const;
+template<> void Matrix::eig_sym_range(Vector& eigenvalues, Matrix* eigenvectors, size_t count) const;
+
+/// Eigen decomposition of a symmetric matrix in two steps. The matrix
+/// is reduced to tridiagonal form only once (#reduce), then all its
+/// eigenvalues and the eigenvectors of the largest ones can be
+/// calculated without reducing it again (e.g. when the number of
+/// eigenvectors depends on the eigenvalues).
+///
+class SymmetricEigen
+{
+  Matrix m_reflectors;		// Householder reflectors of the reduction
+  Vector m_tau;			// Scalar factors of the reflectors
+  Vector m_diagonal;		// Tridiagonal form
+  Vector m_offDiagonal;
+
+public:
+  void reduce(const Matrix& A);
+  size_t size() const { return m_diagonal.size(); }
+  void getEigenvalues(Vector& eigenvalues) const;
+  void getEigenvectors(Vector& eigenvalues,
+		       Matrix& eigenvectors,
+		       size_t count) const;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Matrix expressions
+//////////////////////////////////////////////////////////////////////
+
+/// The transpose of a matrix (see Matrix::getTranspose). Products
+/// with a transposed matrix use the transposed kernels directly.
+///
+class MatrixTranspose : public MatrixExpr<MatrixTranspose>
+{
+  const Matrix& m_A;
+
+public:
+  enum { elementwise = false };
+
+  explicit MatrixTranspose(const Matrix& A) : m_A(A) { }
+
+  const Matrix& matrix() const { return m_A; }
+  size_t rows() const { return m_A.cols(); }
+  size_t cols() const { return m_A.rows(); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_A.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const;
+  void addTo(double* dst, double s) const;
+};
+
+/// op(A)*u where op(A) is A or A^T.
+///
+class MatrixVectorProduct : public VectorExpr<MatrixVectorProduct>
+{
+  const Matrix& m_A;
+  GemmOp m_op;
+  const Vector& m_u;
+
+public:
+  enum { elementwise = false };
+
+  MatrixVectorProduct(const Matrix& A, GemmOp op, const Vector& u)
+    : m_A(A), m_op(op), m_u(u) {
+    assert((op == GemmNormal ? A.cols(): A.rows()) == u.size());
+  }
+
+  size_t size() const {
+    return m_op == GemmNormal ? m_A.rows(): m_A.cols();
+  }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_A.aliases(first, last) || m_u.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const;
+  void addTo(double* dst, double s) const;
+};
+
+/// op(A)*op(B) where op(X) is X or X^T.
+///
+class MatrixProduct : public MatrixExpr<MatrixProduct>
+{
+  const Matrix& m_A;
+  GemmOp m_opA;
+  const Matrix& m_B;
+  GemmOp m_opB;
+
+public:
+  enum { elementwise = false };
+
+  MatrixProduct(const Matrix& A, GemmOp opA, const Matrix& B, GemmOp opB)
+    : m_A(A), m_opA(opA), m_B(B), m_opB(opB) {
+    assert(inner() == (opB == GemmNormal ? B.rows(): B.cols()));
+  }
+
+  size_t rows() const { return m_opA == GemmNormal ? m_A.rows(): m_A.cols(); }
+  size_t cols() const { return m_opB == GemmNormal ? m_B.cols(): m_B.rows(); }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_A.aliases(first, last) || m_B.aliases(first, last);
+  }
+
+  void assignTo(double* dst) const;
+  void addTo(double* dst, double s) const;
+
+private:
+  size_t inner() const { return m_opA == GemmNormal ? m_A.cols(): m_A.rows(); }
+};
+
+inline MatrixVectorProduct operator*(const Matrix& A, const Vector& u)
+{
+  return MatrixVectorProduct(A, GemmNormal, u);
+}
+
+inline MatrixVectorProduct operator*(const MatrixTranspose& At, const Vector& u)
+{
+  return MatrixVectorProduct(At.matrix(), GemmTransposed, u);
+}
+
+/// Product with a vector expression (e.g. "A * (u + v)"), the
+/// expression is evaluated in a temporary vector.
+template<class E>
+inline Vector operator*(const Matrix& A, const VectorExpr<E>& expr)
+{
+  Vector u(expr), v(A.rows());
+  A.multiply(u, v);
+  return v;
+}
+
+inline MatrixProduct operator*(const Matrix& A, const Matrix& B)
+{
+  return MatrixProduct(A, GemmNormal, B, GemmNormal);
+}
+
+inline MatrixProduct operator*(const MatrixTranspose& At, const Matrix& B)
+{
+  return MatrixProduct(At.matrix(), GemmTransposed, B, GemmNormal);
+}
+
+inline MatrixProduct operator*(const Matrix& A, const MatrixTranspose& Bt)
+{
+  return MatrixProduct(A, GemmNormal, Bt.matrix(), GemmTransposed);
+}
+
+inline MatrixProduct operator*(const MatrixTranspose& At, const MatrixTranspose& Bt)
+{
+  return MatrixProduct(At.matrix(), GemmTransposed, Bt.matrix(), GemmTransposed);
+}
 
 bool approx_eq(const Matrix& A, const Matrix& B, unsigned precision);
 
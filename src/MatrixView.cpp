@@ -0,0 +1,123 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "MatrixView.h"
+#include "Blas.h"
+#include "Simd.h"
+
+//////////////////////////////////////////////////////////////////////
+// ConstMatrixView
+//////////////////////////////////////////////////////////////////////
+
+ConstVectorView ConstMatrixView::getRow(size_t i) const
+{
+  assert(i >= 0 && i < m_rows);
+  return ConstVectorView(m_data+i, m_cols, m_ld);
+}
+
+ConstVectorView ConstMatrixView::getCol(size_t j) const
+{
+  assert(j >= 0 && j < m_cols);
+  return ConstVectorView(m_data+j*m_ld, m_rows);
+}
+
+/// Returns the block of @a rows x @a cols elements which starts in
+/// the (@a i, @a j) element.
+///
+ConstMatrixView ConstMatrixView::getBlock(size_t i, size_t j,
+					  size_t rows, size_t cols) const
+{
+  assert(rows >= 1 && i+rows <= m_rows);
+  assert(cols >= 1 && j+cols <= m_cols);
+  return ConstMatrixView(m_data+i+j*m_ld, rows, cols, m_ld);
+}
+
+void ConstMatrixView::assignTo(double* dst) const
+{
+  for (size_t j=0; j<m_cols; ++j)
+    std::copy(m_data+j*m_ld, m_data+j*m_ld+m_rows, dst+j*m_rows);
+}
+
+void ConstMatrixView::addTo(double* dst, double s) const
+{
+  for (size_t j=0; j<m_cols; ++j)
+    blas_axpy(m_rows, s, m_data+j*m_ld, dst+j*m_rows);
+}
+
+void ConstMatrixView::write(std::ostream& s) const
+{
+  s.write((char*)&m_rows, sizeof(size_t));
+  s.write((char*)&m_cols, sizeof(size_t));
+  for (size_t j=0; j<m_cols; ++j)
+    s.write((char*)(m_data+j*m_ld), sizeof(double)*m_rows);
+}
+
+//////////////////////////////////////////////////////////////////////
+// MatrixView
+//////////////////////////////////////////////////////////////////////
+
+VectorView MatrixView::getRow(size_t i)
+{
+  assert(i >= 0 && i < m_rows);
+  return VectorView(getRaw()+i, m_cols, m_ld);
+}
+
+VectorView MatrixView::getCol(size_t j)
+{
+  assert(j >= 0 && j < m_cols);
+  return VectorView(getRaw()+j*m_ld, m_rows);
+}
+
+MatrixView MatrixView::getBlock(size_t i, size_t j, size_t rows, size_t cols)
+{
+  assert(rows >= 1 && i+rows <= m_rows);
+  assert(cols >= 1 && j+cols <= m_cols);
+  return MatrixView(getRaw()+i+j*m_ld, rows, cols, m_ld);
+}
+
+MatrixView& MatrixView::zero()
+{
+  for (size_t j=0; j<m_cols; ++j)
+    std::fill(getRaw()+j*m_ld, getRaw()+j*m_ld+m_rows, double(0));
+  return *this;
+}
+
+MatrixView& MatrixView::operator*=(double s)
+{
+  for (size_t j=0; j<m_cols; ++j)
+    simd().scale(m_rows, s, getRaw()+j*m_ld, getRaw()+j*m_ld);
+  return *this;
+}
+
+/// Reads a matrix written with Matrix::write or
+/// ConstMatrixView::write. The stored matrix must have the same size
+/// as the view.
+///
+void MatrixView::read(std::istream& s)
+{
+  size_t m, n;
+  s.read((char*)&m, sizeof(size_t));
+  s.read((char*)&n, sizeof(size_t));
+  if (m != m_rows || n != m_cols)
+    throw std::invalid_argument("The stored matrix does not have the size of the view.");
+
+  for (size_t j=0; j<m_cols; ++j)
+    s.read((char*)(getRaw()+j*m_ld), sizeof(double)*m_rows);
+}
+
+void MatrixView::copyFrom(const std::vector<double>& tmp)
+{
+  for (size_t j=0; j<m_cols; ++j)
+    std::copy(&tmp[j*m_rows], &tmp[j*m_rows]+m_rows, getRaw()+j*m_ld);
+}
+
+void MatrixView::addFrom(const std::vector<double>& tmp, double s)
+{
+  for (size_t j=0; j<m_cols; ++j)
+    blas_axpy(m_rows, s, &tmp[j*m_rows], getRaw()+j*m_ld);
+}
@@ -0,0 +1,174 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_MATRIXVIEW_H
+#define LOSEFACE_MATRIXVIEW_H
+
+#include <cassert>
+#include <vector>
+#include <iostream>
+
+#include "Expr.h"
+#include "VectorView.h"
+
+/// Read-only view of a sub-block of a matrix (see Matrix::getBlock).
+///
+/// Elements are stored column by column, @a ld doubles is the
+/// distance between two columns (the number of rows of the viewed
+/// matrix).
+///
+class ConstMatrixView : public MatrixExpr<ConstMatrixView>
+{
+protected:
+  const double* m_data;
+  size_t m_rows;
+  size_t m_cols;
+  size_t m_ld;
+
+public:
+  enum { elementwise = false };
+
+  ConstMatrixView(const double* data, size_t rows, size_t cols, size_t ld)
+    : m_data(data), m_rows(rows), m_cols(cols), m_ld(ld) {
+    assert(ld >= rows);
+  }
+
+  const double* getRaw() const { return m_data; }
+  size_t rows() const { return m_rows; }
+  size_t cols() const { return m_cols; }
+  size_t ld() const { return m_ld; }
+
+  ConstVectorView getRow(size_t i) const;
+  ConstVectorView getCol(size_t j) const;
+  ConstMatrixView getBlock(size_t i, size_t j, size_t rows, size_t cols) const;
+
+  inline const double& operator()(size_t i, size_t j) const {
+    assert(i >= 0 && i < m_rows);
+    assert(j >= 0 && j < m_cols);
+    return m_data[i+j*m_ld];
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // Expressions (see Expr.h)
+  //////////////////////////////////////////////////////////////////////
+
+  bool aliases(const double* first, const double* last) const {
+    return m_data < last && first < end();
+  }
+
+  void assignTo(double* dst) const;
+  void addTo(double* dst, double s) const;
+
+  //////////////////////////////////////////////////////////////////////
+  // Binary I/O (same format as Matrix)
+  //////////////////////////////////////////////////////////////////////
+
+  void write(std::ostream& s) const;
+
+protected:
+  /// Returns the address after the last element.
+  const double* end() const { return m_data+(m_cols-1)*m_ld+m_rows; }
+
+};
+
+/// A view to modify a sub-block of a matrix (see Matrix::getBlock).
+///
+/// As in VectorView, assignments copy the elements.
+///
+class MatrixView : public ConstMatrixView
+{
+public:
+  MatrixView(double* data, size_t rows, size_t cols, size_t ld)
+    : ConstMatrixView(data, rows, cols, ld) { }
+
+  double* getRaw() { return const_cast<double*>(m_data); }
+  const double* getRaw() const { return m_data; }
+
+  VectorView getRow(size_t i);
+  VectorView getCol(size_t j);
+  MatrixView getBlock(size_t i, size_t j, size_t rows, size_t cols);
+  ConstVectorView getRow(size_t i) const { return ConstMatrixView::getRow(i); }
+  ConstVectorView getCol(size_t j) const { return ConstMatrixView::getCol(j); }
+  ConstMatrixView getBlock(size_t i, size_t j, size_t rows, size_t cols) const {
+    return ConstMatrixView::getBlock(i, j, rows, cols);
+  }
+
+  MatrixView& zero();
+  MatrixView& operator=(const MatrixView& A) { return assign(A); }
+  MatrixView& operator*=(double s);
+
+  template<class E>
+  MatrixView& operator=(const MatrixExpr<E>& expr) {
+    return assign(expr.self());
+  }
+
+  template<class E>
+  MatrixView& operator+=(const MatrixExpr<E>& expr) {
+    return add(expr.self(), 1.0);
+  }
+
+  template<class E>
+  MatrixView& operator-=(const MatrixExpr<E>& expr) {
+    return add(expr.self(), -1.0);
+  }
+
+  inline double& operator()(size_t i, size_t j) {
+    assert(i >= 0 && i < m_rows);
+    assert(j >= 0 && j < m_cols);
+    return getRaw()[i+j*m_ld];
+  }
+
+  inline const double& operator()(size_t i, size_t j) const {
+    assert(i >= 0 && i < m_rows);
+    assert(j >= 0 && j < m_cols);
+    return m_data[i+j*m_ld];
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // Binary I/O
+  //////////////////////////////////////////////////////////////////////
+
+  void read(std::istream& s);
+
+private:
+
+  // Expressions are evaluated in a temporary buffer (column by
+  // column) when the view is not contiguous or the expression reads
+  // the viewed memory.
+
+  template<class E>
+  MatrixView& assign(const E& e) {
+    assert(m_rows == e.rows());
+    assert(m_cols == e.cols());
+    if (m_ld == m_rows && !e.aliases(m_data, end()))
+      e.assignTo(getRaw());
+    else {
+      std::vector<double> tmp(m_rows*m_cols);
+      e.assignTo(&tmp[0]);
+      copyFrom(tmp);
+    }
+    return *this;
+  }
+
+  template<class E>
+  MatrixView& add(const E& e, double s) {
+    assert(m_rows == e.rows());
+    assert(m_cols == e.cols());
+    if (m_ld == m_rows && !e.aliases(m_data, end()))
+      e.addTo(getRaw(), s);
+    else {
+      std::vector<double> tmp(m_rows*m_cols);
+      e.assignTo(&tmp[0]);
+      addFrom(tmp, s);
+    }
+    return *this;
+  }
+
+  void copyFrom(const std::vector<double>& tmp);
+  void addFrom(const std::vector<double>& tmp, double s);
+
+};
+
+#endif // LOSEFACE_MATRIXVIEW_H
@@ -3,18 +3,33 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
 #include "Mlp.h"
 #include "ActivationFunctions.h"
+#include "MlpKernels.h"
+#include "Blas.h"
 #include "PatternSet.h"
 #include "Random.h"
+#include "Thread.h"
+
+// Inputs of each GEMM in Mlp::recallColumns
+#define RECALL_COLUMNS		64
 
-Mlp::Mlp()
+// Minimum number of inputs per thread in Mlp::recallBatch
+#define RECALL_PARALLEL_MIN_COLS	64
+
+template<class T>
+MlpT<T>::MlpT()
   : m_hiddenFunc(new Logsig())
   , m_outputFunc(new Purelin())
 {
 }
 
-Mlp::Mlp(size_t inputs, size_t hiddens, size_t outputs)
+template<class T>
+MlpT<T>::MlpT(size_t inputs, size_t hiddens, size_t outputs)
   : m_weight1(hiddens, inputs)
   , m_weight2(outputs, hiddens)
   , m_bias1(hiddens)
@@ -26,7 +41,8 @@ Mlp::Mlp(size_t inputs, size_t hiddens, size_t outputs)
   m_bias2.zero();
 }
 
-Mlp::Mlp(const Mlp& mlp)
+template<class T>
+MlpT<T>::MlpT(const MlpT& mlp)
   : m_weight1(mlp.m_weight1)
   , m_weight2(mlp.m_weight2)
   , m_bias1(mlp.m_bias1)
@@ -36,13 +52,15 @@ Mlp::Mlp(const Mlp& mlp)
 {
 }
 
-Mlp::~Mlp()
+template<class T>
+MlpT<T>::~MlpT()
 {
   delete m_hiddenFunc;
   delete m_outputFunc;
 }
 
-Mlp& Mlp::operator=(const Mlp& mlp)
+template<class T>
+MlpT<T>& MlpT<T>::operator=(const MlpT& mlp)
 {
   delete m_hiddenFunc;
   delete m_outputFunc;
@@ -57,7 +75,8 @@ Mlp& Mlp::operator=(const Mlp& mlp)
   return *this;
 }
 
-Mlp& Mlp::operator+=(const Mlp& delta)
+template<class T>
+MlpT<T>& MlpT<T>::operator+=(const MlpT& delta)
 {
   m_weight1 += delta.m_weight1;
   m_weight2 += delta.m_weight2;
@@ -66,7 +85,8 @@ Mlp& Mlp::operator+=(const Mlp& delta)
   return *this;
 }
 
-Mlp& Mlp::operator*=(double s)
+template<class T>
+MlpT<T>& MlpT<T>::operator*=(T s)
 {
   m_weight1 *= s;
   m_weight2 *= s;
@@ -75,19 +95,22 @@ Mlp& Mlp::operator*=(double s)
   return *this;
 }
 
-void Mlp::setHiddenActivationFunction(const ActivationFunction& func)
+template<class T>
+void MlpT<T>::setHiddenActivationFunction(const ActivationFunction& func)
 {
   delete m_hiddenFunc;
   m_hiddenFunc = func.clone();
 }
 
-void Mlp::setOutputActivationFunction(const ActivationFunction& func)
+template<class T>
+void MlpT<T>::setOutputActivationFunction(const ActivationFunction& func)
 {
   delete m_outputFunc;
   m_outputFunc = func.clone();
 }
 
-void Mlp::zero()
+template<class T>
+void MlpT<T>::zero()
 {
   m_weight1.zero();
   m_weight2.zero();
@@ -95,100 +118,258 @@ void Mlp::zero()
   m_bias2.zero();
 }
 
-void Mlp::initRandom(double min_value, double max_value)
+// Uses Random as a generator for init_random
+struct GlobalRandom
+{
+  double getReal() { return Random::getReal(); }
+};
+
+template<class T, class Generator>
+static void init_random(MatrixT<T>& weight1, MatrixT<T>& weight2,
+			VectorT<T>& bias1, VectorT<T>& bias2,
+			double min_value, double max_value,
+			Generator& random)
 {
   size_t i, j, k;
   double range = (max_value - min_value);
 
-  for (j=0; j<m_weight1.rows(); ++j)
-    for (i=0; i<m_weight1.cols(); ++i)
-      m_weight1(j, i) = min_value + range*Random::getReal();
+  for (j=0; j<weight1.rows(); ++j)
+    for (i=0; i<weight1.cols(); ++i)
+      weight1(j, i) = min_value + range*random.getReal();
 
-  for (k=0; k<m_weight2.rows(); ++k)
-    for (j=0; j<m_weight2.cols(); ++j)
-      m_weight2(k, j) = min_value + range*Random::getReal();
+  for (k=0; k<weight2.rows(); ++k)
+    for (j=0; j<weight2.cols(); ++j)
+      weight2(k, j) = min_value + range*random.getReal();
 
-  for (j=0; j<m_bias1.size(); ++j)
-    m_bias1(j) = min_value + range*Random::getReal();
+  for (j=0; j<bias1.size(); ++j)
+    bias1(j) = min_value + range*random.getReal();
 
-  for (k=0; k<m_bias2.size(); ++k)
-    m_bias2(k) = min_value + range*Random::getReal();
+  for (k=0; k<bias2.size(); ++k)
+    bias2(k) = min_value + range*random.getReal();
 }
 
-void Mlp::recall(const Vector& input, Vector& hidden, Vector& output) const
+template<class T>
+void MlpT<T>::initRandom(double min_value, double max_value)
 {
-#if 1
-  hidden = m_weight1 * input + m_bias1;
-  for (size_t j=0; j<hidden.size(); ++j)
-    hidden(j) = m_hiddenFunc->f(hidden(j));
+  GlobalRandom random;
+  init_random(m_weight1, m_weight2, m_bias1, m_bias2,
+	      min_value, max_value, random);
+}
+
+/// Initializes the weights with numbers of the given @a random
+/// stream (instead of the global generator), so the result does not
+/// depend on other threads.
+///
+template<class T>
+void MlpT<T>::initRandom(double min_value, double max_value, RandomStream& random)
+{
+  init_random(m_weight1, m_weight2, m_bias1, m_bias2,
+	      min_value, max_value, random);
+}
+
+// Expressions (e.g. "W * x + b") are only for double, so the
+// layers are calculated with products of MatrixT (the same operations
+// that the expressions do)
+
+template<class T>
+void MlpT<T>::recall(const VectorT<T>& input, VectorT<T>& hidden, VectorT<T>& output) const
+{
+  const MlpKernels<T>& kernels(mlp_kernels<T>(*m_hiddenFunc, *m_outputFunc));
 
-  output = m_weight2 * hidden + m_bias2;
-  for (size_t k=0; k<output.size(); ++k)
-    output(k) = m_outputFunc->f(output(k));
-#else  // optimized (to avoid temporary objects)
   m_weight1.multiply(input, hidden);
   hidden += m_bias1;
-  for (size_t j=0; j<hidden.size(); ++j)
-    hidden(j) = hiddenFunc.f(hidden(j));
+  kernels.hidden(m_hiddenFunc, hidden.size(), hidden.getRaw(), hidden.getRaw());
 
   m_weight2.multiply(hidden, output);
   output += m_bias2;
-  for (size_t k=0; k<output.size(); ++k)
-    output(k) = outputFunc.f(output(k));
-#endif
+  kernels.output(m_outputFunc, output.size(), output.getRaw(), output.getRaw());
 }
 
-void Mlp::recall(const Vector& input,
-		 Vector& hidden0, Vector& hidden,
-		 Vector& output0, Vector& output) const
+template<class T>
+void MlpT<T>::recall(const VectorT<T>& input,
+		     VectorT<T>& hidden0, VectorT<T>& hidden,
+		     VectorT<T>& output0, VectorT<T>& output) const
 {
-#if 1
-  hidden0 = m_weight1 * input + m_bias1;
-  hidden.resize(hidden0.size());
-  for (size_t j=0; j<hidden0.size(); ++j)
-    hidden(j) = m_hiddenFunc->f(hidden0(j));
+  const MlpKernels<T>& kernels(mlp_kernels<T>(*m_hiddenFunc, *m_outputFunc));
 
-  output0 = m_weight2 * hidden + m_bias2;
-  output.resize(output0.size());
-  for (size_t k=0; k<output0.size(); ++k)
-    output(k) = m_outputFunc->f(output0(k));
-#else  // optimized
   m_weight1.multiply(input, hidden0);
   hidden0 += m_bias1;
   hidden.resize(hidden0.size());
-  for (size_t j=0; j<hidden0.size(); ++j)
-    hidden(j) = hiddenFunc.f(hidden0(j));
+  kernels.hidden(m_hiddenFunc, hidden0.size(), hidden0.getRaw(), hidden.getRaw());
 
   m_weight2.multiply(hidden, output0);
   output0 += m_bias2;
   output.resize(output0.size());
-  for (size_t k=0; k<output0.size(); ++k)
-    output(k) = outputFunc.f(output0(k));
-#endif
+  kernels.output(m_outputFunc, output0.size(), output0.getRaw(), output.getRaw());
+}
+
+// A range of inputs for a thread of Mlp::recallBatch
+template<class T>
+struct MlpT<T>::RecallTask
+{
+  const MlpT* net;
+  const T* inputs;
+  size_t n;
+  T* outputs;
+};
+
+/// Calculates the outputs of the network for a batch of inputs.
+///
+/// @param inputs
+///   One input in each column.
+///
+/// @param outputs
+///   Returns one output in each column. It is resized only if it does
+///   not have the right size, so it can be allocated once and reused
+///   for each batch.
+///
+/// @param threads
+///   Number of threads (0 means one per processor). Each thread
+///   calculates a range of columns.
+///
+template<class T>
+void MlpT<T>::recallBatch(const MatrixT<T>& inputs, MatrixT<T>& outputs, size_t threads) const
+{
+  if (inputs.rows() != getInputs())
+    throw std::invalid_argument("Invalid argument 'inputs' in Mlp::recallBatch method: each column must be an input of the network.");
+
+  size_t n = inputs.cols();
+  if (outputs.rows() != getOutputs() || outputs.cols() != n)
+    outputs.resize(getOutputs(), n);
+
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::min(threads, n / RECALL_PARALLEL_MIN_COLS);
+
+  if (threads <= 1) {
+    recallColumns(inputs.getRaw(), n, outputs.getRaw());
+    return;
+  }
+
+  std::vector<RecallTask> tasks(threads);
+  size_t j = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t cols = n/threads + (t < n%threads ? 1: 0);
+    tasks[t].net = this;
+    tasks[t].inputs = inputs.getRaw() + j*getInputs();
+    tasks[t].n = cols;
+    tasks[t].outputs = outputs.getRaw() + j*getOutputs();
+    j += cols;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&MlpT::recallThread, &tasks[t]));
+
+  recallThread(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+}
+
+template<class T>
+void MlpT<T>::recallThread(void* data)
+{
+  const RecallTask& task = *(RecallTask*)data;
+  task.net->recallColumns(task.inputs, task.n, task.outputs);
+}
+
+// Recalls @a n inputs (contiguous columns) with two GEMMs for each
+// RECALL_COLUMNS inputs
+template<class T>
+void MlpT<T>::recallColumns(const T* inputs, size_t n, T* outputs) const
+{
+  const size_t I = getInputs(), H = getHiddens(), O = getOutputs();
+  const MlpKernels<T>& kernels(mlp_kernels<T>(*m_hiddenFunc, *m_outputFunc));
+  MatrixT<T> hidden(H, std::min<size_t>(n, RECALL_COLUMNS));
+
+  for (size_t first=0; first<n; first+=RECALL_COLUMNS) {
+    size_t cols = std::min<size_t>(n-first, RECALL_COLUMNS);
+    T* h = hidden.getRaw();
+    T* y = outputs + first*O;
+
+    for (size_t j=0; j<cols; ++j)
+      std::copy(m_bias1.getRaw(), m_bias1.getRaw()+H, h+j*H);
+
+    blas_gemm(GemmNormal, GemmNormal, H, cols, I,
+	      1.0, m_weight1.getRaw(), H, inputs + first*I, I,
+	      1.0, h, H);
+
+    kernels.hidden(m_hiddenFunc, H*cols, h, h);
+
+    for (size_t j=0; j<cols; ++j)
+      std::copy(m_bias2.getRaw(), m_bias2.getRaw()+O, y+j*O);
+
+    blas_gemm(GemmNormal, GemmNormal, O, cols, H,
+	      1.0, m_weight2.getRaw(), O, h, H,
+	      1.0, y, O);
+
+    kernels.output(m_outputFunc, O*cols, y, y);
+  }
+}
+
+// Copies (and converts) the inputs of the patterns [first,
+// first+cols) of the set to the columns of @a tmp
+template<class T>
+static const T* copy_inputs(const PatternSet& set, size_t first, size_t cols, MatrixT<T>& tmp)
+{
+  const size_t n = set.getInputSize();
+  if (tmp.rows() != n || tmp.cols() != cols)
+    tmp.resize(n, cols);
+
+  for (size_t j=0; j<cols; ++j) {
+    const double* row = set.getInputRow(first+j);
+    std::copy(row, row+n, tmp.getRaw() + j*n);
+  }
+  return tmp.getRaw();
+}
+
+template<class T>
+static const T* get_inputs(const PatternSet& set, size_t first, size_t cols, MatrixT<T>& tmp)
+{
+  return copy_inputs(set, first, cols, tmp);
+}
+
+// Double networks use the rows of the set directly if they are
+// contiguous
+template<>
+const double* get_inputs(const PatternSet& set, size_t first, size_t cols, Matrix& tmp)
+{
+  if (set.isContiguous(first, cols))
+    return set.getInputRow(first);
+  else
+    return copy_inputs(set, first, cols, tmp);
 }
 
 /// Calculates the sum of squared errors.
 ///
-double Mlp::calcSSE(const PatternSet& set) const
+/// The patterns are recalled with one GEMM for each RECALL_COLUMNS
+/// patterns. Their inputs are used directly if they are contiguous
+/// in the set (e.g. a set that was not shuffled), in other case they
+/// are copied.
+///
+template<class T>
+double MlpT<T>::calcSSE(const PatternSet& set) const
 {
   assert(!set.empty());
+  assert(set.getInputSize() == getInputs());
+  assert(set.getOutputSize() == getOutputs());
 
-  PatternSet::const_iterator pattern, set_end = set.end();
-  Vector hidden, output;
+  const size_t O = getOutputs(), N = set.size();
+  MatrixT<T> tmp, outputs(O, std::min<size_t>(N, RECALL_COLUMNS));
   double error = 0.0;
 
-  // for each pattern of the set
-  for (pattern=set.begin(); pattern!=set_end; ++pattern) {
-    const Vector& input((*pattern)->getInput());
-    const Vector& target((*pattern)->getOutput());
-    recall(input, hidden, output);
+  for (size_t first=0; first<N; first+=RECALL_COLUMNS) {
+    size_t cols = std::min<size_t>(N-first, RECALL_COLUMNS);
+    recallColumns(get_inputs(set, first, cols, tmp), cols, outputs.getRaw());
 
     // calculate the difference between each "target" and "output"
-    Vector::const_iterator target_k = target.begin(), target_end = target.end();
-    Vector::iterator output_k = output.begin();
-    for (; target_k != target_end; ++target_k, ++output_k) {
-      // accumulate error
-      error += std::pow(*target_k - *output_k, 2.0);
+    // (accumulated in double for float networks too)
+    for (size_t j=0; j<cols; ++j) {
+      const double* target = set.getOutputRow(first+j);
+      const T* output = outputs.getRaw() + j*O;
+      for (size_t k=0; k<O; ++k)
+	error += (target[k] - output[k]) * (target[k] - output[k]);
     }
   }
 
@@ -197,7 +378,8 @@ double Mlp::calcSSE(const PatternSet& set) const
 
 /// Calculates the mean squared error (MSE).
 ///
-double Mlp::calcMSE(const PatternSet& set) const
+template<class T>
+double MlpT<T>::calcMSE(const PatternSet& set) const
 {
   return calcSSE(set) / (set.size() * getOutputs());
 }
@@ -206,19 +388,22 @@ double Mlp::calcMSE(const PatternSet& set) const
 // Binary I/O
 //////////////////////////////////////////////////////////////////////
 
-void Mlp::save(const char* filename) const
+template<class T>
+void MlpT<T>::save(const char* filename) const
 {
   std::ofstream f(filename, std::ios::binary);
   write(f);
 }
 
-void Mlp::load(const char* filename)
+template<class T>
+void MlpT<T>::load(const char* filename)
 {
   std::ifstream f(filename, std::ios::binary);
   read(f);
 }
 
-void Mlp::write(std::ostream& s) const
+template<class T>
+void MlpT<T>::write(std::ostream& s) const
 {
   m_weight1.write(s);
   m_weight2.write(s);
@@ -226,10 +411,14 @@ void Mlp::write(std::ostream& s) const
   m_bias2.write(s);
 }
 
-void Mlp::read(std::istream& s)
+template<class T>
+void MlpT<T>::read(std::istream& s)
 {
   m_weight1.read(s);
   m_weight2.read(s);
   m_bias1.read(s);
   m_bias2.read(s);
 }
+
+template class MlpT<double>;
+template class MlpT<float>;
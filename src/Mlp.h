@@ -9,51 +9,83 @@
 #include "Matrix.h"
 
 class ActivationFunction;
-class Backpropagation;
 class PatternSet;
+class RandomStream;
+
+template<class T> class BackpropagationT;
 
 /// A specific feedforward multilayer perceptron (MLP) neural network
 /// with 3 layers of neurons: input, hidden, output.
 ///
-class Mlp
+/// Weights are of type @a T: Mlp (double) or MlpT<float>, which
+/// uses half the memory and is trained and recalled with single
+/// precision BLAS. Patterns (PatternSet) are always double, they are
+/// converted when a float network uses them.
+///
+template<class T>
+class MlpT
 {
-  friend class Backpropagation;
-
-  Matrix m_weight1;
-  Matrix m_weight2;
-  Vector m_bias1;
-  Vector m_bias2;
+  template<class U> friend class BackpropagationT;
+  template<class U> friend class MlpT;
+  friend class FusedMlpArray;
+  friend class LevenbergMarquardt;
+  friend class QuantizedMlp;
+  friend class Recognizer;
+
+  MatrixT<T> m_weight1;
+  MatrixT<T> m_weight2;
+  VectorT<T> m_bias1;
+  VectorT<T> m_bias2;
   ActivationFunction* m_hiddenFunc;
   ActivationFunction* m_outputFunc;
 
+  struct RecallTask;
+  static void recallThread(void* data);
+
 public:
+  typedef T value_type;
 
-  Mlp();
-  Mlp(size_t inputs, size_t hiddens, size_t outputs);
-  Mlp(const Mlp& mlp);
-  ~Mlp();
+  MlpT();
+  MlpT(size_t inputs, size_t hiddens, size_t outputs);
+  MlpT(const MlpT& mlp);
+  ~MlpT();
 
   size_t getInputs() const { return m_weight1.cols(); }
   size_t getHiddens() const { return m_weight1.rows(); }
   size_t getOutputs() const { return m_weight2.rows(); }
 
-  Vector createInput() const { return Vector(getInputs()); }
-  Vector createHidden() const { return Vector(getHiddens()); }
-  Vector createOutput() const { return Vector(getOutputs()); }
-
-  Mlp& operator=(const Mlp& mlp);
-  Mlp& operator+=(const Mlp& delta);
-  Mlp& operator*=(double s);
+  VectorT<T> createInput() const { return VectorT<T>(getInputs()); }
+  VectorT<T> createHidden() const { return VectorT<T>(getHiddens()); }
+  VectorT<T> createOutput() const { return VectorT<T>(getOutputs()); }
+
+  MlpT& operator=(const MlpT& mlp);
+  MlpT& operator+=(const MlpT& delta);
+  MlpT& operator*=(T s);
+
+  /// Copies a network with weights of other type (e.g. to recall
+  /// with a float copy of a network trained in double).
+  template<class U>
+  MlpT& assign(const MlpT<U>& mlp) {
+    m_weight1.assign(mlp.m_weight1);
+    m_weight2.assign(mlp.m_weight2);
+    m_bias1.assign(mlp.m_bias1);
+    m_bias2.assign(mlp.m_bias2);
+    setHiddenActivationFunction(*mlp.m_hiddenFunc);
+    setOutputActivationFunction(*mlp.m_outputFunc);
+    return *this;
+  }
 
   void setHiddenActivationFunction(const ActivationFunction& func);
   void setOutputActivationFunction(const ActivationFunction& func);
 
   void zero();
   void initRandom(double min_value, double max_value);
-  void recall(const Vector& input, Vector& hidden, Vector& output) const;
-  void recall(const Vector& input,
-	      Vector& hidden0, Vector& hidden,
-	      Vector& output0, Vector& output) const;
+  void initRandom(double min_value, double max_value, RandomStream& random);
+  void recall(const VectorT<T>& input, VectorT<T>& hidden, VectorT<T>& output) const;
+  void recall(const VectorT<T>& input,
+	      VectorT<T>& hidden0, VectorT<T>& hidden,
+	      VectorT<T>& output0, VectorT<T>& output) const;
+  void recallBatch(const MatrixT<T>& inputs, MatrixT<T>& outputs, size_t threads = 1) const;
 
   double calcSSE(const PatternSet& set) const;
   double calcMSE(const PatternSet& set) const;
@@ -67,6 +99,11 @@ public:
   void write(std::ostream& s) const;
   void read(std::istream& s);
 
+private:
+  void recallColumns(const T* inputs, size_t n, T* outputs) const;
+
 };
 
+typedef MlpT<double> Mlp;
+
 #endif // LOSEFACE_MLP_H
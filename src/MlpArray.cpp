@@ -3,25 +3,315 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "MlpArray.h"
+#include "ActivationFunctions.h"
+#include "MlpKernels.h"
+#include "Backpropagation.h"
+#include "Blas.h"
+#include "PatternSet.h"
+#include "Random.h"
+#include "Thread.h"
+
+//////////////////////////////////////////////////////////////////////
+// FusedMlpArray
+//////////////////////////////////////////////////////////////////////
+
+// Inputs of each GEMM in FusedMlpArray::recallColumns
+#define FUSED_COLUMNS		64
+
+// Minimum number of inputs per thread in FusedMlpArray::recallBatch
+#define FUSED_PARALLEL_MIN_COLS	64
+
+FusedMlpArray::FusedMlpArray()
+{
+  m_hiddens = 0;
+  m_outputs = 0;
+}
+
+FusedMlpArray::~FusedMlpArray()
+{
+  clear();
+}
+
+/// Stacks the layers of all the networks of @a array.
+///
+void FusedMlpArray::compile(const MlpArray& array)
+{
+  clear();
+
+  for (MlpArray::Nets::const_iterator
+	 it = array.m_nets.begin(); it != array.m_nets.end(); ++it) {
+    Block b;
+    b.hidden = m_hiddens;
+    b.hiddens = it->getHiddens();
+    b.output = m_outputs;
+    b.outputs = it->getOutputs();
+    b.weight2 = m_weight2.size();
+    b.hiddenFunc = it->m_hiddenFunc->clone();
+    b.outputFunc = it->m_outputFunc->clone();
+    m_blocks.push_back(b);
+
+    const MlpKernels<double>& kernels(mlp_kernels<double>(*b.hiddenFunc, *b.outputFunc));
+    addRun(m_hiddenRuns, b.hidden, b.hiddens, b.hiddenFunc, kernels.hidden);
+    addRun(m_outputRuns, b.output, b.outputs, b.outputFunc, kernels.output);
+
+    m_hiddens += b.hiddens;
+    m_outputs += b.outputs;
+    m_weight2.insert(m_weight2.end(),
+		     it->m_weight2.getRaw(),
+		     it->m_weight2.getRaw() + b.outputs*b.hiddens);
+  }
+
+  if (m_blocks.empty())
+    return;
+
+  m_weight1.resize(m_hiddens, array.getInputs());
+  m_bias1.resize(m_hiddens);
+  m_bias2.resize(m_outputs);
+
+  size_t c = 0;
+  for (MlpArray::Nets::const_iterator
+	 it = array.m_nets.begin(); it != array.m_nets.end(); ++it, ++c) {
+    const Block& b(m_blocks[c]);
+
+    m_weight1.getBlock(b.hidden, 0, b.hiddens, m_weight1.cols()) = it->m_weight1;
+    for (size_t j=0; j<b.hiddens; ++j)
+      m_bias1(b.hidden+j) = it->m_bias1(j);
+    for (size_t k=0; k<b.outputs; ++k)
+      m_bias2(b.output+k) = it->m_bias2(k);
+  }
+}
+
+void FusedMlpArray::clear()
+{
+  for (size_t c=0; c<m_blocks.size(); ++c) {
+    delete m_blocks[c].hiddenFunc;
+    delete m_blocks[c].outputFunc;
+  }
+  m_blocks.clear();
+  m_hiddenRuns.clear();
+  m_outputRuns.clear();
+  m_weight2.clear();
+  m_hiddens = 0;
+  m_outputs = 0;
+}
+
+/// Calculates the outputs of all the networks for one @a input.
+///
+void FusedMlpArray::recall(const Vector& input, Vector& hidden, Vector& output) const
+{
+  assert(!m_blocks.empty());
+  assert(input.size() == getInputs());
+
+  hidden = m_bias1;
+  blas_gemv(GemmNormal, m_hiddens, getInputs(),
+	    1.0, m_weight1.getRaw(), m_hiddens,
+	    input.getRaw(), 1.0, hidden.getRaw());
+  activate(m_hiddenRuns, m_hiddens, hidden.getRaw(), 1);
+
+  output = m_bias2;
+  addOutput(hidden.getRaw(), output.getRaw());
+  activate(m_outputRuns, m_outputs, output.getRaw(), 1);
+}
+
+// A range of inputs for a thread of FusedMlpArray::recallBatch
+struct FusedMlpArray::RecallTask
+{
+  const FusedMlpArray* array;
+  const double* inputs;
+  size_t n;
+  double* outputs;
+};
+
+/// Calculates the outputs of all the networks for a batch of inputs
+/// (one input in each column of @a inputs).
+///
+/// @param outputs
+///   Returns the outputs of the array (one column for each input). It
+///   is resized only if it does not have the right size.
+///
+/// @param threads
+///   Number of threads (0 means one per processor). Each thread
+///   calculates a range of columns.
+///
+void FusedMlpArray::recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads) const
+{
+  assert(!m_blocks.empty());
+
+  if (inputs.rows() != getInputs())
+    throw std::invalid_argument("Invalid argument 'inputs' in FusedMlpArray::recallBatch method: each column must be an input of the array.");
+
+  size_t n = inputs.cols();
+  if (outputs.rows() != m_outputs || outputs.cols() != n)
+    outputs.resize(m_outputs, n);
+
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::min(threads, n / FUSED_PARALLEL_MIN_COLS);
+
+  if (threads <= 1) {
+    recallColumns(inputs.getRaw(), n, outputs.getRaw());
+    return;
+  }
+
+  std::vector<RecallTask> tasks(threads);
+  size_t j = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t cols = n/threads + (t < n%threads ? 1: 0);
+    tasks[t].array = this;
+    tasks[t].inputs = inputs.getRaw() + j*getInputs();
+    tasks[t].n = cols;
+    tasks[t].outputs = outputs.getRaw() + j*m_outputs;
+    j += cols;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&FusedMlpArray::recallThread, &tasks[t]));
+
+  recallThread(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+}
+
+void FusedMlpArray::recallThread(void* data)
+{
+  const RecallTask& task = *(RecallTask*)data;
+  task.array->recallColumns(task.inputs, task.n, task.outputs);
+}
+
+// Recalls @a n inputs (contiguous columns). The hidden layers of all
+// networks are calculated with one GEMM for each block of
+// FUSED_COLUMNS inputs (so they stay in cache until the second
+// layers use them).
+void FusedMlpArray::recallColumns(const double* inputs, size_t n, double* outputs) const
+{
+  const size_t I = getInputs();
+  Matrix hiddens(m_hiddens, std::min<size_t>(n, FUSED_COLUMNS));
+
+  for (size_t first=0; first<n; first+=FUSED_COLUMNS) {
+    size_t cols = std::min<size_t>(n-first, FUSED_COLUMNS);
+
+    for (size_t j=0; j<cols; ++j)
+      hiddens.getCol(j) = m_bias1;
+
+    blas_gemm(GemmNormal, GemmNormal, m_hiddens, cols, I,
+	      1.0, m_weight1.getRaw(), m_hiddens,
+	      inputs + first*I, I,
+	      1.0, hiddens.getRaw(), m_hiddens);
+    activate(m_hiddenRuns, m_hiddens, hiddens.getRaw(), cols);
+
+    for (size_t j=0; j<cols; ++j) {
+      double* output = outputs+(first+j)*m_outputs;
+
+      std::copy(m_bias2.getRaw(), m_bias2.getRaw()+m_outputs, output);
+      addOutput(hiddens.getRaw()+j*m_hiddens, output);
+    }
+    activate(m_outputRuns, m_outputs, outputs+first*m_outputs, cols);
+  }
+}
+
+// Adds the second layers to one column of outputs. The blocks are
+// too small for gemv/GEMM (usually one output of a few hidden
+// neurons), so they are multiplied directly.
+void FusedMlpArray::addOutput(const double* hidden, double* output) const
+{
+  for (size_t c=0; c<m_blocks.size(); ++c) {
+    const Block& b(m_blocks[c]);
+    const double* w = &m_weight2[b.weight2];
+    const double* h = hidden+b.hidden;
+    double* o = output+b.output;
+
+    for (size_t j=0; j<b.hiddens; ++j, w+=b.outputs)
+      for (size_t k=0; k<b.outputs; ++k)
+	o[k] += w[k] * h[j];
+  }
+}
+
+// Adds @a size neurons (from @a first) activated with @a func,
+// joining them to the last run if it has the same function
+void FusedMlpArray::addRun(std::vector<Run>& runs, size_t first, size_t size,
+			   ActivationFunction* func,
+			   void (*f)(ActivationFunction*, size_t, const double*, double*))
+{
+  int kind = func->getKind();
+
+  if (!runs.empty() &&
+      runs.back().kind == kind && kind != CustomActivation &&
+      runs.back().first + runs.back().size == first) {
+    runs.back().size += size;
+    return;
+  }
+
+  Run run;
+  run.first = first;
+  run.size = size;
+  run.kind = kind;
+  run.func = func;
+  run.f = f;
+  runs.push_back(run);
+}
+
+// Applies the activation functions to @a cols columns of @a rows
+// neurons. If there is just one run (all networks use the same
+// function), the whole matrix is activated with one call.
+void FusedMlpArray::activate(const std::vector<Run>& runs, size_t rows,
+			     double* x, size_t cols)
+{
+  if (runs.size() == 1) {
+    runs[0].f(runs[0].func, rows*cols, x, x);
+    return;
+  }
+
+  for (size_t j=0; j<cols; ++j, x+=rows)
+    for (size_t r=0; r<runs.size(); ++r)
+      runs[r].f(runs[r].func, runs[r].size, x+runs[r].first, x+runs[r].first);
+}
+
+//////////////////////////////////////////////////////////////////////
+// MlpArray
+//////////////////////////////////////////////////////////////////////
 
 MlpArray::MlpArray()
 {
   m_outputs = 0;
+  m_compiled = false;
 }
 
 MlpArray::MlpArray(const MlpArray& net)
   : m_nets(net.m_nets)
   , m_outputs(net.m_outputs)
+  , m_compiled(false)
 {
 }
 
 MlpArray& MlpArray::operator=(const MlpArray& net)
 {
   m_nets = net.m_nets;
+  m_outputs = net.m_outputs;
+  m_compiled = false;
   return *this;
 }
 
+/// Returns the compiled form of the array. The array is compiled in
+/// the first call after its networks are added or modified (so
+/// building an array of N networks does not compile it N times), and
+/// that first call (e.g. the first #recall) must not be done from
+/// two threads at the same time.
+///
+const FusedMlpArray& MlpArray::getFused() const
+{
+  if (!m_compiled) {
+    m_fused.compile(*this);
+    m_compiled = true;
+  }
+  return m_fused;
+}
+
 /// Adds a new network to the array.
 ///
 /// @param net
@@ -34,24 +324,206 @@ void MlpArray::add(const Mlp& net)
 
   m_nets.push_back(net);
   m_outputs += net.getOutputs();
+  m_compiled = false;
 }
 
+/// Calculates the outputs of all the networks with the compiled form
+/// of the array (see FusedMlpArray).
+///
 void MlpArray::recall(const Vector& input, Vector& output) const
 {
   assert(!m_nets.empty());
 
-  Vector hidden, it_output;
-  size_t i = 0;
+  Vector hidden;
+  getFused().recall(input, hidden, output);
+}
 
-  output = createOutput();
+/// Calculates the outputs of all the networks for each column of
+/// @a inputs (see FusedMlpArray::recallBatch).
+///
+void MlpArray::recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads) const
+{
+  assert(!m_nets.empty());
 
-  for (Nets::const_iterator
-	 it = m_nets.begin(); it != m_nets.end(); ++it) {
-    it->recall(input, hidden, it_output);
+  getFused().recallBatch(inputs, outputs, threads);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Training
+//////////////////////////////////////////////////////////////////////
 
-    for (size_t j=0; j<it_output.size(); ++j, ++i)
-      output(i) = it_output(j);
+// Work shared by all the threads of trainAll
+struct MlpArray::TrainTask
+{
+  std::vector<Mlp*> nets;
+  std::vector<size_t> offsets;	// First output of each net in the array
+  const PatternSet* set;
+  const MlpArrayTraining* params;
+  std::vector<size_t>* epochs;
+  std::vector<size_t>* adjustments;
+  std::vector<double>* mse;
+  Mutex mutex;
+  size_t next;			// Next net to be trained
+};
+
+/// Trains all the networks of the array at the same time (each one in
+/// its own thread).
+///
+/// Each network learns its outputs of the patterns in @a set: the
+/// patterns with the maximum output in the range of the network are
+/// its positive patterns and the rest are negative ones. So with
+/// networks of one output and a @a set with one output per subject,
+/// each network learns to recognize one subject.
+///
+/// The random numbers of each network (to initialize weights and to
+/// shuffle patterns) come from its own RandomStream, so the result
+/// does not depend on the number of threads.
+///
+/// @param epochs
+///   Returns the number of trained epochs of each network.
+///
+/// @param adjustments
+///   Returns the number of weight adjustments of each network
+///   (epochs by number of patterns).
+///
+/// @param mse
+///   Returns the MSE of each network (the returned one, e.g. the best
+///   network with MlpArrayTraining::keepBest) with its patterns.
+///
+void MlpArray::trainAll(const PatternSet& set, const MlpArrayTraining& params,
+			std::vector<size_t>& epochs,
+			std::vector<size_t>& adjustments,
+			std::vector<double>& mse)
+{
+  if (m_nets.empty())
+    throw std::invalid_argument("There are no networks in the array to train.");
+
+  if (set.empty() ||
+      set.getInputSize() != getInputs() ||
+      set.getOutputSize() != getOutputs())
+    throw std::invalid_argument("The patterns do not have the inputs and outputs of the array.");
+
+  TrainTask task;
+  size_t offset = 0;
+  for (Nets::iterator it = m_nets.begin(); it != m_nets.end(); ++it) {
+    task.nets.push_back(&*it);
+    task.offsets.push_back(offset);
+    offset += it->getOutputs();
+  }
+  task.set = &set;
+  task.params = &params;
+  task.epochs = &epochs;
+  task.adjustments = &adjustments;
+  task.mse = &mse;
+  task.next = 0;
+
+  epochs.assign(task.nets.size(), 0);
+  adjustments.assign(task.nets.size(), 0);
+  mse.assign(task.nets.size(), 0.0);
+
+  size_t threads = params.threads > 0 ? params.threads: Thread::processors();
+  if (threads > task.nets.size())
+    threads = task.nets.size();
+
+  // Each thread takes the next untrained network until all are trained
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&MlpArray::trainThread, &task));
+
+  trainThread(&task);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+
+  m_compiled = false;
+}
+
+void MlpArray::trainThread(void* data)
+{
+  TrainTask& task(*(TrainTask*)data);
+
+  for (;;) {
+    task.mutex.lock();
+    size_t i = task.next++;
+    task.mutex.unlock();
+
+    if (i >= task.nets.size())
+      break;
+
+    trainNet(*task.nets[i], i, task.offsets[i], *task.set, *task.params,
+	     (*task.epochs)[i], (*task.adjustments)[i], (*task.mse)[i]);
+  }
+}
+
+void MlpArray::trainNet(Mlp& net, size_t index, size_t offset,
+			const PatternSet& set, const MlpArrayTraining& params,
+			size_t& epochs, size_t& adjustments, double& mse)
+{
+  RandomStream random(params.seed, index);
+  const size_t outputs = net.getOutputs();
+
+  if (params.initWeights)
+    net.initRandom(params.initMin, params.initMax, random);
+
+  // Patterns for this network: first the positive ones and then the
+  // negative ones (as mlp_array.lua does)
+  PatternSet subset;
+  Vector target(outputs);
+  for (int positive=1; positive>=0; --positive) {
+    for (size_t p=0; p<set.size(); ++p) {
+      size_t k = set.getLabel(p);
+      if ((k >= offset && k < offset+outputs) != (positive == 1))
+	continue;
+
+      const double* output = set.getOutputRow(p);
+      for (size_t j=0; j<outputs; ++j)
+	target(j) = output[offset+j];
+
+      subset.push_back(Pattern(set[p].getInput(), target));
+    }
+  }
+
+  epochs = adjustments = 0;
+  mse = 0.0;
+  if (subset.empty())
+    return;
+
+  Backpropagation bp(net);
+  bp.setLearningRate(params.learningRate);
+  bp.setMomentum(params.momentum);
+
+  Mlp best;
+  mse = bp.calcMSE(subset);
+  double bestMse = mse;
+  if (params.keepBest)
+    best = net;
+
+  for (size_t i=0, j=0; params.epochs == 0 || i < params.epochs; ++i, ++j) {
+    // Same schedule as net:train in Lua (see mlp__train)
+    if (params.shuffle > 0 && j == params.shuffle-1) {
+      subset.shuffle(random);
+      j = 0;
+    }
+
+    bp.train(subset);
+    epochs++;
+
+    mse = bp.calcMSE(subset);
+    if (params.keepBest && mse < bestMse) {
+      best = net;
+      bestMse = mse;
+    }
+
+    if (params.goalMse >= 0.0 && mse < params.goalMse)
+      break;
+  }
+
+  if (params.keepBest) {
+    net = best;
+    mse = bestMse;
   }
+
+  adjustments = epochs * subset.size();
 }
 
 //////////////////////////////////////////////////////////////////////
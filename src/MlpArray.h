@@ -7,8 +7,104 @@
 #define LOSEFACE_MLPARRAY_H
 
 #include <list>
+#include <vector>
 #include "Mlp.h"
 
+class ActivationFunction;
+class MlpArray;
+class PatternSet;
+
+/// A compiled form of MlpArray to recall all its networks at once.
+///
+/// The first layers of all networks are stacked in one (sum of
+/// hiddens) x inputs matrix, so one gemv (or one GEMM for a batch of
+/// inputs) calculates the hidden layers of all the networks. The
+/// second layers are packed block-diagonally: each network only
+/// multiplies the rows of its own hidden neurons.
+///
+class FusedMlpArray
+{
+  // One network of the array
+  struct Block {
+    size_t hidden, hiddens;	// Rows in m_weight1
+    size_t output, outputs;	// Rows in the output
+    size_t weight2;		// Position of its second layer in m_weight2
+    ActivationFunction* hiddenFunc;
+    ActivationFunction* outputFunc;
+  };
+
+  // Consecutive neurons activated with one call (consecutive blocks
+  // with the same Purelin, Logsig or Tansig function are joined)
+  struct Run {
+    size_t first, size;
+    int kind;			// ActivationKind
+    ActivationFunction* func;
+    void (*f)(ActivationFunction* func, size_t n, const double* x, double* y);
+  };
+
+  struct RecallTask;
+  static void recallThread(void* data);
+
+  std::vector<Block> m_blocks;
+  std::vector<Run> m_hiddenRuns;
+  std::vector<Run> m_outputRuns;
+  Matrix m_weight1;		// All first layers (sum of hiddens x inputs)
+  Vector m_bias1;
+  std::vector<double> m_weight2;	// Second layers (outputs x hiddens each one)
+  Vector m_bias2;
+  size_t m_hiddens;
+  size_t m_outputs;
+
+public:
+  FusedMlpArray();
+  ~FusedMlpArray();
+
+  size_t getInputs() const { return m_weight1.cols(); }
+  size_t getOutputs() const { return m_outputs; }
+
+  void compile(const MlpArray& array);
+  void clear();
+
+  void recall(const Vector& input, Vector& hidden, Vector& output) const;
+  void recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads = 1) const;
+
+private:
+  void recallColumns(const double* inputs, size_t n, double* outputs) const;
+  void addOutput(const double* hidden, double* output) const;
+  static void addRun(std::vector<Run>& runs, size_t first, size_t size,
+		     ActivationFunction* func,
+		     void (*f)(ActivationFunction*, size_t, const double*, double*));
+  static void activate(const std::vector<Run>& runs, size_t rows,
+		       double* x, size_t cols);
+
+  // Non-copyable (MlpArray compiles its own copy)
+  FusedMlpArray(const FusedMlpArray&);
+  FusedMlpArray& operator=(const FusedMlpArray&);
+};
+
+/// Parameters to train all the networks of a MlpArray (see
+/// MlpArray::trainAll).
+///
+struct MlpArrayTraining
+{
+  double learningRate;
+  double momentum;
+  size_t epochs;	///< Maximum number of epochs (0 means until goalMse)
+  size_t shuffle;	///< Shuffles the patterns every this number of epochs
+  bool keepBest;	///< Keeps the network with the best MSE
+  double goalMse;	///< Stops when the MSE is less than this (if it is >= 0)
+  bool initWeights;	///< Initializes the weights in [initMin, initMax]
+  double initMin, initMax;
+  unsigned long seed;	///< Seed of the random streams of each network
+  size_t threads;	///< Number of threads (0 means one per processor)
+
+  MlpArrayTraining()
+    : learningRate(0.6), momentum(0.4)
+    , epochs(1), shuffle(0), keepBest(false), goalMse(-1.0)
+    , initWeights(false), initMin(-1.0), initMax(1.0)
+    , seed(1), threads(0) { }
+};
+
 /// An array of neural networks.
 ///
 /// If you have a set of networks with one output (or a small number
@@ -20,9 +116,21 @@
 ///
 class MlpArray
 {
+  friend class FusedMlpArray;
+  friend class QuantizedMlp;
+  friend class Recognizer;
+
   typedef std::list<Mlp> Nets;
   Nets m_nets;
   size_t m_outputs;
+  mutable FusedMlpArray m_fused;
+  mutable bool m_compiled;	// m_fused has the current networks
+
+  struct TrainTask;
+  static void trainThread(void* data);
+  static void trainNet(Mlp& net, size_t index, size_t offset,
+		       const PatternSet& set, const MlpArrayTraining& params,
+		       size_t& epochs, size_t& adjustments, double& mse);
 
 public:
   MlpArray();
@@ -35,8 +143,16 @@ public:
   Vector createInput() const { return Vector(getInputs()); }
   Vector createOutput() const { return Vector(getOutputs()); }
 
+  const FusedMlpArray& getFused() const;
+
   void add(const Mlp& net);
   void recall(const Vector& input, Vector& output) const;
+  void recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads = 1) const;
+
+  void trainAll(const PatternSet& set, const MlpArrayTraining& params,
+		std::vector<size_t>& epochs,
+		std::vector<size_t>& adjustments,
+		std::vector<double>& mse);
 
   //////////////////////////////////////////////////////////////////////
   // Binary I/O
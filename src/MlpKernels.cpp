@@ -0,0 +1,189 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cmath>
+
+#include "MlpKernels.h"
+#include "ActivationFunctions.h"
+#include "Simd.h"
+
+static ExpMode g_expMode = AccurateExp;
+
+//////////////////////////////////////////////////////////////////////
+// Layers
+//////////////////////////////////////////////////////////////////////
+
+// The SIMD kernels (FastExp) are for double, float layers always use
+// std::exp/std::tanh.
+
+static void logsig_elements(size_t n, const double* x, double* y)
+{
+  if (g_expMode == FastExp)
+    simd().logsig(n, x, y);
+  else
+    for (size_t i=0; i<n; ++i)
+      y[i] = 1.0 / (1.0 + std::exp(-x[i]));
+}
+
+static void logsig_elements(size_t n, const float* x, float* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] = 1.0f / (1.0f + std::exp(-x[i]));
+}
+
+static void tansig_elements(size_t n, const double* x, double* y)
+{
+  if (g_expMode == FastExp)
+    simd().tansig(n, x, y);
+  else
+    for (size_t i=0; i<n; ++i)
+      y[i] = std::tanh(x[i]);
+}
+
+static void tansig_elements(size_t n, const float* x, float* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] = std::tanh(x[i]);
+}
+
+// Each layer class has a whole-layer f() and the df() of one neuron
+// (which is inlined in the loops of MlpPair).
+
+struct PurelinLayer
+{
+  template<class T>
+  static void f(ActivationFunction*, size_t n, const T* x, T* y) {
+    if (x != y)
+      std::copy(x, x+n, y);
+  }
+  template<class T>
+  static T df(ActivationFunction*, T, T) {
+    return T(1);
+  }
+};
+
+struct LogsigLayer
+{
+  template<class T>
+  static void f(ActivationFunction*, size_t n, const T* x, T* y) {
+    logsig_elements(n, x, y);
+  }
+  template<class T>
+  static T df(ActivationFunction*, T, T s) {
+    return s * (T(1) - s);
+  }
+};
+
+struct TansigLayer
+{
+  template<class T>
+  static void f(ActivationFunction*, size_t n, const T* x, T* y) {
+    tansig_elements(n, x, y);
+  }
+  template<class T>
+  static T df(ActivationFunction*, T, T s) {
+    return T(1) - s*s;
+  }
+};
+
+// Fallback for other activation functions (virtual calls)
+struct CustomLayer
+{
+  template<class T>
+  static void f(ActivationFunction* func, size_t n, const T* x, T* y) {
+    for (size_t i=0; i<n; ++i)
+      y[i] = T(func->f(x[i]));
+  }
+  template<class T>
+  static T df(ActivationFunction* func, T x, T s) {
+    return T(func->df(x, s));
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+// Pairs of layers
+//////////////////////////////////////////////////////////////////////
+
+template<class T, class Hidden, class Output>
+struct MlpPair
+{
+  static const MlpKernels<T> kernels;
+
+  static void hidden(ActivationFunction* func, size_t n, const T* x, T* y) {
+    Hidden::f(func, n, x, y);
+  }
+
+  static void output(ActivationFunction* func, size_t n, const T* x, T* y) {
+    Output::f(func, n, x, y);
+  }
+
+  static void outputDelta(ActivationFunction* func, size_t n,
+			  const T* target, const T* output0,
+			  const T* output, T* delta) {
+    for (size_t k=0; k<n; ++k)
+      delta[k] = (target[k] - output[k]) * Output::df(func, output0[k], output[k]);
+  }
+
+  static void hiddenDelta(ActivationFunction* func, size_t n,
+			  const T* hidden0, const T* hidden,
+			  T* delta) {
+    for (size_t j=0; j<n; ++j)
+      delta[j] *= Hidden::df(func, hidden0[j], hidden[j]);
+  }
+};
+
+template<class T, class Hidden, class Output>
+const MlpKernels<T> MlpPair<T, Hidden, Output>::kernels = {
+  &MlpPair<T, Hidden, Output>::hidden,
+  &MlpPair<T, Hidden, Output>::output,
+  &MlpPair<T, Hidden, Output>::outputDelta,
+  &MlpPair<T, Hidden, Output>::hiddenDelta
+};
+
+template<class T, class Hidden>
+static const MlpKernels<T>& mlp_kernels_for(const ActivationFunction& output)
+{
+  switch (output.getKind()) {
+    case PurelinActivation: return MlpPair<T, Hidden, PurelinLayer>::kernels;
+    case LogsigActivation:  return MlpPair<T, Hidden, LogsigLayer>::kernels;
+    case TansigActivation:  return MlpPair<T, Hidden, TansigLayer>::kernels;
+    default:		    return MlpPair<T, Hidden, CustomLayer>::kernels;
+  }
+}
+
+template<class T>
+const MlpKernels<T>& mlp_kernels(const ActivationFunction& hidden,
+				 const ActivationFunction& output)
+{
+  switch (hidden.getKind()) {
+    case PurelinActivation: return mlp_kernels_for<T, PurelinLayer>(output);
+    case LogsigActivation:  return mlp_kernels_for<T, LogsigLayer>(output);
+    case TansigActivation:  return mlp_kernels_for<T, TansigLayer>(output);
+    default:		    return mlp_kernels_for<T, CustomLayer>(output);
+  }
+}
+
+template const MlpKernels<double>& mlp_kernels<double>(const ActivationFunction&,
+						       const ActivationFunction&);
+template const MlpKernels<float>& mlp_kernels<float>(const ActivationFunction&,
+						     const ActivationFunction&);
+
+/// Returns how the Logsig and Tansig layers calculate exponentials.
+///
+ExpMode exp_mode()
+{
+  return g_expMode;
+}
+
+/// Changes how the Logsig and Tansig layers calculate exponentials
+/// (AccurateExp by default). FastExp uses the logsig/tansig SIMD
+/// kernels, so results can differ from ActivationFunction::f in the
+/// last bits.
+///
+void exp_select(ExpMode mode)
+{
+  g_expMode = mode;
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_MLPKERNELS_H
+#define LOSEFACE_MLPKERNELS_H
+
+#include <cstddef>
+
+class ActivationFunction;
+
+/// How the exponentials of Logsig and Tansig layers are calculated.
+///
+enum ExpMode {
+  AccurateExp,			// std::exp/std::tanh (same results as ActivationFunction::f)
+  FastExp			// polynomial exp with SIMD kernels (see simd_exp)
+};
+
+/// Routines over whole layers of a MLP (of @a T weights) for one
+/// pair of (hidden, output) activation functions. There is one
+/// instantiation for each pair of Purelin, Logsig and Tansig (as the
+/// old Mlp<T, Hidden, Output> template), other functions are called
+/// neuron by neuron through ActivationFunction.
+///
+/// Each routine receives the activation function of its layer (only
+/// used by the neuron by neuron fallback).
+///
+template<class T>
+struct MlpKernels
+{
+  /// y = f(x) for @a n hidden neurons (y can be x)
+  void (*hidden)(ActivationFunction* func, size_t n, const T* x, T* y);
+
+  /// y = f(x) for @a n output neurons (y can be x)
+  void (*output)(ActivationFunction* func, size_t n, const T* x, T* y);
+
+  /// delta = (target - output) * df(output0, output)
+  void (*outputDelta)(ActivationFunction* func, size_t n,
+		      const T* target, const T* output0,
+		      const T* output, T* delta);
+
+  /// delta *= df(hidden0, hidden)
+  void (*hiddenDelta)(ActivationFunction* func, size_t n,
+		      const T* hidden0, const T* hidden,
+		      T* delta);
+};
+
+/// Returns the kernels specialized for the given pair of activation
+/// functions (instantiated for double and float).
+///
+template<class T>
+const MlpKernels<T>& mlp_kernels(const ActivationFunction& hidden,
+				 const ActivationFunction& output);
+
+ExpMode exp_mode();
+void exp_select(ExpMode mode);
+
+#endif // LOSEFACE_MLPKERNELS_H
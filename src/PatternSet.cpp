@@ -3,38 +3,490 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "PatternSet.h"
+#include "Matrix.h"
+#include "Random.h"
+#include "Thread.h"
+
+// Last version given to a set (see PatternSet::getVersion)
+static unsigned long lastVersion = 0;
+static Mutex lastVersionMutex;
 
 PatternSet::PatternSet()
 {
+  m_inputs.rows.reset(new Rows(0));
+  m_inputs.distinct = true;
+  m_outputs.rows.reset(new Rows(0));
+  m_outputs.distinct = true;
+  m_version = newVersion();
 }
 
-PatternSet::PatternSet(const PatternSet& copy)
+/// Creates a copy of @a set sharing its rows. The copy has a new
+/// version (like in #operator=).
+///
+PatternSet::PatternSet(const PatternSet& set)
+  : m_inputs(set.m_inputs)
+  , m_outputs(set.m_outputs)
+  , m_labels(set.m_labels)
+  , m_classes(set.m_classes)
+  , m_version(newVersion())
 {
-  operator=(copy);
 }
 
-PatternSet::~PatternSet()
+/// Copies the patterns of @a set (sharing its rows). This set gets a
+/// new version.
+///
+PatternSet& PatternSet::operator=(const PatternSet& set)
 {
-  for (iterator it = begin(); it != end(); ++it)
-    delete *it;
-  m_set.clear();
+  m_inputs = set.m_inputs;
+  m_outputs = set.m_outputs;
+  m_labels = set.m_labels;
+  m_classes = set.m_classes;
+  m_version = newVersion();
+  return *this;
 }
 
-PatternSet& PatternSet::operator=(const PatternSet& set)
+/// Reserves memory for @a patterns patterns (with the size of the
+/// patterns already added).
+///
+void PatternSet::reserve(size_t patterns)
 {
-  m_set.reserve(set.size());
-  for (const_iterator it = set.begin(); it != set.end(); ++it)
-    push_back(**it);
-  return *this;
+  m_inputs.index.reserve(patterns);
+  m_outputs.index.reserve(patterns);
+  if (m_inputs.rows.unique())
+    m_inputs.rows->data.reserve(patterns*getInputSize());
+  if (m_outputs.rows.unique() && !m_outputs.rows->labels)
+    m_outputs.rows->data.reserve(patterns*getOutputSize());
 }
 
+/// Adds a copy of the pattern at the end of the set.
+///
+/// @throw std::invalid_argument
+///   If the pattern does not have the same number of inputs and
+///   outputs as the other patterns of the set.
+///
 void PatternSet::push_back(const Pattern& p)
 {
-  m_set.push_back(new Pattern(p));
+  add(p.getInput().getRaw(), p.getInput().size(),
+      p.getOutput().getRaw(), p.getOutput().size());
+}
+
+/// Adds a copy of a pattern of other set.
+///
+void PatternSet::push_back(const ConstPatternRef& p)
+{
+  add(p.getRawInput(), p.getInput().size(),
+      p.getRawOutput(), p.getOutput().size());
+}
+
+/// Adds a pattern with the output of the class @a label (the set must
+/// have label outputs, see #setLabelOutputs).
+///
+/// @throw std::invalid_argument
+///   If the set does not have label outputs, @a label is not a class
+///   of the set, or the input does not have the size of the other
+///   patterns.
+///
+void PatternSet::push_back(const Vector& input, size_t label)
+{
+  if (!hasLabelOutputs() || label >= getOutputSize())
+    throw std::invalid_argument("Invalid argument in PatternSet::push_back method: the set does not have label outputs for the specified class.");
+
+  const size_t outputs = getOutputSize();
+  add(input.getRaw(), input.size(),
+      &m_outputs.rows->data[outputs-1-label], outputs);
+}
+
+/// Adds the pattern @a index of @a set without copying it: this set
+/// uses the same rows if they are the rows of @a set.
+///
+/// @throw std::invalid_argument
+///   If the pattern does not have the same number of inputs and
+///   outputs as the other patterns of the set.
+///
+void PatternSet::append(const PatternSet& set, size_t index)
+{
+  assert(index < set.size());
+
+  if (empty()) {
+    m_inputs.rows = set.m_inputs.rows;
+    m_outputs.rows = set.m_outputs.rows;
+  }
+  else if (set.getInputSize() != getInputSize() ||
+	   set.getOutputSize() != getOutputSize())
+    throw std::invalid_argument("Invalid argument in PatternSet::append method: all patterns must have the same number of inputs and outputs.");
+
+  addIndex(m_inputs, set.m_inputs, index);
+  if (m_outputs.rows == set.m_outputs.rows)
+    addIndex(m_outputs, set.m_outputs, index);
+  else
+    addOutput(set.getOutputRow(index), set.m_labels[index]);
+  addLabel(set.m_labels[index]);
+  m_version = newVersion();
+}
+
+/// Adds all the patterns of @a set (see #append(const PatternSet&, size_t)).
+///
+void PatternSet::append(const PatternSet& set)
+{
+  size_t n = set.size();	// It can be this same set
+  reserve(size() + n);
+  for (size_t i=0; i<n; ++i)
+    append(set, i);
+}
+
+/// Changes the output of all patterns (it can have other size). All
+/// the patterns use the same row until one of them is modified.
+///
+void PatternSet::setOutputs(const Vector& output)
+{
+  m_outputs.rows.reset(new Rows(output.size()));
+  m_outputs.rows->data.assign(output.begin(), output.end());
+  m_outputs.index.assign(size(), 0);
+  m_outputs.distinct = (size() <= 1);
+
+  m_labels.assign(size(), output.getMaxPos());
+  updateClasses();
+  m_version = newVersion();
+}
+
+/// Changes the output of each pattern to the output of its class (see
+/// #getLabel): @a on in the position of the class and @a off in the
+/// other @a outputs-1 positions.
+///
+/// The outputs of the classes are overlapped in one row of
+/// 2*outputs-1 values (off...off on off...off), where the output of
+/// the class @a k starts in the position outputs-1-k, so the set only
+/// keeps that position for each pattern. The patterns added later with
+/// the output of a class (see #push_back(const Vector&, size_t)) use
+/// the same row; a pattern with other output (or a modified output)
+/// copies the outputs of all the patterns to their own rows.
+///
+/// @throw std::invalid_argument
+///   If @a on is not greater than @a off, or a pattern has a class
+///   out of the @a outputs classes.
+///
+void PatternSet::setLabelOutputs(size_t outputs, double on, double off)
+{
+  if (outputs == 0 || on <= off)
+    throw std::invalid_argument("Invalid argument in PatternSet::setLabelOutputs method: the 'on' output must be greater than the 'off' output.");
+
+  for (size_t i=0; i<m_labels.size(); ++i)
+    if (m_labels[i] >= outputs)
+      throw std::invalid_argument("Invalid argument in PatternSet::setLabelOutputs method: there are patterns of other classes.");
+
+  SharedPtr<Rows> rows(new Rows(outputs));
+  rows->step = 1;
+  rows->labels = true;
+  rows->data.assign(2*outputs-1, off);
+  rows->data[outputs-1] = on;
+
+  m_outputs.rows = rows;
+  m_outputs.index.resize(size());
+  for (size_t i=0; i<size(); ++i)
+    m_outputs.index[i] = outputs-1-m_labels[i];
+  m_outputs.distinct = false;
+
+  updateClasses();
+  m_version = newVersion();
 }
 
 void PatternSet::shuffle()
 {
-  std::random_shuffle(begin(), end());
+  std::vector<size_t> order(size());
+  for (size_t i=0; i<order.size(); ++i)
+    order[i] = i;
+
+  std::random_shuffle(order.begin(), order.end());
+  permute(order);
+}
+
+/// Shuffles the patterns with the given random stream (the order
+/// only depends on the stream, not on std::rand).
+///
+void PatternSet::shuffle(RandomStream& random)
+{
+  std::vector<size_t> order(size());
+  for (size_t i=0; i<order.size(); ++i)
+    order[i] = i;
+
+  std::random_shuffle(order.begin(), order.end(), random);
+  permute(order);
+}
+
+/// Adds to @a sample @a n random patterns of each class of this set
+/// (sharing their rows), e.g. to train with the same number of
+/// patterns of each class. The random stream is seeded with std::rand.
+///
+void PatternSet::sampleBalanced(PatternSet& sample, size_t n) const
+{
+  RandomStream random(std::rand());
+  sampleBalanced(sample, n, random);
+}
+
+/// Adds to @a sample @a n random patterns of each class of this set
+/// (empty classes are skipped). A class with less than @a n patterns
+/// repeats them: all its patterns are taken (in a random order) before
+/// one is taken again. The classes are interleaved (the first pattern
+/// of each class, then the second one, etc.).
+///
+void PatternSet::sampleBalanced(PatternSet& sample, size_t n,
+				RandomStream& random) const
+{
+  std::vector<std::vector<size_t> > orders;
+  for (size_t k=0; k<m_classes.size(); ++k)
+    if (!m_classes[k].empty())
+      orders.push_back(m_classes[k]);
+
+  sample.reserve(sample.size() + n*orders.size());
+
+  for (size_t i=0; i<n; ++i)
+    for (size_t k=0; k<orders.size(); ++k) {
+      std::vector<size_t>& order(orders[k]);
+      size_t j = i % order.size();
+      if (j == 0)
+	std::random_shuffle(order.begin(), order.end(), random);
+      sample.append(*this, order[j]);
+    }
+}
+
+/// Copies the input of each pattern in a column of @a inputs (to
+/// recall all the patterns at once, see Mlp::recallBatch).
+///
+void PatternSet::getInputs(Matrix& inputs) const
+{
+  assert(!empty());
+
+  const size_t n = getInputSize();
+  if (inputs.rows() != n || inputs.cols() != size())
+    inputs.resize(n, size());
+
+  double* dst = inputs.getRaw();
+  for (size_t j=0; j<size(); ++j, dst += n) {
+    const double* src = getInputRow(j);
+    std::copy(src, src+n, dst);
+  }
+}
+
+/// Returns true if the inputs of the patterns [@a first, @a first+n)
+/// are contiguous rows (e.g. to use them as the columns of a matrix
+/// without copying them).
+///
+bool PatternSet::isContiguous(size_t first, size_t n) const
+{
+  assert(first+n <= size());
+
+  for (size_t i=1; i<n; ++i)
+    if (m_inputs.index[first+i] != m_inputs.index[first]+i)
+      return false;
+  return true;
+}
+
+/// Returns the patterns of the class @a label (their positions in the
+/// set, in increasing order).
+///
+const std::vector<size_t>& PatternSet::getClass(size_t label) const
+{
+  static const std::vector<size_t> none;
+  return (label < m_classes.size() ? m_classes[label]: none);
+}
+
+PatternSet::PatternRef PatternSet::getRef(size_t index)
+{
+  if (index >= size())
+    return PatternRef(this, index, NULL, getInputSize(), NULL, getOutputSize());
+
+  return PatternRef(this, index,
+		    getInputRow(index), getInputSize(),
+		    getOutputRow(index), getOutputSize());
+}
+
+PatternSet::ConstPatternRef PatternSet::getRef(size_t index) const
+{
+  if (index >= size())
+    return ConstPatternRef(NULL, getInputSize(), NULL, getOutputSize());
+
+  return ConstPatternRef(getInputRow(index), getInputSize(),
+			 getOutputRow(index), getOutputSize());
+}
+
+void PatternSet::add(const double* input, size_t inputs,
+		     const double* output, size_t outputs)
+{
+  if (empty()) {
+    m_inputs.rows.reset(new Rows(inputs));
+    m_inputs.distinct = true;
+    if (!hasLabelOutputs() || outputs != getOutputSize()) {
+      m_outputs.rows.reset(new Rows(outputs));
+      m_outputs.distinct = true;
+    }
+  }
+  else if (inputs != getInputSize() || outputs != getOutputSize())
+    throw std::invalid_argument("Invalid argument in PatternSet::push_back method: all patterns must have the same number of inputs and outputs.");
+
+  size_t label = std::max_element(output, output+outputs) - output;
+  addRow(m_inputs, input);
+  addOutput(output, label);
+  addLabel(label);
+  m_version = newVersion();
+}
+
+/// Adds a copy of @a row at the end of the rows of @a part. If the
+/// rows are shared with other sets, they are copied first.
+///
+void PatternSet::addRow(Part& part, const double* row)
+{
+  const size_t n = part.rows->size;
+  std::vector<double>& data(part.rows->data);
+
+  // A row of this same set is copied before the rows are reallocated
+  if (!data.empty() && row >= &data[0] && row < &data[0] + data.size()) {
+    std::vector<double> copy(row, row+n);
+    addRow(part, &copy[0]);
+    return;
+  }
+
+  if (!part.rows.unique() || part.rows->labels)
+    detach(part);
+
+  part.index.push_back(part.rows->data.size() / n);
+  part.rows->data.insert(part.rows->data.end(), row, row+n);
+}
+
+/// Adds the row of the pattern @a index of @a other, sharing it if
+/// both parts use the same rows.
+///
+void PatternSet::addIndex(Part& part, const Part& other, size_t index)
+{
+  if (part.rows == other.rows) {
+    size_t row = other.index[index];
+    part.index.push_back(row);
+    part.distinct = false;
+  }
+  else
+    addRow(part, other.getRow(index));
+}
+
+/// Adds the output of the last pattern added to the set (of the class
+/// @a label): the row of the class if the set has label outputs and
+/// @a output is the output of the class, or a copy of @a output.
+///
+void PatternSet::addOutput(const double* output, size_t label)
+{
+  const Rows& rows(*m_outputs.rows);
+
+  if (rows.labels && label < rows.size) {
+    size_t row = rows.size-1-label;
+    if (std::equal(output, output+rows.size, &rows.data[row])) {
+      m_outputs.index.push_back(row);
+      m_outputs.distinct = false;
+      return;
+    }
+  }
+
+  addRow(m_outputs, output);
+}
+
+/// Copies the rows used by the patterns of the set to new rows only
+/// for this set (in the order of the set).
+///
+void PatternSet::detach(Part& part)
+{
+  const size_t n = part.rows->size;
+  const size_t patterns = part.index.size();
+  SharedPtr<Rows> rows(new Rows(n));
+  rows->data.resize(patterns*n);
+
+  for (size_t i=0; i<patterns; ++i) {
+    const double* src = part.getRow(i);
+    std::copy(src, src+n, rows->data.begin() + i*n);
+    part.index[i] = i;
+  }
+
+  part.rows = rows;
+  part.distinct = true;
+}
+
+/// Puts the pattern @a order[i] in the position @a i.
+///
+void PatternSet::permute(const std::vector<size_t>& order)
+{
+  std::vector<size_t> inputs(size()), outputs(size());
+
+  for (size_t i=0; i<order.size(); ++i) {
+    inputs[i] = m_inputs.index[order[i]];
+    outputs[i] = m_outputs.index[order[i]];
+  }
+
+  m_inputs.index.swap(inputs);
+  m_outputs.index.swap(outputs);
+
+  std::vector<size_t> labels(size());
+  for (size_t i=0; i<order.size(); ++i)
+    labels[i] = m_labels[order[i]];
+
+  m_labels.swap(labels);
+  updateClasses();
+}
+
+/// Adds the class of the last pattern added to the set.
+///
+void PatternSet::addLabel(size_t label)
+{
+  if (m_labels.empty())
+    m_classes.clear();
+  if (label >= m_classes.size())
+    m_classes.resize(label+1);
+
+  m_labels.push_back(label);
+  m_classes[label].push_back(m_labels.size()-1);
+}
+
+/// Moves the pattern @a index to other class if its maximum output
+/// was changed.
+///
+void PatternSet::updateLabel(size_t index)
+{
+  const double* output = getOutputRow(index);
+  size_t label = std::max_element(output, output+getOutputSize()) - output;
+  if (label == m_labels[index])
+    return;
+
+  std::vector<size_t>& from(m_classes[m_labels[index]]);
+  from.erase(std::lower_bound(from.begin(), from.end(), index));
+
+  if (label >= m_classes.size())
+    m_classes.resize(label+1);
+
+  std::vector<size_t>& to(m_classes[label]);
+  to.insert(std::lower_bound(to.begin(), to.end(), index), index);
+  m_labels[index] = label;
+}
+
+/// Creates the lists of patterns of each class from the labels.
+///
+void PatternSet::updateClasses()
+{
+  m_classes.clear();
+  m_classes.resize(getOutputSize());
+
+  for (size_t i=0; i<m_labels.size(); ++i) {
+    if (m_labels[i] >= m_classes.size())
+      m_classes.resize(m_labels[i]+1);
+    m_classes[m_labels[i]].push_back(i);
+  }
+}
+
+/// Returns a version that was never given to a set (the sets can be
+/// created and modified from different threads).
+///
+unsigned long PatternSet::newVersion()
+{
+  lastVersionMutex.lock();
+  unsigned long version = ++lastVersion;
+  lastVersionMutex.unlock();
+  return version;
 }
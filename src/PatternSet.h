@@ -6,45 +6,287 @@
 #ifndef LOSEFACE_PATTERNSET_H
 #define LOSEFACE_PATTERNSET_H
 
+#include <cassert>
 #include <vector>
 #include "Pattern.h"
+#include "SharedPtr.h"
+#include "VectorView.h"
 
+class RandomStream;
+
+/// A set of patterns with the same number of inputs and outputs.
+///
+/// The inputs of the patterns are stored contiguously, one row after
+/// the other (the same layout as a Matrix with one input in each
+/// column), and the outputs in other array. The set has the row of
+/// each pattern, so #shuffle does not move the data.
+///
+/// Copies of a set, and the sets created with #append (e.g. the
+/// splits and merges of the Lua API), share the rows of the original
+/// set instead of copying them. The rows are copied only when they
+/// are modified (copy-on-write), or when patterns are added to rows
+/// shared with other sets. The sharing is not thread-safe: sets with
+/// the same rows must be copied or destroyed from one thread.
+///
+/// The set keeps the class of each pattern (the position of its
+/// maximum output) and the patterns of each class, so selecting the
+/// patterns of some classes (see #getClass) does not need to check
+/// the outputs of the whole set.
+///
+/// With #setLabelOutputs the outputs are not stored for each pattern:
+/// the output of a pattern is the output of its class (one value
+/// "on" and the other ones "off"), and all the patterns use the same
+/// row with the outputs of all the classes, so the memory of the set
+/// does not grow with the number of classes.
+///
+/// Patterns are accessed with PatternRef (see #operator[] and the
+/// iterators), which points to the rows of the pattern, so a
+/// reference cannot be used after adding or modifying other patterns
+/// of the set.
+///
 class PatternSet
 {
 public:
-  typedef std::vector<Pattern*> Patterns;
-  typedef Patterns::iterator iterator;
-  typedef Patterns::const_iterator const_iterator;
+
+  /// Read-only reference to a pattern of the set.
+  ///
+  class ConstPatternRef
+  {
+  protected:
+    const double* m_input;
+    const double* m_output;
+    size_t m_inputs;
+    size_t m_outputs;
+
+  public:
+    ConstPatternRef(const double* input, size_t inputs,
+		    const double* output, size_t outputs)
+      : m_input(input), m_output(output)
+      , m_inputs(inputs), m_outputs(outputs) { }
+
+    ConstVectorView getInput() const { return ConstVectorView(m_input, m_inputs); }
+    ConstVectorView getOutput() const { return ConstVectorView(m_output, m_outputs); }
+
+    double getInput(size_t index) const {
+      assert(index < m_inputs);
+      return m_input[index];
+    }
+
+    double getOutput(size_t index) const {
+      assert(index < m_outputs);
+      return m_output[index];
+    }
+
+    const double* getRawInput() const { return m_input; }
+    const double* getRawOutput() const { return m_output; }
+
+    /// Returns a copy of the pattern.
+    operator Pattern() const { return Pattern(getInput(), getOutput()); }
+  };
+
+  /// Reference to modify a pattern of the set. If the rows of the
+  /// pattern are shared, they are copied before the modification.
+  ///
+  class PatternRef : public ConstPatternRef
+  {
+    PatternSet* m_set;
+    size_t m_index;
+
+  public:
+    PatternRef(PatternSet* set, size_t index,
+	       const double* input, size_t inputs,
+	       const double* output, size_t outputs)
+      : ConstPatternRef(input, inputs, output, outputs)
+      , m_set(set), m_index(index) { }
+
+    void setInput(size_t index, double value) {
+      assert(index < m_inputs);
+      if (!m_set->m_inputs.isOwned()) {
+	m_set->detach(m_set->m_inputs);
+	m_input = m_set->getInputRow(m_index);
+      }
+      const_cast<double*>(m_input)[index] = value;
+      m_set->m_version = newVersion();
+    }
+
+    void setOutput(size_t index, double value) {
+      assert(index < m_outputs);
+      if (!m_set->m_outputs.isOwned()) {
+	m_set->detach(m_set->m_outputs);
+	m_output = m_set->getOutputRow(m_index);
+      }
+      const_cast<double*>(m_output)[index] = value;
+      m_set->updateLabel(m_index);
+      m_set->m_version = newVersion();
+    }
+  };
+
+  /// Iterator of the patterns in the order of the set. It is
+  /// dereferenced to a PatternRef (or ConstPatternRef).
+  ///
+  template<class Set, class Ref>
+  class IteratorT
+  {
+    template<class, class> friend class IteratorT;
+
+    Set* m_set;
+    size_t m_index;
+    Ref m_ref;
+
+  public:
+    IteratorT(Set* set, size_t index)
+      : m_set(set), m_index(index), m_ref(set->getRef(index)) { }
+
+    /// An iterator can be converted to a const_iterator.
+    template<class S, class R>
+    IteratorT(const IteratorT<S, R>& it)
+      : m_set(it.m_set), m_index(it.m_index), m_ref(it.m_ref) { }
+
+    const Ref& operator*() const { return m_ref; }
+    const Ref* operator->() const { return &m_ref; }
+    Ref& operator*() { return m_ref; }
+    Ref* operator->() { return &m_ref; }
+
+    IteratorT& operator++() {
+      m_ref = m_set->getRef(++m_index);
+      return *this;
+    }
+
+    bool operator==(const IteratorT& it) const { return m_index == it.m_index; }
+    bool operator!=(const IteratorT& it) const { return m_index != it.m_index; }
+  };
+
+  typedef IteratorT<PatternSet, PatternRef> iterator;
+  typedef IteratorT<const PatternSet, ConstPatternRef> const_iterator;
 
 private:
-  Patterns m_set;
+  /// Rows of inputs (or outputs), shared by the sets with the same
+  /// patterns.
+  struct Rows
+  {
+    std::vector<double> data;
+    size_t size;		// Doubles of each row
+    size_t step;		// Doubles from one row to the next one
+    bool labels;		// Outputs of the classes (overlapped rows)
 
-public:
-  iterator begin() { return m_set.begin(); }
-  iterator end() { return m_set.end(); }
-  const_iterator begin() const { return m_set.begin(); }
-  const_iterator end() const { return m_set.end(); }
+    Rows(size_t size) : size(size), step(size), labels(false) { }
+  };
 
-  bool empty() const { return m_set.empty(); }
-  size_t size() const { return m_set.size(); }
+  /// Inputs (or outputs) of the patterns of the set.
+  struct Part
+  {
+    SharedPtr<Rows> rows;
+    std::vector<size_t> index;	// Row of each pattern
+    bool distinct;		// Each pattern has its own row
 
-  PatternSet();
-  PatternSet(const PatternSet& copy);
-  ~PatternSet();
+    const double* getRow(size_t i) const { return &rows->data[index[i]*rows->step]; }
+    bool isOwned() const { return rows.unique() && distinct; }
+  };
+
+  Part m_inputs;
+  Part m_outputs;
 
+  std::vector<size_t> m_labels;	// Class of each pattern
+  std::vector<std::vector<size_t> > m_classes; // Patterns of each class
+
+  unsigned long m_version;	// See #getVersion
+
+public:
+  PatternSet();
+  PatternSet(const PatternSet& set);
   PatternSet& operator=(const PatternSet& set);
 
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  bool empty() const { return m_inputs.index.empty(); }
+  size_t size() const { return m_inputs.index.size(); }
+
+  /// Number of inputs/outputs of each pattern (zero if the set is
+  /// empty).
+  size_t getInputSize() const { return m_inputs.rows->size; }
+  size_t getOutputSize() const { return m_outputs.rows->size; }
+
+  void reserve(size_t patterns);
   void push_back(const Pattern& p);
+  void push_back(const ConstPatternRef& p);
+  void push_back(const Vector& input, size_t label);
+  void append(const PatternSet& set, size_t index);
+  void append(const PatternSet& set);
+  void setOutputs(const Vector& output);
+  void setLabelOutputs(size_t outputs, double on = 1.0, double off = 0.0);
   void shuffle();
+  void shuffle(RandomStream& random);
+  void sampleBalanced(PatternSet& sample, size_t n) const;
+  void sampleBalanced(PatternSet& sample, size_t n, RandomStream& random) const;
+
+  void getInputs(Matrix& inputs) const;
+
+  PatternRef operator[](size_t index) {
+    assert(index < size());
+    return getRef(index);
+  }
+
+  ConstPatternRef operator[](size_t index) const {
+    assert(index < size());
+    return getRef(index);
+  }
+
+  /// Returns the input of the pattern @a index of the set.
+  const double* getInputRow(size_t index) const {
+    return m_inputs.getRow(index);
+  }
 
-  Pattern& operator[](size_t index) {
-    return *m_set[index];
+  /// Returns the output of the pattern @a index of the set.
+  const double* getOutputRow(size_t index) const {
+    return m_outputs.getRow(index);
   }
 
-  const Pattern& operator[](size_t index) const {
-    return *m_set[index];
+  bool isContiguous(size_t first, size_t n) const;
+
+  /// Returns the class of the pattern @a index: the position of its
+  /// maximum output.
+  size_t getLabel(size_t index) const {
+    assert(index < size());
+    return m_labels[index];
   }
 
+  /// Number of classes (the number of outputs).
+  size_t getClasses() const { return getOutputSize(); }
+
+  /// Returns true if the outputs of the patterns are the outputs of
+  /// their classes (see #setLabelOutputs).
+  bool hasLabelOutputs() const { return m_outputs.rows->labels; }
+
+  const std::vector<size_t>& getClass(size_t label) const;
+
+  /// Returns a number that changes each time patterns are added to
+  /// the set or their inputs or outputs are modified (not when they
+  /// are reordered), e.g. to know if a value calculated with the
+  /// patterns of the set is still valid. Versions come from a global
+  /// counter, so two sets (even in the same address) never have the
+  /// same version.
+  unsigned long getVersion() const { return m_version; }
+
+private:
+  template<class, class> friend class IteratorT;
+
+  PatternRef getRef(size_t index);
+  ConstPatternRef getRef(size_t index) const;
+  void add(const double* input, size_t inputs,
+	   const double* output, size_t outputs);
+  void addRow(Part& part, const double* row);
+  void addIndex(Part& part, const Part& other, size_t index);
+  void addOutput(const double* output, size_t label);
+  void detach(Part& part);
+  void permute(const std::vector<size_t>& order);
+  void addLabel(size_t label);
+  void updateLabel(size_t index);
+  void updateClasses();
+  static unsigned long newVersion();
+
 };
 
 #endif // LOSEFACE_PATTERNSET_H
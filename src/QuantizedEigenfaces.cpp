@@ -0,0 +1,134 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "QuantizedEigenfaces.h"
+#include "Int8.h"
+#include "Simd.h"
+#include "Thread.h"
+
+// Minimum number of images per thread in QuantizedEigenfaces::projectBatch
+#define QUANT_PARALLEL_MIN_COLS	8
+
+QuantizedEigenfaces::QuantizedEigenfaces()
+{
+  m_pixels = 0;
+  m_components = 0;
+}
+
+/// Quantizes the eigenfaces of @a eigenfaces (they must be calculated
+/// or loaded).
+///
+void QuantizedEigenfaces::compile(const Eigenfaces& eigenfaces)
+{
+  const Matrix& E(eigenfaces.m_eigenfaces);
+
+  m_pixels = E.rows();
+  m_components = E.cols();
+  m_meanFace = eigenfaces.m_meanFace;
+
+  // The pixels of each int32 accumulation (see SimdKernels::i8dot)
+  assert(m_pixels < 0x7fffffff / (INT8_LEVELS*INT8_LEVELS));
+
+  m_eigenfaces.resize(m_pixels*m_components);
+  m_scales.resize(m_components);
+  for (size_t c=0; c<m_components; ++c)
+    m_scales[c] = quantize_int8(m_pixels, E.getRaw() + c*m_pixels, 1,
+				&m_eigenfaces[c*m_pixels]);
+}
+
+/// Projects one image in the eigenspace.
+///
+/// @see Eigenfaces::projectInEigenspace
+///
+void QuantizedEigenfaces::projectInEigenspace(const Vector& faceImage, Vector& eigenspacePoint) const
+{
+  assert(faceImage.size() == m_pixels);
+
+  eigenspacePoint.resize(m_components);
+  projectColumns(faceImage.getRaw(), 1, eigenspacePoint.getRaw());
+}
+
+// A range of images for a thread of QuantizedEigenfaces::projectBatch
+struct QuantizedEigenfaces::ProjectTask
+{
+  const QuantizedEigenfaces* eigenfaces;
+  const double* images;
+  size_t n;
+  double* points;
+};
+
+/// Projects a set of images (one image per column).
+///
+/// @param threads
+///   Number of threads (0 means one per processor). Each thread
+///   projects a range of images.
+///
+/// @see Eigenfaces::projectBatch
+///
+void QuantizedEigenfaces::projectBatch(const Matrix& faceImages, Matrix& eigenspacePoints, size_t threads) const
+{
+  if (faceImages.rows() != m_pixels)
+    throw std::invalid_argument("Invalid argument 'faceImages' in QuantizedEigenfaces::projectBatch method: images must have the size of the eigenfaces.");
+
+  size_t n = faceImages.cols();
+  eigenspacePoints.resize(m_components, n);
+
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::min(threads, n / QUANT_PARALLEL_MIN_COLS);
+
+  if (threads <= 1) {
+    projectColumns(faceImages.getRaw(), n, eigenspacePoints.getRaw());
+    return;
+  }
+
+  std::vector<ProjectTask> tasks(threads);
+  size_t j = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t cols = n/threads + (t < n%threads ? 1: 0);
+    tasks[t].eigenfaces = this;
+    tasks[t].images = faceImages.getRaw() + j*m_pixels;
+    tasks[t].n = cols;
+    tasks[t].points = eigenspacePoints.getRaw() + j*m_components;
+    j += cols;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&QuantizedEigenfaces::projectThread, &tasks[t]));
+
+  projectThread(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+}
+
+void QuantizedEigenfaces::projectThread(void* data)
+{
+  const ProjectTask& task = *(ProjectTask*)data;
+  task.eigenfaces->projectColumns(task.images, task.n, task.points);
+}
+
+// Projects @a n images (contiguous columns)
+void QuantizedEigenfaces::projectColumns(const double* images, size_t n, double* points) const
+{
+  const SimdKernels& k(simd());
+  std::vector<double> centered(m_pixels);
+  std::vector<signed char> image(m_pixels);
+  std::vector<int> sums(m_components);
+
+  for (size_t j=0; j<n; ++j, images+=m_pixels, points+=m_components) {
+    // E^T*(image - Psi)
+    k.sub(m_pixels, images, m_meanFace.getRaw(), &centered[0]);
+    double scale = quantize_int8(m_pixels, &centered[0], 1, &image[0]);
+
+    k.i8gemv(m_components, m_pixels, &m_eigenfaces[0], &image[0], &sums[0]);
+    for (size_t c=0; c<m_components; ++c)
+      points[c] = scale*m_scales[c]*sums[c];
+  }
+}
@@ -0,0 +1,49 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_QUANTIZEDEIGENFACES_H
+#define LOSEFACE_QUANTIZEDEIGENFACES_H
+
+#include <vector>
+#include "Eigenfaces.h"
+
+/// An int8 copy of the eigenfaces to project images faster.
+///
+/// Each eigenface is quantized to 8-bit integers with its own scale
+/// (one scale per component of the eigenspace). Images are centered
+/// (the mean face is subtracted in double) and quantized with one
+/// scale per image, so each component of the projection is just one
+/// 8-bit dot product accumulated in 32-bit integers.
+///
+/// The projections can be recalled with a QuantizedMlp.
+///
+class QuantizedEigenfaces
+{
+  struct ProjectTask;
+  static void projectThread(void* data);
+
+  size_t m_pixels;
+  size_t m_components;
+  std::vector<signed char> m_eigenfaces;	// Each eigenface (m_pixels values)
+  std::vector<double> m_scales;		// Scale of each eigenface
+  Vector m_meanFace;
+
+public:
+  QuantizedEigenfaces();
+
+  size_t getPixelsPerImage() const { return m_pixels; }
+  size_t getEigenfaceComponents() const { return m_components; }
+
+  void compile(const Eigenfaces& eigenfaces);
+
+  void projectInEigenspace(const Vector& faceImage, Vector& eigenspacePoint) const;
+  void projectBatch(const Matrix& faceImages, Matrix& eigenspacePoints, size_t threads = 1) const;
+
+private:
+  void projectColumns(const double* images, size_t n, double* points) const;
+
+};
+
+#endif // LOSEFACE_QUANTIZEDEIGENFACES_H
@@ -0,0 +1,277 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "QuantizedMlp.h"
+#include "ActivationFunctions.h"
+#include "Int8.h"
+#include "MlpArray.h"
+#include "MlpKernels.h"
+#include "Simd.h"
+#include "Thread.h"
+
+// Minimum number of inputs per thread in QuantizedMlp::recallBatch
+#define QUANT_PARALLEL_MIN_COLS	64
+
+//////////////////////////////////////////////////////////////////////
+// Lookup tables of the hidden functions
+//////////////////////////////////////////////////////////////////////
+
+// Each table has the 8-bit hidden neuron (INT8_LEVELS*f(x)) for
+// QUANT_TABLE_SIZE points in [-QUANT_TABLE_RANGE, QUANT_TABLE_RANGE].
+// Outside that range Logsig and Tansig are saturated (their distance
+// to 0, 1 or -1 is less than half a level).
+#define QUANT_TABLE_SIZE	4096
+#define QUANT_TABLE_RANGE	8.0
+#define QUANT_TABLE_STEPS	((QUANT_TABLE_SIZE-1) / (2.0*QUANT_TABLE_RANGE))
+
+static double logsig(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+static double tansig(double x) { return std::tanh(x); }
+
+struct HiddenTable
+{
+  signed char values[QUANT_TABLE_SIZE];
+
+  HiddenTable(double (*f)(double)) {
+    for (int i=0; i<QUANT_TABLE_SIZE; ++i) {
+      double x = -QUANT_TABLE_RANGE + i / QUANT_TABLE_STEPS;
+      values[i] = (signed char)std::floor(INT8_LEVELS*f(x) + 0.5);
+    }
+  }
+};
+
+static const HiddenTable g_logsigTable(&logsig);
+static const HiddenTable g_tansigTable(&tansig);
+
+static inline signed char lookup(const signed char* table, double x)
+{
+  double i = (x + QUANT_TABLE_RANGE) * QUANT_TABLE_STEPS + 0.5;
+  if (i <= 0.0)
+    return table[0];
+  else if (i >= QUANT_TABLE_SIZE-1)
+    return table[QUANT_TABLE_SIZE-1];
+  else
+    return table[int(i)];
+}
+
+//////////////////////////////////////////////////////////////////////
+// QuantizedMlp
+//////////////////////////////////////////////////////////////////////
+
+QuantizedMlp::QuantizedMlp()
+{
+  m_inputs = 0;
+  m_hiddens = 0;
+  m_outputs = 0;
+}
+
+QuantizedMlp::~QuantizedMlp()
+{
+  clear();
+}
+
+/// Quantizes the weights of @a mlp.
+///
+/// @throw std::invalid_argument
+///   If the hidden layer does not use Logsig or Tansig.
+///
+void QuantizedMlp::compile(const Mlp& mlp)
+{
+  clear();
+  addNet(mlp);
+}
+
+/// Quantizes the weights of all the networks of @a array.
+///
+/// @throw std::invalid_argument
+///   If a hidden layer does not use Logsig or Tansig.
+///
+void QuantizedMlp::compile(const MlpArray& array)
+{
+  clear();
+
+  for (MlpArray::Nets::const_iterator
+	 it = array.m_nets.begin(); it != array.m_nets.end(); ++it)
+    addNet(*it);
+}
+
+void QuantizedMlp::clear()
+{
+  for (size_t c=0; c<m_blocks.size(); ++c)
+    delete m_blocks[c].outputFunc;
+
+  m_blocks.clear();
+  m_weight1.clear();
+  m_scale1.clear();
+  m_weight2.clear();
+  m_scale2.clear();
+  m_bias1.clear();
+  m_bias2.clear();
+  m_inputs = 0;
+  m_hiddens = 0;
+  m_outputs = 0;
+}
+
+/// Calculates the outputs of all the networks for one @a input.
+///
+void QuantizedMlp::recall(const Vector& input, Vector& output) const
+{
+  assert(!m_blocks.empty());
+  assert(input.size() == getInputs());
+
+  output.resize(m_outputs);
+  recallColumns(input.getRaw(), 1, output.getRaw());
+}
+
+// A range of inputs for a thread of QuantizedMlp::recallBatch
+struct QuantizedMlp::RecallTask
+{
+  const QuantizedMlp* mlp;
+  const double* inputs;
+  size_t n;
+  double* outputs;
+};
+
+/// Calculates the outputs for a batch of inputs (one input in each
+/// column of @a inputs).
+///
+/// @param outputs
+///   Returns the outputs (one column for each input). It is resized
+///   only if it does not have the right size.
+///
+/// @param threads
+///   Number of threads (0 means one per processor). Each thread
+///   calculates a range of columns.
+///
+void QuantizedMlp::recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads) const
+{
+  assert(!m_blocks.empty());
+
+  if (inputs.rows() != m_inputs)
+    throw std::invalid_argument("Invalid argument 'inputs' in QuantizedMlp::recallBatch method: each column must be an input of the network.");
+
+  size_t n = inputs.cols();
+  if (outputs.rows() != m_outputs || outputs.cols() != n)
+    outputs.resize(m_outputs, n);
+
+  if (threads == 0)
+    threads = Thread::processors();
+  threads = std::min(threads, n / QUANT_PARALLEL_MIN_COLS);
+
+  if (threads <= 1) {
+    recallColumns(inputs.getRaw(), n, outputs.getRaw());
+    return;
+  }
+
+  std::vector<RecallTask> tasks(threads);
+  size_t j = 0;
+  for (size_t t=0; t<threads; ++t) {
+    size_t cols = n/threads + (t < n%threads ? 1: 0);
+    tasks[t].mlp = this;
+    tasks[t].inputs = inputs.getRaw() + j*m_inputs;
+    tasks[t].n = cols;
+    tasks[t].outputs = outputs.getRaw() + j*m_outputs;
+    j += cols;
+  }
+
+  std::vector<Thread*> workers;
+  for (size_t t=1; t<threads; ++t)
+    workers.push_back(new Thread(&QuantizedMlp::recallThread, &tasks[t]));
+
+  recallThread(&tasks[0]);
+
+  for (size_t t=0; t<workers.size(); ++t)
+    delete workers[t];
+}
+
+void QuantizedMlp::recallThread(void* data)
+{
+  const RecallTask& task = *(RecallTask*)data;
+  task.mlp->recallColumns(task.inputs, task.n, task.outputs);
+}
+
+// Appends the layers of @a net as a new block
+void QuantizedMlp::addNet(const Mlp& net)
+{
+  if (!m_blocks.empty() && net.getInputs() != m_inputs)
+    throw std::invalid_argument("Invalid argument in QuantizedMlp::compile method: all networks must have the same number of inputs.");
+
+  Block b;
+  switch (net.m_hiddenFunc->getKind()) {
+    case LogsigActivation: b.table = g_logsigTable.values; break;
+    case TansigActivation: b.table = g_tansigTable.values; break;
+    default:
+      throw std::invalid_argument("Invalid argument in QuantizedMlp::compile method: the hidden layers must use Logsig or Tansig.");
+  }
+
+  const size_t I = net.getInputs();
+  const size_t H = net.getHiddens();
+  const size_t O = net.getOutputs();
+
+  b.hidden = m_hiddens;
+  b.hiddens = H;
+  b.output = m_outputs;
+  b.outputs = O;
+  b.outputFunc = net.m_outputFunc->clone();
+  b.f = mlp_kernels<double>(*net.m_hiddenFunc, *b.outputFunc).output;
+  m_blocks.push_back(b);
+
+  // Each row of the first layer (weights of one hidden neuron)
+  m_inputs = I;
+  m_weight1.resize((m_hiddens+H)*I);
+  for (size_t j=0; j<H; ++j)
+    m_scale1.push_back(quantize_int8(I, net.m_weight1.getRaw()+j, H,
+				     &m_weight1[(m_hiddens+j)*I]));
+
+  // Each row of the second layer, its scale includes the scale of the
+  // hidden neurons (1/INT8_LEVELS)
+  m_weight2.resize(m_weight2.size() + O*H);
+  for (size_t k=0; k<O; ++k)
+    m_scale2.push_back(quantize_int8(H, net.m_weight2.getRaw()+k, O,
+				     &m_weight2[m_weight2.size() - (O-k)*H])
+		       / INT8_LEVELS);
+
+  m_bias1.insert(m_bias1.end(), net.m_bias1.begin(), net.m_bias1.end());
+  m_bias2.insert(m_bias2.end(), net.m_bias2.begin(), net.m_bias2.end());
+
+  m_hiddens += H;
+  m_outputs += O;
+}
+
+// Recalls @a n inputs (contiguous columns)
+void QuantizedMlp::recallColumns(const double* inputs, size_t n, double* outputs) const
+{
+  const SimdKernels& k(simd());
+  std::vector<signed char> input(m_inputs), hidden(m_hiddens);
+  std::vector<int> sums(std::max(m_hiddens, m_outputs));
+
+  for (size_t j=0; j<n; ++j, inputs+=m_inputs, outputs+=m_outputs) {
+    double scale = quantize_int8(m_inputs, inputs, 1, &input[0]);
+
+    // The hidden neurons of all the networks with one product
+    k.i8gemv(m_hiddens, m_inputs, &m_weight1[0], &input[0], &sums[0]);
+    for (size_t c=0; c<m_blocks.size(); ++c) {
+      const Block& b(m_blocks[c]);
+      for (size_t h=b.hidden; h<b.hidden+b.hiddens; ++h)
+	hidden[h] = lookup(b.table, m_bias1[h] + scale*m_scale1[h]*sums[h]);
+    }
+
+    const signed char* w2 = &m_weight2[0];
+    for (size_t c=0; c<m_blocks.size(); ++c) {
+      const Block& b(m_blocks[c]);
+      double* o = outputs+b.output;
+
+      k.i8gemv(b.outputs, b.hiddens, w2, &hidden[b.hidden], &sums[0]);
+      for (size_t r=0; r<b.outputs; ++r)
+	o[r] = m_bias2[b.output+r] + m_scale2[b.output+r]*sums[r];
+
+      b.f(b.outputFunc, b.outputs, o, o);
+      w2 += b.outputs*b.hiddens;
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_QUANTIZEDMLP_H
+#define LOSEFACE_QUANTIZEDMLP_H
+
+#include <vector>
+#include "Mlp.h"
+
+class ActivationFunction;
+class MlpArray;
+
+/// An int8 copy of a trained Mlp or MlpArray to recall it faster.
+///
+/// The weights of each neuron are quantized to 8-bit integers with
+/// their own scale (one scale per output channel), and each input
+/// vector is quantized with one scale for all its elements. Products
+/// are accumulated in 32-bit integers (see SimdKernels::i8dot).
+///
+/// The hidden activations (Logsig or Tansig) are read from lookup
+/// tables which give directly the 8-bit hidden neurons for the
+/// second layer. Biases and the output activations are calculated
+/// in double.
+///
+/// As FusedMlpArray, the first layers of an array are stacked and
+/// each second layer only uses the hidden neurons of its network.
+///
+class QuantizedMlp
+{
+  // One network of the array
+  struct Block {
+    size_t hidden, hiddens;	// Rows in m_weight1
+    size_t output, outputs;	// Rows in m_weight2
+    const signed char* table;	// Lookup table of the hidden function
+    ActivationFunction* outputFunc;
+    void (*f)(ActivationFunction* func, size_t n, const double* x, double* y);
+  };
+
+  struct RecallTask;
+  static void recallThread(void* data);
+
+  std::vector<Block> m_blocks;
+  size_t m_inputs;
+  size_t m_hiddens;
+  size_t m_outputs;
+  std::vector<signed char> m_weight1;	// Rows of m_inputs weights
+  std::vector<double> m_scale1;		// Scale of each row
+  std::vector<double> m_bias1;
+  std::vector<signed char> m_weight2;	// Rows of the hiddens of its block
+  std::vector<double> m_scale2;
+  std::vector<double> m_bias2;
+
+public:
+  QuantizedMlp();
+  ~QuantizedMlp();
+
+  size_t getInputs() const { return m_inputs; }
+  size_t getOutputs() const { return m_outputs; }
+
+  void compile(const Mlp& mlp);
+  void compile(const MlpArray& array);
+  void clear();
+
+  void recall(const Vector& input, Vector& output) const;
+  void recallBatch(const Matrix& inputs, Matrix& outputs, size_t threads = 1) const;
+
+private:
+  void addNet(const Mlp& net);
+  void recallColumns(const double* inputs, size_t n, double* outputs) const;
+
+  // Non-copyable
+  QuantizedMlp(const QuantizedMlp&);
+  QuantizedMlp& operator=(const QuantizedMlp&);
+};
+
+#endif // LOSEFACE_QUANTIZEDMLP_H
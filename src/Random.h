@@ -6,6 +6,8 @@
 #ifndef LOSEFACE_RANDOM_H
 #define LOSEFACE_RANDOM_H
 
+#include <cstdlib>
+
 extern "C" {
 
 extern void init_genrand(unsigned long s);
@@ -49,4 +51,52 @@ public:
 
 };
 
+/// A random number generator with its own state.
+///
+/// Unlike Random, each object is an independent stream (Park-Miller
+/// minimal standard generator), so several threads can use their own
+/// streams and get the same numbers for the same seed in any order.
+///
+class RandomStream
+{
+  unsigned long m_state;	// Always in [1, 2^31-2]
+
+public:
+
+  /// Creates the stream number @a stream of the given @a seed.
+  RandomStream(unsigned long seed, unsigned long stream = 0) {
+    unsigned long h = (seed * 2654435761UL + stream * 40503UL + 12345UL) & 0xffffffffUL;
+    h ^= h >> 16;
+    h = (h * 0x45d9f3bUL) & 0xffffffffUL;
+    h ^= h >> 16;
+    m_state = h % 2147483646UL + 1;
+
+    for (int i=0; i<4; ++i)	// Discard the first numbers
+      getInt();
+  }
+
+  /// Generates a random number on [1,0x7ffffffe]-interval.
+  long getInt() {
+    // Schrage's method to compute 16807*state % (2^31-1) without overflow
+    long s = (long)m_state;
+    long t = 16807 * (s % 127773) - 2836 * (s / 127773);
+    if (t <= 0)
+      t += 2147483647;
+    m_state = (unsigned long)t;
+    return t;
+  }
+
+  /// Generates a random number on [0,1]-real-interval.
+  double getReal() {
+    return static_cast<double>(getInt() - 1) / 2147483645.0;
+  }
+
+  /// Generates a random number on [0,n)-interval (to be used with
+  /// std::random_shuffle).
+  long operator()(long n) {
+    return getInt() % n;
+  }
+
+};
+
 #endif // LOSEFACE_RANDOM_H
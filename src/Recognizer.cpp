@@ -0,0 +1,258 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <fstream>
+#include <stdexcept>
+
+#include "Recognizer.h"
+#include "ActivationFunctions.h"
+#include "Blas.h"
+
+Recognizer::Recognizer()
+{
+  m_pixels = 0;
+  m_fused = false;
+}
+
+/// Collapses the projection, the normalization and the first layer
+/// of @a mlp.
+///
+/// @param normalMin, normalMax
+///   Range of each component of the projections (the ann.Normalizer
+///   used to train the network).
+///
+void Recognizer::compile(const Eigenfaces& eigenfaces,
+			 const Vector& normalMin, const Vector& normalMax,
+			 const Mlp& mlp)
+{
+  MlpArray array;
+  array.add(mlp);
+  compile(eigenfaces, normalMin, normalMax, array);
+}
+
+/// Collapses the projection, the normalization and the first layers
+/// of all the networks of @a array.
+///
+/// @throw std::invalid_argument
+///   If the networks or the normalization ranges do not have one
+///   input for each eigenface.
+///
+void Recognizer::compile(const Eigenfaces& eigenfaces,
+			 const Vector& normalMin, const Vector& normalMax,
+			 const MlpArray& array)
+{
+  const Matrix& E(eigenfaces.m_eigenfaces);
+  const size_t N = E.rows();
+  const size_t M = E.cols();
+
+  if (array.getInputs() != M || normalMin.size() != M || normalMax.size() != M)
+    throw std::invalid_argument("Invalid argument in Recognizer::compile method: the networks and the normalizer must have one input for each eigenface.");
+
+  // The normalization of the projections is a.*p + c (components
+  // without range are left in zero)
+  Vector a(M), c(M);
+  for (size_t i=0; i<M; ++i) {
+    double range = normalMax(i) - normalMin(i);
+    if (range != 0.0) {
+      a(i) = 2.0 / range;
+      c(i) = -2.0 * normalMin(i) / range - 1.0;
+    }
+    else
+      a(i) = c(i) = 0.0;
+  }
+
+  size_t hiddens = 0;
+  for (MlpArray::Nets::const_iterator
+	 it = array.m_nets.begin(); it != array.m_nets.end(); ++it)
+    hiddens += it->getHiddens();
+
+  m_pixels = N;
+  m_fused = (hiddens <= M);
+  m_eigenfaces = m_fused ? Matrix(): E;
+  m_array = MlpArray();
+
+  for (MlpArray::Nets::const_iterator
+	 it = array.m_nets.begin(); it != array.m_nets.end(); ++it) {
+    const size_t H = it->getHiddens();
+    Mlp net(*it);
+
+    // W1*diag(a), and b1 + W1*c
+    Matrix W1(it->m_weight1);
+    for (size_t i=0; i<M; ++i)
+      W1.getCol(i) *= a(i);
+
+    Vector b1(it->m_bias1);
+    blas_gemv(GemmNormal, H, M, 1.0, it->m_weight1.getRaw(), H,
+	      c.getRaw(), 1.0, b1.getRaw());
+
+    if (m_fused) {
+      // W1*diag(a)*E^T, and the mean face in the bias
+      net.m_weight1.resize(H, N);
+      blas_gemm(GemmNormal, GemmTransposed, H, N, M,
+		1.0, W1.getRaw(), H,
+		E.getRaw(), N,
+		0.0, net.m_weight1.getRaw(), H);
+      blas_gemv(GemmNormal, H, N, -1.0, net.m_weight1.getRaw(), H,
+		eigenfaces.m_meanFace.getRaw(), 1.0, b1.getRaw());
+    }
+    else {
+      net.m_weight1 = W1;
+      blas_gemv(GemmNormal, H, M, -1.0, W1.getRaw(), H,
+		eigenfaces.m_meanProjection.getRaw(), 1.0, b1.getRaw());
+    }
+
+    net.m_bias1 = b1;
+    m_array.add(net);
+  }
+}
+
+/// Calculates the outputs of the networks for the pixels of one
+/// @a image.
+///
+void Recognizer::recall(const Vector& image, Vector& output) const
+{
+  assert(image.size() == m_pixels);
+
+  if (m_fused)
+    m_array.recall(image, output);
+  else {
+    Vector point(m_eigenfaces.cols());
+    blas_gemv(GemmTransposed, m_pixels, m_eigenfaces.cols(),
+	      1.0, m_eigenfaces.getRaw(), m_pixels,
+	      image.getRaw(), 0.0, point.getRaw());
+    m_array.recall(point, output);
+  }
+}
+
+/// Calculates the outputs of the networks for a batch of images (one
+/// image in each column of @a images).
+///
+/// @param threads
+///   Number of threads (0 means one per processor).
+///
+void Recognizer::recallBatch(const Matrix& images, Matrix& outputs, size_t threads) const
+{
+  if (images.rows() != m_pixels)
+    throw std::invalid_argument("Invalid argument 'images' in Recognizer::recallBatch method: images must have the size of the eigenfaces.");
+
+  if (m_fused)
+    m_array.recallBatch(images, outputs, threads);
+  else {
+    const size_t M = m_eigenfaces.cols();
+    Matrix points(M, images.cols());
+    blas_gemm_parallel(GemmTransposed, GemmNormal,
+		       M, images.cols(), m_pixels,
+		       1.0, m_eigenfaces.getRaw(), m_pixels,
+		       images.getRaw(), m_pixels,
+		       0.0, points.getRaw(), M, threads);
+    m_array.recallBatch(points, outputs, threads);
+  }
+}
+
+/// Returns the output with the maximum value (the recognized subject)
+/// of each image.
+///
+void Recognizer::recognizeBatch(const Matrix& images, std::vector<size_t>& subjects, size_t threads) const
+{
+  Matrix outputs;
+  recallBatch(images, outputs, threads);
+
+  subjects.resize(images.cols());
+  for (size_t j=0; j<images.cols(); ++j)
+    subjects[j] = outputs.getCol(j).getMaxPos();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Binary I/O
+//////////////////////////////////////////////////////////////////////
+
+void Recognizer::save(const char* filename) const
+{
+  std::ofstream f(filename, std::ios::binary);
+  write(f);
+}
+
+void Recognizer::load(const char* filename)
+{
+  std::ifstream f(filename, std::ios::binary);
+  read(f);
+}
+
+// Writes the kind of an activation function (see read_function)
+static void write_function(std::ostream& s, const ActivationFunction& func)
+{
+  size_t kind = func.getKind();
+  s.write((char*)&kind, sizeof(size_t));
+}
+
+// Returns the Purelin, Logsig or Tansig function saved with
+// write_function (other functions are loaded as Logsig)
+static const ActivationFunction& read_function(std::istream& s)
+{
+  static Purelin purelin;
+  static Logsig logsig;
+  static Tansig tansig;
+  size_t kind = 0;
+  s.read((char*)&kind, sizeof(size_t));
+
+  switch (kind) {
+    case PurelinActivation: return purelin;
+    case TansigActivation: return tansig;
+    default: return logsig;
+  }
+}
+
+/// Writes the number of pixels, if the model is fused, the
+/// eigenfaces (only if it is not fused) and the networks with the
+/// kind of their activation functions (Mlp::write does not save
+/// them).
+///
+void Recognizer::write(std::ostream& s) const
+{
+  size_t fused = m_fused ? 1: 0;
+  s.write((char*)&m_pixels, sizeof(size_t));
+  s.write((char*)&fused, sizeof(size_t));
+
+  if (!m_fused)
+    m_eigenfaces.write(s);
+
+  size_t n = m_array.m_nets.size();
+  s.write((char*)&n, sizeof(size_t));
+
+  for (MlpArray::Nets::const_iterator
+	 it = m_array.m_nets.begin(); it != m_array.m_nets.end(); ++it) {
+    write_function(s, *it->m_hiddenFunc);
+    write_function(s, *it->m_outputFunc);
+    it->write(s);
+  }
+}
+
+void Recognizer::read(std::istream& s)
+{
+  size_t fused = 0;
+  s.read((char*)&m_pixels, sizeof(size_t));
+  s.read((char*)&fused, sizeof(size_t));
+  m_fused = (fused != 0);
+
+  if (m_fused)
+    m_eigenfaces = Matrix();
+  else
+    m_eigenfaces.read(s);
+
+  size_t n = 0;
+  s.read((char*)&n, sizeof(size_t));
+
+  m_array = MlpArray();
+  for (size_t c=0; c<n; ++c) {
+    const ActivationFunction& hidden(read_function(s));
+    const ActivationFunction& output(read_function(s));
+
+    Mlp net;
+    net.read(s);
+    net.setHiddenActivationFunction(hidden);
+    net.setOutputActivationFunction(output);
+    m_array.add(net);
+  }
+}
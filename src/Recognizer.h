@@ -0,0 +1,75 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_RECOGNIZER_H
+#define LOSEFACE_RECOGNIZER_H
+
+#include <iostream>
+#include <vector>
+
+#include "Eigenfaces.h"
+#include "MlpArray.h"
+
+/// Recognizes face images with the eigenfaces, the min/max
+/// normalization and the networks used to classify their
+/// projections, collapsed in one model.
+///
+/// The projection E^T*(x - Psi), the normalization of each component
+/// to [-1,1] (a.*p + c) and the first layer W1*p + b1 are linear, so
+/// they are one map from the pixels to the hidden neurons:
+///
+///   W1' = W1*diag(a)*E^T
+///   b1' = b1 + W1*c - W1'*Psi
+///
+/// This matrix is used only if the networks have no more hidden
+/// neurons (all together) than eigenfaces, otherwise the projection
+/// is cheaper than the H x pixels product, and only the mean face and
+/// the normalization are moved to the first layer (W1' = W1*diag(a),
+/// which receives E^T*x).
+///
+/// The saved models keep Purelin, Logsig and Tansig layers (custom
+/// activation functions are loaded as Logsig).
+///
+class Recognizer
+{
+  size_t m_pixels;
+  bool m_fused;			// True if m_array receives the pixels
+  Matrix m_eigenfaces;		// E (pixels x components) if it is not fused
+  MlpArray m_array;
+
+public:
+  Recognizer();
+
+  size_t getPixelsPerImage() const { return m_pixels; }
+  size_t getOutputs() const { return m_array.getOutputs(); }
+  bool isFused() const { return m_fused; }
+
+  /// The networks with the first layers collapsed (they receive the
+  /// pixels if isFused(), or the projections E^T*x).
+  const MlpArray& getArray() const { return m_array; }
+
+  void compile(const Eigenfaces& eigenfaces,
+	       const Vector& normalMin, const Vector& normalMax,
+	       const Mlp& mlp);
+  void compile(const Eigenfaces& eigenfaces,
+	       const Vector& normalMin, const Vector& normalMax,
+	       const MlpArray& array);
+
+  void recall(const Vector& image, Vector& output) const;
+  void recallBatch(const Matrix& images, Matrix& outputs, size_t threads = 1) const;
+  void recognizeBatch(const Matrix& images, std::vector<size_t>& subjects, size_t threads = 1) const;
+
+  //////////////////////////////////////////////////////////////////////
+  // Binary I/O
+  //////////////////////////////////////////////////////////////////////
+
+  void save(const char* filename) const;
+  void load(const char* filename);
+  void write(std::ostream& s) const;
+  void read(std::istream& s);
+
+};
+
+#endif // LOSEFACE_RECOGNIZER_H
@@ -0,0 +1,85 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_SCALAR_H
+#define LOSEFACE_SCALAR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+/// Type of the elements in the binary files of Vector and Matrix.
+///
+/// It is saved in the highest byte of the first size of the file
+/// (files written before the float matrices have a zero there, so
+/// they are read as double).
+///
+enum ScalarType {
+  DoubleScalar = 0,
+  FloatScalar = 1
+};
+
+template<class T> struct ScalarTraits;
+
+template<> struct ScalarTraits<double> {
+  static ScalarType type() { return DoubleScalar; }
+};
+
+template<> struct ScalarTraits<float> {
+  static ScalarType type() { return FloatScalar; }
+};
+
+#define SCALAR_TYPE_SHIFT	((sizeof(size_t)-1)*8)
+
+/// Writes the size @a n tagged with the type of @a T.
+///
+template<class T>
+inline void write_scalar_size(std::ostream& s, size_t n)
+{
+  n |= size_t(ScalarTraits<T>::type()) << SCALAR_TYPE_SHIFT;
+  s.write((char*)&n, sizeof(size_t));
+}
+
+/// Reads a size written with #write_scalar_size.
+///
+inline size_t read_scalar_size(std::istream& s, ScalarType& type)
+{
+  size_t n = 0;
+  s.read((char*)&n, sizeof(size_t));
+
+  type = ScalarType(n >> SCALAR_TYPE_SHIFT);
+  if (type != DoubleScalar && type != FloatScalar)
+    throw std::runtime_error("Unknown scalar type in a binary matrix/vector.");
+
+  return n & ((size_t(1) << SCALAR_TYPE_SHIFT) - 1);
+}
+
+template<class S, class T>
+inline void read_converted_scalars(std::istream& s, T* dst, size_t n)
+{
+  std::vector<S> src(n);
+  if (n > 0) {
+    s.read((char*)&src[0], sizeof(S)*n);
+    std::copy(src.begin(), src.end(), dst);
+  }
+}
+
+/// Reads @a n elements saved as @a type, converting them to @a T if
+/// it is needed.
+///
+template<class T>
+inline void read_scalars(std::istream& s, ScalarType type, T* dst, size_t n)
+{
+  if (type == ScalarTraits<T>::type())
+    s.read((char*)dst, sizeof(T)*n);
+  else if (type == FloatScalar)
+    read_converted_scalars<float>(s, dst, n);
+  else
+    read_converted_scalars<double>(s, dst, n);
+}
+
+#endif // LOSEFACE_SCALAR_H
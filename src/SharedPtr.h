@@ -114,6 +114,14 @@ public:
     return m_ptr != NULL ? true: false;
   }
 
+  /// Returns true if this is the only reference to the object (or it
+  /// is NULL).
+  ///
+  inline bool unique() const
+  {
+    return m_ptr == NULL || *m_refCount == 1;
+  }
+
 private:
 
   void ref()
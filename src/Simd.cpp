@@ -0,0 +1,806 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define SIMD_X86
+  #define SIMD_TARGET(isa) __attribute__((target(isa)))
+  #include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #define SIMD_X86
+  #define SIMD_TARGET(isa)
+  #include <intrin.h>
+  #include <immintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Polynomial exp
+//////////////////////////////////////////////////////////////////////
+
+// exp(x) = 2^k * exp(r), where k = round(x/ln2) and r = x - k*ln2
+// (so |r| <= ln2/2), and exp(r) is approximated with its Taylor
+// polynomial of degree 11 (error < 1e-14). ln2 is split in two parts
+// so k*EXP_LN2_HI is exact. x is clamped to [-EXP_MAX, EXP_MAX] so
+// 2^k is always a normal number.
+#define EXP_MAX		708.0
+#define EXP_LOG2E	1.4426950408889634
+#define EXP_LN2_HI	6.93145751953125e-1
+#define EXP_LN2_LO	1.42860682030941723212e-6
+#define EXP_DEGREE	11
+
+// 1/i!
+static const double exp_coef[EXP_DEGREE+1] = {
+  1.0, 1.0, 0.5,
+  1.6666666666666666e-01, 4.1666666666666664e-02,
+  8.3333333333333332e-03, 1.3888888888888889e-03,
+  1.9841269841269841e-04, 2.4801587301587302e-05,
+  2.7557319223985893e-06, 2.7557319223985888e-07,
+  2.5052108385441720e-08
+};
+
+/// Returns exp(x) calculated with the same polynomial used by the
+/// logsig and tansig kernels.
+///
+double simd_exp(double x)
+{
+  x = std::min(std::max(x, -EXP_MAX), EXP_MAX);
+
+  double k = std::floor(x*EXP_LOG2E + 0.5);
+  double r = (x - k*EXP_LN2_HI) - k*EXP_LN2_LO;
+  double p = exp_coef[EXP_DEGREE];
+  for (int i=EXP_DEGREE-1; i>=0; --i)
+    p = p*r + exp_coef[i];
+
+  return std::ldexp(p, (int)k);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Scalar kernels
+//////////////////////////////////////////////////////////////////////
+
+static double scalar_dot(size_t n, const double* x, const double* y)
+{
+  double r = 0.0;
+  for (size_t i=0; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+static void scalar_axpy(size_t n, double a, const double* x, double* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+static void scalar_add(size_t n, const double* x, const double* y, double* z)
+{
+  for (size_t i=0; i<n; ++i)
+    z[i] = x[i] + y[i];
+}
+
+static void scalar_sub(size_t n, const double* x, const double* y, double* z)
+{
+  for (size_t i=0; i<n; ++i)
+    z[i] = x[i] - y[i];
+}
+
+static void scalar_scale(size_t n, double a, const double* x, double* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] = a * x[i];
+}
+
+// Column by column (unit stride), but each y(i) accumulates its
+// products in the same order as the old row by row loop.
+static void scalar_gemv(size_t m, size_t n, const double* A, size_t lda,
+			const double* x, double* y)
+{
+  for (size_t i=0; i<m; ++i)
+    y[i] = 0.0;
+
+  for (size_t j=0; j<n; ++j)
+    scalar_axpy(m, x[j], A+j*lda, y);
+}
+
+static void scalar_gemvT(size_t m, size_t n, const double* A, size_t lda,
+			 const double* x, double* y)
+{
+  for (size_t j=0; j<n; ++j)
+    y[j] = scalar_dot(m, A+j*lda, x);
+}
+
+static void scalar_logsig(size_t n, const double* x, double* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] = 1.0 / (1.0 + simd_exp(-x[i]));
+}
+
+static void scalar_tansig(size_t n, const double* x, double* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] = 2.0 / (1.0 + simd_exp(-2.0*x[i])) - 1.0;
+}
+
+static float scalar_sdot(size_t n, const float* x, const float* y)
+{
+  float r = 0.0f;
+  for (size_t i=0; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+static void scalar_saxpy(size_t n, float a, const float* x, float* y)
+{
+  for (size_t i=0; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+static int scalar_i8dot(size_t n, const signed char* x, const signed char* y)
+{
+  int r = 0;
+  for (size_t i=0; i<n; ++i)
+    r += int(x[i]) * int(y[i]);
+  return r;
+}
+
+static void scalar_i8gemv(size_t m, size_t n, const signed char* A,
+			  const signed char* x, int* y)
+{
+  for (size_t i=0; i<m; ++i, A+=n)
+    y[i] = scalar_i8dot(n, A, x);
+}
+
+static const SimdKernels scalar_kernels = {
+  SimdScalar, "scalar",
+  scalar_dot, scalar_axpy, scalar_add, scalar_sub, scalar_scale,
+  scalar_gemv, scalar_gemvT,
+  scalar_logsig, scalar_tansig,
+  scalar_sdot, scalar_saxpy,
+  scalar_i8dot, scalar_i8gemv
+};
+
+#ifdef SIMD_X86
+
+//////////////////////////////////////////////////////////////////////
+// SSE2 kernels
+//////////////////////////////////////////////////////////////////////
+
+SIMD_TARGET("sse2")
+static double sse2_dot(size_t n, const double* x, const double* y)
+{
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  size_t i = 0;
+
+  for (; i+4<=n; i+=4) {
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2)));
+  }
+
+  double t[2];
+  _mm_storeu_pd(t, _mm_add_pd(s0, s1));
+  double r = t[0] + t[1];
+
+  for (; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+SIMD_TARGET("sse2")
+static void sse2_axpy(size_t n, double a, const double* x, double* y)
+{
+  __m128d va = _mm_set1_pd(a);
+  size_t i = 0;
+
+  for (; i+2<=n; i+=2)
+    _mm_storeu_pd(y+i, _mm_add_pd(_mm_loadu_pd(y+i),
+				  _mm_mul_pd(va, _mm_loadu_pd(x+i))));
+  for (; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+SIMD_TARGET("sse2")
+static void sse2_add(size_t n, const double* x, const double* y, double* z)
+{
+  size_t i = 0;
+  for (; i+2<=n; i+=2)
+    _mm_storeu_pd(z+i, _mm_add_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+  for (; i<n; ++i)
+    z[i] = x[i] + y[i];
+}
+
+SIMD_TARGET("sse2")
+static void sse2_sub(size_t n, const double* x, const double* y, double* z)
+{
+  size_t i = 0;
+  for (; i+2<=n; i+=2)
+    _mm_storeu_pd(z+i, _mm_sub_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+  for (; i<n; ++i)
+    z[i] = x[i] - y[i];
+}
+
+SIMD_TARGET("sse2")
+static void sse2_scale(size_t n, double a, const double* x, double* y)
+{
+  __m128d va = _mm_set1_pd(a);
+  size_t i = 0;
+  for (; i+2<=n; i+=2)
+    _mm_storeu_pd(y+i, _mm_mul_pd(va, _mm_loadu_pd(x+i)));
+  for (; i<n; ++i)
+    y[i] = a * x[i];
+}
+
+SIMD_TARGET("sse2")
+static void sse2_gemv(size_t m, size_t n, const double* A, size_t lda,
+		      const double* x, double* y)
+{
+  for (size_t i=0; i<m; ++i)
+    y[i] = 0.0;
+
+  for (size_t j=0; j<n; ++j)
+    sse2_axpy(m, x[j], A+j*lda, y);
+}
+
+SIMD_TARGET("sse2")
+static void sse2_gemvT(size_t m, size_t n, const double* A, size_t lda,
+		       const double* x, double* y)
+{
+  for (size_t j=0; j<n; ++j)
+    y[j] = sse2_dot(m, A+j*lda, x);
+}
+
+// Two exponentials (see simd_exp). SSE2 does not have a round
+// instruction, the conversion to int32 rounds to nearest.
+SIMD_TARGET("sse2")
+static __m128d sse2_exp(__m128d x)
+{
+  x = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(-EXP_MAX)), _mm_set1_pd(EXP_MAX));
+
+  __m128i ki = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(EXP_LOG2E)));
+  __m128d k = _mm_cvtepi32_pd(ki);
+  __m128d r = _mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(EXP_LN2_HI)));
+  r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(EXP_LN2_LO)));
+
+  __m128d p = _mm_set1_pd(exp_coef[EXP_DEGREE]);
+  for (int i=EXP_DEGREE-1; i>=0; --i)
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(exp_coef[i]));
+
+  // 2^k (k+1023 in the exponent bits)
+  __m128i e = _mm_add_epi32(ki, _mm_set1_epi32(1023));
+  e = _mm_slli_epi64(_mm_unpacklo_epi32(e, _mm_setzero_si128()), 52);
+  return _mm_mul_pd(p, _mm_castsi128_pd(e));
+}
+
+SIMD_TARGET("sse2")
+static void sse2_logsig(size_t n, const double* x, double* y)
+{
+  __m128d one = _mm_set1_pd(1.0);
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    __m128d e = sse2_exp(_mm_sub_pd(_mm_setzero_pd(), _mm_loadu_pd(x+i)));
+    _mm_storeu_pd(y+i, _mm_div_pd(one, _mm_add_pd(one, e)));
+  }
+  scalar_logsig(n-i, x+i, y+i);
+}
+
+SIMD_TARGET("sse2")
+static void sse2_tansig(size_t n, const double* x, double* y)
+{
+  __m128d one = _mm_set1_pd(1.0);
+  __m128d two = _mm_set1_pd(2.0);
+  size_t i = 0;
+  for (; i+2<=n; i+=2) {
+    __m128d e = sse2_exp(_mm_mul_pd(_mm_set1_pd(-2.0), _mm_loadu_pd(x+i)));
+    _mm_storeu_pd(y+i, _mm_sub_pd(_mm_div_pd(two, _mm_add_pd(one, e)), one));
+  }
+  scalar_tansig(n-i, x+i, y+i);
+}
+
+SIMD_TARGET("sse2")
+static float sse2_sdot(size_t n, const float* x, const float* y)
+{
+  __m128 s0 = _mm_setzero_ps();
+  __m128 s1 = _mm_setzero_ps();
+  size_t i = 0;
+
+  for (; i+8<=n; i+=8) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(y+i+4)));
+  }
+
+  float t[4];
+  _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+  float r = (t[0] + t[1]) + (t[2] + t[3]);
+
+  for (; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+SIMD_TARGET("sse2")
+static void sse2_saxpy(size_t n, float a, const float* x, float* y)
+{
+  __m128 va = _mm_set1_ps(a);
+  size_t i = 0;
+
+  for (; i+4<=n; i+=4)
+    _mm_storeu_ps(y+i, _mm_add_ps(_mm_loadu_ps(y+i),
+				  _mm_mul_ps(va, _mm_loadu_ps(x+i))));
+  for (; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+// Sign extension of the low/high 8-bit integers of v to 16 bits
+#define SSE2_I8_LO(v)	_mm_srai_epi16(_mm_unpacklo_epi8((v), (v)), 8)
+#define SSE2_I8_HI(v)	_mm_srai_epi16(_mm_unpackhi_epi8((v), (v)), 8)
+
+SIMD_TARGET("sse2")
+static int sse2_i8dot(size_t n, const signed char* x, const signed char* y)
+{
+  __m128i s = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i+16<=n; i+=16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(y+i));
+    s = _mm_add_epi32(s, _mm_madd_epi16(SSE2_I8_LO(a), SSE2_I8_LO(b)));
+    s = _mm_add_epi32(s, _mm_madd_epi16(SSE2_I8_HI(a), SSE2_I8_HI(b)));
+  }
+
+  int t[4];
+  _mm_storeu_si128((__m128i*)t, s);
+  int r = t[0] + t[1] + t[2] + t[3];
+
+  for (; i<n; ++i)
+    r += int(x[i]) * int(y[i]);
+  return r;
+}
+
+SIMD_TARGET("sse2")
+static void sse2_i8gemv(size_t m, size_t n, const signed char* A,
+			const signed char* x, int* y)
+{
+  for (size_t i=0; i<m; ++i, A+=n)
+    y[i] = sse2_i8dot(n, A, x);
+}
+
+static const SimdKernels sse2_kernels = {
+  SimdSSE2, "sse2",
+  sse2_dot, sse2_axpy, sse2_add, sse2_sub, sse2_scale,
+  sse2_gemv, sse2_gemvT,
+  sse2_logsig, sse2_tansig,
+  sse2_sdot, sse2_saxpy,
+  sse2_i8dot, sse2_i8gemv
+};
+
+//////////////////////////////////////////////////////////////////////
+// AVX2 + FMA kernels
+//////////////////////////////////////////////////////////////////////
+
+SIMD_TARGET("avx2,fma")
+static double avx2_hsum(__m256d v)
+{
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+  lo = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+SIMD_TARGET("avx2,fma")
+static double avx2_dot(size_t n, const double* x, const double* y)
+{
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd();
+  __m256d s3 = _mm256_setzero_pd();
+  size_t i = 0;
+
+  for (; i+16<=n; i+=16) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i),    _mm256_loadu_pd(y+i),    s0);
+    s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+4),  _mm256_loadu_pd(y+i+4),  s1);
+    s2 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+8),  _mm256_loadu_pd(y+i+8),  s2);
+    s3 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+12), _mm256_loadu_pd(y+i+12), s3);
+  }
+  for (; i+4<=n; i+=4)
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i), s0);
+
+  double r = avx2_hsum(_mm256_add_pd(_mm256_add_pd(s0, s1),
+				     _mm256_add_pd(s2, s3)));
+  for (; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_axpy(size_t n, double a, const double* x, double* y)
+{
+  __m256d va = _mm256_set1_pd(a);
+  size_t i = 0;
+
+  for (; i+4<=n; i+=4)
+    _mm256_storeu_pd(y+i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x+i),
+					  _mm256_loadu_pd(y+i)));
+  for (; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_add(size_t n, const double* x, const double* y, double* z)
+{
+  size_t i = 0;
+  for (; i+4<=n; i+=4)
+    _mm256_storeu_pd(z+i, _mm256_add_pd(_mm256_loadu_pd(x+i),
+					_mm256_loadu_pd(y+i)));
+  for (; i<n; ++i)
+    z[i] = x[i] + y[i];
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_sub(size_t n, const double* x, const double* y, double* z)
+{
+  size_t i = 0;
+  for (; i+4<=n; i+=4)
+    _mm256_storeu_pd(z+i, _mm256_sub_pd(_mm256_loadu_pd(x+i),
+					_mm256_loadu_pd(y+i)));
+  for (; i<n; ++i)
+    z[i] = x[i] - y[i];
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_scale(size_t n, double a, const double* x, double* y)
+{
+  __m256d va = _mm256_set1_pd(a);
+  size_t i = 0;
+  for (; i+4<=n; i+=4)
+    _mm256_storeu_pd(y+i, _mm256_mul_pd(va, _mm256_loadu_pd(x+i)));
+  for (; i<n; ++i)
+    y[i] = a * x[i];
+}
+
+// Four columns are added to "y" in each pass (so "y" is loaded and
+// stored four times less than with one axpy per column).
+SIMD_TARGET("avx2,fma")
+static void avx2_gemv(size_t m, size_t n, const double* A, size_t lda,
+		      const double* x, double* y)
+{
+  size_t i, j = 0;
+
+  for (i=0; i<m; ++i)
+    y[i] = 0.0;
+
+  for (; j+4<=n; j+=4) {
+    const double* c0 = A + j*lda;
+    const double* c1 = c0 + lda;
+    const double* c2 = c1 + lda;
+    const double* c3 = c2 + lda;
+    __m256d x0 = _mm256_set1_pd(x[j]);
+    __m256d x1 = _mm256_set1_pd(x[j+1]);
+    __m256d x2 = _mm256_set1_pd(x[j+2]);
+    __m256d x3 = _mm256_set1_pd(x[j+3]);
+
+    for (i=0; i+4<=m; i+=4) {
+      __m256d v = _mm256_loadu_pd(y+i);
+      v = _mm256_fmadd_pd(_mm256_loadu_pd(c0+i), x0, v);
+      v = _mm256_fmadd_pd(_mm256_loadu_pd(c1+i), x1, v);
+      v = _mm256_fmadd_pd(_mm256_loadu_pd(c2+i), x2, v);
+      v = _mm256_fmadd_pd(_mm256_loadu_pd(c3+i), x3, v);
+      _mm256_storeu_pd(y+i, v);
+    }
+    for (; i<m; ++i)
+      y[i] += c0[i]*x[j] + c1[i]*x[j+1] + c2[i]*x[j+2] + c3[i]*x[j+3];
+  }
+
+  for (; j<n; ++j)
+    avx2_axpy(m, x[j], A+j*lda, y);
+}
+
+// Four dot products (four columns) for each load of "x".
+SIMD_TARGET("avx2,fma")
+static void avx2_gemvT(size_t m, size_t n, const double* A, size_t lda,
+		       const double* x, double* y)
+{
+  size_t i, j = 0;
+
+  for (; j+4<=n; j+=4) {
+    const double* c0 = A + j*lda;
+    const double* c1 = c0 + lda;
+    const double* c2 = c1 + lda;
+    const double* c3 = c2 + lda;
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+
+    for (i=0; i+4<=m; i+=4) {
+      __m256d v = _mm256_loadu_pd(x+i);
+      s0 = _mm256_fmadd_pd(_mm256_loadu_pd(c0+i), v, s0);
+      s1 = _mm256_fmadd_pd(_mm256_loadu_pd(c1+i), v, s1);
+      s2 = _mm256_fmadd_pd(_mm256_loadu_pd(c2+i), v, s2);
+      s3 = _mm256_fmadd_pd(_mm256_loadu_pd(c3+i), v, s3);
+    }
+
+    double r0 = avx2_hsum(s0), r1 = avx2_hsum(s1);
+    double r2 = avx2_hsum(s2), r3 = avx2_hsum(s3);
+    for (; i<m; ++i) {
+      r0 += c0[i] * x[i];
+      r1 += c1[i] * x[i];
+      r2 += c2[i] * x[i];
+      r3 += c3[i] * x[i];
+    }
+    y[j] = r0; y[j+1] = r1; y[j+2] = r2; y[j+3] = r3;
+  }
+
+  for (; j<n; ++j)
+    y[j] = avx2_dot(m, A+j*lda, x);
+}
+
+// Four exponentials (see simd_exp)
+SIMD_TARGET("avx2,fma")
+static __m256d avx2_exp(__m256d x)
+{
+  x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-EXP_MAX)),
+		    _mm256_set1_pd(EXP_MAX));
+
+  __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(EXP_LOG2E)),
+			      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(EXP_LN2_HI), x);
+  r = _mm256_fnmadd_pd(k, _mm256_set1_pd(EXP_LN2_LO), r);
+
+  __m256d p = _mm256_set1_pd(exp_coef[EXP_DEGREE]);
+  for (int i=EXP_DEGREE-1; i>=0; --i)
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_coef[i]));
+
+  // 2^k (k+1023 in the exponent bits)
+  __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+  e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+  return _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_logsig(size_t n, const double* x, double* y)
+{
+  __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256d e = avx2_exp(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(x+i)));
+    _mm256_storeu_pd(y+i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+  }
+  scalar_logsig(n-i, x+i, y+i);
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_tansig(size_t n, const double* x, double* y)
+{
+  __m256d one = _mm256_set1_pd(1.0);
+  __m256d two = _mm256_set1_pd(2.0);
+  size_t i = 0;
+  for (; i+4<=n; i+=4) {
+    __m256d e = avx2_exp(_mm256_mul_pd(_mm256_set1_pd(-2.0), _mm256_loadu_pd(x+i)));
+    _mm256_storeu_pd(y+i, _mm256_sub_pd(_mm256_div_pd(two, _mm256_add_pd(one, e)), one));
+  }
+  scalar_tansig(n-i, x+i, y+i);
+}
+
+SIMD_TARGET("avx2,fma")
+static float avx2_sdot(size_t n, const float* x, const float* y)
+{
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  size_t i = 0;
+
+  for (; i+16<=n; i+=16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i),   _mm256_loadu_ps(y+i),   s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i+8), _mm256_loadu_ps(y+i+8), s1);
+  }
+  for (; i+8<=n; i+=8)
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i), s0);
+
+  __m256 s = _mm256_add_ps(s0, s1);
+  __m128 v = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  float r = _mm_cvtss_f32(v);
+
+  for (; i<n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+SIMD_TARGET("avx2,fma")
+static void avx2_saxpy(size_t n, float a, const float* x, float* y)
+{
+  __m256 va = _mm256_set1_ps(a);
+  size_t i = 0;
+
+  for (; i+8<=n; i+=8)
+    _mm256_storeu_ps(y+i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x+i),
+					  _mm256_loadu_ps(y+i)));
+  for (; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+SIMD_TARGET("avx2,fma")
+static int avx2_i8dot(size_t n, const signed char* x, const signed char* y)
+{
+  __m256i s = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for (; i+16<=n; i+=16) {
+    __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x+i)));
+    __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(y+i)));
+    s = _mm256_add_epi32(s, _mm256_madd_epi16(a, b));
+  }
+
+  __m128i v = _mm_add_epi32(_mm256_castsi256_si128(s),
+			    _mm256_extracti128_si256(s, 1));
+  int t[4];
+  _mm_storeu_si128((__m128i*)t, v);
+  int r = t[0] + t[1] + t[2] + t[3];
+
+  for (; i<n; ++i)
+    r += int(x[i]) * int(y[i]);
+  return r;
+}
+
+// Four rows at once: each 16 elements of x are loaded one time, and
+// the four sums are reduced together
+SIMD_TARGET("avx2,fma")
+static void avx2_i8gemv(size_t m, size_t n, const signed char* A,
+			const signed char* x, int* y)
+{
+  size_t i = 0;
+
+  for (; i+4<=m; i+=4, A+=4*n) {
+    __m256i s0 = _mm256_setzero_si256();
+    __m256i s1 = _mm256_setzero_si256();
+    __m256i s2 = _mm256_setzero_si256();
+    __m256i s3 = _mm256_setzero_si256();
+    size_t j = 0;
+
+    for (; j+16<=n; j+=16) {
+      __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x+j)));
+#define AVX2_I8_ROW(s, r)						\
+      s = _mm256_add_epi32(s, _mm256_madd_epi16(b, _mm256_cvtepi8_epi16( \
+	    _mm_loadu_si128((const __m128i*)(A+(r)*n+j)))))
+      AVX2_I8_ROW(s0, 0);
+      AVX2_I8_ROW(s1, 1);
+      AVX2_I8_ROW(s2, 2);
+      AVX2_I8_ROW(s3, 3);
+#undef AVX2_I8_ROW
+    }
+
+    // Horizontal sums of the four accumulators
+    __m256i s01 = _mm256_hadd_epi32(s0, s1);
+    __m256i s23 = _mm256_hadd_epi32(s2, s3);
+    __m256i s0123 = _mm256_hadd_epi32(s01, s23);
+    __m128i v = _mm_add_epi32(_mm256_castsi256_si128(s0123),
+			      _mm256_extracti128_si256(s0123, 1));
+    _mm_storeu_si128((__m128i*)(y+i), v);
+
+    for (; j<n; ++j)
+      for (size_t r=0; r<4; ++r)
+	y[i+r] += int(A[r*n+j]) * int(x[j]);
+  }
+
+  for (; i<m; ++i, A+=n)
+    y[i] = avx2_i8dot(n, A, x);
+}
+
+static const SimdKernels avx2_kernels = {
+  SimdAVX2, "avx2",
+  avx2_dot, avx2_axpy, avx2_add, avx2_sub, avx2_scale,
+  avx2_gemv, avx2_gemvT,
+  avx2_logsig, avx2_tansig,
+  avx2_sdot, avx2_saxpy,
+  avx2_i8dot, avx2_i8gemv
+};
+
+#endif // SIMD_X86
+
+//////////////////////////////////////////////////////////////////////
+// CPU detection
+//////////////////////////////////////////////////////////////////////
+
+static bool cpu_supports(SimdLevel level)
+{
+  switch (level) {
+
+    case SimdScalar:
+      return true;
+
+#if defined(SIMD_X86) && defined(__GNUC__)
+    case SimdSSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2");
+
+    case SimdAVX2:
+      __builtin_cpu_init();
+      return (__builtin_cpu_supports("avx2") &&
+	      __builtin_cpu_supports("fma"));
+#elif defined(SIMD_X86) && defined(_MSC_VER)
+    case SimdSSE2: {
+      int info[4];
+      __cpuid(info, 1);
+      return (info[3] & (1<<26)) != 0;
+    }
+
+    case SimdAVX2: {
+      int info[4];
+      __cpuid(info, 1);
+      bool fma = (info[2] & (1<<12)) != 0;
+      bool osxsave = (info[2] & (1<<27)) != 0;
+      if (!fma || !osxsave)
+	return false;
+
+      // The OS has to save the YMM registers
+      if ((_xgetbv(0) & 6) != 6)
+	return false;
+
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1<<5)) != 0;
+    }
+#endif
+
+    default:
+      return false;
+  }
+}
+
+/// Returns the implementation of the kernels for the specified
+/// instruction set, or NULL if the CPU does not support it.
+///
+const SimdKernels* simd_kernels(SimdLevel level)
+{
+  if (!cpu_supports(level))
+    return NULL;
+
+  switch (level) {
+#ifdef SIMD_X86
+    case SimdSSE2: return &sse2_kernels;
+    case SimdAVX2: return &avx2_kernels;
+#endif
+    default:
+      return &scalar_kernels;
+  }
+}
+
+static const SimdKernels* best_kernels()
+{
+  const SimdKernels* kernels;
+  if ((kernels = simd_kernels(SimdAVX2)) ||
+      (kernels = simd_kernels(SimdSSE2)))
+    return kernels;
+  return &scalar_kernels;
+}
+
+// The kernels are selected at startup (when this global variable is
+// initialized), anyway simd() checks it in case that another global
+// object needs the kernels before.
+static const SimdKernels* g_kernels = best_kernels();
+
+/// Returns the kernels used by Vector and Matrix.
+///
+const SimdKernels& simd()
+{
+  if (!g_kernels)
+    g_kernels = best_kernels();
+  return *g_kernels;
+}
+
+/// Changes the kernels used by Vector and Matrix.
+///
+/// @return false if the CPU does not support the specified level.
+///
+bool simd_select(SimdLevel level)
+{
+  const SimdKernels* kernels = simd_kernels(level);
+  if (kernels)
+    g_kernels = kernels;
+  return kernels != NULL;
+}
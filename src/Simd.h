@@ -0,0 +1,87 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_SIMD_H
+#define LOSEFACE_SIMD_H
+
+#include <cstddef>
+
+/// Instruction sets that can be used by the vector kernels.
+///
+enum SimdLevel {
+  SimdScalar,			// plain C++ (always available)
+  SimdSSE2,			// x86 SSE2
+  SimdAVX2			// x86 AVX2 + FMA
+};
+
+/// Low level routines over arrays of doubles used by Vector and
+/// Matrix. All matrices are stored column by column (@a lda is the
+/// distance between two columns).
+///
+/// Element-wise routines (add, sub, scale) give exactly the same
+/// results in all implementations. Routines that accumulate (dot,
+/// axpy, gemv, gemvT) can use fused multiply-adds or a different
+/// order of additions, so results can differ in the last bits.
+///
+/// The activation routines (logsig, tansig) use a polynomial
+/// approximation of exp (see simd_exp), its error is less than 1e-13
+/// relative to std::exp.
+///
+struct SimdKernels
+{
+  SimdLevel level;
+  const char* name;
+
+  /// Returns x^T*y.
+  double (*dot)(size_t n, const double* x, const double* y);
+
+  /// y = a*x + y
+  void (*axpy)(size_t n, double a, const double* x, double* y);
+
+  /// z = x + y (z can be x or y)
+  void (*add)(size_t n, const double* x, const double* y, double* z);
+
+  /// z = x - y (z can be x or y)
+  void (*sub)(size_t n, const double* x, const double* y, double* z);
+
+  /// y = a*x (y can be x)
+  void (*scale)(size_t n, double a, const double* x, double* y);
+
+  /// y = A*x, where A is a @a m x @a n matrix.
+  void (*gemv)(size_t m, size_t n, const double* A, size_t lda,
+	       const double* x, double* y);
+
+  /// y = A^T*x, where A is a @a m x @a n matrix.
+  void (*gemvT)(size_t m, size_t n, const double* A, size_t lda,
+		const double* x, double* y);
+
+  /// y = 1/(1+exp(-x)) (y can be x)
+  void (*logsig)(size_t n, const double* x, double* y);
+
+  /// y = tanh(x) = 2/(1+exp(-2x)) - 1 (y can be x)
+  void (*tansig)(size_t n, const double* x, double* y);
+
+  /// Single precision x^T*y.
+  float (*sdot)(size_t n, const float* x, const float* y);
+
+  /// Single precision y = a*x + y
+  void (*saxpy)(size_t n, float a, const float* x, float* y);
+
+  /// x^T*y of 8-bit integers accumulated in 32-bit integers (it is
+  /// exact in all implementations while n < 2^31/127^2).
+  int (*i8dot)(size_t n, const signed char* x, const signed char* y);
+
+  /// y = A*x of 8-bit integers, where A is a @a m x @a n matrix
+  /// stored row by row (each y[i] is i8dot of the row i and x).
+  void (*i8gemv)(size_t m, size_t n, const signed char* A,
+		 const signed char* x, int* y);
+};
+
+const SimdKernels& simd();
+const SimdKernels* simd_kernels(SimdLevel level);
+bool simd_select(SimdLevel level);
+double simd_exp(double x);
+
+#endif // LOSEFACE_SIMD_H
@@ -0,0 +1,167 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_THREAD_H
+#define LOSEFACE_THREAD_H
+
+#include <cstddef>
+
+//////////////////////////////////////////////////////////////////////
+//  For Windows
+
+#ifdef _WIN32
+
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+
+  /// Runs a function in a new thread. The thread starts in the
+  /// constructor and the destructor waits it (if #join was not called
+  /// before). If the thread cannot be created the function is called
+  /// in the constructor.
+  ///
+  class Thread
+  {
+  public:
+    typedef void (*Function)(void* data);
+
+  private:
+    HANDLE m_handle;
+    Function m_function;
+    void* m_data;
+
+    static DWORD WINAPI proc(LPVOID self) {
+      ((Thread*)self)->m_function(((Thread*)self)->m_data);
+      return 0;
+    }
+
+  public:
+
+    Thread(Function function, void* data)
+      : m_function(function)
+      , m_data(data) {
+      m_handle = CreateThread(NULL, 0, &Thread::proc, this, 0, NULL);
+
+      // If the thread cannot be created, the work is done anyway
+      if (!m_handle)
+	m_function(m_data);
+    }
+
+    ~Thread() {
+      join();
+    }
+
+    void join() {
+      if (m_handle) {
+	WaitForSingleObject(m_handle, INFINITE);
+	CloseHandle(m_handle);
+	m_handle = NULL;
+      }
+    }
+
+    /// Returns the number of processors available.
+    static size_t processors() {
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors: 1;
+    }
+
+  private:
+    // Non-copyable
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+  };
+
+  /// A mutual exclusion lock to share data between threads.
+  ///
+  class Mutex
+  {
+    CRITICAL_SECTION m_section;
+
+  public:
+    Mutex() { InitializeCriticalSection(&m_section); }
+    ~Mutex() { DeleteCriticalSection(&m_section); }
+
+    void lock() { EnterCriticalSection(&m_section); }
+    void unlock() { LeaveCriticalSection(&m_section); }
+
+  private:
+    // Non-copyable
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+  };
+
+#else  // For UNIX like
+
+  #include <pthread.h>
+  #include <unistd.h>
+
+  class Thread
+  {
+  public:
+    typedef void (*Function)(void* data);
+
+  private:
+    pthread_t m_thread;
+    bool m_running;
+    Function m_function;
+    void* m_data;
+
+    static void* proc(void* self) {
+      ((Thread*)self)->m_function(((Thread*)self)->m_data);
+      return NULL;
+    }
+
+  public:
+
+    Thread(Function function, void* data)
+      : m_function(function)
+      , m_data(data) {
+      m_running = (pthread_create(&m_thread, NULL, &Thread::proc, this) == 0);
+      if (!m_running)
+	m_function(m_data);
+    }
+
+    ~Thread() {
+      join();
+    }
+
+    void join() {
+      if (m_running) {
+	pthread_join(m_thread, NULL);
+	m_running = false;
+      }
+    }
+
+    static size_t processors() {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      return n > 0 ? n: 1;
+    }
+
+  private:
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+  };
+
+  class Mutex
+  {
+    pthread_mutex_t m_mutex;
+
+  public:
+    Mutex() { pthread_mutex_init(&m_mutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&m_mutex); }
+
+    void lock() { pthread_mutex_lock(&m_mutex); }
+    void unlock() { pthread_mutex_unlock(&m_mutex); }
+
+  private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+  };
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+
+#endif // LOSEFACE_THREAD_H
@@ -5,35 +5,66 @@
 
 #include "Vector.h"
 #include "Matrix.h"
+#include "Blas.h"
+#include "Scalar.h"
+#include "Simd.h"
 #include "approx_eq.h"
 
-Vector::Vector()
+// The SIMD kernels are for double, float vectors use plain loops.
+
+static void scale_elements(size_t n, double s, double* x)
+{
+  simd().scale(n, s, x, x);
+}
+
+static void scale_elements(size_t n, float s, float* x)
+{
+  for (size_t i=0; i<n; ++i)
+    x[i] *= s;
+}
+
+static void add_elements(size_t n, double s, const double* x, double* y)
+{
+  if (s == 1.0)
+    simd().add(n, y, x, y);
+  else if (s == -1.0)
+    simd().sub(n, y, x, y);
+  else
+    blas_axpy(n, s, x, y);
+}
+
+static void add_elements(size_t n, float s, const float* x, float* y)
+{
+  blas_axpy(n, s, x, y);
+}
+
+template<class T>
+VectorT<T>::VectorT()
 {
   m_data.resize(1);
 }
 
-Vector::Vector(size_t n)
+template<class T>
+VectorT<T>::VectorT(size_t n)
 {
   assert(n >= 1);
   m_data.resize(n);
 }
 
-Vector::Vector(const Vector& u)
+template<class T>
+VectorT<T>::VectorT(const VectorT& u)
 {
   m_data = u.m_data;
 }
 
-double Vector::magnitude() const
+template<class T>
+double VectorT<T>::magnitude() const
 {
-  double sq_sum = 0.0;
-
-  for (size_t i=0; i<size(); ++i)
-    sq_sum += m_data[i]*m_data[i];
-
-  return std::sqrt(sq_sum);
+  return std::sqrt(double(blas_dot(size(), getRaw(), getRaw())));
 }
 
-double Vector::mean() const
+template<class T>
+double VectorT<T>::mean() const
 {
   double result = 0.0;
 
@@ -43,22 +74,25 @@ double Vector::mean() const
   return result / double(size());
 }
 
-Vector& Vector::resize(size_t n)
+template<class T>
+VectorT<T>& VectorT<T>::resize(size_t n)
 {
   assert(n >= 1);
   m_data.resize(n);
   return *this;
 }
 
-Vector& Vector::zero()
+template<class T>
+VectorT<T>& VectorT<T>::zero()
 {
-  std::fill(m_data.begin(), m_data.end(), double(0));
+  std::fill(m_data.begin(), m_data.end(), T(0));
   return *this;
 }
 
-double Vector::getMin() const
+template<class T>
+T VectorT<T>::getMin() const
 {
-  double a = m_data[0];
+  T a = m_data[0];
 
   for (size_t i=1; i<size(); ++i)
     if (a > m_data[i])
@@ -67,9 +101,10 @@ double Vector::getMin() const
   return a;
 }
 
-double Vector::getMax() const
+template<class T>
+T VectorT<T>::getMax() const
 {
-  double a = m_data[0];
+  T a = m_data[0];
 
   for (size_t i=1; i<size(); ++i)
     if (a < m_data[i])
@@ -78,10 +113,11 @@ double Vector::getMax() const
   return a;
 }
 
-size_t Vector::getMinPos() const
+template<class T>
+size_t VectorT<T>::getMinPos() const
 {
   size_t k = 0;
-  double a = m_data[0];
+  T a = m_data[0];
 
   for (size_t i=1; i<size(); ++i)
     if (a > m_data[i])
@@ -90,10 +126,11 @@ size_t Vector::getMinPos() const
   return k;
 }
 
-size_t Vector::getMaxPos() const
+template<class T>
+size_t VectorT<T>::getMaxPos() const
 {
   size_t k = 0;
-  double a = m_data[0];
+  T a = m_data[0];
 
   for (size_t i=1; i<size(); ++i)
     if (a < m_data[i])
@@ -102,9 +139,10 @@ size_t Vector::getMaxPos() const
   return k;
 }
 
-Matrix Vector::diagonalMatrix() const
+template<class T>
+MatrixT<T> VectorT<T>::diagonalMatrix() const
 {
-  Matrix A(size(), size());
+  MatrixT<T> A(size(), size());
   A.zero();
 
   for (size_t i=0; i<size(); ++i)
@@ -113,41 +151,22 @@ Matrix Vector::diagonalMatrix() const
   return A;
 }
 
-Vector& Vector::operator=(const Vector& u)
+template<class T>
+VectorT<T>& VectorT<T>::operator=(const VectorT& u)
 {
   m_data = u.m_data;
   return *this;
 }
 
-Vector& Vector::operator+=(const Vector& u)
+template<class T>
+VectorT<T>& VectorT<T>::operator*=(T s)
 {
-  assert(size() == u.size());
-
-  for (size_t i=0; i<size(); ++i)
-    m_data[i] += u.m_data[i];
-
-  return *this;
-}
-
-Vector& Vector::operator-=(const Vector& u)
-{
-  assert(size() == u.size());
-
-  for (size_t i=0; i<size(); ++i)
-    m_data[i] -= u.m_data[i];
-
+  scale_elements(size(), s, getRaw());
   return *this;
 }
 
-Vector& Vector::operator*=(double s)
-{
-  for (size_t i=0; i<size(); ++i)
-    m_data[i] *= s;
-
-  return *this;
-}
-
-Vector& Vector::operator/=(double s)
+template<class T>
+VectorT<T>& VectorT<T>::operator/=(T s)
 {
   for (size_t i=0; i<size(); ++i)
     m_data[i] /= s;
@@ -155,60 +174,15 @@ Vector& Vector::operator/=(double s)
   return *this;
 }
 
-Vector Vector::operator*(double s) const
-{
-  Vector w(size());
-
-  for (size_t i=0; i<size(); ++i)
-    w.m_data[i] = s * m_data[i];
-
-  return w;
-}
-
-Vector Vector::operator/(double s) const
-{
-  Vector w(size());
-
-  for (size_t i=0; i<size(); ++i)
-    w.m_data[i] = m_data[i] / s;
-
-  return w;
-}
-
-Vector Vector::operator+(const Vector& u) const
+template<class T>
+T VectorT<T>::operator*(const VectorT& u) const
 {
   assert(size() == u.size());
-  Vector w(size());
-
-  for (size_t i=0; i<size(); ++i)
-    w.m_data[i] = m_data[i] + u.m_data[i];
-
-  return w;
-}
-
-Vector Vector::operator-(const Vector& u) const
-{
-  assert(size() == u.size());
-  Vector w(size());
-
-  for (size_t i=0; i<size(); ++i)
-    w.m_data[i] = m_data[i] - u.m_data[i];
-
-  return w;
+  return blas_dot(size(), getRaw(), u.getRaw());
 }
 
-double Vector::operator*(const Vector& u) const
-{
-  assert(size() == u.size());
-  double dot_product = 0.0;
-
-  for (size_t i=0; i<size(); ++i)
-    dot_product += m_data[i] * u.m_data[i];
-
-  return dot_product;
-}
-
-bool Vector::operator==(const Vector& u) const
+template<class T>
+bool VectorT<T>::operator==(const VectorT& u) const
 {
   if (size() != u.size())
     return false;
@@ -220,46 +194,71 @@ bool Vector::operator==(const Vector& u) const
   return true;
 }
 
-bool Vector::operator!=(const Vector& u) const
+template<class T>
+bool VectorT<T>::operator!=(const VectorT& u) const
 {
   return !operator==(u);
 }
 
+//////////////////////////////////////////////////////////////////////
+// Expressions
+//////////////////////////////////////////////////////////////////////
+
+template<class T>
+void VectorT<T>::assignTo(T* dst) const
+{
+  std::copy(m_data.begin(), m_data.end(), dst);
+}
+
+template<class T>
+void VectorT<T>::addTo(T* dst, T s) const
+{
+  add_elements(size(), s, getRaw(), dst);
+}
+
 //////////////////////////////////////////////////////////////////////
 // Binary I/O
 //////////////////////////////////////////////////////////////////////
 
-void Vector::save(const char* filename) const
+template<class T>
+void VectorT<T>::save(const char* filename) const
 {
   std::ofstream f(filename, std::ios::binary);
   write(f);
 }
 
-void Vector::load(const char* filename)
+template<class T>
+void VectorT<T>::load(const char* filename)
 {
   std::ifstream f(filename, std::ios::binary);
   read(f);
 }
 
-void Vector::write(std::ostream& s) const
+/// Writes the vector, the size is tagged with the scalar type (see
+/// write_scalar_size).
+///
+template<class T>
+void VectorT<T>::write(std::ostream& s) const
 {
   size_t n = size();
-  s.write((char*)&n, sizeof(size_t));
-  s.write((char*)getRaw(), sizeof(double)*n);
+  write_scalar_size<T>(s, n);
+  s.write((char*)getRaw(), sizeof(T)*n);
 }
 
-void Vector::read(std::istream& s)
+/// Reads a vector saved with any scalar type (elements are converted
+/// to @a T).
+///
+template<class T>
+void VectorT<T>::read(std::istream& s)
 {
-  size_t n;
-  s.read((char*)&n, sizeof(size_t));
+  ScalarType type;
+  size_t n = read_scalar_size(s, type);
   resize(n);
-  s.read((char*)getRaw(), sizeof(double)*n);
+  read_scalars(s, type, getRaw(), n);
 }
 
-Vector operator*(double s, const Vector& u)
-{
-  return u.operator*(s);
-}
+template class VectorT<double>;
+template class VectorT<float>;
 
 bool approx_eq(const Vector& u, const Vector& v, unsigned precision)
 {
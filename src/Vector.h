@@ -14,17 +14,31 @@
 #include <fstream>
 
 #include "approx_eq.h"
-
-class Matrix;
-
-class Vector
+#include "Expr.h"
+
+template<class T> class MatrixT;
+template<class T> class VectorT;
+
+typedef VectorT<double> Vector;
+typedef MatrixT<double> Matrix;
+
+/// A vector of @a T elements (double or float).
+///
+/// Vector (double) is the general type, with expressions (see
+/// Expr.h) and views. VectorT<float> stores data in single precision
+/// (half the memory and memory bandwidth): it has the same storage,
+/// I/O and BLAS operations, but not expressions.
+///
+template<class T>
+class VectorT : public VectorExpr<VectorT<T> >
 {
 public:
-  typedef std::vector<double>::iterator iterator;
-  typedef std::vector<double>::const_iterator const_iterator;
+  typedef T value_type;
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
 
 private:
-  std::vector<double> m_data;	        // values of each element in the vector
+  std::vector<T> m_data;	        // values of each element in the vector
 
 public:
   iterator begin() { return m_data.begin(); }
@@ -32,48 +46,99 @@ public:
   const_iterator begin() const { return m_data.begin(); }
   const_iterator end() const { return m_data.end(); }
 
-  Vector();
-  explicit Vector(size_t n);
-  Vector(const Vector& u);
+  VectorT();
+  explicit VectorT(size_t n);
+  VectorT(const VectorT& u);
 
-  double* getRaw() { return &m_data[0]; }
-  const double* getRaw() const { return &m_data[0]; }
+  /// Creates a vector evaluating the given expression (e.g. "u + v").
+  template<class E>
+  VectorT(const VectorExpr<E>& expr) : m_data(expr.self().size()) {
+    expr.self().assignTo(getRaw());
+  }
+
+  T* getRaw() { return &m_data[0]; }
+  const T* getRaw() const { return &m_data[0]; }
 
   size_t size() const { return m_data.size(); }
 
   double magnitude() const;
   double mean() const;
-  Vector& resize(size_t n);
-  Vector& zero();
-  double getMin() const;
-  double getMax() const;
+  VectorT& resize(size_t n);
+  VectorT& zero();
+  T getMin() const;
+  T getMax() const;
   size_t getMinPos() const;
   size_t getMaxPos() const;
-  Matrix diagonalMatrix() const;
-
-  Vector& operator=(const Vector& u);
-  Vector& operator+=(const Vector& u);
-  Vector& operator-=(const Vector& u);
-  Vector& operator*=(double s);
-  Vector& operator/=(double s);
-  Vector operator*(double s) const;
-  Vector operator/(double s) const;
-  Vector operator+(const Vector& u) const;
-  Vector operator-(const Vector& u) const;
-  double operator*(const Vector& u) const;
-  bool operator==(const Vector& u) const;
-  bool operator!=(const Vector& u) const;
-
-  inline double& operator()(size_t i) {
+  MatrixT<T> diagonalMatrix() const;
+
+  /// Copies (and converts) the elements of a vector of other type.
+  template<class U>
+  VectorT& assign(const VectorT<U>& u) {
+    m_data.assign(u.begin(), u.end());
+    return *this;
+  }
+
+  VectorT& operator=(const VectorT& u);
+  VectorT& operator*=(T s);
+  VectorT& operator/=(T s);
+  T operator*(const VectorT& u) const;
+  bool operator==(const VectorT& u) const;
+  bool operator!=(const VectorT& u) const;
+
+  inline T& operator()(size_t i) {
     assert(i >= 0 && i < size());
     return m_data[i];
   }
 
-  inline const double& operator()(size_t i) const {
+  inline const T& operator()(size_t i) const {
     assert(i >= 0 && i < size());
     return m_data[i];
   }
 
+  //////////////////////////////////////////////////////////////////////
+  // Expressions (see Expr.h)
+  //////////////////////////////////////////////////////////////////////
+
+  enum { elementwise = true };
+
+  T operator[](size_t i) const { return m_data[i]; }
+
+  bool aliases(const T* first, const T* last) const {
+    return getRaw() < last && first < getRaw()+size();
+  }
+
+  void assignTo(T* dst) const;
+  void addTo(T* dst, T s) const;
+
+  // Element-wise expressions can be evaluated directly over this
+  // vector even if they use it (e.g. "u = u + v") because each
+  // element is read only to calculate itself. Other expressions
+  // (e.g. "u = A * u") are evaluated in a temporary vector.
+
+  template<class E>
+  VectorT& operator=(const VectorExpr<E>& expr) {
+    const E& e = expr.self();
+    if (!E::elementwise && e.aliases(getRaw(), getRaw()+size())) {
+      VectorT tmp(e);
+      m_data.swap(tmp.m_data);
+    }
+    else {
+      m_data.resize(e.size());
+      e.assignTo(getRaw());
+    }
+    return *this;
+  }
+
+  template<class E>
+  VectorT& operator+=(const VectorExpr<E>& expr) {
+    return addExpr(expr.self(), 1.0);
+  }
+
+  template<class E>
+  VectorT& operator-=(const VectorExpr<E>& expr) {
+    return addExpr(expr.self(), -1.0);
+  }
+
   //////////////////////////////////////////////////////////////////////
   // Binary I/O
   //////////////////////////////////////////////////////////////////////
@@ -83,9 +148,65 @@ public:
   void write(std::ostream& s) const;
   void read(std::istream& s);
 
-}; // class Vector
+private:
+
+  template<class E>
+  VectorT& addExpr(const E& e, T s) {
+    assert(size() == e.size());
+    if (!E::elementwise && e.aliases(getRaw(), getRaw()+size())) {
+      VectorT tmp(e);
+      tmp.addTo(getRaw(), s);
+    }
+    else
+      e.addTo(getRaw(), s);
+    return *this;
+  }
+
+}; // class VectorT
+
+/// Returns @a u with elements of type @a T: @a u itself for double,
+/// or a converted copy in @a tmp (e.g. a pattern for a float Mlp).
+///
+template<class T>
+inline const VectorT<T>& convert_vector(const Vector& u, VectorT<T>& tmp)
+{
+  tmp.assign(u);
+  return tmp;
+}
+
+template<>
+inline const Vector& convert_vector(const Vector& u, Vector&)
+{
+  return u;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Dot product of expressions (e.g. "A.getCol(k) * (u - v)")
+//////////////////////////////////////////////////////////////////////
+
+template<class L, class R>
+inline double expr_dot(const L& l, const R& r, ExprTag<true>)
+{
+  assert(l.size() == r.size());
+  double result = 0.0;
+  for (size_t i=0, n=l.size(); i<n; ++i)
+    result += l[i] * r[i];
+  return result;
+}
+
+template<class L, class R>
+inline double expr_dot(const L& l, const R& r, ExprTag<false>)
+{
+  return Vector(l) * Vector(r);
+}
+
+template<class L, class R>
+inline double operator*(const VectorExpr<L>& l, const VectorExpr<R>& r)
+{
+  return expr_dot(l.self(), r.self(),
+		  ExprTag<L::elementwise && R::elementwise>());
+}
 
-Vector operator*(double s, const Vector& u);
 bool approx_eq(const Vector& u, const Vector& v, unsigned precision);
 
 //////////////////////////////////////////////////////////////////////
@@ -0,0 +1,231 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "VectorView.h"
+#include "Blas.h"
+#include "Simd.h"
+
+//////////////////////////////////////////////////////////////////////
+// ConstVectorView
+//////////////////////////////////////////////////////////////////////
+
+double ConstVectorView::magnitude() const
+{
+  if (m_stride == 1)
+    return std::sqrt(blas_dot(m_size, m_data, m_data));
+
+  double result = 0.0;
+  for (size_t i=0; i<m_size; ++i)
+    result += m_data[i*m_stride] * m_data[i*m_stride];
+  return std::sqrt(result);
+}
+
+double ConstVectorView::mean() const
+{
+  double result = 0.0;
+
+  for (size_t i=0; i<m_size; ++i)
+    result += m_data[i*m_stride];
+
+  return result / double(m_size);
+}
+
+double ConstVectorView::getMin() const
+{
+  double a = m_data[0];
+
+  for (size_t i=1; i<m_size; ++i)
+    if (a > m_data[i*m_stride])
+      a = m_data[i*m_stride];
+
+  return a;
+}
+
+double ConstVectorView::getMax() const
+{
+  double a = m_data[0];
+
+  for (size_t i=1; i<m_size; ++i)
+    if (a < m_data[i*m_stride])
+      a = m_data[i*m_stride];
+
+  return a;
+}
+
+size_t ConstVectorView::getMinPos() const
+{
+  size_t k = 0;
+  double a = m_data[0];
+
+  for (size_t i=1; i<m_size; ++i)
+    if (a > m_data[i*m_stride])
+      a = m_data[(k=i)*m_stride];
+
+  return k;
+}
+
+size_t ConstVectorView::getMaxPos() const
+{
+  size_t k = 0;
+  double a = m_data[0];
+
+  for (size_t i=1; i<m_size; ++i)
+    if (a < m_data[i*m_stride])
+      a = m_data[(k=i)*m_stride];
+
+  return k;
+}
+
+bool ConstVectorView::operator==(const ConstVectorView& u) const
+{
+  if (m_size != u.m_size)
+    return false;
+
+  for (size_t i=0; i<m_size; ++i)
+    if (m_data[i*m_stride] != u.m_data[i*u.m_stride])
+      return false;
+
+  return true;
+}
+
+bool ConstVectorView::operator!=(const ConstVectorView& u) const
+{
+  return !operator==(u);
+}
+
+void ConstVectorView::assignTo(double* dst) const
+{
+  if (m_stride == 1)
+    std::copy(m_data, m_data+m_size, dst);
+  else {
+    for (size_t i=0; i<m_size; ++i)
+      dst[i] = m_data[i*m_stride];
+  }
+}
+
+void ConstVectorView::addTo(double* dst, double s) const
+{
+  if (m_stride == 1)
+    blas_axpy(m_size, s, m_data, dst);
+  else {
+    for (size_t i=0; i<m_size; ++i)
+      dst[i] += s * m_data[i*m_stride];
+  }
+}
+
+void ConstVectorView::write(std::ostream& s) const
+{
+  size_t n = m_size;
+  s.write((char*)&n, sizeof(size_t));
+
+  if (m_stride == 1)
+    s.write((char*)m_data, sizeof(double)*n);
+  else {
+    for (size_t i=0; i<n; ++i)
+      s.write((char*)&m_data[i*m_stride], sizeof(double));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// VectorView
+//////////////////////////////////////////////////////////////////////
+
+VectorView& VectorView::zero()
+{
+  double* p = getRaw();
+  for (size_t i=0; i<m_size; ++i)
+    p[i*m_stride] = 0.0;
+  return *this;
+}
+
+/// Swaps the elements of both views (e.g. to swap two columns of a
+/// matrix without a temporary vector).
+///
+void VectorView::swap(VectorView u)
+{
+  assert(m_size == u.m_size);
+
+  double* p = getRaw();
+  double* q = u.getRaw();
+  for (size_t i=0; i<m_size; ++i)
+    std::swap(p[i*m_stride], q[i*u.m_stride]);
+}
+
+VectorView& VectorView::operator*=(double s)
+{
+  if (m_stride == 1)
+    simd().scale(m_size, s, m_data, getRaw());
+  else {
+    double* p = getRaw();
+    for (size_t i=0; i<m_size; ++i)
+      p[i*m_stride] *= s;
+  }
+  return *this;
+}
+
+VectorView& VectorView::operator/=(double s)
+{
+  double* p = getRaw();
+  for (size_t i=0; i<m_size; ++i)
+    p[i*m_stride] /= s;
+  return *this;
+}
+
+/// Reads a vector written with Vector::write or
+/// ConstVectorView::write. The size of the stored vector must be the
+/// same as the size of the view.
+///
+void VectorView::read(std::istream& s)
+{
+  size_t n;
+  s.read((char*)&n, sizeof(size_t));
+  if (n != m_size)
+    throw std::invalid_argument("The stored vector does not have the size of the view.");
+
+  if (m_stride == 1)
+    s.read((char*)getRaw(), sizeof(double)*n);
+  else {
+    double* p = getRaw();
+    for (size_t i=0; i<n; ++i)
+      s.read((char*)&p[i*m_stride], sizeof(double));
+  }
+}
+
+void VectorView::copyFrom(const std::vector<double>& tmp)
+{
+  double* p = getRaw();
+  for (size_t i=0; i<m_size; ++i)
+    p[i*m_stride] = tmp[i];
+}
+
+void VectorView::addFrom(const std::vector<double>& tmp, double s)
+{
+  double* p = getRaw();
+  for (size_t i=0; i<m_size; ++i)
+    p[i*m_stride] += s * tmp[i];
+}
+
+//////////////////////////////////////////////////////////////////////
+// Text I/O
+//////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& o, const ConstVectorView& v)
+{
+  o.precision(16);
+
+  o << "(" << v.size() << ")";
+  o << "[ ";
+
+  for (size_t i=0; i<v.size(); ++i)
+    o << v(i) << " ";
+
+  o << "]";
+
+  return o;
+}
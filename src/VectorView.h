@@ -0,0 +1,208 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef LOSEFACE_VECTORVIEW_H
+#define LOSEFACE_VECTORVIEW_H
+
+#include <cassert>
+#include <vector>
+#include <iostream>
+
+#include "Expr.h"
+
+/// Read-only view of a vector stored in memory of other object (e.g. a
+/// column or a row of a Matrix). Elements are @a stride doubles apart.
+///
+/// It does not copy the data, so it cannot be used after the original
+/// object is resized or destroyed. Convert it to a Vector to get a
+/// copy.
+///
+class ConstVectorView : public VectorExpr<ConstVectorView>
+{
+protected:
+  const double* m_data;
+  size_t m_size;
+  size_t m_stride;
+
+public:
+  enum { elementwise = true };
+
+  ConstVectorView(const double* data, size_t size, size_t stride = 1)
+    : m_data(data), m_size(size), m_stride(stride) { }
+
+  const double* getRaw() const { return m_data; }
+  size_t size() const { return m_size; }
+  size_t stride() const { return m_stride; }
+
+  double magnitude() const;
+  double mean() const;
+  double getMin() const;
+  double getMax() const;
+  size_t getMinPos() const;
+  size_t getMaxPos() const;
+
+  bool operator==(const ConstVectorView& u) const;
+  bool operator!=(const ConstVectorView& u) const;
+
+  inline const double& operator()(size_t i) const {
+    assert(i >= 0 && i < m_size);
+    return m_data[i*m_stride];
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // Expressions (see Expr.h)
+  //////////////////////////////////////////////////////////////////////
+
+  double operator[](size_t i) const { return m_data[i*m_stride]; }
+
+  bool aliases(const double* first, const double* last) const {
+    return m_data < last && first < end();
+  }
+
+  void assignTo(double* dst) const;
+  void addTo(double* dst, double s) const;
+
+  //////////////////////////////////////////////////////////////////////
+  // Binary I/O (same format as Vector)
+  //////////////////////////////////////////////////////////////////////
+
+  void write(std::ostream& s) const;
+
+protected:
+  /// Returns the address after the last element.
+  const double* end() const { return m_data+(m_size-1)*m_stride+1; }
+
+};
+
+/// A view to modify a vector stored in memory of other object (e.g. a
+/// column of a Matrix).
+///
+/// Assigning to a view copies the elements (it does not change the
+/// viewed memory):
+///
+/// @code
+/// A.getCol(0) = B.getCol(1) + u;
+/// @endcode
+///
+class VectorView : public ConstVectorView
+{
+public:
+  VectorView(double* data, size_t size, size_t stride = 1)
+    : ConstVectorView(data, size, stride) { }
+
+  double* getRaw() { return const_cast<double*>(m_data); }
+  const double* getRaw() const { return m_data; }
+
+  VectorView& zero();
+  void swap(VectorView u);
+
+  VectorView& operator=(const VectorView& u) { return assign(u); }
+  VectorView& operator*=(double s);
+  VectorView& operator/=(double s);
+
+  template<class E>
+  VectorView& operator=(const VectorExpr<E>& expr) {
+    return assign(expr.self());
+  }
+
+  template<class E>
+  VectorView& operator+=(const VectorExpr<E>& expr) {
+    return add(expr.self(), 1.0);
+  }
+
+  template<class E>
+  VectorView& operator-=(const VectorExpr<E>& expr) {
+    return add(expr.self(), -1.0);
+  }
+
+  inline double& operator()(size_t i) {
+    assert(i >= 0 && i < m_size);
+    return getRaw()[i*m_stride];
+  }
+
+  inline const double& operator()(size_t i) const {
+    assert(i >= 0 && i < m_size);
+    return m_data[i*m_stride];
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // Binary I/O
+  //////////////////////////////////////////////////////////////////////
+
+  void read(std::istream& s);
+
+private:
+
+  // Expressions are evaluated directly in the viewed memory when it
+  // is contiguous. If the expression reads the same memory (e.g. other
+  // row of the same matrix), it is evaluated in a temporary buffer.
+
+  template<class E>
+  VectorView& assign(const E& e) {
+    assert(m_size == e.size());
+    if (e.aliases(m_data, end()))
+      copyFrom(evaluate(e));
+    else if (m_stride == 1)
+      e.assignTo(getRaw());
+    else
+      assignStrided(e, ExprTag<E::elementwise>());
+    return *this;
+  }
+
+  template<class E>
+  VectorView& add(const E& e, double s) {
+    assert(m_size == e.size());
+    if (e.aliases(m_data, end()))
+      addFrom(evaluate(e), s);
+    else if (m_stride == 1)
+      e.addTo(getRaw(), s);
+    else
+      addStrided(e, s, ExprTag<E::elementwise>());
+    return *this;
+  }
+
+  template<class E>
+  static std::vector<double> evaluate(const E& e) {
+    std::vector<double> tmp(e.size());
+    e.assignTo(&tmp[0]);
+    return tmp;
+  }
+
+  template<class E>
+  void assignStrided(const E& e, ExprTag<true>) {
+    double* p = getRaw();
+    for (size_t i=0; i<m_size; ++i)
+      p[i*m_stride] = e[i];
+  }
+
+  template<class E>
+  void assignStrided(const E& e, ExprTag<false>) {
+    copyFrom(evaluate(e));
+  }
+
+  template<class E>
+  void addStrided(const E& e, double s, ExprTag<true>) {
+    double* p = getRaw();
+    for (size_t i=0; i<m_size; ++i)
+      p[i*m_stride] += s * e[i];
+  }
+
+  template<class E>
+  void addStrided(const E& e, double s, ExprTag<false>) {
+    addFrom(evaluate(e), s);
+  }
+
+  void copyFrom(const std::vector<double>& tmp);
+  void addFrom(const std::vector<double>& tmp, double s);
+
+};
+
+//////////////////////////////////////////////////////////////////////
+// Text I/O
+//////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& o, const ConstVectorView& v);
+
+#endif // LOSEFACE_VECTORVIEW_H
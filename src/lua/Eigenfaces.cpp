@@ -91,7 +91,16 @@ static int eigenfaces__calculate_eigenfaces(lua_State* L)
     return luaL_error(L, buf);
   }
 
-  (*eig)->calculateEigenfaces(components);
+  bool converge = true;
+  try {
+    (*eig)->calculateEigenfaces(components);
+  }
+  catch (std::exception& e) {
+    converge = false;
+  }
+  if (!converge)
+    return luaL_error(L, "Error calculating eigenvectors of covariance matrix");
+
   lua_pushnumber(L, components);
   return 1;
 }
@@ -130,43 +139,43 @@ static int eigenfaces__eigenvalues_count(lua_State* L)
 ///   Eigenfaces:project_in_eigenspace({ image1, image2, image3... })
 /// @endcode
 ///
+/// All images are projected together with one matrix product (see
+/// Eigenfaces::projectBatch).
+///
 static int eigenfaces__project_in_eigenspace(lua_State* L)
 {
   lua_Eigenfaces** eig = toEigenfaces(L, 1);
   if (!eig)
     return luaL_error(L, "No Eigenfaces user-data specified");
 
-  luaL_checktype(L, 2, LUA_TTABLE);
-
-  vector<Vector> outputs;
-
-  // iterate table
-  lua_pushnil(L);		// push nil for first element of table
-  while (lua_next(L, 2) != 0) {
-    lua_Image* img = *toImage(L, -1); // get value
-    if (img) {
-      Vector imgVector, output;
-      imglib::details::image2vector(img, imgVector);
+  Matrix images;
+  size_t count = images2matrix(L, 2, images);
+  if (count == 0) {
+    lua_newtable(L);
+    return 1;
+  }
 
-      (*eig)->projectInEigenspace(imgVector, output);
-      outputs.push_back(output);
-    }
-    lua_pop(L, 1);		// remove value, the key is in stack for next iteration
+  Matrix outputs;
+  bool valid = true;
+  try {
+    (*eig)->projectBatch(images, outputs);
+  }
+  catch (std::exception& e) {
+    valid = false;
   }
+  if (!valid)
+    return luaL_error(L, "Images do not have the size of the eigenfaces");
 
   // Create table of converted images
   lua_newtable(L);
-  size_t i = 1;
-  for (vector<Vector>::iterator it =
-  	 outputs.begin(); it != outputs.end(); ++it, ++i) {
+  for (size_t j=0; j<count; ++j) {
     // a new table in the stack
-    lua_pushinteger(L, i);
+    lua_pushinteger(L, j+1);
     lua_newtable(L);
 
-    Vector& output(*it);
-    for (size_t j=0; j<output.size(); ++j) {
-      lua_pushinteger(L, j+1);
-      lua_pushnumber(L, output(j));
+    for (size_t i=0; i<outputs.rows(); ++i) {
+      lua_pushinteger(L, i+1);
+      lua_pushnumber(L, outputs(i, j));
       lua_settable(L, -3);
     }
 
@@ -183,3 +183,47 @@ void imglib::details::image2vector(const lua_Image* _img, Vector& output)
     for (x=0; x<img.width; ++x)
       output(i++) = img(x, y, 0, 0);
 }
+
+/// Puts the images of the table at @a pos in the columns of @a images
+/// (all images must have the same size).
+///
+/// @return The number of images (@a images is not modified if the
+///         table is empty).
+///
+size_t imglib::details::images2matrix(lua_State* L, int pos, Matrix& images)
+{
+  luaL_checktype(L, pos, LUA_TTABLE);
+
+  // Count images
+  size_t count = 0, pixels = 0;
+  lua_pushnil(L);
+  while (lua_next(L, pos) != 0) {
+    lua_Image* img = *toImage(L, -1);
+    if (img) {
+      if (count++ == 0)
+	pixels = img->width * img->height;
+    }
+    lua_pop(L, 1);
+  }
+  if (count == 0)
+    return 0;
+
+  // Put all images in the columns of a matrix
+  images.resize(pixels, count);
+  Vector imgVector;
+  size_t j = 0;
+
+  lua_pushnil(L);		// push nil for first element of table
+  while (lua_next(L, pos) != 0) {
+    lua_Image* img = *toImage(L, -1); // get value
+    if (img) {
+      image2vector(img, imgVector);
+      if (imgVector.size() != pixels)
+	luaL_error(L, "All images must have the same size");
+
+      images.setCol(j++, imgVector);
+    }
+    lua_pop(L, 1);		// remove value, the key is in stack for next iteration
+  }
+  return count;
+}
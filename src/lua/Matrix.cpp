@@ -0,0 +1,155 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "lua/annlib.h"
+
+#define LUAOBJ_MATRIX		"Matrix"
+
+using namespace std;
+using namespace annlib::details;
+
+lua_Matrix** annlib::details::toMatrix(lua_State* L, int pos)
+{
+  return ((lua_Matrix**)luaL_checkudata(L, pos, LUAOBJ_MATRIX));
+}
+
+/// Pushes a new matrix in the stack (used to return the outputs of
+/// Mlp:recall_batch and MlpArray:recall_batch).
+///
+lua_Matrix** annlib::details::newMatrix(lua_State* L)
+{
+  lua_Matrix** m = (lua_Matrix**)lua_newuserdata(L, sizeof(lua_Matrix**));
+  *m = new lua_Matrix;
+  luaL_getmetatable(L, LUAOBJ_MATRIX);
+  lua_setmetatable(L, -2);
+  return m;
+}
+
+// Returns the 1-based column argument at @a pos as a 0-based index
+static size_t checkcol(lua_State* L, const lua_Matrix& m, int pos)
+{
+  int j = luaL_checkint(L, pos);
+  luaL_argcheck(L, j >= 1 && j <= (int)m.cols(), pos, "column out of range");
+  return j-1;
+}
+
+/// @code
+/// number = matrix:rows()
+/// @endcode
+///
+static int matrix__rows(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    lua_pushinteger(L, (*m)->rows());
+    return 1;
+  }
+  return 0;
+}
+
+/// @code
+/// number = matrix:cols()
+/// @endcode
+///
+static int matrix__cols(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    lua_pushinteger(L, (*m)->cols());
+    return 1;
+  }
+  return 0;
+}
+
+/// Returns the element of the row @a i and column @a j (1-based).
+///
+/// @code
+/// number = matrix:get(i, j)
+/// @endcode
+///
+static int matrix__get(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    int i = luaL_checkint(L, 2);
+    luaL_argcheck(L, i >= 1 && i <= (int)(*m)->rows(), 2, "row out of range");
+    size_t j = checkcol(L, **m, 3);
+
+    lua_pushnumber(L, (**m)(i-1, j));
+    return 1;
+  }
+  return 0;
+}
+
+/// Returns the column @a j as a table (e.g. the output of one pattern).
+///
+/// @code
+/// { number1, number2, ... } = matrix:col(j)
+/// @endcode
+///
+static int matrix__col(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    size_t j = checkcol(L, **m, 2);
+
+    lua_newtable(L);
+    for (size_t i=0; i<(*m)->rows(); ++i) {
+      lua_pushinteger(L, i+1);
+      lua_pushnumber(L, (**m)(i, j));
+      lua_settable(L, -3);
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/// Returns the row (1-based) of the maximum element of the column
+/// @a j (e.g. the recognized subject of one pattern).
+///
+/// @code
+/// number = matrix:max_pos(j)
+/// @endcode
+///
+static int matrix__max_pos(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    size_t j = checkcol(L, **m, 2);
+
+    lua_pushinteger(L, (*m)->getCol(j).getMaxPos()+1);
+    return 1;
+  }
+  return 0;
+}
+
+static int matrix__gc(lua_State* L)
+{
+  lua_Matrix** m = toMatrix(L, 1);
+  if (m) {
+    delete *m;
+    *m = NULL;
+  }
+  return 0;
+}
+
+static const luaL_Reg matrix_metatable[] = {
+  { "rows",	matrix__rows },
+  { "cols",	matrix__cols },
+  { "get",	matrix__get },
+  { "col",	matrix__col },
+  { "max_pos",	matrix__max_pos },
+  { "__gc",	matrix__gc },
+  { NULL, NULL }
+};
+
+void annlib::details::registerMatrix(lua_State* L)
+{
+  // Matrix user data
+  luaL_newmetatable(L, LUAOBJ_MATRIX);		// create metatable for Matrix
+  lua_pushvalue(L, -1);				// push metatable
+  lua_setfield(L, -2, "__index");		// metatable.__index = metatable
+  luaL_register(L, NULL, matrix_metatable);	// Matrix methods
+}
@@ -3,6 +3,10 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
 #include "lua/annlib.h"
 
 #define LUAOBJ_MLP		"Mlp"
@@ -112,8 +116,13 @@ static int mlp__save(lua_State* L)
 ///		momentum=MOMENTUM,
 ///		epochs=NUMBER,
 ///		shuffle=NUMBER,
+///		batch=NUMBER,
+///		threads=NUMBER,
+///		mode="sync"|"hogwild",
 ///		goal=ann.LAST|ann.BESTMSE,
 ///		goal_mse=NUMBER,
+///		bold_driver=BOOLEAN,
+///		algorithm=ann.BACKPROP|ann.RPROP|ann.ADAM|ann.LM,
 ///		early_stopping={ set=PatternSet, iterations=NUMBER } })
 /// @endcode
 ///
@@ -128,8 +137,36 @@ static int mlp__save(lua_State* L)
 ///     stop the training if in the given @a iterations number of epochs
 ///     the MSE of the given validation set is getting worse.
 /// @li shuffle > 0: Shuffles the patterns every @a shuffle number of epochs.
+/// @li batch > 1: Updates the weights after each @a batch patterns
+///     (mini-batch training) instead of after each pattern.
+/// @li threads > 1 (or 0 to use all processors): With mode="sync"
+///     (default) each mini-batch is divided between threads (the
+///     result is the same for any number of threads). With
+///     mode="hogwild" each thread trains online a part of the
+///     patterns updating the same weights without locks.
+/// @li bold_driver=true: Adapts the learning rate with the bold driver
+///     method (see BoldDriverMethod). It cannot be used with ann.RPROP
+///     or ann.ADAM (the bold driver restores the weights without
+///     restoring the state of the optimizer).
+/// @li algorithm=ann.RPROP: Uses iRPROP+ (see Rprop) with the whole set
+///     as one batch, @a learning_rate and @a momentum are not used.
+/// @li algorithm=ann.ADAM: Uses Adam (see Adam) with batches of @a batch
+///     patterns and @a learning_rate (0.001 by default).
+/// @li algorithm=ann.LM: Uses Levenberg-Marquardt (see
+///     LevenbergMarquardt), only for networks with few weights. The
+///     training stops if an epoch cannot reduce the error. Each epoch
+///     uses the whole set, so @a bold_driver, @a shuffle, @a batch,
+///     @a threads and @a mode cannot be used.
+///
+/// The MSE of each set is calculated once per epoch (it is shared by
+/// the bold driver, the goal and the early stopping).
 ///
-/// @return Returns how many epochs the net was trained
+/// @return Returns how many epochs the net was trained, and a table
+///         with statistics: { forward_passes={ NUMBER, ... },
+///         training_error=NUMBER, mse=NUMBER }. forward_passes has the
+///         sweeps over whole sets of each epoch (the training pass and
+///         each MSE calculated). mse is the MSE of the returned network
+///         (the best one with goal=ann.BESTMSE) with the training set.
 ///
 static int mlp__train(lua_State* L)
 {
@@ -161,7 +198,8 @@ static int mlp__train(lua_State* L)
   if (lua_isuserdata(L, -3)) set = *toPatternSet(L, -3);
   if (lua_isnumber(L, -4)) goal = (int)lua_tonumber(L, -4);
   if (lua_isnumber(L, -5)) momentum = lua_tonumber(L, -5);
-  if (lua_isnumber(L, -6)) learning_rate = lua_tonumber(L, -6);
+  bool has_learning_rate = (lua_isnumber(L, -6) ? true: false);
+  if (has_learning_rate) learning_rate = lua_tonumber(L, -6);
   if (lua_istable(L, -7)) {
     lua_getfield(L, -7, "set");
     if (lua_isuserdata(L, -1)) early_stopping_set = *toPatternSet(L, -1);
@@ -178,17 +216,74 @@ static int mlp__train(lua_State* L)
     epochs = 1;
   lua_pop(L, 8);
 
+  int batch = 1;
+  int threads = 1;
+  bool has_batch = false, has_threads = false, has_mode = false;
+  bool bold_driver = false;
+  int algorithm = annlib::BACKPROP;
+  Backpropagation::ParallelMode mode = Backpropagation::SynchronousMode;
+  lua_getfield(L, 2, "bold_driver");
+  lua_getfield(L, 2, "algorithm");
+  if (lua_isnumber(L, -1)) algorithm = lua_tointeger(L, -1);
+  bold_driver = lua_toboolean(L, -2) ? true: false;
+  lua_pop(L, 2);
+  lua_getfield(L, 2, "batch");
+  lua_getfield(L, 2, "threads");
+  lua_getfield(L, 2, "mode");
+  if (lua_isstring(L, -1)) {
+    const char* mode_name = lua_tostring(L, -1);
+    has_mode = true;
+    if (std::strcmp(mode_name, "hogwild") == 0)
+      mode = Backpropagation::HogwildMode;
+    else if (std::strcmp(mode_name, "sync") != 0)
+      return luaL_error(L, "Invalid training mode '%s' (it must be \"sync\" or \"hogwild\")",
+			mode_name);
+  }
+  if (lua_isnumber(L, -2)) { threads = lua_tointeger(L, -2); has_threads = true; }
+  if (lua_isnumber(L, -3)) { batch = lua_tointeger(L, -3); has_batch = true; }
+  lua_pop(L, 3);
+
   if (!set)
     return luaL_error(L, "Invalid pattern set specified");
+  if (batch < 1)
+    return luaL_error(L, "Invalid batch size specified (it must be 1 or greater)");
+  if (threads < 0)
+    return luaL_error(L, "Invalid number of threads specified (0 means one per processor)");
+  if (algorithm != annlib::BACKPROP &&
+      algorithm != annlib::RPROP &&
+      algorithm != annlib::ADAM &&
+      algorithm != annlib::LM)
+    return luaL_error(L, "Invalid training algorithm (it must be ann.BACKPROP, ann.RPROP, ann.ADAM or ann.LM)");
+  if (bold_driver && (algorithm == annlib::RPROP || algorithm == annlib::ADAM))
+    return luaL_error(L, "The bold driver cannot be used with ann.RPROP or ann.ADAM");
+  if (algorithm == annlib::LM &&
+      (bold_driver || shuffle > 0 || has_batch || has_threads || has_mode))
+    return luaL_error(L, "ann.LM cannot be used with bold_driver, shuffle, batch, threads or mode");
 
   /// Backpropagation algorithm configuration
   Backpropagation bp(net);
   bp.setLearningRate(learning_rate);
   bp.setMomentum(momentum);
+  bp.setBatchSize(batch);
+  bp.setThreads(threads);
+  bp.setParallelMode(mode);
+  if (bold_driver)
+    bp.setAdaptativeLearningRate(BoldDriverMethod());
+
+  switch (algorithm) {
+    case annlib::RPROP:
+      bp.setOptimizer(Rprop());
+      break;
+    case annlib::ADAM:
+      bp.setOptimizer(Adam(has_learning_rate ? learning_rate: 0.001));
+      break;
+  }
+
+  LevenbergMarquardt lm(net);
 
   lua_PatternSet& pattern_set(*set);
   lua_Mlp best;
-  double mse = net.calcMSE(pattern_set);
+  double mse = bp.calcMSE(pattern_set);
   double measure, bestMeasure = 0.0;	// Best MSE
   if (goal != annlib::LAST) {
     best = net;
@@ -203,11 +298,16 @@ static int mlp__train(lua_State* L)
   double early_stopping_mse = 1.0;
   int early_stopping_bad_iterations = 0;
   if (early_stopping_set)
-    early_stopping_mse = net.calcMSE(*early_stopping_set);
+    early_stopping_mse = bp.calcMSE(*early_stopping_set);
+
+  // Forward passes of each epoch
+  std::vector<size_t> forward_passes;
 
   // For each training epoch...
   int trained_epochs = 0;
   for (int i=0, j=0; epochs == 0 || i < epochs; ++i, ++j) {
+    size_t passes = bp.getForwardPasses() + lm.getForwardPasses();
+
     // Time to shuffle patterns?
     if (shuffle > 0 && j == shuffle-1) {
       pattern_set.shuffle();
@@ -215,11 +315,24 @@ static int mlp__train(lua_State* L)
     }
 
     // Train one epoch
-    bp.train(pattern_set);
+    if (algorithm == annlib::LM) {
+      bool progress = lm.train(pattern_set);
+
+      // The MSE is known (and the weights are not modified if there
+      // is no progress)
+      bp.invalidateMSE();
+      bp.setMSE(pattern_set, lm.getMSE());
+      if (!progress) {
+	forward_passes.push_back(bp.getForwardPasses() + lm.getForwardPasses() - passes);
+	break;
+      }
+    }
+    else
+      bp.train(pattern_set);
     trained_epochs++;
 
-    // Recalculate MSE
-    mse = net.calcMSE(pattern_set);
+    // Recalculate MSE (if the adaptative learning rate did not)
+    mse = bp.calcMSE(pattern_set);
 
     // What we are looking for? (network with best MSE, etc.)
     if (goal != annlib::LAST) {
@@ -237,12 +350,15 @@ static int mlp__train(lua_State* L)
     }
 
     // MSE goal?
-    if (goal_mse > -.5 && mse < goal_mse)
+    if (goal_mse > -.5 && mse < goal_mse) {
+      forward_passes.push_back(bp.getForwardPasses() + lm.getForwardPasses() - passes);
       break;
+    }
 
     // Early stopping rules
     if (early_stopping_set) {
-      double mse2 = net.calcMSE(*early_stopping_set);
+      double mse2 = bp.calcMSE(*early_stopping_set);
+      forward_passes.push_back(bp.getForwardPasses() + lm.getForwardPasses() - passes);
 
       if (mse2 > early_stopping_mse) {
 	early_stopping_bad_iterations++;
@@ -254,13 +370,36 @@ static int mlp__train(lua_State* L)
 
       early_stopping_mse = mse2;
     }
+    else
+      forward_passes.push_back(bp.getForwardPasses() + lm.getForwardPasses() - passes);
   }
 
-  if (goal != annlib::LAST)
+  if (goal != annlib::LAST) {
     net = best;
+    switch (goal) {
+      case annlib::BESTMSE:
+	mse = bestMeasure;
+	break;
+    }
+  }
 
   lua_pushnumber(L, trained_epochs);
-  return 1;
+
+  // Statistics
+  lua_newtable(L);
+  lua_newtable(L);
+  for (size_t e=0; e<forward_passes.size(); ++e) {
+    lua_pushinteger(L, e+1);
+    lua_pushinteger(L, forward_passes[e]);
+    lua_settable(L, -3);
+  }
+  lua_setfield(L, -2, "forward_passes");
+  lua_pushnumber(L, algorithm == annlib::LM ? lm.getTrainingError():
+				    bp.getTrainingError());
+  lua_setfield(L, -2, "training_error");
+  lua_pushnumber(L, mse);
+  lua_setfield(L, -2, "mse");
+  return 2;
 }
 
 /// Calculates MSE given a set of patterns.
@@ -291,7 +430,7 @@ static int mlp__mse(lua_State* L)
 }
 
 /// @code
-/// { output_table1, output_table2, ... } = net:recall({ set=PatternSet })
+/// { output_table1, output_table2, ... } = net:recall(PatternSet)
 /// @endcode
 ///
 static int mlp__recall(lua_State* L)
@@ -304,31 +443,36 @@ static int mlp__recall(lua_State* L)
 
   lua_PatternSet* set = NULL;
   if (lua_isuserdata(L, 2))
-    set = *toPatternSet(L, -1);
+    set = *toPatternSet(L, 2);
 
   if (!set)
     return luaL_error(L, "Invalid pattern set specified");
 
-  Vector input, hidden, output;
-
   // Put a table in the stack: array of outputs
   lua_newtable(L);
 
-  lua_PatternSet::iterator it = set->begin();
-  lua_PatternSet::iterator end = set->end();
-  size_t i = 1;
-  for (; it != end; ++it, ++i) {
-    // Execute the neural network
-    net.recall((*it)->getInput(), hidden, output);
+  if (set->empty())
+    return 1;
+
+  // recallBatch throws std::invalid_argument for other inputs (it
+  // cannot go through the Lua C functions)
+  if (set->getInputSize() != net.getInputs())
+    return luaL_error(L, "The patterns do not have the inputs of the network");
+
+  // All the patterns are recalled at once
+  Matrix inputs, outputs;
+  set->getInputs(inputs);
+  net.recallBatch(inputs, outputs);
 
+  for (size_t i=0; i<outputs.cols(); ++i) {
     // A new table in the stack: output vector
-    lua_pushinteger(L, i);
+    lua_pushinteger(L, i+1);
     lua_newtable(L);
 
     // Fill the output vector (converts Vector<double> -> Lua Table)
-    for (size_t j=0; j<output.size(); ++j) {
+    for (size_t j=0; j<outputs.rows(); ++j) {
       lua_pushinteger(L, j+1);
-      lua_pushnumber(L, output(j));
+      lua_pushnumber(L, outputs(j, i));
       lua_settable(L, -3);
     }
 
@@ -337,6 +481,52 @@ static int mlp__recall(lua_State* L)
   return 1;
 }
 
+/// Recalls all the patterns at once and returns a Matrix with the
+/// output of each pattern in a column (instead of a table of tables).
+///
+/// @code
+/// matrix = net:recall_batch(PatternSet, { threads=NUMBER })
+/// @endcode
+///
+static int mlp__recall_batch(lua_State* L)
+{
+  lua_Mlp** _net = toMlp(L, 1);
+  if (!_net)
+    return 0;
+
+  lua_PatternSet* set = NULL;
+  if (lua_isuserdata(L, 2))
+    set = *toPatternSet(L, 2);
+
+  if (!set || set->empty())
+    return luaL_error(L, "Invalid pattern set specified");
+
+  int threads = 1;
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "threads");
+    if (lua_isnumber(L, -1)) threads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+  }
+  if (threads < 0)
+    return luaL_error(L, "Invalid number of threads specified (0 means one per processor)");
+
+  lua_Matrix* outputs = *newMatrix(L);
+  bool ok = true;
+  {
+    Matrix inputs;
+    set->getInputs(inputs);
+    try {
+      (*_net)->recallBatch(inputs, *outputs, threads);
+    }
+    catch (std::invalid_argument&) {
+      ok = false;
+    }
+  }
+  if (!ok)
+    return luaL_error(L, "The patterns do not have the inputs of the network");
+  return 1;
+}
+
 static int mlp__gc(lua_State* L)
 {
   lua_Mlp** m = toMlp(L, 1);
@@ -355,6 +545,7 @@ static const luaL_Reg mlp_metatable[] = {
   { "train", mlp__train },
   { "mse", mlp__mse },
   { "recall", mlp__recall },
+  { "recall_batch", mlp__recall_batch },
   { "__gc", mlp__gc },
   { NULL, NULL }
 };
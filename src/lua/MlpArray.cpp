@@ -3,6 +3,9 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <stdexcept>
+#include <vector>
+
 #include "lua/annlib.h"
 
 #define LUAOBJ_MLPARRAY		"MlpArray"
@@ -70,6 +73,13 @@ static int mlparray__save(lua_State* L)
   return 0;
 }
 
+/// @code
+/// { output_table1, output_table2, ... } = array:recall(PatternSet)
+/// @endcode
+///
+/// All the patterns are recalled at once with the compiled form of
+/// the array (see FusedMlpArray).
+///
 static int mlparray__recall(lua_State* L)
 {
   lua_MlpArray** _array = toMlpArray(L, 1);
@@ -85,26 +95,31 @@ static int mlparray__recall(lua_State* L)
   if (!set)
     return luaL_error(L, "Invalid pattern set specified");
 
-  Vector input, output;
-
   // Put a table in the stack: array of outputs
   lua_newtable(L);
 
-  lua_PatternSet::iterator it = set->begin();
-  lua_PatternSet::iterator end = set->end();
-  size_t i = 1;
-  for (; it != end; ++it, ++i) {
-    // Execute the array of neural networks
-    array.recall((*it)->getInput(), output);
+  if (set->empty())
+    return 1;
+
+  // recallBatch throws std::invalid_argument for other inputs (it
+  // cannot go through the Lua C functions)
+  if (set->getInputSize() != array.getInputs())
+    return luaL_error(L, "The patterns do not have the inputs of the array");
+
+  // All the patterns are recalled at once
+  Matrix inputs, outputs;
+  set->getInputs(inputs);
+  array.recallBatch(inputs, outputs);
 
+  for (size_t i=0; i<outputs.cols(); ++i) {
     // A new table in the stack: output vector
-    lua_pushinteger(L, i);
+    lua_pushinteger(L, i+1);
     lua_newtable(L);
 
     // Fill the output vector (converts Vector<double> -> Lua Table)
-    for (size_t j=0; j<output.size(); ++j) {
+    for (size_t j=0; j<outputs.rows(); ++j) {
       lua_pushinteger(L, j+1);
-      lua_pushnumber(L, output(j));
+      lua_pushnumber(L, outputs(j, i));
       lua_settable(L, -3);
     }
 
@@ -113,6 +128,180 @@ static int mlparray__recall(lua_State* L)
   return 1;
 }
 
+/// Recalls all the patterns at once and returns a Matrix with the
+/// output of the array for each pattern in a column.
+///
+/// @code
+/// matrix = array:recall_batch(PatternSet, { threads=NUMBER })
+/// @endcode
+///
+static int mlparray__recall_batch(lua_State* L)
+{
+  lua_MlpArray** _array = toMlpArray(L, 1);
+  if (!_array)
+    return 0;
+
+  lua_PatternSet* set = NULL;
+  if (lua_isuserdata(L, 2))
+    set = *toPatternSet(L, 2);
+
+  if (!set || set->empty())
+    return luaL_error(L, "Invalid pattern set specified");
+
+  int threads = 1;
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "threads");
+    if (lua_isnumber(L, -1)) threads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+  }
+  if (threads < 0)
+    return luaL_error(L, "Invalid number of threads specified (0 means one per processor)");
+
+  lua_Matrix* outputs = *newMatrix(L);
+  bool ok = true;
+  {
+    Matrix inputs;
+    set->getInputs(inputs);
+    try {
+      (*_array)->recallBatch(inputs, *outputs, threads);
+    }
+    catch (std::invalid_argument&) {
+      ok = false;
+    }
+  }
+  if (!ok)
+    return luaL_error(L, "The patterns do not have the inputs of the array");
+  return 1;
+}
+
+/// Trains all the networks of the array (each network in parallel).
+///
+/// @code
+/// epochs, adjustments, stats =
+///   array:train_all({ set=PatternSet,
+///			learning_rate=LEARNING_RATE,
+///			momentum=MOMENTUM,
+///			epochs=NUMBER,
+///			shuffle=NUMBER,
+///			goal=ann.LAST|ann.BESTMSE,
+///			goal_mse=NUMBER,
+///			threads=NUMBER,
+///			seed=NUMBER,
+///			init={ min=NUMBER, max=NUMBER } })
+/// @endcode
+///
+/// The @a set must have one output for each output of the array.
+/// Each network is trained with all the patterns of @a set (its
+/// positive patterns first) using only its outputs as targets.
+///
+/// @return Two tables with the trained epochs and the number of
+///         weight adjustments of each network, and a table with
+///         statistics: { mse={ NUMBER, ... } } with the MSE of each
+///         returned network (the best one with goal=ann.BESTMSE) with
+///         its patterns.
+///
+static int mlparray__train_all(lua_State* L)
+{
+  lua_MlpArray** _array = toMlpArray(L, 1);
+  if (!_array)
+    return 0;
+
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  lua_PatternSet* set = NULL;
+  MlpArrayTraining params;
+  int epochs = 0;
+  int shuffle = 0;
+  int threads = 0;
+  int goal = annlib::LAST;
+  lua_getfield(L, 2, "set");
+  lua_getfield(L, 2, "learning_rate");
+  lua_getfield(L, 2, "momentum");
+  lua_getfield(L, 2, "epochs");
+  lua_getfield(L, 2, "shuffle");
+  lua_getfield(L, 2, "goal");
+  lua_getfield(L, 2, "goal_mse");
+  lua_getfield(L, 2, "threads");
+  lua_getfield(L, 2, "seed");
+  if (lua_isnumber(L, -1)) params.seed = (unsigned long)lua_tonumber(L, -1);
+  if (lua_isnumber(L, -2)) threads = lua_tointeger(L, -2);
+  if (lua_isnumber(L, -3)) params.goalMse = lua_tonumber(L, -3);
+  if (lua_isnumber(L, -4)) goal = lua_tointeger(L, -4);
+  if (lua_isnumber(L, -5)) shuffle = lua_tointeger(L, -5);
+  if (lua_isnumber(L, -6)) epochs = lua_tointeger(L, -6);
+  if (lua_isnumber(L, -7)) params.momentum = lua_tonumber(L, -7);
+  if (lua_isnumber(L, -8)) params.learningRate = lua_tonumber(L, -8);
+  if (lua_isuserdata(L, -9)) set = *toPatternSet(L, -9);
+  lua_pop(L, 9);
+
+  lua_getfield(L, 2, "init");
+  if (lua_istable(L, -1)) {
+    params.initWeights = true;
+    lua_getfield(L, -1, "min");
+    lua_getfield(L, -2, "max");
+    if (lua_isnumber(L, -2)) params.initMin = lua_tonumber(L, -2);
+    if (lua_isnumber(L, -1)) params.initMax = lua_tonumber(L, -1);
+    lua_pop(L, 2);
+  }
+  lua_pop(L, 1);
+
+  if (!set)
+    return luaL_error(L, "Invalid pattern set specified");
+  if (epochs < 0 || shuffle < 0 || threads < 0)
+    return luaL_error(L, "Invalid number of epochs, shuffle or threads specified");
+
+  // Without epochs and goal_mse the networks are trained one epoch
+  if (epochs == 0 && params.goalMse < 0.0)
+    epochs = 1;
+
+  params.epochs = epochs;
+  params.shuffle = shuffle;
+  params.keepBest = (goal == annlib::BESTMSE);
+  params.threads = threads;
+
+  bool ok = true;
+  {
+    vector<size_t> trained_epochs, adjustments;
+    vector<double> mse;
+    try {
+      (*_array)->trainAll(*set, params, trained_epochs, adjustments, mse);
+    }
+    catch (std::invalid_argument&) {
+      ok = false;
+    }
+
+    if (ok) {
+      lua_newtable(L);
+      for (size_t i=0; i<trained_epochs.size(); ++i) {
+	lua_pushinteger(L, i+1);
+	lua_pushinteger(L, trained_epochs[i]);
+	lua_settable(L, -3);
+      }
+
+      lua_newtable(L);
+      for (size_t i=0; i<adjustments.size(); ++i) {
+	lua_pushinteger(L, i+1);
+	lua_pushinteger(L, adjustments[i]);
+	lua_settable(L, -3);
+      }
+
+      // Statistics
+      lua_newtable(L);
+      lua_newtable(L);
+      for (size_t i=0; i<mse.size(); ++i) {
+	lua_pushinteger(L, i+1);
+	lua_pushnumber(L, mse[i]);
+	lua_settable(L, -3);
+      }
+      lua_setfield(L, -2, "mse");
+    }
+  }
+  if (!ok)
+    return luaL_error(L, "The pattern set does not have the inputs and outputs of the array");
+
+  return 3;
+}
+
 static int mlparray__gc(lua_State* L)
 {
   lua_MlpArray** n = toMlpArray(L, 1);
@@ -127,6 +316,8 @@ static const luaL_Reg mlparray_metatable[] = {
   { "load",	mlparray__load },
   { "save",	mlparray__save },
   { "recall",	mlparray__recall },
+  { "recall_batch",	mlparray__recall_batch },
+  { "train_all",	mlparray__train_all },
   { "__gc",	mlparray__gc },
   { NULL, NULL }
 };
@@ -37,13 +37,11 @@ static int normalizer__normalize(lua_State* L)
 
       // Here we normalize the other pattern set through the calculate range
       for (lua_PatternSet::iterator it=set->begin(); it!=set->end(); ++it) {
-	Pattern* pat = *it;
-
-	for (size_t i=0; i<pat->getInput().size(); ++i) {
+	for (size_t i=0; i<set->getInputSize(); ++i) {
 	  // Normalize input to [-1;+1] range
-	  pat->setInput(i,
-			2.0 * ((pat->getInput(i) - normalMin(i)) /
-			       (normalMax(i) - normalMin(i))) - 1.0);
+	  it->setInput(i,
+		       2.0 * ((it->getInput(i) - normalMin(i)) /
+			      (normalMax(i) - normalMin(i))) - 1.0);
 	}
       }
     }
@@ -108,13 +106,13 @@ int annlib::details::NormalizerCtor(lua_State* L)
     case MINMAX: {
       // First we have to calculate min-max ranges
       lua_PatternSet::iterator it = pattern_set.begin();
-      Vector normalMin = (*it)->getInput();
-      Vector normalMax = (*it)->getInput();
+      Vector normalMin = it->getInput();
+      Vector normalMax = it->getInput();
 
       for (++it; it!=pattern_set.end(); ++it) {
-	for (size_t i=0; i<(*it)->getInput().size(); ++i) {
-	  if ((*it)->getInput()(i) < normalMin(i))  normalMin(i) = (*it)->getInput()(i);
-	  if ((*it)->getInput()(i) > normalMax(i))  normalMax(i) = (*it)->getInput()(i);
+	for (size_t i=0; i<it->getInput().size(); ++i) {
+	  if (it->getInput()(i) < normalMin(i))  normalMin(i) = it->getInput()(i);
+	  if (it->getInput()(i) > normalMax(i))  normalMax(i) = it->getInput()(i);
 	}
       }
 
@@ -3,7 +3,9 @@
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
 
 #include "lua/annlib.h"
 
@@ -48,15 +50,13 @@ static int patternset__save(lua_State* L)
 
     for (lua_PatternSet::const_iterator
 	   it=(*p)->begin(); it!=(*p)->end(); ++it) {
-      const Pattern* pat = *it;
+      for (size_t i=0; i<(*p)->getInputSize(); ++i)
+	f << '\t' << it->getInput(i);
 
-      for (size_t i=0; i<pat->getInput().size(); ++i)
-	f << '\t' << pat->getInput(i);
-
-      if (pat->getOutput().size() > 1)
-	f << '\t' << ((int)pat->getOutput().getMaxPos()+1);
+      if ((*p)->getOutputSize() > 1)
+	f << '\t' << ((int)it->getOutput().getMaxPos()+1);
       else
-	f << '\t' << pat->getOutput(0);
+	f << '\t' << it->getOutput(0);
 
       f << std::endl;
     }
@@ -71,6 +71,7 @@ static int patternset__add_pattern(lua_State* L)
     return luaL_error(L, "Invalid pattern set specified");
 
   Pattern newPattern;
+  int label = 0;
 
   if (lua_istable(L, 2)) {
     size_t N = lua_objlen(L, 2);
@@ -106,12 +107,34 @@ static int patternset__add_pattern(lua_State* L)
       lua_pop(L, 1);		// remove value, the key is in stack for next iteration
     }
   }
+  else if (lua_isnumber(L, 3)) {
+    // the class of the pattern (for sets with label outputs)
+    label = lua_tointeger(L, 3);
+    if (label < 1)
+      return luaL_error(L, "Invalid 'output' class %d", label);
+  }
   else {
-    return luaL_error(L, "You have to specified the 'output' vector as second argument");
+    return luaL_error(L, "You have to specified the 'output' vector or class as second argument");
   }
 
   // add the new pattern
-  (*p)->push_back(newPattern);
+  bool ok = true;
+  try {
+    if (label > 0)
+      (*p)->push_back(newPattern.getInput(), label-1);
+    else
+      (*p)->push_back(newPattern);
+  }
+  catch (std::invalid_argument&) {
+    ok = false;
+  }
+  if (!ok) {
+    if (label > 0)
+      return luaL_error(L, "The pattern does not have the inputs of the other patterns of the set, or the class %d is not one of the outputs of the set", label);
+    else
+      return luaL_error(L, "The pattern does not have the inputs and outputs of the other patterns of the set");
+  }
+
   return 0;
 }
 
@@ -135,11 +158,7 @@ static int patternset__set_output(lua_State* L)
     }
 
     // Setup all outputs
-    for (lua_PatternSet::iterator
-	   it=(*p)->begin(); it!=(*p)->end(); ++it) {
-      Pattern& pat(**it);
-      pat.setOutput(newoutput);
-    }
+    (*p)->setOutputs(newoutput);
 
     return 0;
   }
@@ -169,7 +188,7 @@ static int patternset__split_by_percentage(lua_State* L)
   if (!p)
     return luaL_error(L, "Invalid pattern set specified");
 
-  lua_PatternSet* set = *p;
+  const lua_PatternSet* set = *p;
 
   // Split by percentage...
   vector<double> percentages;
@@ -200,10 +219,9 @@ static int patternset__split_by_percentage(lua_State* L)
     // for each pattern in the original set
     end = beg + set->size()*percentage/100.0;
     end = end < set->size() ? end: set->size();
-    for (size_t c=beg; c<end; ++c) {
-      Pattern& pat = (*set)[c];
-      newset->push_back(pat);
-    }
+    newset->reserve(end - beg);
+    for (size_t c=beg; c<end; ++c)
+      newset->append(*set, c);
     beg = end;
   }
 
@@ -216,7 +234,7 @@ static int patternset__split_by_output(lua_State* L)
   if (!p)
     return luaL_error(L, "Invalid pattern set specified");
 
-  lua_PatternSet* set = *p;
+  const lua_PatternSet* set = *p;
 
   // Split by output...
   vector<int> outputs;
@@ -243,16 +261,95 @@ static int patternset__split_by_output(lua_State* L)
     // output of the pattern
     int output_nth = *it;
 
-    // for each pattern in the original set
-    for (size_t c=0; c<set->size(); ++c) {
-      Pattern& pat = (*set)[c];
+    // patterns of the original set for output_nth
+    if (output_nth >= 1) {
+      const vector<size_t>& patterns(set->getClass(output_nth-1));
+      newset->reserve(patterns.size());
+      for (size_t c=0; c<patterns.size(); ++c)
+	newset->append(*set, patterns[c]);
+    }
+  }
 
-      // this is a pattern for output_nth
-      if (output_nth == pat.getOutput().getMaxPos()+1) // TODO this should be parametric
-	newset->push_back(pat);
+  return 1;
+}
+
+/// Splits the set by percentage keeping the proportion of each class
+/// (output) in each subset. The patterns of each class are divided as
+/// in split_by_percentage.
+///
+/// @code
+/// PatternSet:split_stratified({ percentage1, percentage2... })
+/// @endcode
+static int patternset__split_stratified(lua_State* L)
+{
+  lua_PatternSet** p = toPatternSet(L, 1);
+  if (!p)
+    return luaL_error(L, "Invalid pattern set specified");
+
+  const lua_PatternSet* set = *p;
+
+  vector<double> percentages;
+
+  if (lua_istable(L, 2)) {
+    // iterate the table
+    lua_pushnil(L);		// push nil for first element of table
+    while (lua_next(L, 2) != 0) {
+      double percentage = lua_tonumber(L, -1); // get value
+      percentages.push_back(percentage);
+      lua_pop(L, 1);		// remove value, the key is in stack for next iteration
+    }
+  }
+
+  // subset of each pattern (percentages.size() for patterns in none)
+  vector<size_t> subset(set->size(), percentages.size());
+  for (size_t k=0; k<set->getClasses(); ++k) {
+    const vector<size_t>& patterns(set->getClass(k));
+    size_t beg = 0, end;
+    for (size_t i=0; i<percentages.size(); ++i) {
+      end = beg + patterns.size()*percentages[i]/100.0;
+      end = end < patterns.size() ? end: patterns.size();
+      for (size_t c=beg; c<end; ++c)
+	subset[patterns[c]] = i;
+      beg = end;
     }
   }
 
+  // put in the stack the return value (a new table)
+  lua_newtable(L);
+  vector<lua_PatternSet*> newsets;
+  for (size_t i=0; i<percentages.size(); ++i) {
+    lua_pushinteger(L, i+1);
+    newsets.push_back(*newpatternset(L));
+    lua_settable(L, -3);
+  }
+
+  // the patterns are added in the order of the original set
+  for (size_t c=0; c<set->size(); ++c)
+    if (subset[c] < newsets.size())
+      newsets[subset[c]]->append(*set, c);
+
+  return 1;
+}
+
+/// Creates a set with @a n random patterns of each class (see
+/// PatternSet::sampleBalanced). The patterns are chosen with the
+/// generator of ann.init_random.
+///
+/// @code
+/// PatternSet:sample_balanced(n)
+/// @endcode
+static int patternset__sample_balanced(lua_State* L)
+{
+  lua_PatternSet** p = toPatternSet(L, 1);
+  if (!p)
+    return luaL_error(L, "Invalid pattern set specified");
+
+  lua_Number n = luaL_checknumber(L, 2);
+  if (n < 0)
+    return luaL_error(L, "Invalid number of patterns for each class");
+
+  lua_PatternSet* sample = *newpatternset(L);
+  (*p)->sampleBalanced(*sample, (size_t)n);
   return 1;
 }
 
@@ -268,14 +365,22 @@ static int patternset__merge(lua_State* L)
     return luaL_error(L, "Invalid pattern set specified");
 
   int n = lua_gettop(L);	// number of arguments
-  for (int i=2; i<=n; ++i) {
+  bool ok = true;
+  for (int i=2; i<=n && ok; ++i) {
     lua_PatternSet* set = *toPatternSet(L, i); // get argument "i"
     if (set) {
-      // Add all patterns of 'set' in 'p'
-      for (lua_PatternSet::iterator it=set->begin(); it!=set->end(); ++it)
-	(*p)->push_back(**it);
+      // Add all patterns of 'set' in 'p' (they share the rows of
+      // 'set' until they are modified)
+      try {
+	(*p)->append(*set);
+      }
+      catch (std::invalid_argument&) {
+	ok = false;
+      }
     }
   }
+  if (!ok)
+    return luaL_error(L, "The patterns to merge do not have the inputs and outputs of the set");
 
   return 0;
 }
@@ -308,6 +413,8 @@ static const luaL_Reg patternset_metatable[] = {
   { "shuffle", patternset__shuffle },
   { "split_by_percentage", patternset__split_by_percentage },
   { "split_by_output", patternset__split_by_output },
+  { "split_stratified", patternset__split_stratified },
+  { "sample_balanced", patternset__sample_balanced },
   { "merge", patternset__merge },
   { "__gc", patternset__gc },
   { "__len", patternset__len },
@@ -327,29 +434,47 @@ void annlib::details::registerPatternSet(lua_State* L)
 ///
 /// @code
 /// set = ann.PatternSet()
-/// set = ann.PatternSet({ inputs=NUMBER, outputs=NUMBER, file=FILE })
+/// set = ann.PatternSet({ inputs=NUMBER, outputs=NUMBER, file=FILE,
+///			 on=NUMBER, off=NUMBER })
 /// @endcode
 ///
+/// The 'outputs' are the classes of the patterns: the set has label
+/// outputs (see PatternSet::setLabelOutputs) with the 'on' (1) and
+/// 'off' (0) values.
+///
 /// @return Pattern user data
 ///
 int annlib::details::PatternSetCtor(lua_State* L)
 {
   string file;
   size_t inputs = 1, outputs = 1;
+  bool labels = false;
+  double on = 1.0, off = 0.0;
   if (lua_istable(L, 1)) {
     lua_getfield(L, 1, "file");
     lua_getfield(L, 1, "inputs");
     lua_getfield(L, 1, "outputs");
-    if (lua_isstring(L, -1)) outputs = lua_tonumber(L, -1);
-    if (lua_isstring(L, -2)) inputs = lua_tonumber(L, -2);
-    if (lua_isstring(L, -3)) file = lua_tostring(L, -3);
-    lua_pop(L, 3);
+    lua_getfield(L, 1, "on");
+    lua_getfield(L, 1, "off");
+    if (lua_isnumber(L, -1)) off = lua_tonumber(L, -1);
+    if (lua_isnumber(L, -2)) on = lua_tonumber(L, -2);
+    if (lua_isstring(L, -3)) { outputs = lua_tonumber(L, -3); labels = true; }
+    if (lua_isstring(L, -4)) inputs = lua_tonumber(L, -4);
+    if (lua_isstring(L, -5)) file = lua_tostring(L, -5);
+    lua_pop(L, 5);
   }
 
+  if (outputs < 1 || on <= off)
+    return luaL_error(L, "Invalid 'outputs', 'on' or 'off' values (the 'on' value must be greater than 'off')");
+
   // Create the new pattern set
   lua_PatternSet* set = *newpatternset(L);
   lua_PatternSet& pattern_set(*set);
 
+  // The outputs are the classes of the patterns
+  if (labels || !file.empty())
+    pattern_set.setLabelOutputs(outputs, on, off);
+
   // Return the empty pattern set
   if (file.empty())
     return 1;			// the PatternSet is in the stack
@@ -366,31 +491,33 @@ int annlib::details::PatternSetCtor(lua_State* L)
     // For this line
     istringstream str(buf);
 
-    // Create one pattern (input/target pair)
-    Pattern pat(inputs, outputs);
-
     // Read input
-    for (size_t c=0; c<inputs; ++c) {
-      double input;
-      str >> input;
-      pat.setInput(c, input);
-    }
+    Vector input(inputs);
+    for (size_t c=0; c<inputs; ++c)
+      str >> input(c);
 
     // Read last digit (target)
     int target = 0;
     str >> target;
 
-    for (size_t c=0; c<outputs; ++c)
-      pat.setOutput(c, (c == target-1) ? 1.0: 0.0);
-
 #if 0			// To see if patterns are loaded correctly
     cout << "Pattern loaded:" << endl;
-    cout << "  in  = " << pat.getInput() << endl;
-    cout << "  out = " << pat.getOutput() << endl;
+    cout << "  in  = " << input << endl;
+    cout << "  out = " << target << endl;
 #endif
 
-    if (target <= outputs)
-      pattern_set.push_back(pat);
+    // The output is the class of the pattern (a pattern of class 0
+    // has all the outputs off, so the set copies the outputs of each
+    // pattern from that moment). Negative classes are skipped.
+    if (target >= 1 && target <= (int)outputs && pattern_set.hasLabelOutputs())
+      pattern_set.push_back(input, target-1);
+    else if (target >= 0 && target <= (int)outputs) {
+      Vector output(outputs);
+      std::fill(output.begin(), output.end(), off);
+      if (target >= 1)
+	output(target-1) = on;
+      pattern_set.push_back(Pattern(input, output));
+    }
   }
 
   // if (verbose_mode)
@@ -0,0 +1,128 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <stdexcept>
+
+#include "lua/annlib.h"
+
+#define LUAOBJ_QUANTIZEDMLP	"QuantizedMlp"
+
+using namespace std;
+using namespace annlib::details;
+
+lua_QuantizedMlp** annlib::details::toQuantizedMlp(lua_State* L, int pos)
+{
+  return ((lua_QuantizedMlp**)luaL_checkudata(L, pos, LUAOBJ_QUANTIZEDMLP));
+}
+
+static lua_QuantizedMlp** newquantizedmlp(lua_State* L)
+{
+  lua_QuantizedMlp** n = (lua_QuantizedMlp**)lua_newuserdata(L, sizeof(lua_QuantizedMlp**));
+  *n = new lua_QuantizedMlp;
+  luaL_getmetatable(L, LUAOBJ_QUANTIZEDMLP);
+  lua_setmetatable(L, -2);
+  return n;
+}
+
+/// Recalls all the patterns at once and returns a Matrix with the
+/// outputs of the network for each pattern in a column.
+///
+/// @code
+/// matrix = qnet:recall_batch(PatternSet, { threads=NUMBER })
+/// @endcode
+///
+static int quantizedmlp__recall_batch(lua_State* L)
+{
+  lua_QuantizedMlp** _net = toQuantizedMlp(L, 1);
+  if (!_net)
+    return 0;
+
+  lua_PatternSet* set = NULL;
+  if (lua_isuserdata(L, 2))
+    set = *toPatternSet(L, 2);
+
+  if (!set || set->empty())
+    return luaL_error(L, "Invalid pattern set specified");
+
+  int threads = 1;
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "threads");
+    if (lua_isnumber(L, -1)) threads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+  }
+  if (threads < 0)
+    return luaL_error(L, "Invalid number of threads specified (0 means one per processor)");
+
+  lua_Matrix* outputs = *newMatrix(L);
+  bool ok = true;
+  {
+    Matrix inputs;
+    set->getInputs(inputs);
+    try {
+      (*_net)->recallBatch(inputs, *outputs, threads);
+    }
+    catch (std::invalid_argument&) {
+      ok = false;
+    }
+  }
+  if (!ok)
+    return luaL_error(L, "The patterns do not have the inputs of the network");
+  return 1;
+}
+
+static int quantizedmlp__gc(lua_State* L)
+{
+  lua_QuantizedMlp** n = toQuantizedMlp(L, 1);
+  if (n) {
+    delete *n;
+    *n = NULL;
+  }
+  return 0;
+}
+
+static const luaL_Reg quantizedmlp_metatable[] = {
+  { "recall_batch",	quantizedmlp__recall_batch },
+  { "__gc",		quantizedmlp__gc },
+  { NULL, NULL }
+};
+
+void annlib::details::registerQuantizedMlp(lua_State* L)
+{
+  // QuantizedMlp user data
+  luaL_newmetatable(L, LUAOBJ_QUANTIZEDMLP);	// create metatable for QuantizedMlp
+  lua_pushvalue(L, -1);				// push metatable
+  lua_setfield(L, -2, "__index");		// metatable.__index = metatable
+  luaL_register(L, NULL, quantizedmlp_metatable); // QuantizedMlp methods
+}
+
+/// Creates an int8 copy of a trained Mlp or MlpArray (see
+/// QuantizedMlp).
+///
+/// @code
+/// qnet = ann.QuantizedMlp(Mlp|MlpArray)
+/// @endcode
+///
+int annlib::details::QuantizedMlpCtor(lua_State* L)
+{
+  bool isMlp = isUserData(L, 1, "Mlp");
+  if (!isMlp && !isUserData(L, 1, "MlpArray"))
+    return luaL_error(L, "Invalid argument in ann.QuantizedMlp (Mlp or MlpArray expected)");
+
+  lua_QuantizedMlp* net = *newquantizedmlp(L);
+  bool ok = true;
+  try {
+    if (isMlp)
+      net->compile(**toMlp(L, 1));
+    else
+      net->compile(**toMlpArray(L, 1));
+  }
+  catch (std::invalid_argument&) {
+    ok = false;
+  }
+  if (!ok)
+    return luaL_error(L, "The hidden layers must use ann.LOGSIG or ann.TANSIG to be quantized");
+
+  return 1; // the network is in the stack
+}
@@ -0,0 +1,183 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <stdexcept>
+#include <vector>
+
+#include "lua/imglib.h"
+#include "lua/annlib.h"
+
+#define LUAOBJ_RECOGNIZER	"Recognizer"
+
+using namespace std;
+using namespace imglib::details;
+
+lua_Recognizer** imglib::details::toRecognizer(lua_State* L, int pos)
+{
+  return ((lua_Recognizer**)luaL_checkudata(L, pos, LUAOBJ_RECOGNIZER));
+}
+
+static lua_Recognizer** newrecognizer(lua_State* L)
+{
+  lua_Recognizer** r = (lua_Recognizer**)lua_newuserdata(L, sizeof(lua_Recognizer**));
+  *r = new lua_Recognizer;
+  luaL_getmetatable(L, LUAOBJ_RECOGNIZER);
+  lua_setmetatable(L, -2);
+  return r;
+}
+
+/// Recognizes a set of images (all of them with one matrix product).
+///
+/// @code
+/// { subject1, subject2, ... } =
+///   recognizer:recognize({ image1, image2, ... }, { threads=NUMBER })
+/// @endcode
+///
+/// @return The output with the maximum value (1-based) for each
+///         image.
+///
+static int recognizer__recognize(lua_State* L)
+{
+  lua_Recognizer** r = toRecognizer(L, 1);
+  if (!r)
+    return luaL_error(L, "No Recognizer user-data specified");
+
+  int threads = 1;
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "threads");
+    if (lua_isnumber(L, -1)) threads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+  }
+  if (threads < 0)
+    return luaL_error(L, "Invalid number of threads specified (0 means one per processor)");
+
+  Matrix images;
+  size_t count = images2matrix(L, 2, images);
+  vector<size_t> subjects;
+  bool valid = true;
+  if (count > 0) {
+    try {
+      (*r)->recognizeBatch(images, subjects, threads);
+    }
+    catch (std::invalid_argument&) {
+      valid = false;
+    }
+  }
+  if (!valid)
+    return luaL_error(L, "Images do not have the size of the eigenfaces");
+
+  lua_newtable(L);
+  for (size_t j=0; j<subjects.size(); ++j) {
+    lua_pushinteger(L, j+1);
+    lua_pushinteger(L, subjects[j]+1);
+    lua_settable(L, -3);
+  }
+  return 1;
+}
+
+/// @code
+/// recognizer:save(FILENAME)
+/// @endcode
+///
+static int recognizer__save(lua_State* L)
+{
+  lua_Recognizer** r = toRecognizer(L, 1);
+  if (!r)
+    return luaL_error(L, "No Recognizer user-data specified");
+
+  string file;
+  if (lua_isstring(L, 2))
+    file = lua_tostring(L, 2);
+  else
+    return luaL_error(L, "File-name expected in Recognizer:save() as first argument");
+
+  (*r)->save(file.c_str());
+  return 0;
+}
+
+static int recognizer__gc(lua_State* L)
+{
+  lua_Recognizer** r = toRecognizer(L, 1);
+  if (r) {
+    delete *r;
+    *r = NULL;
+  }
+  return 0;
+}
+
+static const luaL_Reg recognizer_metatable[] = {
+  { "recognize",	recognizer__recognize },
+  { "save",		recognizer__save },
+  { "__gc",		recognizer__gc },
+  { NULL, NULL }
+};
+
+void imglib::details::registerRecognizer(lua_State* L)
+{
+  // Recognizer user data
+  luaL_newmetatable(L, LUAOBJ_RECOGNIZER);	// create metatable for Recognizer
+  lua_pushvalue(L, -1);				// push metatable
+  lua_setfield(L, -2, "__index");		// metatable.__index = metatable
+  luaL_register(L, NULL, recognizer_metatable); // Recognizer methods
+}
+
+/// Creates a recognizer from the eigenfaces, the normalizer of the
+/// patterns and the trained network (see Recognizer), or loads it
+/// from a file saved with recognizer:save.
+///
+/// @code
+/// recognizer = img.Recognizer({ eigenfaces=Eigenfaces,
+///				  normalizer=Normalizer,
+///				  mlp=Mlp|MlpArray })
+/// recognizer = img.Recognizer({ file=FILENAME })
+/// @endcode
+///
+int imglib::details::RecognizerCtor(lua_State* L)
+{
+  luaL_checktype(L, 1, LUA_TTABLE);
+
+  lua_Recognizer* r = *newrecognizer(L);	// at index 2
+
+  lua_getfield(L, 1, "file");
+  if (lua_isstring(L, -1)) {
+    r->load(lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return 1;
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, 1, "eigenfaces");
+  lua_getfield(L, 1, "normalizer");
+  lua_getfield(L, 1, "mlp");
+
+  lua_Eigenfaces* eig = NULL;
+  annlib::details::lua_Normalizer* normalizer = NULL;
+  if (lua_isuserdata(L, -3)) eig = *toEigenfaces(L, -3);
+  if (lua_isuserdata(L, -2)) normalizer = *annlib::details::toNormalizer(L, -2);
+  if (!eig || !normalizer)
+    return luaL_error(L, "Invalid eigenfaces or normalizer specified");
+
+  bool isMlp = annlib::details::isUserData(L, -1, "Mlp");
+  if (!isMlp && !annlib::details::isUserData(L, -1, "MlpArray"))
+    return luaL_error(L, "Invalid mlp specified (Mlp or MlpArray expected)");
+
+  bool ok = true;
+  try {
+    if (isMlp)
+      r->compile(*eig, normalizer->min, normalizer->max,
+		 **annlib::details::toMlp(L, -1));
+    else
+      r->compile(*eig, normalizer->min, normalizer->max,
+		 **annlib::details::toMlpArray(L, -1));
+  }
+  catch (std::invalid_argument&) {
+    ok = false;
+  }
+  if (!ok)
+    return luaL_error(L, "The network and the normalizer must have one input for each eigenface");
+
+  lua_pop(L, 3);
+  return 1; // the recognizer is in the stack
+}
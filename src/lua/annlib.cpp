@@ -5,6 +5,7 @@
 
 #include "lua/annlib.h"
 #include "Random.h"
+#include "MlpKernels.h"
 
 using namespace std;
 
@@ -26,12 +27,41 @@ static int annlib_init_random(lua_State* L)
   return 0;
 }
 
+/// Selects the polynomial (true) or the standard (false) exponential
+/// for Logsig and Tansig layers.
+///
+/// @code
+/// ann.fast_exp(BOOLEAN)
+/// @endcode
+///
+static int annlib_fast_exp(lua_State* L)
+{
+  exp_select(lua_toboolean(L, 1) ? FastExp: AccurateExp);
+  return 0;
+}
+
+/// Returns true if the value at @a pos is a user data of type @a name
+/// (e.g. to accept a Mlp or a MlpArray in the same argument).
+///
+bool annlib::details::isUserData(lua_State* L, int pos, const char* name)
+{
+  if (!lua_getmetatable(L, pos))
+    return false;
+
+  luaL_getmetatable(L, name);
+  bool res = lua_rawequal(L, -1, -2) ? true: false;
+  lua_pop(L, 2);
+  return res;
+}
+
 static const luaL_Reg annlib_funcstable[] = {
   { "init_random",	annlib_init_random },
+  { "fast_exp",		annlib_fast_exp },
   { "Mlp",		annlib::details::MlpCtor },
   { "MlpArray",		annlib::details::MlpArrayCtor },
   { "PatternSet",	annlib::details::PatternSetCtor },
   { "Normalizer",	annlib::details::NormalizerCtor },
+  { "QuantizedMlp",	annlib::details::QuantizedMlpCtor },
   { NULL,		NULL }
 };
 
@@ -60,9 +90,20 @@ void annlib::registerLibrary(lua_State* L)
   lua_pushnumber(L, TANSIG);
   lua_setfield(L, -2, "TANSIG");
 
+  lua_pushnumber(L, BACKPROP);
+  lua_setfield(L, -2, "BACKPROP");
+  lua_pushnumber(L, RPROP);
+  lua_setfield(L, -2, "RPROP");
+  lua_pushnumber(L, ADAM);
+  lua_setfield(L, -2, "ADAM");
+  lua_pushnumber(L, LM);
+  lua_setfield(L, -2, "LM");
+
   // Userdatas
+  annlib::details::registerMatrix(L);
   annlib::details::registerMlp(L);
   annlib::details::registerMlpArray(L);
   annlib::details::registerNormalizer(L);
   annlib::details::registerPatternSet(L);
+  annlib::details::registerQuantizedMlp(L);
 }
@@ -17,13 +17,16 @@ namespace annlib {
   enum { LAST, BESTMSE };	    // Learning algorithm goal
   enum { MINMAX, STDDEV };	    // Type of normalizer
   enum { PURELIN, LOGSIG, TANSIG }; // Type of activation function
+  enum { BACKPROP, RPROP, ADAM, LM }; // Training algorithm
 
   void registerLibrary(lua_State* L);
 
   namespace details {
 
+    typedef Matrix lua_Matrix;
     typedef Mlp lua_Mlp;
     typedef MlpArray lua_MlpArray;
+    typedef QuantizedMlp lua_QuantizedMlp;
 
     typedef PatternSet lua_PatternSet;
 
@@ -32,20 +35,29 @@ namespace annlib {
       Vector min, max;
     };
 
+    void registerMatrix(lua_State* L);
     void registerMlp(lua_State* L);
     void registerMlpArray(lua_State* L);
     void registerNormalizer(lua_State* L);
     void registerPatternSet(lua_State* L);
+    void registerQuantizedMlp(lua_State* L);
 
     int MlpCtor(lua_State* L);
     int MlpArrayCtor(lua_State* L);
     int NormalizerCtor(lua_State* L);
     int PatternSetCtor(lua_State* L);
+    int QuantizedMlpCtor(lua_State* L);
 
+    lua_Matrix** toMatrix(lua_State* L, int pos);
     lua_Mlp** toMlp(lua_State* L, int pos);
     lua_MlpArray** toMlpArray(lua_State* L, int pos);
     lua_Normalizer** toNormalizer(lua_State* L, int pos);
     lua_PatternSet** toPatternSet(lua_State* L, int pos);
+    lua_QuantizedMlp** toQuantizedMlp(lua_State* L, int pos);
+
+    lua_Matrix** newMatrix(lua_State* L);
+
+    bool isUserData(lua_State* L, int pos, const char* name);
 
   }
 
@@ -10,6 +10,7 @@ using namespace std;
 static const luaL_Reg imglib_funcstable[] = {
   { "Eigenfaces",	imglib::details::EigenfacesCtor },
   { "Image",		imglib::details::ImageCtor },
+  { "Recognizer",	imglib::details::RecognizerCtor },
   { NULL,		NULL }
 };
 
@@ -23,4 +24,5 @@ void imglib::registerLibrary(lua_State* L)
   // Userdatas
   imglib::details::registerImage(L);
   imglib::details::registerEigenfaces(L);
+  imglib::details::registerRecognizer(L);
 }
@@ -11,6 +11,7 @@
 #include <CImg.h>
 
 #include "Eigenfaces.h"
+#include "Recognizer.h"
 
 namespace imglib {
 
@@ -20,17 +21,22 @@ namespace imglib {
 
     typedef Eigenfaces lua_Eigenfaces;
     typedef cimg_library::CImg<unsigned char> lua_Image;
+    typedef Recognizer lua_Recognizer;
 
     void registerEigenfaces(lua_State* L);
     void registerImage(lua_State* L);
+    void registerRecognizer(lua_State* L);
 
     int EigenfacesCtor(lua_State* L);
     int ImageCtor(lua_State* L);
+    int RecognizerCtor(lua_State* L);
 
     lua_Eigenfaces** toEigenfaces(lua_State* L, int pos);
     lua_Image** toImage(lua_State* L, int pos);
+    lua_Recognizer** toRecognizer(lua_State* L, int pos);
 
     void image2vector(const lua_Image* img, Vector& output);
+    size_t images2matrix(lua_State* L, int pos, Matrix& images);
 
   }
 
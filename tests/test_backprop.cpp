@@ -0,0 +1,548 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "Ann.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+// Counts heap allocations to check that training does not allocate
+// memory for each pattern.
+static size_t allocs = 0;
+
+void* operator new(size_t size)
+{
+  ++allocs;
+  void* p = std::malloc(size ? size: 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p)
+{
+  std::free(p);
+}
+
+static void fill_set(PatternSet& set, size_t patterns)
+{
+  for (size_t p=0; p<patterns; ++p) {
+    Pattern pattern(8, 3);
+    for (size_t i=0; i<8; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    for (size_t k=0; k<3; ++k)
+      pattern.setOutput(k, (p % 3) == k ? 1.0: -1.0);
+    set.push_back(pattern);
+  }
+}
+
+static size_t epoch_allocs(size_t patterns)
+{
+  PatternSet set;
+  fill_set(set, patterns);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.1, 0.1);
+  Backpropagation bp(net);
+  bp.setMomentum(0.5);
+  bp.train(set);		// First epoch creates the momentum matrices
+
+  size_t before = allocs;
+  bp.train(set);
+  return allocs - before;
+}
+
+static void test_no_allocations()
+{
+  // The number of allocations per epoch does not depend on the
+  // number of patterns
+  assert(epoch_allocs(5) == epoch_allocs(50));
+}
+
+static void test_training()
+{
+  PatternSet set;
+  fill_set(set, 30);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.1, 0.1);
+  Backpropagation bp(net);
+  bp.setLearningRate(0.05);
+  bp.setMomentum(0.8);
+
+  double mse = net.calcMSE(set);
+  for (int epoch=0; epoch<200; ++epoch)
+    bp.train(set);
+  assert(net.calcMSE(set) < mse);
+}
+
+// One epoch with only one batch (with all patterns) must apply the
+// sum of the deltas that each pattern gives in online training.
+static void test_batch_equals_sum_of_deltas()
+{
+  PatternSet set;
+  fill_set(set, 12);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.5, 0.5);
+
+  // expected = net + sum(delta_p) = sum(net + delta_p) - (P-1)*net
+  Mlp expected(net), tmp(net);
+  expected.zero();
+  for (size_t p=0; p<set.size(); ++p) {
+    PatternSet one;
+    one.push_back(set[p]);
+
+    Mlp copy(net);
+    Backpropagation bp(copy);
+    bp.setLearningRate(0.1);
+    bp.train(one);
+    expected += copy;
+  }
+  tmp *= -double(set.size()-1);
+  expected += tmp;
+
+  Backpropagation bp(net);
+  bp.setLearningRate(0.1);
+  bp.setBatchSize(set.size());
+  bp.train(set);
+
+  double a = net.calcMSE(set);
+  double b = expected.calcMSE(set);
+  assert(std::fabs(a - b) < 1e-12);
+}
+
+static void test_batch_training()
+{
+  PatternSet set;
+  fill_set(set, 30);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.1, 0.1);
+  Backpropagation bp(net);
+  bp.setLearningRate(0.01);
+  bp.setMomentum(0.8);
+  bp.setBatchSize(7);		// The last batch has only 2 patterns
+
+  double mse = net.calcMSE(set);
+  for (int epoch=0; epoch<200; ++epoch)
+    bp.train(set);
+  assert(net.calcMSE(set) < mse);
+}
+
+// A float network follows the training of the same double network
+// (online and with batches), and recalls the same outputs
+static void test_float_training()
+{
+  PatternSet set;
+  fill_set(set, 30);
+
+  for (size_t batch=1; batch<=7; batch+=6) {
+    Mlp net(8, 6, 3);
+    net.setHiddenActivationFunction(Tansig());
+    net.initRandom(-0.1, 0.1);
+    MlpT<float> netf;
+    netf.assign(net);
+
+    Backpropagation bp(net);
+    BackpropagationT<float> bpf(netf);
+    bp.setLearningRate(0.02);
+    bpf.setLearningRate(0.02);
+    bp.setBatchSize(batch);
+    bpf.setBatchSize(batch);
+
+    double mse = netf.calcMSE(set);
+    for (int epoch=0; epoch<100; ++epoch) {
+      bp.train(set);
+      bpf.train(set);
+    }
+    double a = net.calcMSE(set);
+    double b = netf.calcMSE(set);
+    assert(b < mse);
+    assert(std::fabs(a - b) < 1e-4 * (1.0 + a));
+
+    MatrixT<float> inputs(8, set.size()), outputs;
+    for (size_t p=0; p<set.size(); ++p)
+      for (size_t i=0; i<8; ++i)
+	inputs(i, p) = float(set[p].getInput()(i));
+    netf.recallBatch(inputs, outputs);
+
+    Vector hidden, output;
+    for (size_t p=0; p<set.size(); ++p) {
+      net.recall(set[p].getInput(), hidden, output);
+      for (size_t k=0; k<3; ++k)
+	assert(std::fabs(outputs(k, p) - output(k)) < 1e-3);
+    }
+  }
+}
+
+static void write_net(const Mlp& net, std::string& data)
+{
+  std::ostringstream s;
+  net.write(s);
+  data = s.str();
+}
+
+// Functions that are not recognized by mlp_kernels (so they are
+// called neuron by neuron as custom functions)
+class VirtualLogsig : public Logsig
+{
+public:
+  ActivationKind getKind() const { return CustomActivation; }
+  VirtualLogsig* clone() const { return new VirtualLogsig(*this); }
+};
+
+class VirtualTansig : public Tansig
+{
+public:
+  ActivationKind getKind() const { return CustomActivation; }
+  VirtualTansig* clone() const { return new VirtualTansig(*this); }
+};
+
+static void train_net(Mlp& net, const PatternSet& set, size_t batchSize)
+{
+  Backpropagation bp(net);
+  bp.setLearningRate(0.01);
+  bp.setMomentum(0.5);
+  bp.setBatchSize(batchSize);
+  for (int epoch=0; epoch<5; ++epoch)
+    bp.train(set);
+}
+
+// The specialized layers give the same nets as the virtual
+// functions, and the fast exp almost the same
+static void test_specialized_activations()
+{
+  PatternSet set;
+  fill_set(set, 40);
+
+  Mlp initial(8, 6, 3);
+  initial.initRandom(-0.5, 0.5);
+
+  const size_t batchSizes[] = { 1, 10 };
+  for (size_t b=0; b<2; ++b) {
+    Mlp special(initial), virt(initial), fast(initial);
+    special.setHiddenActivationFunction(Logsig());
+    special.setOutputActivationFunction(Tansig());
+    virt.setHiddenActivationFunction(VirtualLogsig());
+    virt.setOutputActivationFunction(VirtualTansig());
+    fast.setHiddenActivationFunction(Logsig());
+    fast.setOutputActivationFunction(Tansig());
+
+    std::string a, c;
+    train_net(special, set, batchSizes[b]);
+    train_net(virt, set, batchSizes[b]);
+    write_net(special, a);
+    write_net(virt, c);
+    assert(a == c);
+
+    exp_select(FastExp);
+    train_net(fast, set, batchSizes[b]);
+    assert(std::fabs(fast.calcMSE(set) - special.calcMSE(set)) < 1e-10);
+    exp_select(AccurateExp);
+  }
+}
+
+// Synchronous mode gives the same net with any number of threads
+static void test_threads_are_deterministic()
+{
+  PatternSet set;
+  fill_set(set, 150);
+
+  Mlp initial(8, 6, 3);
+  initial.initRandom(-0.5, 0.5);
+
+  std::string data[3];
+  const size_t threads[] = { 1, 2, 5 };
+
+  for (size_t t=0; t<3; ++t) {
+    Mlp net(initial);
+    Backpropagation bp(net);
+    bp.setLearningRate(0.01);
+    bp.setMomentum(0.5);
+    bp.setBatchSize(100);	// 4 chunks per batch
+    bp.setThreads(threads[t]);
+    for (int epoch=0; epoch<5; ++epoch)
+      bp.train(set);
+    write_net(net, data[t]);
+  }
+
+  assert(data[0] == data[1]);
+  assert(data[0] == data[2]);
+}
+
+static void test_hogwild()
+{
+  PatternSet set;
+  fill_set(set, 60);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.1, 0.1);
+  Backpropagation bp(net);
+  bp.setLearningRate(0.05);
+  bp.setThreads(3);
+  bp.setParallelMode(Backpropagation::HogwildMode);
+
+  double mse = net.calcMSE(set);
+  for (int epoch=0; epoch<100; ++epoch)
+    bp.train(set);
+  assert(net.calcMSE(set) < mse);
+}
+
+// iRPROP+ and Adam reduce the error, and iRPROP+ uses the whole set
+// as one batch (the batch size and threads do not change the result)
+static void test_optimizers()
+{
+  PatternSet set;
+  fill_set(set, 30);
+
+  Mlp initial(8, 6, 3);
+  initial.initRandom(-0.1, 0.1);
+  double mse = initial.calcMSE(set);
+
+  std::string data[3];
+  for (size_t i=0; i<3; ++i) {
+    Mlp net(initial);
+    Backpropagation bp(net);
+    bp.setOptimizer(Rprop());
+    bp.setBatchSize(i == 0 ? 1: 7);
+    bp.setThreads(i == 2 ? 3: 1);
+    for (int epoch=0; epoch<50; ++epoch)
+      bp.train(set);
+    assert(bp.calcMSE(set) < mse);
+    write_net(net, data[i]);
+  }
+  assert(data[0] == data[1]);
+  assert(data[0] == data[2]);
+
+  Mlp net(initial);
+  Backpropagation bp(net);
+  bp.setOptimizer(Adam(0.01));
+  bp.setBatchSize(5);
+  for (int epoch=0; epoch<50; ++epoch)
+    bp.train(set);
+  assert(bp.calcMSE(set) < mse);
+
+  MlpT<float> netf(8, 6, 3);
+  netf.initRandom(-0.1, 0.1);
+  BackpropagationT<float> bpf(netf);
+  bpf.setOptimizer(RpropT<float>());
+  mse = netf.calcMSE(set);
+  for (int epoch=0; epoch<50; ++epoch)
+    bpf.train(set);
+  assert(netf.calcMSE(set) < mse);
+}
+
+// The MSE of each epoch is calculated once (the bold driver and the
+// caller share it), and the training pass gives the MSE of the net
+// before the epoch when the whole set is one batch.
+static void test_epoch_statistics()
+{
+  PatternSet set, validation;
+  fill_set(set, 30);
+  fill_set(validation, 10);
+
+  Mlp net(8, 6, 3);
+  net.initRandom(-0.1, 0.1);
+  Backpropagation bp(net);
+  bp.setLearningRate(0.05);
+  bp.setAdaptativeLearningRate(BoldDriverMethod());
+
+  // The same training calculating the MSE with the net
+  Mlp net2(net);
+  double eta = 0.05;
+
+  assert(bp.calcMSE(set) == net.calcMSE(set));
+  assert(bp.getForwardPasses() == 1);
+
+  for (int epoch=0; epoch<20; ++epoch) {
+    size_t passes = bp.getForwardPasses();
+    bp.train(set);
+    double mse = bp.calcMSE(set);
+    double mse2 = bp.calcMSE(validation);
+    assert(bp.calcMSE(validation) == mse2);
+
+    // The training pass, the MSE after the epoch (the MSE before the
+    // epoch was reused), and the validation set
+    assert(bp.getForwardPasses() - passes == 3);
+    assert(mse == net.calcMSE(set));
+    assert(mse2 == net.calcMSE(validation));
+
+    // Bold driver without the cache
+    Mlp backup(net2);
+    double before = net2.calcMSE(set);
+    Backpropagation bp2(net2);
+    bp2.setLearningRate(eta);
+    bp2.train(set);
+    if (net2.calcMSE(set) < before)
+      eta *= 1.1;
+    else {
+      net2 = backup;
+      eta *= 0.5;
+    }
+    assert(bp.getLearningRate() == eta);
+  }
+
+  // Full batch: the error of the training pass is the MSE before the
+  // epoch
+  double mse = bp.calcMSE(set);
+  bp.setAdaptativeLearningRate(NoAdaptativeLearningRate());
+  bp.setBatchSize(set.size());
+  bp.train(set);
+  assert(std::fabs(bp.getTrainingError() - mse) < 1e-12);
+
+  // Modified sets are not in the cache
+  mse = bp.calcMSE(validation);
+  size_t passes = bp.getForwardPasses();
+  validation.shuffle();
+  assert(bp.calcMSE(validation) == mse);
+  validation[0].setInput(0, validation[0].getInput(0) + 1.0);
+  assert(bp.calcMSE(validation) == net.calcMSE(validation));
+  assert(bp.calcMSE(validation) != mse);
+  assert(bp.getForwardPasses() - passes == 1);
+
+  PatternSet other(validation);
+  other.push_back(Pattern(set[0]));
+  validation = other;
+  assert(bp.calcMSE(validation) == net.calcMSE(validation));
+  assert(bp.getForwardPasses() - passes == 2);
+}
+
+// Epoch time versus batch size with the size of the ORL patterns
+// (320 training patterns of 50 inputs, 40 subjects)
+static void bench_batch()
+{
+  PatternSet set;
+  for (size_t p=0; p<320; ++p) {
+    Pattern pattern(50, 40);
+    for (size_t i=0; i<50; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    for (size_t k=0; k<40; ++k)
+      pattern.setOutput(k, (p % 40) == k ? 1.0: 0.0);
+    set.push_back(pattern);
+  }
+
+  const size_t sizes[] = { 1, 4, 16, 64, 320 };
+  for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s) {
+    Mlp net(50, 60, 40);
+    net.initRandom(-1.0, 1.0);
+    Backpropagation bp(net);
+    bp.setBatchSize(sizes[s]);
+
+    Chrono chrono;
+    for (int epoch=0; epoch<20; ++epoch)
+      bp.train(set);
+    printf("batch=%3d: %.6f secs/epoch\n", (int)sizes[s], chrono.elapsed() / 20);
+  }
+
+  // The same with the polynomial exp
+  exp_select(FastExp);
+  for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s) {
+    Mlp net(50, 60, 40);
+    net.initRandom(-1.0, 1.0);
+    Backpropagation bp(net);
+    bp.setBatchSize(sizes[s]);
+
+    Chrono chrono;
+    for (int epoch=0; epoch<20; ++epoch)
+      bp.train(set);
+    printf("batch=%3d, fast exp: %.6f secs/epoch\n", (int)sizes[s], chrono.elapsed() / 20);
+  }
+  exp_select(AccurateExp);
+
+  // The same in single precision
+  for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s) {
+    MlpT<float> net(50, 60, 40);
+    net.initRandom(-1.0, 1.0);
+    BackpropagationT<float> bp(net);
+    bp.setBatchSize(sizes[s]);
+
+    Chrono chrono;
+    for (int epoch=0; epoch<20; ++epoch)
+      bp.train(set);
+    printf("batch=%3d, float: %.6f secs/epoch\n", (int)sizes[s], chrono.elapsed() / 20);
+  }
+}
+
+// Epochs and time that iRPROP+ and Adam need to reach the MSE of
+// 100 epochs of online steepest descent (with the learning rate and
+// momentum of net:train)
+static void bench_optimizers()
+{
+  PatternSet set;
+  for (size_t p=0; p<320; ++p) {
+    Pattern pattern(50, 40);
+    for (size_t i=0; i<50; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    for (size_t k=0; k<40; ++k)
+      pattern.setOutput(k, (p % 40) == k ? 1.0: 0.0);
+    set.push_back(pattern);
+  }
+
+  Mlp initial(50, 60, 40);
+  initial.setOutputActivationFunction(Logsig());
+  initial.initRandom(-1.0, 1.0);
+
+  Mlp net(initial);
+  Backpropagation bp(net);
+  bp.setLearningRate(0.6);
+  bp.setMomentum(0.4);
+
+  Chrono chrono;
+  for (int epoch=0; epoch<100; ++epoch)
+    bp.train(set);
+  double goal = bp.calcMSE(set);
+  printf("steepest descent: MSE=%g in 100 epochs, %.6f secs\n", goal, chrono.elapsed());
+
+  for (int o=0; o<2; ++o) {
+    Mlp net(initial);
+    Backpropagation bp(net);
+    if (o == 0)
+      bp.setOptimizer(Rprop());
+    else {
+      bp.setOptimizer(Adam(0.01));
+      bp.setBatchSize(16);
+    }
+
+    int epochs = 0;
+    chrono.reset();
+    while (epochs < 1000 && bp.calcMSE(set) > goal) {
+      bp.train(set);
+      ++epochs;
+    }
+    printf("%s: MSE=%g in %d epochs, %.6f secs\n",
+	   o == 0 ? "irprop+": "adam (batch=16)",
+	   bp.calcMSE(set), epochs, chrono.elapsed());
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_no_allocations();
+  test_training();
+  test_batch_equals_sum_of_deltas();
+  test_batch_training();
+  test_threads_are_deterministic();
+  test_hogwild();
+  test_optimizers();
+  test_epoch_statistics();
+  test_specialized_activations();
+  test_float_training();
+
+  bench_batch();
+  bench_optimizers();
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Blas.h"
+#include "Random.h"
+
+using namespace std;
+
+static bool near(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-10 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+static void fill_random(vector<double>& v)
+{
+  for (size_t i=0; i<v.size(); ++i)
+    v[i] = Random::getReal() - 0.5;
+}
+
+// Element (i,j) of op(A), where A is stored column by column
+static double op_at(GemmOp op, const double* A, size_t lda, size_t i, size_t j)
+{
+  return op == GemmNormal ? A[i+j*lda]: A[j+i*lda];
+}
+
+static void test_gemm(GemmOp opA, GemmOp opB)
+{
+  const size_t m = 7, n = 5, k = 9, ld = 11;
+  vector<double> A(ld*k), B(ld*k), C(ld*n), D;
+  fill_random(A);
+  fill_random(B);
+  fill_random(C);
+  D = C;
+
+  blas_gemm(opA, opB, m, n, k, 0.5, &A[0], ld, &B[0], ld, -2.0, &C[0], ld);
+
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<m; ++i) {
+      double s = 0.0;
+      for (size_t l=0; l<k; ++l)
+	s += op_at(opA, &A[0], ld, i, l) * op_at(opB, &B[0], ld, l, j);
+      assert(near(C[i+j*ld], 0.5*s - 2.0*D[i+j*ld]));
+    }
+}
+
+static void test_gemm_parallel(GemmOp opB)
+{
+  const size_t m = 9, n = 70, k = 12;
+  vector<double> A(m*k), B(k*n), C(m*n), D(m*n);
+  fill_random(A);
+  fill_random(B);
+
+  size_t ldb = (opB == GemmNormal ? k: n);
+  blas_gemm(GemmNormal, opB, m, n, k, 1.0, &A[0], m, &B[0], ldb, 0.0, &C[0], m);
+  blas_gemm_parallel(GemmNormal, opB, m, n, k, 1.0, &A[0], m, &B[0], ldb, 0.0, &D[0], m, 3);
+
+  for (size_t i=0; i<m*n; ++i)
+    assert(near(C[i], D[i]));
+}
+
+static void test_gemv(GemmOp op, double alpha, double beta)
+{
+  const size_t m = 13, n = 6, lda = 15;
+  const size_t nx = (op == GemmNormal ? n: m);
+  const size_t ny = (op == GemmNormal ? m: n);
+  vector<double> A(lda*n), x(nx), y(ny), z;
+  fill_random(A);
+  fill_random(x);
+  fill_random(y);
+  z = y;
+
+  blas_gemv(op, m, n, alpha, &A[0], lda, &x[0], beta, &y[0]);
+
+  for (size_t i=0; i<ny; ++i) {
+    double s = 0.0;
+    for (size_t j=0; j<nx; ++j)
+      s += op_at(op, &A[0], lda, i, j) * x[j];
+    assert(near(y[i], alpha*s + beta*z[i]));
+  }
+}
+
+static void test_ger()
+{
+  const size_t m = 9, n = 4, lda = 10;
+  vector<double> A(lda*n), x(m), y(n), B;
+  fill_random(A);
+  fill_random(x);
+  fill_random(y);
+  B = A;
+
+  blas_ger(m, n, 3.0, &x[0], &y[0], &A[0], lda);
+
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<m; ++i)
+      assert(near(A[i+j*lda], B[i+j*lda] + 3.0*x[i]*y[j]));
+}
+
+static void test_syrk(GemmOp op)
+{
+  const size_t n = 6, k = 10, ld = 12;
+  vector<double> A(ld*k), C(ld*n);
+  fill_random(A);
+
+  blas_syrk(op, n, k, 1.0, &A[0], ld, 0.0, &C[0], ld);
+
+  // op(A) is n x k, C = op(A)*op(A)^T
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<n; ++i) {
+      double s = 0.0;
+      for (size_t l=0; l<k; ++l)
+	s += op_at(op, &A[0], ld, i, l) * op_at(op, &A[0], ld, j, l);
+      assert(near(C[i+j*ld], s));
+    }
+}
+
+static void test_level1()
+{
+  const size_t n = 37;
+  vector<double> x(n), y(n), z;
+  fill_random(x);
+  fill_random(y);
+  z = y;
+
+  double s = 0.0;
+  for (size_t i=0; i<n; ++i)
+    s += x[i]*y[i];
+  assert(near(blas_dot(n, &x[0], &y[0]), s));
+
+  blas_axpy(n, -1.5, &x[0], &y[0]);
+  for (size_t i=0; i<n; ++i)
+    assert(near(y[i], z[i] - 1.5*x[i]));
+}
+
+// Single precision routines give the double results with float
+// precision
+static void test_single_precision()
+{
+  const size_t m = 23, n = 17, k = 31;
+  vector<double> A(m*k), B(k*n), C(m*n, 0.0), x(k), y(m, 0.0);
+  fill_random(A);
+  fill_random(B);
+  fill_random(x);
+
+  vector<float> Af(A.begin(), A.end()), Bf(B.begin(), B.end()), Cf(m*n, 0.0f);
+  vector<float> xf(x.begin(), x.end()), yf(m, 0.0f);
+
+  blas_gemm(GemmNormal, GemmNormal, m, n, k, 1.0, &A[0], m, &B[0], k, 0.0, &C[0], m);
+  blas_gemm(GemmNormal, GemmNormal, m, n, k, 1.0f, &Af[0], m, &Bf[0], k, 0.0f, &Cf[0], m);
+  for (size_t i=0; i<m*n; ++i)
+    assert(std::fabs(C[i] - Cf[i]) <= 1e-5);
+
+  std::fill(Cf.begin(), Cf.end(), 0.0f);
+  blas_gemm_parallel(GemmNormal, GemmNormal, m, n, k, 1.0f, &Af[0], m, &Bf[0], k, 0.0f, &Cf[0], m, 3);
+  for (size_t i=0; i<m*n; ++i)
+    assert(std::fabs(C[i] - Cf[i]) <= 1e-5);
+
+  blas_gemv(GemmNormal, m, k, 1.0, &A[0], m, &x[0], 0.0, &y[0]);
+  blas_gemv(GemmNormal, m, k, 1.0f, &Af[0], m, &xf[0], 0.0f, &yf[0]);
+  for (size_t i=0; i<m; ++i)
+    assert(std::fabs(y[i] - yf[i]) <= 1e-5);
+
+  assert(std::fabs(blas_dot(k, &x[0], &x[0]) - blas_dot(k, &xf[0], &xf[0])) <= 1e-5);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  printf("BLAS backend: %s\n", blas_backend());
+
+  test_gemm(GemmNormal, GemmNormal);
+  test_gemm(GemmNormal, GemmTransposed);
+  test_gemm(GemmTransposed, GemmNormal);
+  test_gemm(GemmTransposed, GemmTransposed);
+
+  test_gemm_parallel(GemmNormal);
+  test_gemm_parallel(GemmTransposed);
+
+  test_gemv(GemmNormal, 1.0, 0.0);
+  test_gemv(GemmNormal, 2.0, 0.5);
+  test_gemv(GemmTransposed, 1.0, 0.0);
+  test_gemv(GemmTransposed, -1.0, 1.0);
+
+  test_ger();
+  test_syrk(GemmNormal);
+  test_syrk(GemmTransposed);
+  test_level1();
+  test_single_precision();
+  return 0;
+}
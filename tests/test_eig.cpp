@@ -0,0 +1,211 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <sstream>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Eigenfaces.h"
+#include "Random.h"
+
+using namespace std;
+
+static bool near(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-8 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal() - 0.5;
+}
+
+static void test_eig_sym()
+{
+  const size_t n = 40, k = 6;
+  Matrix X(60, n), A;
+  fill_random(X);
+  X.multiplyTransposed(X, A);	// A = X^T*X (symmetric)
+
+  Vector values, all_values;
+  Matrix vectors, all_vectors;
+  A.eig_sym(all_values);
+  A.eig_sym(values, all_vectors);
+  assert(values.size() == n);
+  assert(all_vectors.rows() == n && all_vectors.cols() == n);
+
+  // Descending order
+  for (size_t i=1; i<n; ++i) {
+    assert(all_values(i-1) >= all_values(i));
+    assert(near(values(i), all_values(i)));
+  }
+
+  // Only the k largest eigenpairs
+  A.eig_sym(values, vectors, k);
+  assert(values.size() == k);
+  assert(vectors.rows() == n && vectors.cols() == k);
+
+  for (size_t i=0; i<k; ++i) {
+    assert(near(values(i), all_values(i)));
+
+    // A*v = lambda*v and |v| = 1
+    Vector v = vectors.getCol(i);
+    Vector Av = A * v;
+    for (size_t j=0; j<n; ++j)
+      assert(near(Av(j), values(i) * v(j)));
+    assert(near(v.magnitude(), 1.0));
+  }
+
+  // The same eigenpairs from one tridiagonal reduction
+  Matrix k_vectors(vectors);
+  SymmetricEigen eigen;
+  eigen.reduce(A);
+  eigen.getEigenvalues(values);
+  assert(values.size() == n);
+  for (size_t i=0; i<n; ++i)
+    assert(near(values(i), all_values(i)));
+
+  for (size_t c=0; c<2; ++c) {
+    size_t count = (c == 0 ? k: n);
+    eigen.getEigenvectors(values, vectors, count);
+    assert(values.size() == count);
+    assert(vectors.rows() == n && vectors.cols() == count);
+
+    for (size_t i=0; i<count; ++i) {
+      assert(near(values(i), all_values(i)));
+
+      Vector v = vectors.getCol(i);
+      Vector Av = A * v;
+      for (size_t j=0; j<n; ++j) {
+	assert(near(Av(j), values(i) * v(j)));
+	if (count == k)		// The same signs of Matrix::eig_sym
+	  assert(near(v(j), k_vectors(j, i)));
+      }
+      assert(near(v.magnitude(), 1.0));
+    }
+  }
+}
+
+static void test_eigenfaces()
+{
+  const size_t pixels = 100, images = 30, k = 5;
+  Eigenfaces eig;
+  Vector image(pixels);
+
+  eig.reserve(images);
+  for (size_t i=0; i<images; ++i) {
+    for (size_t j=0; j<pixels; ++j)
+      image(j) = Random::getReal();
+    eig.addImage(image);
+  }
+
+  bool ok = eig.calculateEigenvalues();
+  assert(ok);
+  assert(eig.getEigenvaluesCount() == images);
+
+  eig.calculateEigenfaces(k);
+  assert(eig.getEigenfaceComponents() == k);
+
+  // Read back the eigenfaces (same binary format of Vector/Matrix)
+  stringstream s;
+  eig.write(s);
+  Vector values, mean;
+  Matrix vectors, eigenfaces, I;
+  values.read(s);
+  mean.read(s);
+  vectors.read(s);
+  eigenfaces.read(s);
+  assert(vectors.rows() == images && vectors.cols() == k);
+  assert(eigenfaces.rows() == pixels && eigenfaces.cols() == k);
+
+  // Eigenfaces are orthonormal
+  eigenfaces.multiplyTransposed(eigenfaces, I);
+  for (size_t j=0; j<k; ++j)
+    for (size_t i=0; i<k; ++i)
+      assert(near(I(i, j), i == j ? 1.0: 0.0));
+}
+
+static void test_project_batch()
+{
+  const size_t pixels = 64, images = 20, k = 4;
+  Eigenfaces eig;
+  Matrix faces(pixels, images), points;
+  Vector point;
+
+  for (size_t j=0; j<images; ++j)
+    for (size_t i=0; i<pixels; ++i)
+      faces(i, j) = Random::getReal();
+
+  for (size_t j=0; j<images; ++j)
+    eig.addImage(faces.getCol(j));
+  bool ok = eig.calculateEigenvalues();
+  assert(ok);
+  eig.calculateEigenfaces(k);
+
+  // Each column of the batch is the projection of one image
+  eig.projectBatch(faces, points);
+  assert(points.rows() == k && points.cols() == images);
+
+  for (size_t j=0; j<images; ++j) {
+    eig.projectInEigenspace(faces.getCol(j), point);
+    for (size_t i=0; i<k; ++i)
+      assert(near(points(i, j), point(i)));
+  }
+}
+
+// Float eigenfaces give the projections of double ones, and their
+// files can be loaded as double eigenfaces
+static void test_float_eigenfaces()
+{
+  const size_t pixels = 80, images = 25, k = 5;
+  Eigenfaces eig;
+  EigenfacesT<float> eigf;
+  Vector image(pixels);
+  Matrix faces(pixels, images), points;
+  MatrixT<float> facesf, pointsf;
+
+  for (size_t j=0; j<images; ++j) {
+    for (size_t i=0; i<pixels; ++i)
+      faces(i, j) = image(i) = Random::getReal();
+    eig.addImage(image);
+    eigf.addImage(image);
+  }
+  facesf.assign(faces);
+
+  bool ok = eig.calculateEigenvalues() && eigf.calculateEigenvalues();
+  assert(ok);
+  eig.calculateEigenfaces(k);
+  eigf.calculateEigenfaces(k);
+
+  eig.projectBatch(faces, points);
+  eigf.projectBatch(facesf, pointsf);
+  for (size_t j=0; j<images; ++j)
+    for (size_t i=0; i<k; ++i)
+      assert(std::fabs(points(i, j) - pointsf(i, j)) < 1e-4);
+
+  stringstream s;
+  eigf.write(s);
+  Eigenfaces eig2;
+  eig2.read(s);
+  eig2.projectBatch(faces, points);
+  for (size_t j=0; j<images; ++j)
+    for (size_t i=0; i<k; ++i)
+      assert(std::fabs(points(i, j) - pointsf(i, j)) < 1e-4);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_eig_sym();
+  test_eigenfaces();
+  test_project_batch();
+  test_float_eigenfaces();
+  return 0;
+}
@@ -0,0 +1,214 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Random.h"
+
+using namespace std;
+
+// Counts heap allocations to check that expressions do not create
+// temporary vectors.
+static size_t allocs = 0;
+
+void* operator new(size_t size)
+{
+  ++allocs;
+  void* p = std::malloc(size ? size: 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p)
+{
+  std::free(p);
+}
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal() - 0.5;
+}
+
+static void fill_random(Vector& u)
+{
+  for (size_t i=0; i<u.size(); ++i)
+    u(i) = Random::getReal() - 0.5;
+}
+
+/// Old A*u loop.
+///
+static Vector old_product(const Matrix& A, const Vector& u)
+{
+  Vector v(A.rows());
+  for (size_t i=0; i<A.rows(); ++i) {
+    double r = 0.0;
+    for (size_t j=0; j<A.cols(); ++j)
+      r += A(i, j) * u(j);
+    v(i) = r;
+  }
+  return v;
+}
+
+static void test_vector_ops()
+{
+  Vector u(7), v(7), w(7), r(7);
+  fill_random(u);
+  fill_random(v);
+  fill_random(w);
+
+  r = u + v - 2.0*w;
+  for (size_t i=0; i<r.size(); ++i)
+    assert(approx_eq(r(i), u(i) + v(i) - 2.0*w(i), 10));
+
+  r = (u - v) / 4.0;
+  for (size_t i=0; i<r.size(); ++i)
+    assert(r(i) == (u(i) - v(i)) / 4.0);
+
+  // Aliasing with element-wise expressions
+  r = u;
+  r = r + r*0.5;
+  for (size_t i=0; i<r.size(); ++i)
+    assert(r(i) == u(i) + u(i)*0.5);
+
+  // Dot product of expressions
+  double d = (u + v) * (u - v);
+  double e = u*u - v*v;
+  assert(approx_eq(d, e, 8));
+}
+
+static void test_matrix_vector_ops()
+{
+  Matrix A(5, 3);
+  Vector u(3), w(5), b(5), v(5), t(3);
+  fill_random(A);
+  fill_random(u);
+  fill_random(w);
+  fill_random(b);
+
+  // Same results as the old code
+  v = A * u + b;
+  Vector ref = old_product(A, u);
+  ref += b;
+  assert(approx_eq(v, ref, 10));
+
+  v = b - A * u;
+  for (size_t i=0; i<v.size(); ++i)
+    assert(approx_eq(v(i), b(i) - (ref(i) - b(i)), 8));
+
+  // A^T*w without the transpose
+  Matrix At(A.getTranspose());
+  t = A.getTranspose() * w;
+  assert(approx_eq(t, old_product(At, w), 10));
+
+  // u = A^T*(A*u) (the result is evaluated in a temporary)
+  Matrix B = A.getTranspose() * A;
+  Vector Bu = old_product(B, u);
+  u = B * u;
+  assert(approx_eq(u, Bu, 10));
+}
+
+static void test_matrix_ops()
+{
+  Matrix A(4, 3), B(3, 4), C, D(4, 4);
+  fill_random(A);
+  fill_random(B);
+  fill_random(D);
+
+  C = A * B + D;
+  Matrix E(A * B);
+  E += D;
+  assert(approx_eq(C, E, 10));
+
+  C = 2.0*D - D;
+  assert(approx_eq(C, D, 10));
+
+  // Transpose of a product of transposes
+  C = B.getTranspose() * A.getTranspose();
+  E = A * B;
+  assert(approx_eq(C, Matrix(E.getTranspose()), 10));
+
+  // Aliasing
+  E = A * B;
+  E = E.getTranspose();
+  assert(approx_eq(C, E, 10));
+}
+
+static void test_columns()
+{
+  Matrix A(6, 4), B(6, 4);
+  Vector mean(6);
+  fill_random(A);
+  fill_random(mean);
+
+  for (size_t j=0; j<A.cols(); ++j)
+    B.setCol(j, A.getCol(j) - mean);
+
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      assert(B(i, j) == A(i, j) - mean(i));
+
+  // Rows are strided views
+  Vector row = A.getRow(2);
+  for (size_t j=0; j<A.cols(); ++j)
+    assert(row(j) == A(2, j));
+
+  // Swap columns of the same matrix
+  Vector aux = B.getCol(0);
+  B.setCol(0, B.getCol(3));
+  B.setCol(3, aux);
+  for (size_t i=0; i<A.rows(); ++i) {
+    assert(B(i, 0) == A(i, 3) - mean(i));
+    assert(B(i, 3) == A(i, 0) - mean(i));
+  }
+}
+
+/// Mlp::recall and Eigenfaces::projectInEigenspace code must not
+/// allocate memory once the output vectors have their final size.
+///
+static void test_no_temporaries()
+{
+  Matrix W(10, 20), E(20, 5);
+  Vector input(20), bias(10), hidden(10), mean(20), point(5);
+  fill_random(W);
+  fill_random(E);
+  fill_random(input);
+  fill_random(bias);
+  fill_random(mean);
+
+  size_t before = allocs;
+  Vector copy(W * input);	// this one allocates
+  assert(allocs == before+1);
+
+  before = allocs;
+  hidden = W * input + bias;
+  hidden = bias - W * input;
+
+  for (size_t k=0; k<E.cols(); ++k)
+    point(k) = E.getCol(k) * (input - mean);
+
+  hidden += 0.5 * (W * input);
+
+  assert(allocs == before);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_vector_ops();
+  test_matrix_vector_ops();
+  test_matrix_ops();
+  test_columns();
+  test_no_temporaries();
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Gemm.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal() - 0.5;
+}
+
+/// The old Matrix::operator*(const Matrix&) implementation (it is
+/// used as reference for results and performance). Only the first
+/// @a n columns of the result are calculated.
+///
+static void naive_product(const Matrix& A, const Matrix& B, Matrix& C, size_t n)
+{
+  size_t i, j, k;
+  double result;
+
+  for (j=0; j<n; ++j) {
+    for (i=0; i<C.rows(); ++i) {
+      result = 0.0;
+
+      for (k=0; k<A.cols(); ++k)
+	result += A(i, k) * B(k, j);
+
+      C(i, j) = result;
+    }
+  }
+}
+
+static void test_gemm_ops(size_t m, size_t n, size_t k)
+{
+  Matrix A(m, k), B(k, n), C(m, n), R(m, n);
+  fill_random(A);
+  fill_random(B);
+
+  // C = A*B
+  naive_product(A, B, R, n);
+  C = A * B;
+  assert(approx_eq(C, R, 10));
+
+  // C = A^T*B
+  Matrix At = A.getTranspose();
+  At.multiplyTransposed(B, C);
+  assert(approx_eq(C, R, 10));
+
+  // C = A*B^T
+  Matrix Bt = B.getTranspose();
+  gemm(GemmNormal, GemmTransposed, m, n, k,
+       1.0, A.getRaw(), A.rows(),
+       Bt.getRaw(), Bt.rows(),
+       0.0, C.getRaw(), C.rows());
+  assert(approx_eq(C, R, 10));
+
+  // C = 2*A^T*B^T - C
+  Matrix C2 = C;
+  gemm(GemmTransposed, GemmTransposed, m, n, k,
+       2.0, At.getRaw(), At.rows(),
+       Bt.getRaw(), Bt.rows(),
+       -1.0, C2.getRaw(), C2.rows());
+  assert(approx_eq(C2, R, 10));
+}
+
+static void test_matrix_mult_assign()
+{
+  Matrix A(3, 2), B(2, 2);
+  A(0,0) = 1; A(0,1) = 2;
+  A(1,0) = 3; A(1,1) = 4;
+  A(2,0) = 5; A(2,1) = 6;
+  B(0,0) = 1; B(0,1) = -1;
+  B(1,0) = 2; B(1,1) = 0;
+
+  A *= B;
+  assert(A.rows() == 3 && A.cols() == 2);
+  assert(A(0,0) ==  5 && A(0,1) == -1);
+  assert(A(1,0) == 11 && A(1,1) == -3);
+  assert(A(2,0) == 17 && A(2,1) == -5);
+}
+
+/// Compares the performance of the old product loop with the blocked
+/// GEMM calculating the covariance matrix of the eigenfaces training
+/// (A^T*A where A has one face of @a pixels per column).
+///
+static void bench_covariance(size_t pixels, size_t images)
+{
+  Matrix A(pixels, images), C(images, images);
+  fill_random(A);
+
+  // The old loop needs the transposed matrix, and it is too slow for
+  // big galleries, so we only calculate some columns to get its rate
+  size_t naive_cols = images < 100 ? images: 100;
+  Chrono chrono;
+  Matrix At = A.getTranspose();
+  naive_product(At, A, C, naive_cols);
+  double naive_secs = chrono.elapsed();
+  double naive_flops = 2.0 * images * naive_cols * pixels;
+
+  chrono.reset();
+  A.multiplyTransposed(A, C);
+  double gemm_secs = chrono.elapsed();
+  double gemm_flops = 2.0 * images * images * pixels;
+
+  std::printf("  %6dx%-6d  naive loop: %7.3f GFLOP/s   gemm: %7.3f GFLOP/s   (x%.1f)\n",
+	      (int)pixels, (int)images,
+	      naive_flops / naive_secs * 1e-9,
+	      gemm_flops / gemm_secs * 1e-9,
+	      (gemm_flops / gemm_secs) / (naive_flops / naive_secs));
+}
+
+/// Usage:
+/// @code
+/// test_gemm [GALLERY_SIZE]
+/// @endcode
+///
+/// GALLERY_SIZE is an extra number of images to benchmark A^T*A
+/// (e.g. 10000 to simulate a big gallery).
+///
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+  srand(0);
+
+  test_matrix_mult_assign();
+
+  test_gemm_ops(1, 1, 1);
+  test_gemm_ops(3, 5, 7);
+  test_gemm_ops(4, 4, 4);
+  test_gemm_ops(17, 13, 300);
+  test_gemm_ops(130, 9, 260);
+  test_gemm_ops(131, 67, 513);
+
+  std::printf("A^T*A (faces of 92x112 pixels):\n");
+  bench_covariance(92*112, 400);	// ORL
+  if (argc > 1)
+    bench_covariance(92*112, std::atoi(argv[1]));
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Gram.h"
+#include "Random.h"
+#include "Thread.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static bool near(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-9 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+static void test_gram(size_t rows, size_t cols, size_t threads)
+{
+  Matrix X(rows, cols), Z(rows, cols), G, H;
+  Vector mean;
+
+  for (size_t j=0; j<cols; ++j)
+    for (size_t i=0; i<rows; ++i)
+      X(i, j) = Random::getReal() * 255.0;
+
+  X.meanCol(mean);
+  for (size_t j=0; j<cols; ++j)
+    Z.getCol(j) = X.getCol(j) - mean;
+
+  gram(X, mean, G, threads);
+  Z.multiplyTransposed(Z, H);
+
+  assert(G.rows() == cols && G.cols() == cols);
+  for (size_t j=0; j<cols; ++j)
+    for (size_t i=0; i<cols; ++i) {
+      assert(near(G(i, j), H(i, j)));
+      assert(G(i, j) == G(j, i));
+    }
+}
+
+static void bench_gram()
+{
+  Matrix X(2000, 600), G;
+  Vector mean;
+
+  for (size_t j=0; j<X.cols(); ++j)
+    for (size_t i=0; i<X.rows(); ++i)
+      X(i, j) = Random::getReal();
+  X.meanCol(mean);
+
+  Chrono chrono;
+  gram(X, mean, G, 1);
+  double t1 = chrono.elapsed();
+
+  chrono.reset();
+  gram(X, mean, G);
+  double tn = chrono.elapsed();
+
+  printf("gram 2000x600: 1 thread %.3f secs, %d threads %.3f secs\n",
+	 t1, (int)Thread::processors(), tn);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_gram(10, 1, 1);
+  test_gram(50, 7, 2);
+  test_gram(600, 300, 1);
+  test_gram(600, 300, 3);
+  test_gram(257, 129, 0);
+
+  bench_gram();
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#include "Ann.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static void fill_set(PatternSet& set, size_t patterns, size_t inputs, size_t outputs)
+{
+  for (size_t p=0; p<patterns; ++p) {
+    Pattern pattern(inputs, outputs);
+    for (size_t i=0; i<inputs; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    for (size_t k=0; k<outputs; ++k)
+      pattern.setOutput(k, Random::getReal() < 0.5 ? 0.1: 0.9);
+    set.push_back(pattern);
+  }
+}
+
+// All the weights of the net (read from its binary form)
+static void get_weights(const Mlp& net, vector<double>& weights)
+{
+  stringstream s;
+  net.write(s);
+
+  Matrix weight1, weight2;
+  Vector bias1, bias2;
+  weight1.read(s);
+  weight2.read(s);
+  bias1.read(s);
+  bias2.read(s);
+
+  weights.assign(weight1.getRaw(), weight1.getRaw() + weight1.rows()*weight1.cols());
+  weights.insert(weights.end(), weight2.getRaw(), weight2.getRaw() + weight2.rows()*weight2.cols());
+  weights.insert(weights.end(), bias1.begin(), bias1.end());
+  weights.insert(weights.end(), bias2.begin(), bias2.end());
+}
+
+// With a big damping the step is J^T*e/mu, the same step that the
+// steepest descent does with the whole set in one batch and a
+// learning rate of 1/mu (so the Jacobian is right). With more than
+// 256 outputs J^T*J and J^T*e are accumulated in several blocks.
+static void test_jacobian(size_t patterns)
+{
+  PatternSet set;
+  fill_set(set, patterns, 4, 2);
+
+  Mlp net0(4, 3, 2);
+  net0.setHiddenActivationFunction(Tansig());
+  net0.setOutputActivationFunction(Logsig());
+  net0.initRandom(-1.0, 1.0);
+
+  const double mu = 5e4 * patterns; // J^T*J grows with the patterns
+  Mlp lmNet(net0), bpNet(net0);
+
+  LevenbergMarquardt lm(lmNet);
+  lm.setDamping(mu);
+  bool ok = lm.train(set);
+  assert(ok);
+  assert(lm.getDamping() < mu);
+  assert(lm.getMSE() < net0.calcMSE(set));
+
+  Backpropagation bp(bpNet);
+  bp.setLearningRate(1.0 / mu);
+  bp.setBatchSize(set.size());
+  bp.train(set);
+
+  vector<double> w0, w1, w2;
+  get_weights(net0, w0);
+  get_weights(lmNet, w1);
+  get_weights(bpNet, w2);
+  for (size_t i=0; i<w0.size(); ++i) {
+    double a = w1[i] - w0[i];
+    double b = w2[i] - w0[i];
+    assert(std::fabs(a - b) <= 1e-3 * std::fabs(b) + 1e-12);
+  }
+}
+
+// A small network (as the ones of a MlpArray) reaches a low MSE in
+// a few epochs
+static void test_convergence()
+{
+  PatternSet set;
+  fill_set(set, 40, 25, 1);
+
+  Mlp net(25, 8, 1);
+  net.setOutputActivationFunction(Logsig());
+  net.initRandom(-1.0, 1.0);
+
+  LevenbergMarquardt lm(net);
+  double mse = net.calcMSE(set);
+  for (int epoch=0; epoch<100 && mse >= 1e-4; ++epoch) {
+    if (!lm.train(set))
+      break;
+    assert(lm.getMSE() < mse);
+    mse = lm.getMSE();
+  }
+  assert(std::fabs(mse - net.calcMSE(set)) < 1e-12);
+  assert(mse < 1e-4);
+}
+
+// If the damping is at the maximum and no step reduces the error,
+// the weights are not modified
+static void test_no_progress()
+{
+  PatternSet set;
+  fill_set(set, 10, 3, 1);
+
+  Mlp net(3, 2, 1);
+  net.initRandom(-1.0, 1.0);
+  Mlp net0(net);
+
+  LevenbergMarquardt lm(net);
+  lm.setDamping(10.0);
+  lm.setMaxDamping(1.0);
+  bool ok = lm.train(set);
+  assert(!ok);
+
+  vector<double> w0, w1;
+  get_weights(net0, w0);
+  get_weights(net, w1);
+  assert(w0 == w1);
+  assert(std::fabs(lm.getMSE() - net0.calcMSE(set)) < 1e-12);
+}
+
+// Epochs and time to reach MSE < 1e-4 with the networks of a
+// MlpArray (ORL: 320 patterns of 50 inputs, 1 output)
+static void bench_lm()
+{
+  PatternSet set;
+  for (size_t p=0; p<320; ++p) {
+    Pattern pattern(50, 1);
+    for (size_t i=0; i<50; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    pattern.setOutput(0, (p % 40) == 0 ? 1.0: 0.0);
+    set.push_back(pattern);
+  }
+
+  Mlp initial(50, 10, 1);
+  initial.setOutputActivationFunction(Logsig());
+  initial.initRandom(-1.0, 1.0);
+
+  Mlp net(initial);
+  LevenbergMarquardt lm(net);
+  Chrono chrono;
+  int epochs = 0;
+  while (epochs < 1000 && lm.train(set)) {
+    ++epochs;
+    if (lm.getMSE() < 1e-4)
+      break;
+  }
+  printf("levenberg-marquardt: MSE=%g in %d epochs, %.6f secs\n",
+	 lm.getMSE(), epochs, chrono.elapsed());
+
+  net = initial;
+  Backpropagation bp(net);
+  bp.setLearningRate(0.6);
+  bp.setMomentum(0.1);
+  chrono.reset();
+  epochs = 0;
+  while (epochs < 1000 && bp.calcMSE(set) >= 1e-4) {
+    bp.train(set);
+    ++epochs;
+  }
+  printf("steepest descent: MSE=%g in %d epochs, %.6f secs\n",
+	 bp.calcMSE(set), epochs, chrono.elapsed());
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_jacobian(20);
+  test_jacobian(150);
+  test_convergence();
+  test_no_progress();
+
+  bench_lm();
+  return 0;
+}
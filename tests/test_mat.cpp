@@ -176,6 +176,56 @@ void test_matrix_io()
   assert(approx_eq(A, B, 10));
 }
 
+// Binary files record the scalar type, so they can be read with
+// other type (double files keep the old format)
+void test_scalar_type_io()
+{
+  Matrix A(3, 2);
+  for (size_t j=0; j<2; ++j)
+    for (size_t i=0; i<3; ++i)
+      A(i, j) = Random::getReal() - 0.5;
+
+  stringstream s;
+  A.write(s);
+  size_t rows;
+  s.read((char*)&rows, sizeof(size_t));
+  assert(rows == 3);
+  s.seekg(0);
+
+  MatrixT<float> B;
+  B.read(s);
+  assert(B.rows() == 3 && B.cols() == 2);
+  for (size_t j=0; j<2; ++j)
+    for (size_t i=0; i<3; ++i)
+      assert(B(i, j) == float(A(i, j)));
+
+  stringstream s2;
+  B.write(s2);
+  assert(s2.str().size() < s.str().size());
+
+  Matrix C;
+  C.read(s2);
+  for (size_t j=0; j<2; ++j)
+    for (size_t i=0; i<3; ++i)
+      assert(C(i, j) == double(B(i, j)));
+
+  VectorT<float> u(4);
+  for (size_t i=0; i<4; ++i)
+    u(i) = float(i) / 3.0f;
+
+  stringstream s3;
+  u.write(s3);
+  Vector v;
+  v.read(s3);
+  assert(v.size() == 4);
+  for (size_t i=0; i<4; ++i)
+    assert(v(i) == double(u(i)));
+
+  VectorT<float> w;
+  w.assign(v);
+  assert(w == u);
+}
+
 int main(int argc, char *argv[])
 {
   for (int i=0; i<10; ++i) {
@@ -186,6 +236,7 @@ int main(int argc, char *argv[])
     test_matrix_resize();
     test_vector_io();
     test_matrix_io();
+    test_scalar_type_io();
   }
   return 0;
 }
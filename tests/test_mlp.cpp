@@ -51,7 +51,7 @@ void train_until_mse_is_reached(Mlp& net, Backpropagation& bp, PatternSet& set,
 {
   int i = 0;
   while (net.calcMSE(set) >= target_mse) {
-    std::random_shuffle(set.begin(), set.end());
+    set.shuffle();
     bp.train(set);
     if (show_epochs > 0 && !((i++)%show_epochs))
       std::cout << "MSE=" << net.calcMSE(set) << std::endl;
@@ -66,7 +66,7 @@ void train_net_adapting_learning_rate(Mlp& net, Backpropagation& bp, PatternSet&
   Mlp lastNet;
 
   while (E > 0.1) {
-    std::random_shuffle(set.begin(), set.end());
+    set.shuffle();
 
     lastE = E;
     lastNet = net;
@@ -320,7 +320,7 @@ void test_iris()
   int bestEpoch = 0;
   Mlp theNet;
   for (int c=0; c<1000; ++c) {
-    std::random_shuffle(set.begin(), set.end());
+    set.shuffle();
     bp.train(set);
 
     // performance
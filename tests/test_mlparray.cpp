@@ -0,0 +1,253 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Ann.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static const size_t inputs = 6, subjects = 4, samples = 10;
+
+// Each subject has its own mean input, and one output per subject
+static void fill_set(PatternSet& set)
+{
+  for (size_t s=0; s<subjects; ++s)
+    for (size_t p=0; p<samples; ++p) {
+      Pattern pattern(inputs, subjects);
+      for (size_t i=0; i<inputs; ++i)
+	pattern.setInput(i, (i % subjects == s ? 1.0: 0.0) + 0.2*(Random::getReal() - 0.5));
+      for (size_t k=0; k<subjects; ++k)
+	pattern.setOutput(k, k == s ? 1.0: 0.0);
+      set.push_back(pattern);
+    }
+}
+
+static MlpArray create_array()
+{
+  MlpArray array;
+  for (size_t s=0; s<subjects; ++s) {
+    Mlp net(inputs, 3, 1);
+    net.setOutputActivationFunction(Logsig());
+    array.add(net);
+  }
+  return array;
+}
+
+static string train(const PatternSet& set, size_t threads,
+		    vector<size_t>& epochs, vector<size_t>& adjustments,
+		    vector<double>& mse)
+{
+  MlpArrayTraining params;
+  params.epochs = 30;
+  params.shuffle = 1;
+  params.initWeights = true;
+  params.seed = 7;
+  params.threads = threads;
+
+  MlpArray array = create_array();
+  array.trainAll(set, params, epochs, adjustments, mse);
+
+  ostringstream s;
+  array.write(s);
+  return s.str();
+}
+
+// The result does not depend on the number of threads
+static void test_train_all_is_deterministic()
+{
+  PatternSet set;
+  fill_set(set);
+
+  vector<size_t> epochs, adjustments, epochs2, adjustments2;
+  vector<double> mse, mse2;
+  string a = train(set, 1, epochs, adjustments, mse);
+  string b = train(set, 3, epochs2, adjustments2, mse2);
+  assert(a == b);
+  assert(epochs == epochs2);
+  assert(adjustments == adjustments2);
+  assert(mse == mse2);
+
+  assert(epochs.size() == subjects);
+  for (size_t s=0; s<subjects; ++s) {
+    assert(epochs[s] == 30);
+    assert(adjustments[s] == 30 * set.size());
+  }
+}
+
+// Each network recognizes its subject
+static void test_train_all_learns()
+{
+  PatternSet set;
+  fill_set(set);
+
+  MlpArrayTraining params;
+  params.epochs = 200;
+  params.shuffle = 1;
+  params.initWeights = true;
+  params.goalMse = 1e-3;
+  params.threads = 2;
+
+  MlpArray array = create_array();
+  vector<size_t> epochs, adjustments;
+  vector<double> mse;
+  array.trainAll(set, params, epochs, adjustments, mse);
+
+  // The networks stop when their MSE reaches the goal
+  for (size_t s=0; s<subjects; ++s)
+    assert(mse[s] < params.goalMse || epochs[s] == params.epochs);
+
+  size_t hits = 0;
+  Vector output;
+  for (size_t p=0; p<set.size(); ++p) {
+    array.recall(set[p].getInput(), output);
+    if (output.getMaxPos() == set[p].getOutput().getMaxPos())
+      ++hits;
+  }
+  assert(hits == set.size());
+}
+
+static bool near(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-12 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+// The fused form gives the outputs of each network (with different
+// sizes and activation functions)
+static void test_fused_recall()
+{
+  Mlp nets[3] = { Mlp(inputs, 3, 1), Mlp(inputs, 4, 2), Mlp(inputs, 2, 1) };
+  nets[1].setHiddenActivationFunction(Tansig());
+  nets[1].setOutputActivationFunction(Logsig());
+  nets[2].setOutputActivationFunction(Tansig());
+
+  MlpArray array;
+  for (size_t c=0; c<3; ++c) {
+    nets[c].initRandom(-1.0, 1.0);
+    array.add(nets[c]);
+  }
+  assert(array.getFused().getOutputs() == 4);
+
+  const size_t n = 7;
+  Matrix batch(inputs, n), outputs;
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<inputs; ++i)
+      batch(i, j) = Random::getReal() - 0.5;
+
+  array.recallBatch(batch, outputs);
+  assert(outputs.rows() == 4 && outputs.cols() == n);
+
+  Vector input, hidden, output, fused;
+  for (size_t j=0; j<n; ++j) {
+    input = batch.getCol(j);
+    array.recall(input, fused);
+
+    size_t k = 0;
+    for (size_t c=0; c<3; ++c) {
+      nets[c].recall(input, hidden, output);
+      for (size_t i=0; i<output.size(); ++i, ++k) {
+	assert(near(fused(k), output(i)));
+	assert(near(outputs(k, j), output(i)));
+      }
+    }
+  }
+}
+
+// Batches give the same outputs as one input each time, with any
+// number of threads, and reuse the output matrix
+static void test_recall_batch()
+{
+  const size_t n = 200;
+  Matrix batch(inputs, n), outputs, outputs2;
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<inputs; ++i)
+      batch(i, j) = Random::getReal() - 0.5;
+
+  Mlp net(inputs, 5, 3);
+  net.setHiddenActivationFunction(Tansig());
+  net.initRandom(-1.0, 1.0);
+
+  net.recallBatch(batch, outputs);
+  assert(outputs.rows() == 3 && outputs.cols() == n);
+
+  Vector input, hidden, output;
+  for (size_t j=0; j<n; ++j) {
+    input = batch.getCol(j);
+    net.recall(input, hidden, output);
+    for (size_t k=0; k<3; ++k)
+      assert(near(outputs(k, j), output(k)));
+  }
+
+  const double* raw = outputs.getRaw();
+  net.recallBatch(batch, outputs, 3);
+  assert(outputs.getRaw() == raw);
+
+  MlpArray array;
+  for (size_t c=0; c<subjects; ++c) {
+    net.initRandom(-1.0, 1.0);
+    array.add(net);
+  }
+  array.recallBatch(batch, outputs);
+  array.recallBatch(batch, outputs2, 3);
+  assert(outputs == outputs2);
+}
+
+// Recall time of 40 networks with the size of the ORL patterns (50
+// inputs) for a fold of 2000 patterns
+static void bench_recall()
+{
+  const size_t n = 2000;
+  MlpArray array;
+  for (size_t c=0; c<40; ++c) {
+    Mlp net(50, 10, 1);
+    net.initRandom(-1.0, 1.0);
+    array.add(net);
+  }
+
+  Matrix batch(50, n), outputs;
+  for (size_t j=0; j<n; ++j)
+    for (size_t i=0; i<50; ++i)
+      batch(i, j) = Random::getReal() - 0.5;
+
+  Vector input(50), output;
+  Chrono chrono;
+  for (size_t j=0; j<n; ++j) {
+    input = batch.getCol(j);
+    array.recall(input, output);
+  }
+  printf("one input each time: %.6f secs\n", chrono.elapsed());
+
+  chrono.reset();
+  array.recallBatch(batch, outputs);
+  printf("all inputs at once:  %.6f secs\n", chrono.elapsed());
+
+  exp_select(FastExp);
+  chrono.reset();
+  array.recallBatch(batch, outputs);
+  printf("all inputs, fast exp: %.6f secs\n", chrono.elapsed());
+  exp_select(AccurateExp);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+  std::srand(0);
+
+  test_train_all_is_deterministic();
+  test_train_all_learns();
+  test_fused_recall();
+  test_recall_batch();
+
+  bench_recall();
+  return 0;
+}
@@ -0,0 +1,529 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "Ann.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+// Pattern p has the inputs p*10+i and the output p
+static void fill_set(PatternSet& set, size_t patterns, size_t inputs)
+{
+  for (size_t p=0; p<patterns; ++p) {
+    Pattern pattern(inputs, 1);
+    for (size_t i=0; i<inputs; ++i)
+      pattern.setInput(i, p*10.0 + i);
+    pattern.setOutput(0, p);
+    set.push_back(pattern);
+  }
+}
+
+static void test_access()
+{
+  PatternSet set;
+  assert(set.empty());
+  assert(set.begin() == set.end());
+
+  fill_set(set, 5, 3);
+  assert(set.size() == 5);
+  assert(set.getInputSize() == 3);
+  assert(set.getOutputSize() == 1);
+
+  size_t p = 0;
+  for (PatternSet::const_iterator it = set.begin(); it != set.end(); ++it, ++p) {
+    assert(it->getInput().size() == 3);
+    assert(it->getInput(2) == p*10.0 + 2);
+    assert((*it).getOutput()(0) == p);
+    assert(set.getInputRow(p) == it->getRawInput());
+  }
+  assert(p == 5);
+
+  // Modify the patterns through references
+  set[1].setInput(0, -1.0);
+  for (PatternSet::iterator it = set.begin(); it != set.end(); ++it)
+    it->setOutput(0, it->getOutput(0) * 2.0);
+  assert(set[1].getInput(0) == -1.0);
+  assert(set[4].getOutput(0) == 8.0);
+
+  // Copies
+  Pattern copy(set[2]);
+  assert(copy.getInput(1) == 21.0);
+  PatternSet set2(set);
+  set2[2].setInput(1, 0.0);
+  assert(set[2].getInput(1) == 21.0);
+
+  // All the outputs
+  Vector output(2);
+  output(0) = 0.5;
+  output(1) = 0.25;
+  set.setOutputs(output);
+  assert(set.getOutputSize() == 2);
+  assert(Vector(set[3].getOutput()) == output);
+
+  // Patterns with other size
+  bool thrown = false;
+  try {
+    set.push_back(Pattern(4, 2));
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(set.size() == 5);
+}
+
+// Versions are not repeated by other sets (even in the same address)
+static void test_versions()
+{
+  unsigned long version;
+  {
+    PatternSet set;
+    fill_set(set, 3, 2);
+    version = set.getVersion();
+  }
+  PatternSet set;
+  assert(set.getVersion() > version);
+  version = set.getVersion();
+
+  fill_set(set, 3, 2);
+  assert(set.getVersion() > version);
+  version = set.getVersion();
+  set.shuffle();
+  assert(set.getVersion() == version);
+
+  PatternSet copy(set);
+  assert(copy.getVersion() > version);
+  set = copy;
+  assert(set.getVersion() > copy.getVersion());
+}
+
+// Shuffling changes the order of the patterns, not the data
+static void test_shuffle()
+{
+  PatternSet set;
+  fill_set(set, 100, 4);
+  assert(set.isContiguous(0, 100));
+
+  RandomStream random(1);
+  set.shuffle(random);
+  assert(!set.isContiguous(0, 100));
+
+  vector<bool> found(set.size(), false);
+  bool moved = false;
+  for (size_t p=0; p<set.size(); ++p) {
+    size_t q = size_t(set[p].getOutput(0));
+    for (size_t i=0; i<4; ++i)
+      assert(set[p].getInput(i) == q*10.0 + i);
+    assert(!found[q]);
+    found[q] = true;
+    moved = moved || (q != p);
+  }
+  assert(moved);
+
+  // Inputs in the order of the set
+  Matrix inputs;
+  set.getInputs(inputs);
+  assert(inputs.rows() == 4 && inputs.cols() == set.size());
+  for (size_t p=0; p<set.size(); ++p)
+    assert(inputs.getCol(p) == set[p].getInput());
+
+  // Adding the patterns of the same set
+  size_t n = set.size();
+  for (size_t p=0; p<n; ++p)
+    set.push_back(set[p]);
+  assert(set.size() == 2*n);
+  for (size_t p=0; p<n; ++p)
+    assert(set[n+p].getInput() == set[p].getInput());
+}
+
+// Sets created with append share the rows until they are modified
+static void test_views()
+{
+  PatternSet set;
+  fill_set(set, 10, 3);
+
+  PatternSet even, odd;
+  for (size_t p=0; p<set.size(); ++p)
+    (p % 2 == 0 ? even: odd).append(set, p);
+  assert(even.size() == 5 && odd.size() == 5);
+  assert(even.getInputRow(1) == set.getInputRow(2));
+
+  // Other outputs for a view
+  Vector output(1);
+  output(0) = -1.0;
+  odd.setOutputs(output);
+  assert(odd[4].getOutput(0) == -1.0);
+  assert(set[9].getOutput(0) == 9.0);
+  assert(odd.getInputRow(4) == set.getInputRow(9));
+
+  // Merge of views with the same inputs and other outputs
+  PatternSet mix;
+  mix.append(even);
+  mix.append(odd);
+  assert(mix.size() == 10);
+  assert(mix.getInputRow(5) == set.getInputRow(1));
+  assert(mix[0].getOutput(0) == 0.0 && mix[5].getOutput(0) == -1.0);
+
+  // Copy-on-write: modifying a view does not modify the original set
+  PatternSet copy(set);
+  assert(copy.getInputRow(0) == set.getInputRow(0));
+  copy[0].setInput(0, 100.0);
+  assert(copy.getInputRow(0) != set.getInputRow(0));
+  assert(copy[0].getInput(0) == 100.0 && copy[1].getInput(0) == 10.0);
+  assert(set[0].getInput(0) == 0.0);
+
+  odd[0].setOutput(0, 5.0);
+  assert(odd[0].getOutput(0) == 5.0 && odd[1].getOutput(0) == -1.0);
+  assert(mix[5].getOutput(0) == -1.0);
+
+  // Modifying the original set does not modify the views
+  for (PatternSet::iterator it = set.begin(); it != set.end(); ++it)
+    it->setInput(1, 0.0);
+  assert(set[3].getInput(1) == 0.0);
+  assert(even[1].getInput(1) == 21.0);
+  assert(mix[5].getInput(1) == 11.0);
+
+  // A pattern added twice to the same set is copied when it is
+  // modified
+  PatternSet twice;
+  twice.append(even, 0);
+  twice.append(even, 0);
+  even = PatternSet();
+  twice[0].setInput(0, 7.0);
+  assert(twice[0].getInput(0) == 7.0 && twice[1].getInput(0) == 0.0);
+
+  // Adding patterns with other size
+  bool thrown = false;
+  PatternSet other;
+  fill_set(other, 2, 4);
+  try {
+    mix.append(other);
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+static void check_classes(const PatternSet& set)
+{
+  size_t total = 0;
+  for (size_t k=0; k<set.getClasses(); ++k) {
+    const vector<size_t>& patterns(set.getClass(k));
+    for (size_t i=0; i<patterns.size(); ++i) {
+      assert(i == 0 || patterns[i-1] < patterns[i]);
+      assert(set.getLabel(patterns[i]) == k);
+      assert(set[patterns[i]].getOutput().getMaxPos() == k);
+    }
+    total += patterns.size();
+  }
+  assert(total == set.size());
+}
+
+// Each pattern is in the list of the class of its maximum output
+static void test_classes()
+{
+  PatternSet set;
+  for (size_t p=0; p<60; ++p) {
+    Pattern pattern(2, 4);
+    pattern.setInput(0, p);
+    pattern.setInput(1, 0.0);
+    for (size_t k=0; k<4; ++k)
+      pattern.setOutput(k, k == p%3 ? 1.0: 0.0);
+    set.push_back(pattern);
+  }
+  assert(set.getClasses() == 4);
+  assert(set.getClass(0).size() == 20);
+  assert(set.getClass(3).empty());
+  assert(set.getClass(10).empty());
+  assert(set.getLabel(5) == 2);
+  check_classes(set);
+
+  set.shuffle();
+  check_classes(set);
+
+  // Views keep the classes
+  PatternSet view;
+  const vector<size_t>& ones(set.getClass(1));
+  for (size_t i=0; i<ones.size(); ++i)
+    view.append(set, ones[i]);
+  assert(view.getClass(1).size() == 20);
+  check_classes(view);
+
+  // Modified outputs
+  set[0].setOutput(3, 2.0);
+  assert(set.getLabel(0) == 3);
+  assert(set.getClass(3).size() == 1);
+  check_classes(set);
+
+  Vector output(2);
+  output(0) = 0.0;
+  output(1) = 1.0;
+  view.setOutputs(output);
+  assert(view.getClasses() == 2);
+  assert(view.getClass(1).size() == 20);
+  check_classes(view);
+}
+
+// The same number of patterns of each class
+static void test_sample_balanced()
+{
+  // 20, 5 and 1 patterns in the classes 0, 1 and 2 (3 is empty)
+  PatternSet set;
+  for (size_t p=0; p<26; ++p) {
+    Pattern pattern(1, 4);
+    pattern.setInput(0, p);
+    pattern.setOutput(p < 20 ? 0: p < 25 ? 1: 2, 1.0);
+    set.push_back(pattern);
+  }
+
+  PatternSet sample;
+  RandomStream random(5);
+  set.sampleBalanced(sample, 10, random);
+  assert(sample.size() == 30);
+  check_classes(sample);
+
+  vector<size_t> count(set.size(), 0);
+  for (size_t i=0; i<sample.size(); ++i) {
+    assert(sample.getLabel(i) == i % 3); // Interleaved classes
+    size_t p = sample[i].getInput(0);
+    assert(sample.getInputRow(i) == set.getInputRow(p));
+    count[p]++;
+  }
+
+  // Patterns are repeated only when the class has less than 10
+  for (size_t p=0; p<20; ++p)
+    assert(count[p] <= 1);
+  for (size_t p=20; p<25; ++p)
+    assert(count[p] == 2);
+  assert(count[25] == 10);
+
+  // The same stream gives the same sample
+  PatternSet sample2;
+  RandomStream random2(5);
+  set.sampleBalanced(sample2, 10, random2);
+  for (size_t i=0; i<sample.size(); ++i)
+    assert(sample.getInputRow(i) == sample2.getInputRow(i));
+}
+
+// Outputs of the classes shared by all the patterns
+static void test_labels()
+{
+  PatternSet set;
+  set.setLabelOutputs(5, 0.9, -0.9);
+  assert(set.hasLabelOutputs() && set.getOutputSize() == 5);
+
+  Vector input(3);
+  for (size_t p=0; p<30; ++p) {
+    input(0) = p;
+    set.push_back(input, p%5);
+  }
+  assert(set.size() == 30 && set.hasLabelOutputs());
+  assert(set.getLabel(7) == 2);
+  assert(set.getClass(4).size() == 6);
+  assert(set.getOutputRow(2) == set.getOutputRow(12));
+  for (size_t k=0; k<5; ++k)
+    assert(set[7].getOutput(k) == (k == 2 ? 0.9: -0.9));
+  check_classes(set);
+
+  set.shuffle();
+  check_classes(set);
+
+  // Classes out of the outputs and sets without label outputs
+  bool thrown = false;
+  try {
+    set.push_back(input, 5);
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  thrown = false;
+  try {
+    PatternSet other;
+    fill_set(other, 2, 3);
+    other.push_back(input, 0);
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // The same outputs as one-hot patterns
+  PatternSet dense;
+  for (size_t p=0; p<set.size(); ++p)
+    dense.push_back(Pattern(set[p]));
+  assert(!dense.hasLabelOutputs());
+  dense.setLabelOutputs(5, 0.9, -0.9);
+  assert(dense.getOutputRow(0) != set.getOutputRow(0));
+  for (size_t p=0; p<set.size(); ++p)
+    assert(dense[p].getOutput() == set[p].getOutput());
+
+  // Views and merges use the same row
+  PatternSet view, mix;
+  view.append(set, 3);
+  mix.append(view);
+  mix.append(dense);
+  assert(view.hasLabelOutputs() && mix.hasLabelOutputs());
+  assert(mix.size() == 31);
+  for (size_t p=1; p<mix.size(); ++p)
+    if (mix.getLabel(p) == mix.getLabel(0))
+      assert(mix.getOutputRow(p) == mix.getOutputRow(0));
+  check_classes(mix);
+
+  // Other outputs are copied to each pattern
+  Pattern pattern(3, 5);
+  pattern.setOutput(1, 0.5);
+  mix.push_back(pattern);
+  assert(!mix.hasLabelOutputs());
+  assert(mix[31].getOutput(1) == 0.5 && mix[31].getOutput(0) == 0.0);
+  assert(mix[0].getOutput() == set[3].getOutput());
+  check_classes(mix);
+
+  set[0].setOutput(1, 2.0);
+  assert(!set.hasLabelOutputs());
+  assert(set.getLabel(0) == 1 && set[1].getOutput() == dense[1].getOutput());
+  assert(view.hasLabelOutputs());
+  check_classes(set);
+
+  // Classes out of the outputs
+  thrown = false;
+  try {
+    dense.setLabelOutputs(3);
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// The SSE does not depend on the order of the patterns
+static void test_sse()
+{
+  PatternSet set;
+  for (size_t p=0; p<150; ++p) {
+    Pattern pattern(6, 2);
+    for (size_t i=0; i<6; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    pattern.setOutput(0, Random::getReal());
+    pattern.setOutput(1, Random::getReal());
+    set.push_back(pattern);
+  }
+
+  Mlp net(6, 5, 2);
+  net.initRandom(-1.0, 1.0);
+
+  double expected = 0.0;
+  Vector hidden, output;
+  for (size_t p=0; p<set.size(); ++p) {
+    net.recall(set[p].getInput(), hidden, output);
+    for (size_t k=0; k<2; ++k)
+      expected += std::pow(set[p].getOutput(k) - output(k), 2.0);
+  }
+
+  double sse = net.calcSSE(set);
+  assert(std::fabs(sse - expected) < 1e-9);
+
+  set.shuffle();
+  assert(std::fabs(net.calcSSE(set) - sse) < 1e-9);
+
+  MlpT<float> fnet;
+  fnet.assign(net);
+  assert(std::fabs(fnet.calcSSE(set) - sse) < 1e-3);
+
+  // Label outputs
+  PatternSet labels(set);
+  labels.setLabelOutputs(2);
+  PatternSet dense;
+  for (size_t p=0; p<labels.size(); ++p)
+    dense.push_back(Pattern(labels[p]));
+  assert(labels.hasLabelOutputs() && !dense.hasLabelOutputs());
+  assert(std::fabs(net.calcSSE(labels) - net.calcSSE(dense)) < 1e-9);
+
+  // A view of the set
+  PatternSet view;
+  for (size_t p=0; p<set.size(); p+=3)
+    view.append(set, p);
+  PatternSet copy;
+  for (size_t p=0; p<view.size(); ++p)
+    copy.push_back(Pattern(view[p]));
+  assert(std::fabs(net.calcSSE(view) - net.calcSSE(copy)) < 1e-9);
+}
+
+// MSE of 400 patterns of 50 inputs (ORL), one pattern each time with
+// a copy of each pattern in its own vectors (as the set stored them)
+// or with the set
+static void bench_sse()
+{
+  PatternSet set;
+  vector<Pattern> patterns;
+  for (size_t p=0; p<400; ++p) {
+    Pattern pattern(50, 40);
+    for (size_t i=0; i<50; ++i)
+      pattern.setInput(i, Random::getReal() - 0.5);
+    for (size_t k=0; k<40; ++k)
+      pattern.setOutput(k, k == p%40 ? 1.0: 0.0);
+    set.push_back(pattern);
+    patterns.push_back(pattern);
+  }
+  set.shuffle();
+
+  Mlp net(50, 40, 40);
+  net.initRandom(-1.0, 1.0);
+
+  Chrono chrono;
+  double sse = 0.0;
+  Vector hidden, output;
+  for (int c=0; c<100; ++c)
+    for (size_t p=0; p<patterns.size(); ++p) {
+      net.recall(patterns[p].getInput(), hidden, output);
+      for (size_t k=0; k<40; ++k)
+	sse += std::pow(patterns[p].getOutput(k) - output(k), 2.0);
+    }
+  printf("sse, one pattern each time: %.6f secs\n", chrono.elapsed());
+
+  chrono.reset();
+  double sse2 = 0.0;
+  for (int c=0; c<100; ++c)
+    sse2 += net.calcSSE(set);
+  printf("sse, contiguous set:        %.6f secs\n", chrono.elapsed());
+
+  PatternSet labels(set);
+  labels.setLabelOutputs(40);
+
+  chrono.reset();
+  double sse3 = 0.0;
+  for (int c=0; c<100; ++c)
+    sse3 += net.calcSSE(labels);
+  printf("sse, label outputs:         %.6f secs\n", chrono.elapsed());
+
+  assert(std::fabs(sse - sse2) < 1e-6 * sse);
+  assert(std::fabs(sse2 - sse3) < 1e-6 * sse);
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_access();
+  test_versions();
+  test_shuffle();
+  test_views();
+  test_classes();
+  test_sample_balanced();
+  test_labels();
+  test_sse();
+
+  bench_sse();
+  return 0;
+}
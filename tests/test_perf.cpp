@@ -46,7 +46,7 @@ void train_until_mse_is_reached(Mlp& net, Backpropagation& bp, PatternSet& set,
 {
   int i = 0;
   while (net.calcMSE(set) >= target_mse) {
-    random_shuffle(set.begin(), set.end());
+    set.shuffle();
     bp.train(set);
   }
 }
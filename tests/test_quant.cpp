@@ -0,0 +1,265 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "Ann.h"
+#include "Eigenfaces.h"
+#include "QuantizedEigenfaces.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal() - 0.5;
+}
+
+static double max_error(const Matrix& A, const Matrix& B)
+{
+  assert(A.rows() == B.rows() && A.cols() == B.cols());
+
+  double err = 0.0;
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      err = std::max(err, std::fabs(A(i, j) - B(i, j)));
+  return err;
+}
+
+// The int8 network gives the outputs of the double one with a small
+// error, one input each time or in batches (with any number of
+// threads)
+static void test_quantized_mlp()
+{
+  const size_t inputs = 30, n = 300;
+  Mlp net(inputs, 12, 5);
+  net.setHiddenActivationFunction(Tansig());
+  net.setOutputActivationFunction(Logsig());
+  net.initRandom(-1.0, 1.0);
+
+  QuantizedMlp qnet;
+  qnet.compile(net);
+  assert(qnet.getInputs() == inputs && qnet.getOutputs() == 5);
+
+  Matrix batch(inputs, n), outputs, qoutputs, qoutputs2;
+  fill_random(batch);
+  net.recallBatch(batch, outputs);
+  qnet.recallBatch(batch, qoutputs);
+  qnet.recallBatch(batch, qoutputs2, 3);
+  assert(qoutputs == qoutputs2);
+  assert(max_error(outputs, qoutputs) < 0.02);
+
+  Vector input, output;
+  for (size_t j=0; j<n; ++j) {
+    input = batch.getCol(j);
+    qnet.recall(input, output);
+    for (size_t k=0; k<5; ++k)
+      assert(output(k) == qoutputs(k, j));
+  }
+
+  // Only Logsig and Tansig hidden layers have lookup tables
+  net.setHiddenActivationFunction(Purelin());
+  bool thrown = false;
+  try {
+    qnet.compile(net);
+  }
+  catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// An array with networks of different sizes and functions
+static void test_quantized_array()
+{
+  const size_t inputs = 20, n = 100;
+  Mlp nets[3] = { Mlp(inputs, 3, 1), Mlp(inputs, 6, 2), Mlp(inputs, 4, 1) };
+  nets[1].setHiddenActivationFunction(Tansig());
+  nets[1].setOutputActivationFunction(Logsig());
+  nets[2].setOutputActivationFunction(Tansig());
+
+  MlpArray array;
+  for (size_t c=0; c<3; ++c) {
+    nets[c].initRandom(-1.0, 1.0);
+    array.add(nets[c]);
+  }
+
+  QuantizedMlp qarray;
+  qarray.compile(array);
+  assert(qarray.getInputs() == inputs && qarray.getOutputs() == 4);
+
+  Matrix batch(inputs, n), outputs, qoutputs;
+  fill_random(batch);
+  array.recallBatch(batch, outputs);
+  qarray.recallBatch(batch, qoutputs);
+  assert(max_error(outputs, qoutputs) < 0.05);
+}
+
+// A trained array recognizes the same subjects after the
+// quantization
+static void test_quantized_classification()
+{
+  const size_t inputs = 8, subjects = 4, samples = 20;
+  PatternSet set;
+  for (size_t s=0; s<subjects; ++s)
+    for (size_t p=0; p<samples; ++p) {
+      Pattern pattern(inputs, subjects);
+      for (size_t i=0; i<inputs; ++i)
+	pattern.setInput(i, (i % subjects == s ? 1.0: 0.0) + 0.2*(Random::getReal() - 0.5));
+      for (size_t k=0; k<subjects; ++k)
+	pattern.setOutput(k, k == s ? 1.0: 0.0);
+      set.push_back(pattern);
+    }
+
+  MlpArray array;
+  for (size_t s=0; s<subjects; ++s) {
+    Mlp net(inputs, 4, 1);
+    net.setOutputActivationFunction(Logsig());
+    array.add(net);
+  }
+
+  MlpArrayTraining params;
+  params.epochs = 200;
+  params.shuffle = 1;
+  params.initWeights = true;
+  params.threads = 2;
+  vector<size_t> epochs, adjustments;
+  vector<double> mse;
+  array.trainAll(set, params, epochs, adjustments, mse);
+
+  QuantizedMlp qarray;
+  qarray.compile(array);
+
+  Matrix batch, outputs, qoutputs;
+  set.getInputs(batch);
+  array.recallBatch(batch, outputs);
+  qarray.recallBatch(batch, qoutputs);
+
+  for (size_t p=0; p<set.size(); ++p) {
+    size_t subject = set[p].getOutput().getMaxPos();
+    assert(outputs.getCol(p).getMaxPos() == subject);
+    assert(qoutputs.getCol(p).getMaxPos() == subject);
+  }
+}
+
+// The int8 projections are near the double ones (relative to the
+// distance of each image to the mean face)
+static void test_quantized_eigenfaces()
+{
+  const size_t pixels = 500, images = 30, k = 8;
+  Eigenfaces eig;
+  Matrix faces(pixels, images), points, qpoints, qpoints2;
+  fill_random(faces);
+  for (size_t j=0; j<images; ++j)
+    eig.addImage(faces.getCol(j));
+  bool ok = eig.calculateEigenvalues();
+  assert(ok);
+  eig.calculateEigenfaces(k);
+
+  QuantizedEigenfaces qeig;
+  qeig.compile(eig);
+  assert(qeig.getPixelsPerImage() == pixels);
+  assert(qeig.getEigenfaceComponents() == k);
+
+  eig.projectBatch(faces, points);
+  qeig.projectBatch(faces, qpoints);
+  qeig.projectBatch(faces, qpoints2, 3);
+  assert(qpoints == qpoints2);
+
+  Vector mean(pixels), face, point;
+  mean.zero();
+  for (size_t j=0; j<images; ++j)
+    for (size_t i=0; i<pixels; ++i)
+      mean(i) += faces(i, j) / images;
+
+  for (size_t j=0; j<images; ++j) {
+    face = faces.getCol(j);
+    qeig.projectInEigenspace(face, point);
+
+    double norm = 0.0;
+    for (size_t i=0; i<pixels; ++i)
+      norm += std::pow(faces(i, j) - mean(i), 2);
+    norm = std::sqrt(norm);
+
+    for (size_t i=0; i<k; ++i) {
+      assert(point(i) == qpoints(i, j));
+      assert(std::fabs(points(i, j) - qpoints(i, j)) < 0.01*norm);
+    }
+  }
+}
+
+// Projection of 400 ORL images (92x112 pixels) in 50 eigenfaces, and
+// recall of 40 networks (50 inputs) for a fold of 2000 patterns
+static void bench_quantized()
+{
+  {
+    const size_t pixels = 92*112, images = 400;
+    Eigenfaces eig;
+    Matrix faces(pixels, images), points, qpoints;
+    fill_random(faces);
+    for (size_t j=0; j<images; ++j)
+      eig.addImage(faces.getCol(j));
+    eig.calculateEigenvalues();
+    eig.calculateEigenfaces(50);
+
+    QuantizedEigenfaces qeig;
+    qeig.compile(eig);
+
+    Chrono chrono;
+    eig.projectBatch(faces, points);
+    printf("double projection: %.6f secs\n", chrono.elapsed());
+
+    chrono.reset();
+    qeig.projectBatch(faces, qpoints);
+    printf("int8 projection:   %.6f secs\n", chrono.elapsed());
+  }
+
+  {
+    const size_t n = 2000;
+    MlpArray array;
+    for (size_t c=0; c<40; ++c) {
+      Mlp net(50, 10, 1);
+      net.initRandom(-1.0, 1.0);
+      array.add(net);
+    }
+
+    QuantizedMlp qarray;
+    qarray.compile(array);
+
+    Matrix batch(50, n), outputs, qoutputs;
+    fill_random(batch);
+
+    Chrono chrono;
+    array.recallBatch(batch, outputs);
+    printf("double recall:     %.6f secs\n", chrono.elapsed());
+
+    chrono.reset();
+    qarray.recallBatch(batch, qoutputs);
+    printf("int8 recall:       %.6f secs (max error %g)\n",
+	   chrono.elapsed(), max_error(outputs, qoutputs));
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+  std::srand(0);
+
+  test_quantized_mlp();
+  test_quantized_array();
+  test_quantized_classification();
+  test_quantized_eigenfaces();
+
+  bench_quantized();
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#include "Ann.h"
+#include "Eigenfaces.h"
+#include "Recognizer.h"
+#include "Random.h"
+#include "Chrono.h"
+
+using namespace std;
+
+static const size_t pixels = 300, images = 30, components = 8;
+
+static bool near(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-9 * (1.0 + std::fabs(a) + std::fabs(b));
+}
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal();
+}
+
+// Eigenfaces of random images, and the min/max of their projections
+// (as ann.Normalizer)
+static void create_eigenfaces(const Matrix& faces, Eigenfaces& eig,
+			      Vector& normalMin, Vector& normalMax)
+{
+  for (size_t j=0; j<faces.cols(); ++j)
+    eig.addImage(faces.getCol(j));
+  bool ok = eig.calculateEigenvalues();
+  assert(ok);
+  eig.calculateEigenfaces(components);
+
+  Matrix points;
+  eig.projectBatch(faces, points);
+  normalMin = normalMax = points.getCol(0);
+  for (size_t j=1; j<points.cols(); ++j)
+    for (size_t i=0; i<components; ++i) {
+      normalMin(i) = std::min(normalMin(i), points(i, j));
+      normalMax(i) = std::max(normalMax(i), points(i, j));
+    }
+}
+
+// The steps of the recognition without the recognizer: projection,
+// normalization and the networks
+static void old_recall(const Eigenfaces& eig,
+		       const Vector& normalMin, const Vector& normalMax,
+		       const MlpArray& array, const Vector& image, Vector& output)
+{
+  Vector point;
+  eig.projectInEigenspace(image, point);
+  for (size_t i=0; i<components; ++i)
+    point(i) = 2.0 * ((point(i) - normalMin(i)) / (normalMax(i) - normalMin(i))) - 1.0;
+  array.recall(point, output);
+}
+
+static void check_recognizer(const Recognizer& r, const Eigenfaces& eig,
+			     const Vector& normalMin, const Vector& normalMax,
+			     const MlpArray& array, const Matrix& faces)
+{
+  Matrix outputs;
+  r.recallBatch(faces, outputs, 2);
+  assert(outputs.rows() == array.getOutputs() && outputs.cols() == faces.cols());
+
+  vector<size_t> subjects;
+  r.recognizeBatch(faces, subjects);
+  assert(subjects.size() == faces.cols());
+
+  Vector image, output, expected;
+  for (size_t j=0; j<faces.cols(); ++j) {
+    image = faces.getCol(j);
+    old_recall(eig, normalMin, normalMax, array, image, expected);
+    r.recall(image, output);
+
+    for (size_t k=0; k<expected.size(); ++k) {
+      assert(near(output(k), expected(k)));
+      assert(near(outputs(k, j), expected(k)));
+    }
+    assert(subjects[j] == outputs.getCol(j).getMaxPos());
+  }
+
+  // Binary I/O
+  stringstream s;
+  r.write(s);
+  Recognizer r2;
+  r2.read(s);
+  assert(r2.isFused() == r.isFused());
+  assert(r2.getPixelsPerImage() == pixels);
+
+  Matrix outputs2;
+  r2.recallBatch(faces, outputs2, 2);
+  assert(outputs2 == outputs);
+}
+
+// Networks with less hidden neurons than eigenfaces receive the
+// pixels directly
+static void test_fused()
+{
+  Matrix faces(pixels, images);
+  fill_random(faces);
+
+  Eigenfaces eig;
+  Vector normalMin, normalMax;
+  create_eigenfaces(faces, eig, normalMin, normalMax);
+
+  Mlp net(components, 5, 3);
+  net.setHiddenActivationFunction(Tansig());
+  net.initRandom(-1.0, 1.0);
+
+  Recognizer r;
+  r.compile(eig, normalMin, normalMax, net);
+  assert(r.isFused());
+  assert(r.getArray().getInputs() == pixels);
+  assert(r.getOutputs() == 3);
+
+  MlpArray array;
+  array.add(net);
+  check_recognizer(r, eig, normalMin, normalMax, array, faces);
+}
+
+// An array with more hidden neurons than eigenfaces keeps the
+// projection (only the mean face and the normalization are moved to
+// the first layers)
+static void test_not_fused()
+{
+  Matrix faces(pixels, images);
+  fill_random(faces);
+
+  Eigenfaces eig;
+  Vector normalMin, normalMax;
+  create_eigenfaces(faces, eig, normalMin, normalMax);
+
+  MlpArray array;
+  for (size_t c=0; c<4; ++c) {
+    Mlp net(components, 4, 1);
+    net.initRandom(-1.0, 1.0);
+    array.add(net);
+  }
+
+  Recognizer r;
+  r.compile(eig, normalMin, normalMax, array);
+  assert(!r.isFused());
+  assert(r.getArray().getInputs() == components);
+  assert(r.getOutputs() == 4);
+
+  check_recognizer(r, eig, normalMin, normalMax, array, faces);
+}
+
+// Recognition of 400 ORL images (92x112 pixels) with 50 eigenfaces
+// and a network of 40 hidden neurons
+static void bench_recognizer()
+{
+  const size_t pixels = 92*112, images = 400, components = 50;
+  Matrix faces(pixels, images), points, outputs;
+  fill_random(faces);
+
+  Eigenfaces eig;
+  for (size_t j=0; j<images; ++j)
+    eig.addImage(faces.getCol(j));
+  eig.calculateEigenvalues();
+  eig.calculateEigenfaces(components);
+
+  Vector normalMin(components), normalMax(components);
+  for (size_t i=0; i<components; ++i) {
+    normalMin(i) = -1.0;
+    normalMax(i) = 1.0;
+  }
+
+  Mlp net(components, 40, 40);
+  net.initRandom(-1.0, 1.0);
+  Recognizer r;
+  r.compile(eig, normalMin, normalMax, net);
+
+  Chrono chrono;
+  for (size_t j=0; j<images; ++j) {
+    Vector point, hidden, output;
+    eig.projectInEigenspace(faces.getCol(j), point);
+    net.recall(point, hidden, output);
+  }
+  printf("projection + mlp, one image each time: %.6f secs\n", chrono.elapsed());
+
+  chrono.reset();
+  for (size_t j=0; j<images; ++j) {
+    Vector output;
+    r.recall(faces.getCol(j), output);
+  }
+  printf("recognizer, one image each time:       %.6f secs\n", chrono.elapsed());
+
+  chrono.reset();
+  eig.projectBatch(faces, points);
+  net.recallBatch(points, outputs);
+  printf("projection + mlp, all images at once:  %.6f secs\n", chrono.elapsed());
+
+  chrono.reset();
+  r.recallBatch(faces, outputs);
+  printf("recognizer, all images at once:        %.6f secs\n", chrono.elapsed());
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_fused();
+  test_not_fused();
+
+  bench_recognizer();
+  return 0;
+}
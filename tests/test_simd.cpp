@@ -0,0 +1,234 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "Simd.h"
+#include "Random.h"
+
+using namespace std;
+
+static void fill_random(vector<double>& v)
+{
+  for (size_t i=0; i<v.size(); ++i)
+    v[i] = Random::getReal() - 0.5;
+}
+
+static bool same_bits(const vector<double>& a, const vector<double>& b)
+{
+  return a == b;
+}
+
+static bool approx(const vector<double>& a, const vector<double>& b)
+{
+  for (size_t i=0; i<a.size(); ++i)
+    if (!approx_eq(a[i], b[i], 10))
+      return false;
+  return true;
+}
+
+/// Old row by row Matrix::multiply(const Vector&, Vector&).
+///
+static void old_gemv(size_t m, size_t n, const double* A,
+		     const double* x, double* y)
+{
+  for (size_t i=0; i<m; ++i) {
+    double r = 0.0;
+    for (size_t j=0; j<n; ++j)
+      r += A[i+j*m] * x[j];
+    y[i] = r;
+  }
+}
+
+/// The scalar kernels must give exactly the same results as the old
+/// loops of Vector and Matrix.
+///
+static void test_scalar_is_exact(size_t m, size_t n)
+{
+  const SimdKernels* k = simd_kernels(SimdScalar);
+  assert(k != NULL);
+
+  vector<double> A(m*n), x(n), y(m), ref(m);
+  fill_random(A);
+  fill_random(x);
+
+  k->gemv(m, n, &A[0], m, &x[0], &y[0]);
+  old_gemv(m, n, &A[0], &x[0], &ref[0]);
+  assert(same_bits(y, ref));
+
+  double r = 0.0;
+  for (size_t i=0; i<n; ++i)
+    r += x[i]*x[i];
+  assert(k->dot(n, &x[0], &x[0]) == r);
+}
+
+/// Compares the kernels of the given level with the scalar ones.
+///
+static void test_kernels(const SimdKernels* k, size_t m, size_t n)
+{
+  const SimdKernels* s = simd_kernels(SimdScalar);
+
+  vector<double> A(m*n), x(m), y(m), z1(m), z2(m), u(n), v1(n), v2(n);
+  fill_random(A);
+  fill_random(x);
+  fill_random(y);
+  fill_random(u);
+
+  // Element-wise operations: bit for bit
+  k->add(m, &x[0], &y[0], &z1[0]);
+  s->add(m, &x[0], &y[0], &z2[0]);
+  assert(same_bits(z1, z2));
+
+  k->sub(m, &x[0], &y[0], &z1[0]);
+  s->sub(m, &x[0], &y[0], &z2[0]);
+  assert(same_bits(z1, z2));
+
+  k->scale(m, 0.3, &x[0], &z1[0]);
+  s->scale(m, 0.3, &x[0], &z2[0]);
+  assert(same_bits(z1, z2));
+
+  // In-place (output aliased with the input)
+  z1 = x; z2 = x;
+  k->add(m, &z1[0], &y[0], &z1[0]);
+  s->add(m, &z2[0], &y[0], &z2[0]);
+  assert(same_bits(z1, z2));
+
+  // Accumulations: with tolerance
+  assert(approx_eq(k->dot(m, &x[0], &y[0]),
+		   s->dot(m, &x[0], &y[0]), 10));
+
+  z1 = y; z2 = y;
+  k->axpy(m, -1.7, &x[0], &z1[0]);
+  s->axpy(m, -1.7, &x[0], &z2[0]);
+  assert(approx(z1, z2));
+
+  k->gemv(m, n, &A[0], m, &u[0], &z1[0]);
+  s->gemv(m, n, &A[0], m, &u[0], &z2[0]);
+  assert(approx(z1, z2));
+
+  k->gemvT(m, n, &A[0], m, &x[0], &v1[0]);
+  s->gemvT(m, n, &A[0], m, &x[0], &v2[0]);
+  assert(approx(v1, v2));
+
+  // Single precision (compared with double results)
+  vector<float> xf(x.begin(), x.end()), yf(y.begin(), y.end());
+  double d = 0.0;
+  for (size_t i=0; i<m; ++i)
+    d += double(xf[i]) * yf[i];
+  assert(std::fabs(k->sdot(m, &xf[0], &yf[0]) - d) <= 1e-5 * (1.0 + m));
+
+  k->saxpy(m, -1.7f, &xf[0], &yf[0]);
+  for (size_t i=0; i<m; ++i)
+    assert(std::fabs(yf[i] - (float(y[i]) - 1.7f*float(x[i]))) <= 1e-6);
+
+  // 8-bit integers: exact
+  vector<signed char> xi(m), yi(m);
+  for (size_t i=0; i<m; ++i) {
+    xi[i] = (signed char)(std::rand() % 256 - 128);
+    yi[i] = (signed char)(std::rand() % 256 - 128);
+  }
+  if (m > 0) {
+    assert(k->i8dot(m, &xi[0], &yi[0]) == s->i8dot(m, &xi[0], &yi[0]));
+    assert(k->i8dot(m-1, &xi[1], &yi[0]) == s->i8dot(m-1, &xi[1], &yi[0]));
+  }
+
+  // Rows of the matrix are the first elements of xi
+  vector<signed char> Ai(xi.begin(), xi.begin() + (m/n)*n);
+  vector<int> r1(m/n+1), r2(m/n+1);
+  if (!Ai.empty()) {
+    k->i8gemv(m/n, n, &Ai[0], &yi[0], &r1[0]);
+    s->i8gemv(m/n, n, &Ai[0], &yi[0], &r2[0]);
+    assert(r1 == r2);
+  }
+}
+
+/// Polynomial exp and the activation kernels against the standard
+/// functions.
+///
+static void test_activations(const SimdKernels* k)
+{
+  const size_t n = 1001;
+  vector<double> x(n), y(n), z(n);
+  for (size_t i=0; i<n; ++i)
+    x[i] = 80.0 * (double(i) / (n-1) - 0.5);
+  x[0] = -1000.0;		// Out of the range of the polynomial
+  x[n-1] = 1000.0;
+
+  for (size_t i=1; i<n-1; ++i) {
+    double e = std::exp(x[i]*8.5);
+    assert(std::fabs(simd_exp(x[i]*8.5) - e) <= 1e-13 * e);
+  }
+
+  k->logsig(n, &x[0], &y[0]);
+  for (size_t i=0; i<n; ++i)
+    assert(std::fabs(y[i] - 1.0 / (1.0 + std::exp(-x[i]))) < 1e-13);
+
+  k->tansig(n, &x[0], &y[0]);
+  for (size_t i=0; i<n; ++i)
+    assert(std::fabs(y[i] - std::tanh(x[i])) < 1e-13);
+
+  // In-place
+  z = x;
+  k->logsig(n, &z[0], &z[0]);
+  k->logsig(n, &x[0], &y[0]);
+  assert(same_bits(y, z));
+}
+
+static void test_matrix_vector()
+{
+  Matrix A(5, 3);
+  Vector u(3), w(5), v, t;
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal();
+  for (size_t i=0; i<u.size(); ++i)
+    u(i) = Random::getReal();
+  for (size_t i=0; i<w.size(); ++i)
+    w(i) = Random::getReal();
+
+  // A^T*w
+  A.multiplyTransposed(w, v);
+  Matrix At = A.getTranspose();
+  At.multiply(w, t);
+  assert(approx_eq(v, t, 10));
+}
+
+int main(int argc, char *argv[])
+{
+  static const size_t sizes[] = { 1, 2, 3, 5, 7, 16, 17, 64, 103, 1001 };
+  static const SimdLevel levels[] = { SimdScalar, SimdSSE2, SimdAVX2 };
+  const size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  Random::init(0);
+  srand(0);
+
+  for (size_t i=0; i<nsizes; ++i)
+    for (size_t j=0; j<nsizes; j+=3)
+      test_scalar_is_exact(sizes[i], sizes[j]);
+
+  for (size_t l=0; l<sizeof(levels)/sizeof(levels[0]); ++l) {
+    const SimdKernels* k = simd_kernels(levels[l]);
+    if (!k) {
+      std::printf("%d level not supported by this CPU\n", (int)levels[l]);
+      continue;
+    }
+    std::printf("Testing %s kernels\n", k->name);
+
+    for (size_t i=0; i<nsizes; ++i)
+      for (size_t j=0; j<nsizes; j+=3)
+	test_kernels(k, sizes[i], sizes[j]);
+    test_activations(k);
+
+    simd_select(levels[l]);
+    test_matrix_vector();
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+// Copyright (C) 2008-2010 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <cassert>
+#include <sstream>
+
+#include "Matrix.h"
+#include "Vector.h"
+#include "MatrixView.h"
+#include "VectorView.h"
+#include "Random.h"
+
+using namespace std;
+
+static void fill_random(Matrix& A)
+{
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i)
+      A(i, j) = Random::getReal() - 0.5;
+}
+
+static void test_vector_views()
+{
+  Matrix A(4, 3);
+  fill_random(A);
+  const Matrix B = A;
+
+  // Columns and rows use the matrix memory
+  VectorView col = A.getCol(1);
+  VectorView row = A.getRow(2);
+  col(0) = 5.0;
+  row(2) = 7.0;
+  assert(A(0, 1) == 5.0);
+  assert(A(2, 2) == 7.0);
+  assert(row.stride() == A.rows());
+
+  // Same operations as Vector
+  Vector u = B.getRow(3);
+  assert(approx_eq(B.getRow(3).magnitude(), u.magnitude(), 10));
+  assert(B.getRow(3).getMaxPos() == u.getMaxPos());
+  assert(B.getRow(3).getMin() == u.getMin());
+  assert(B.getRow(3) == B.getRow(3));
+  assert(approx_eq(B.getRow(3) * B.getRow(3), u * u, 10));
+
+  // Element-wise operations over a strided view
+  A = B;
+  A.getRow(1) += B.getRow(0);
+  A.getRow(1) *= 2.0;
+  for (size_t j=0; j<A.cols(); ++j)
+    assert(A(1, j) == (B(1, j) + B(0, j)) * 2.0);
+
+  // Swap columns
+  A = B;
+  A.getCol(0).swap(A.getCol(2));
+  for (size_t i=0; i<A.rows(); ++i) {
+    assert(A(i, 0) == B(i, 2));
+    assert(A(i, 2) == B(i, 0));
+  }
+}
+
+static void test_aliasing()
+{
+  Matrix A(3, 3), B;
+  fill_random(A);
+  B = A;
+
+  // A row and a column of the same matrix share one element
+  A.getCol(0) = A.getRow(0) + A.getRow(1);
+  for (size_t i=0; i<3; ++i)
+    assert(A(i, 0) == B(0, i) + B(1, i));
+
+  // Matrix-vector product over its own column
+  A = B;
+  Vector u = B.getCol(1);
+  Vector v = B * u;
+  A.getCol(1) = A * A.getCol(1);
+  assert(approx_eq(Vector(A.getCol(1)), v, 10));
+}
+
+static void test_blocks()
+{
+  Matrix A(5, 6), B(2, 3);
+  fill_random(A);
+  fill_random(B);
+  const Matrix C = A;
+
+  MatrixView block = A.getBlock(1, 2, 2, 3);
+  assert(block.rows() == 2 && block.cols() == 3);
+
+  block = B;
+  for (size_t j=0; j<A.cols(); ++j)
+    for (size_t i=0; i<A.rows(); ++i) {
+      if (i >= 1 && i < 3 && j >= 2 && j < 5)
+	assert(A(i, j) == B(i-1, j-2));
+      else
+	assert(A(i, j) == C(i, j));
+    }
+
+  // Copy of a block
+  Matrix D = C.getBlock(1, 2, 2, 3);
+  block -= D;
+  block += 2.0 * D;
+  for (size_t j=0; j<B.cols(); ++j)
+    for (size_t i=0; i<B.rows(); ++i)
+      assert(approx_eq(A(i+1, j+2), B(i, j) + C(i+1, j+2), 10));
+
+  // Columns of a block
+  assert(block.getCol(1)(0) == A(1, 3));
+  assert(block.getRow(1)(2) == A(2, 4));
+  assert(block.getBlock(1, 1, 1, 2)(0, 1) == A(2, 4));
+
+  block.zero();
+  assert(A(1, 2) == 0.0 && A(2, 4) == 0.0);
+  assert(A(0, 2) == C(0, 2) && A(3, 4) == C(3, 4));
+}
+
+static void test_io()
+{
+  Matrix A(4, 5), B(2, 2);
+  fill_random(A);
+  fill_random(B);
+
+  // A view is written with the Vector/Matrix format
+  {
+    stringstream s;
+    A.getRow(2).write(s);
+    Vector u;
+    u.read(s);
+    assert(u == Vector(A.getRow(2)));
+  }
+  {
+    stringstream s;
+    A.getBlock(1, 1, 2, 3).write(s);
+    Matrix C;
+    C.read(s);
+    assert(C == Matrix(A.getBlock(1, 1, 2, 3)));
+  }
+
+  // Read directly in the matrix memory
+  {
+    stringstream s;
+    B.write(s);
+    A.getBlock(2, 3, 2, 2).read(s);
+    assert(A(2, 3) == B(0, 0) && A(3, 4) == B(1, 1));
+  }
+  {
+    stringstream s;
+    Vector u(4);
+    u(0) = 1; u(1) = 2; u(2) = 3; u(3) = 4;
+    u.write(s);
+    A.getCol(0).read(s);
+    assert(Vector(A.getCol(0)) == u);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  Random::init(0);
+
+  test_vector_views();
+  test_aliasing();
+  test_blocks();
+  test_io();
+  return 0;
+}